@@ -5,6 +5,8 @@ noinst_HEADERS +=\
 	api/emptypostlist.h\
 	api/leafpostlist.h\
 	api/maptermlist.h\
+	api/matchprofileinternal.h\
+	api/msetcache.h\
 	api/omenquireinternal.h\
 	api/postlist.h\
 	api/queryinternal.h\
@@ -29,7 +31,9 @@ lib_src +=\
 	api/expanddecider.cc\
 	api/keymaker.cc\
 	api/leafpostlist.cc\
+	api/matchprofile.cc\
 	api/matchspy.cc\
+	api/msetcache.cc\
 	api/omdatabase.cc\
 	api/omdocument.cc\
 	api/omenquire.cc\
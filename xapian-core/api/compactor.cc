@@ -89,6 +89,8 @@ class Compactor::Internal : public Xapian::Internal::intrusive_base {
     string destdir;
     bool renumber;
     bool multipass;
+    bool pack_postlists;
+    unsigned threads;
     int compact_to_stub;
     size_t block_size;
     compaction_level compaction;
@@ -105,8 +107,8 @@ class Compactor::Internal : public Xapian::Internal::intrusive_base {
     vector<pair<Xapian::docid, Xapian::docid> > used_ranges;
   public:
     Internal()
-	: renumber(true), multipass(false),
-	  block_size(8192), compaction(FULL), tot_off(0),
+	: renumber(true), multipass(false), pack_postlists(false),
+	  threads(1), block_size(8192), compaction(FULL), tot_off(0),
 	  last_docid(0), backend(UNKNOWN)
     {
     }
@@ -140,6 +142,18 @@ Compactor::set_multipass(bool multipass)
     internal->multipass = multipass;
 }
 
+void
+Compactor::set_pack_postlists(bool pack_postlists)
+{
+    internal->pack_postlists = pack_postlists;
+}
+
+void
+Compactor::set_threads(unsigned threads)
+{
+    internal->threads = threads;
+}
+
 void
 Compactor::set_compaction_level(compaction_level compaction)
 {
@@ -461,7 +475,8 @@ Compactor::Internal::compact(Xapian::Compactor & compactor)
     } else if (backend == BRASS) {
 #ifdef XAPIAN_HAS_BRASS_BACKEND
 	compact_brass(compactor, destdir.c_str(), sources, offset, block_size,
-		      compaction, multipass, last_docid);
+		      compaction, multipass, pack_postlists, threads,
+		      last_docid);
 #else
 	(void)compactor;
 	throw Xapian::FeatureUnavailableError("Brass backend disabled at build time");
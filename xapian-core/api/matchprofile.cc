@@ -0,0 +1,206 @@
+/** @file matchprofile.cc
+ * @brief Information about where a match spent its time
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include "xapian/matchprofile.h"
+#include "matchprofileinternal.h"
+
+#include "xapian/error.h"
+
+#include "str.h"
+
+using namespace std;
+
+/// Append " <name>=<count>" to @a desc if @a count is non-zero.
+static void
+append_count(string & desc, const char * name, unsigned long count)
+{
+    if (count == 0) return;
+    desc += ' ';
+    desc += name;
+    desc += '=';
+    desc += str(count);
+}
+
+/// Append a time in seconds to @a desc, in whole microseconds.
+static void
+append_time(string & desc, double time)
+{
+    desc += str((unsigned long)(time * 1e6 + 0.5));
+    desc += "us";
+}
+
+namespace Xapian {
+
+MatchProfile::MatchProfile(Internal * internal_) : internal(internal_) { }
+
+MatchProfile::MatchProfile() { }
+
+MatchProfile::~MatchProfile() { }
+
+MatchProfile::MatchProfile(const MatchProfile & other)
+    : internal(other.internal) { }
+
+void
+MatchProfile::operator=(const MatchProfile & other)
+{
+    internal = other.internal;
+}
+
+size_t
+MatchProfile::get_node_count() const
+{
+    return internal.get() ? internal->nodes.size() : 0;
+}
+
+MatchProfile::Node
+MatchProfile::get_node(size_t i) const
+{
+    if (i >= get_node_count())
+	throw Xapian::RangeError("MatchProfile node index out of range");
+    return Node(*this, i);
+}
+
+double
+MatchProfile::get_total_time() const
+{
+    return internal.get() ? internal->total_time : 0;
+}
+
+Xapian::doccount
+MatchProfile::get_collapse_keys() const
+{
+    return internal.get() ? internal->collapse_keys : 0;
+}
+
+Xapian::doccount
+MatchProfile::get_collapse_buckets() const
+{
+    return internal.get() ? internal->collapse_buckets : 0;
+}
+
+Xapian::doccount
+MatchProfile::get_collapse_peak_keys() const
+{
+    return internal.get() ? internal->collapse_peak_keys : 0;
+}
+
+Xapian::doccount
+MatchProfile::get_collapse_keys_forgotten() const
+{
+    return internal.get() ? internal->collapse_keys_forgotten : 0;
+}
+
+string
+MatchProfile::get_description() const
+{
+    string desc = "total: ";
+    append_time(desc, get_total_time());
+    if (!internal.get()) {
+	desc += '\n';
+	return desc;
+    }
+    if (internal->collapse_buckets) {
+	append_count(desc, "collapse_keys", internal->collapse_keys);
+	append_count(desc, "collapse_buckets", internal->collapse_buckets);
+	append_count(desc, "collapse_peak_keys", internal->collapse_peak_keys);
+	append_count(desc, "collapse_forgotten",
+		     internal->collapse_keys_forgotten);
+    }
+    desc += '\n';
+    vector<Internal::Node>::const_iterator i;
+    for (i = internal->nodes.begin(); i != internal->nodes.end(); ++i) {
+	desc.append(2 * (i->depth + 1), ' ');
+	desc += i->description;
+	desc += ": ";
+	append_time(desc, i->time);
+	append_count(desc, "est", i->termfreq_est);
+	append_count(desc, "next", i->next_calls);
+	append_count(desc, "skip_to", i->skip_to_calls);
+	append_count(desc, "check", i->check_calls);
+	append_count(desc, "docs", i->docs);
+	append_count(desc, "poslists", i->position_lists_opened);
+	append_count(desc, "recalc", i->recalc_maxweight_calls);
+	desc += '\n';
+    }
+    return desc;
+}
+
+string
+MatchProfile::Node::get_description() const
+{
+    return profile.internal->nodes[index].description;
+}
+
+unsigned
+MatchProfile::Node::get_depth() const
+{
+    return profile.internal->nodes[index].depth;
+}
+
+Xapian::doccount
+MatchProfile::Node::get_termfreq_est() const
+{
+    return profile.internal->nodes[index].termfreq_est;
+}
+
+unsigned long
+MatchProfile::Node::get_next_calls() const
+{
+    return profile.internal->nodes[index].next_calls;
+}
+
+unsigned long
+MatchProfile::Node::get_skip_to_calls() const
+{
+    return profile.internal->nodes[index].skip_to_calls;
+}
+
+unsigned long
+MatchProfile::Node::get_check_calls() const
+{
+    return profile.internal->nodes[index].check_calls;
+}
+
+unsigned long
+MatchProfile::Node::get_docs() const
+{
+    return profile.internal->nodes[index].docs;
+}
+
+unsigned long
+MatchProfile::Node::get_position_lists_opened() const
+{
+    return profile.internal->nodes[index].position_lists_opened;
+}
+
+unsigned long
+MatchProfile::Node::get_recalc_maxweight_calls() const
+{
+    return profile.internal->nodes[index].recalc_maxweight_calls;
+}
+
+double
+MatchProfile::Node::get_time() const
+{
+    return profile.internal->nodes[index].time;
+}
+
+}
@@ -0,0 +1,78 @@
+/** @file matchprofileinternal.h
+ * @brief Internals of Xapian::MatchProfile
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#ifndef XAPIAN_INCLUDED_MATCHPROFILEINTERNAL_H
+#define XAPIAN_INCLUDED_MATCHPROFILEINTERNAL_H
+
+#include "xapian/matchprofile.h"
+
+#include <string>
+#include <vector>
+
+/// The counts which a match records while it runs.
+class Xapian::MatchProfile::Internal : public Xapian::Internal::intrusive_base {
+  public:
+    /// The counts for one node of the postlist tree.
+    struct Node {
+	std::string description;
+
+	unsigned depth;
+
+	Xapian::doccount termfreq_est;
+
+	unsigned long next_calls;
+
+	unsigned long skip_to_calls;
+
+	unsigned long check_calls;
+
+	unsigned long docs;
+
+	unsigned long position_lists_opened;
+
+	unsigned long recalc_maxweight_calls;
+
+	double time;
+
+	/// Construct a Node with all counts zero.
+	Node(const std::string & description_, unsigned depth_)
+	    : description(description_), depth(depth_), termfreq_est(0),
+	      next_calls(0), skip_to_calls(0), check_calls(0), docs(0),
+	      position_lists_opened(0), recalc_maxweight_calls(0), time(0) { }
+    };
+
+    /// The nodes of the postlist trees, in the order described for get_node().
+    std::vector<Node> nodes;
+
+    double total_time;
+
+    Xapian::doccount collapse_keys;
+
+    Xapian::doccount collapse_buckets;
+
+    Xapian::doccount collapse_peak_keys;
+
+    Xapian::doccount collapse_keys_forgotten;
+
+    Internal()
+	: total_time(0), collapse_keys(0), collapse_buckets(0),
+	  collapse_peak_keys(0), collapse_keys_forgotten(0) { }
+};
+
+#endif // XAPIAN_INCLUDED_MATCHPROFILEINTERNAL_H
@@ -28,12 +28,14 @@
 #include <xapian/queryparser.h>
 #include <xapian/registry.h>
 
+#include <algorithm>
 #include <map>
 #include <string>
 #include <vector>
 
 #include "autoptr.h"
 #include "debuglog.h"
+#include "internaltypes.h"
 #include "noreturn.h"
 #include "omassert.h"
 #include "net/length.h"
@@ -90,6 +92,11 @@ static void unsupported_method() {
     throw Xapian::InvalidOperationError("Method not supported for this type of termlist");
 }
 
+static void flush_counts(ValueCountMatchSpy::Internal & spy);
+
+static Xapian::doccount
+scale_freq(const ValueCountMatchSpy::Internal & spy, Xapian::doccount freq);
+
 /// A termlist iterator over the contents of a ValueCountMatchSpy
 class ValueCountTermList : public TermList {
   private:
@@ -99,6 +106,7 @@ class ValueCountTermList : public TermList {
   public:
 
     ValueCountTermList(ValueCountMatchSpy::Internal * spy_) : spy(spy_) {
+	flush_counts(*spy);
 	it = spy->values.begin();
 	started = false;
     }
@@ -112,7 +120,7 @@ class ValueCountTermList : public TermList {
     Xapian::doccount get_termfreq() const {
 	Assert(started);
 	Assert(!at_end());
-	return it->second;
+	return scale_freq(*spy, it->second);
     }
 
     TermList * next() {
@@ -154,11 +162,12 @@ class StringAndFrequency {
     Xapian::doccount frequency;
   public:
     /// Construct a StringAndFrequency object.
-    StringAndFrequency(std::string str_, Xapian::doccount frequency_)
+    StringAndFrequency(const std::string & str_,
+		       Xapian::doccount frequency_)
 	    : str(str_), frequency(frequency_) {}
 
     /// Return the string.
-    std::string get_string() const { return str; }
+    const std::string & get_string() const { return str; }
 
     /// Return the frequency.
     Xapian::doccount get_frequency() const { return frequency; }
@@ -245,63 +254,364 @@ class StringAndFreqTermList : public TermList {
     Xapian::termcount positionlist_count() const { unsupported_method(); return 0; }
 };
 
-/** Get the most frequent items from a map from string to frequency.
- *
- *  This takes input such as that in ValueCountMatchSpy::Internal::values and
- *  returns a vector of the most frequent items in the input.
- *
- *  @param result A vector which will be filled with the most frequent
- *                items, in descending order of frequency.  Items with
- *                the same frequency will be sorted in ascending
- *                alphabetical order.
+/** Select the most frequent of a series of items.
  *
- *  @param items The map from string to frequency, from which the most
- *               frequent items will be selected.
- *
- *  @param maxitems The maximum number of items to return.
+ *  The items are kept in a heap with the least frequent at the top, so we
+ *  only need to copy an item's string if it is more frequent than that.
  */
-static void
-get_most_frequent_items(vector<StringAndFrequency> & result,
-			const map<string, doccount> & items,
-			size_t maxitems)
-{
-    result.clear();
-    result.reserve(maxitems);
+class MostFrequentItems {
+    /// Don't allow assignment.
+    void operator=(const MostFrequentItems &);
+
+    /// Don't allow copying.
+    MostFrequentItems(const MostFrequentItems &);
+
+    vector<StringAndFrequency> & result;
+
+    size_t maxitems;
+
+    bool is_heap;
+
     StringAndFreqCmpByFreq cmpfn;
-    bool is_heap(false);
 
-    for (map<string, doccount>::const_iterator i = items.begin();
-	 i != items.end(); ++i) {
+  public:
+    /** Construct a MostFrequentItems object.
+     *
+     *  @param result_	A vector which will be filled with the most frequent
+     *			items, in descending order of frequency.  Items with
+     *			the same frequency will be sorted in ascending
+     *			alphabetical order.
+     *
+     *  @param maxitems_	The maximum number of items to return.
+     */
+    MostFrequentItems(vector<StringAndFrequency> & result_, size_t maxitems_)
+	: result(result_), maxitems(maxitems_), is_heap(false) {
+	result.clear();
+	result.reserve(maxitems);
+    }
+
+    /// Consider an item.
+    void add(const string & str, Xapian::doccount freq) {
 	Assert(result.size() <= maxitems);
-	result.push_back(StringAndFrequency(i->first, i->second));
-	if (result.size() > maxitems) {
-	    // Make the list back into a heap.
-	    if (is_heap) {
-		// Only the new element isn't in the right place.
-		push_heap(result.begin(), result.end(), cmpfn);
-	    } else {
+	if (result.size() == maxitems) {
+	    if (maxitems == 0) return;
+	    if (!is_heap) {
 		// Need to build heap from scratch.
 		make_heap(result.begin(), result.end(), cmpfn);
 		is_heap = true;
 	    }
+	    // Skip the item if it wouldn't displace the least frequent.
+	    const StringAndFrequency & worst = result.front();
+	    if (freq < worst.get_frequency()) return;
+	    if (freq == worst.get_frequency() && str >= worst.get_string())
+		return;
 	    pop_heap(result.begin(), result.end(), cmpfn);
-	    result.pop_back();
+	    result.back() = StringAndFrequency(str, freq);
+	    push_heap(result.begin(), result.end(), cmpfn);
+	    return;
 	}
+	result.push_back(StringAndFrequency(str, freq));
     }
 
-    if (is_heap) {
-	sort_heap(result.begin(), result.end(), cmpfn);
-    } else {
-	sort(result.begin(), result.end(), cmpfn);
+    /// Sort the selected items.
+    void finish() {
+	if (is_heap) {
+	    sort_heap(result.begin(), result.end(), cmpfn);
+	} else {
+	    sort(result.begin(), result.end(), cmpfn);
+	}
+    }
+};
+
+/** Value counts for a ValueCountMatchSpy which haven't been added to the map.
+ *
+ *  This also holds the sampling state, so none of it needs to be in the
+ *  public header.
+ *
+ *  Values of one byte (such as single character category codes) are counted
+ *  in an array indexed by the value.  Other values are counted in an
+ *  open-addressing hash table, so counting a document usually costs a hash
+ *  and one string comparison, rather than a string comparison at each level
+ *  of the map and a node allocation for each new value.  Once enough distinct
+ *  two byte values (such as small integers encoded with sortable_serialise())
+ *  have been seen, they're moved to an array indexed by the value too - it
+ *  has 65536 entries, so isn't worth allocating and scanning for a few.
+ */
+class ValueCountMatchSpy::Internal::Counts {
+    /// Don't allow assignment.
+    void operator=(const Counts &);
+
+    /// Don't allow copying.
+    Counts(const Counts &);
+
+    struct Entry {
+	std::string value;
+
+	/// The frequency, or 0 for an unused entry.
+	Xapian::doccount freq;
+
+	Entry() : freq(0) { }
+    };
+
+    /// Order pointers to entries by value.
+    struct EntryPtrCmp {
+	bool operator()(const Entry * a, const Entry * b) const {
+	    return a->value < b->value;
+	}
+    };
+
+    /// Counts for values of length 1, indexed by the byte.
+    vector<Xapian::doccount> one_byte;
+
+    /** Counts for values of length 2, indexed by their bytes (big-endian).
+     *
+     *  This is empty until TWO_BYTE_ARRAY_THRESHOLD distinct values of length
+     *  2 have been added to @a table.
+     */
+    vector<Xapian::doccount> two_byte;
+
+    /// Use @a two_byte once @a table has this many distinct values of length 2.
+    static const size_t TWO_BYTE_ARRAY_THRESHOLD = 256;
+
+    /// Hash table of counts for longer values (size is a power of 2).
+    vector<Entry> table;
+
+    /// The number of used entries in @a table.
+    size_t used;
+
+    /// The number of used entries in @a table with values of length 2.
+    size_t two_byte_used;
+
+    /// The index in @a two_byte for @a val, which must be of length 2.
+    static unsigned two_byte_index(const string & val) {
+	return (static_cast<unsigned char>(val[0]) << 8) |
+	       static_cast<unsigned char>(val[1]);
+    }
+
+    /// Hash a value (using 32-bit FNV-1a).
+    static uint4 hash(const string & val) {
+	uint4 h = 2166136261u;
+	for (string::const_iterator i = val.begin(); i != val.end(); ++i) {
+	    h ^= static_cast<unsigned char>(*i);
+	    h *= 16777619u;
+	}
+	return h;
+    }
+
+    /** Rebuild @a table with @a size entries.
+     *
+     *  If @a two_byte is in use, values of length 2 are moved to it.
+     */
+    void rehash(size_t size) {
+	vector<Entry> old(size);
+	swap(table, old);
+	used = two_byte_used = 0;
+	size_t mask = table.size() - 1;
+	for (vector<Entry>::iterator i = old.begin(); i != old.end(); ++i) {
+	    if (i->freq == 0) continue;
+	    if (i->value.size() == 2) {
+		if (!two_byte.empty()) {
+		    two_byte[two_byte_index(i->value)] += i->freq;
+		    continue;
+		}
+		++two_byte_used;
+	    }
+	    size_t j = hash(i->value) & mask;
+	    while (table[j].freq) j = (j + 1) & mask;
+	    swap(table[j].value, i->value);
+	    table[j].freq = i->freq;
+	    ++used;
+	}
+    }
+
+  public:
+    /// Count one in this many documents (1 to count them all).
+    Xapian::doccount sample_period;
+
+    /// The number of documents whose values were counted.
+    Xapian::doccount counted;
+
+    Counts(Xapian::doccount sample_period_, Xapian::doccount counted_)
+	: one_byte(256), used(0), two_byte_used(0),
+	  sample_period(sample_period_), counted(counted_) { }
+
+    void add(const string & val) {
+	switch (val.size()) {
+	    case 1:
+		++one_byte[static_cast<unsigned char>(val[0])];
+		return;
+	    case 2:
+		if (!two_byte.empty()) {
+		    ++two_byte[two_byte_index(val)];
+		    return;
+		}
+		break;
+	}
+	if ((used + 1) * 2 > table.size())
+	    rehash(table.empty() ? 32 : table.size() * 2);
+	size_t mask = table.size() - 1;
+	size_t j = hash(val) & mask;
+	while (true) {
+	    Entry & e = table[j];
+	    if (e.freq == 0) {
+		e.value = val;
+		e.freq = 1;
+		++used;
+		if (val.size() == 2 &&
+		    ++two_byte_used == TWO_BYTE_ARRAY_THRESHOLD) {
+		    two_byte.resize(0x10000);
+		    rehash(table.size());
+		}
+		return;
+	    }
+	    if (e.value == val) {
+		++e.freq;
+		return;
+	    }
+	    j = (j + 1) & mask;
+	}
     }
+
+    /// Pass each value and its count to @a top.
+    void get_most_frequent(MostFrequentItems & top) const {
+	for (unsigned i = 0; i != one_byte.size(); ++i) {
+	    if (one_byte[i]) top.add(string(1, char(i)), one_byte[i]);
+	}
+	for (unsigned i = 0; i != two_byte.size(); ++i) {
+	    if (two_byte[i] == 0) continue;
+	    char buf[2] = { char(i >> 8), char(i & 0xff) };
+	    top.add(string(buf, 2), two_byte[i]);
+	}
+	if (used == 0) return;
+	vector<Entry>::const_iterator i;
+	for (i = table.begin(); i != table.end(); ++i) {
+	    if (i->freq) top.add(i->value, i->freq);
+	}
+    }
+
+    /// Add the counts to @a values and reset them.
+    void flush_to(map<string, Xapian::doccount> & values) {
+	for (unsigned i = 0; i != one_byte.size(); ++i) {
+	    if (one_byte[i] == 0) continue;
+	    values[string(1, char(i))] += one_byte[i];
+	    one_byte[i] = 0;
+	}
+	for (unsigned i = 0; i != two_byte.size(); ++i) {
+	    if (two_byte[i] == 0) continue;
+	    char buf[2] = { char(i >> 8), char(i & 0xff) };
+	    values[string(buf, 2)] += two_byte[i];
+	    two_byte[i] = 0;
+	}
+	if (used == 0) return;
+	// Add the values in sorted order, so we can give the map a hint where
+	// each goes, which is much cheaper than a full lookup.
+	vector<Entry *> sorted;
+	sorted.reserve(used);
+	for (vector<Entry>::iterator i = table.begin(); i != table.end(); ++i) {
+	    if (i->freq) sorted.push_back(&*i);
+	}
+	sort(sorted.begin(), sorted.end(), EntryPtrCmp());
+	map<string, Xapian::doccount>::iterator hint = values.begin();
+	vector<Entry *>::const_iterator j;
+	for (j = sorted.begin(); j != sorted.end(); ++j) {
+	    Entry & e = **j;
+	    while (hint != values.end() && hint->first < e.value) ++hint;
+	    if (hint != values.end() && hint->first == e.value) {
+		hint->second += e.freq;
+	    } else {
+		hint = values.insert(hint, make_pair(e.value, e.freq));
+	    }
+	    e.freq = 0;
+	}
+	used = two_byte_used = 0;
+    }
+
+};
+
+ValueCountMatchSpy::Internal::~Internal()
+{
+    delete counts;
+}
+
+/// Return the pending counts of @a spy, creating them if necessary.
+static ValueCountMatchSpy::Internal::Counts &
+get_counts(ValueCountMatchSpy::Internal & spy)
+{
+    if (!spy.counts) {
+	// So far every document seen has been counted.
+	spy.counts = new ValueCountMatchSpy::Internal::Counts(1, spy.total);
+    }
+    return *spy.counts;
+}
+
+/// Add the pending counts of @a spy to its values map.
+static void
+flush_counts(ValueCountMatchSpy::Internal & spy)
+{
+    if (spy.counts) spy.counts->flush_to(spy.values);
+}
+
+/// Return one in how many documents @a spy counts.
+static inline Xapian::doccount
+get_sample_period(const ValueCountMatchSpy::Internal & spy)
+{
+    return spy.counts ? spy.counts->sample_period : 1;
+}
+
+/// Return the number of documents whose values @a spy counted.
+static inline Xapian::doccount
+get_counted(const ValueCountMatchSpy::Internal & spy)
+{
+    return spy.counts ? spy.counts->counted : spy.total;
+}
+
+/// Scale frequency @a freq up if @a spy only counted a sample.
+static Xapian::doccount
+scale_freq(const ValueCountMatchSpy::Internal & spy, Xapian::doccount freq)
+{
+    Xapian::doccount n = get_counted(spy);
+    if (n == spy.total || n == 0 || freq == 0) return freq;
+    double est = double(freq) * spy.total / n;
+    return max(Xapian::doccount(1), Xapian::doccount(est + 0.5));
+}
+
+/** Decide if document @a did is in a sample of one in @a period documents.
+ *
+ *  We use a multiplicative hash of the docid so that documents with
+ *  regularly spaced docids aren't over or under represented.
+ */
+static inline bool
+in_sample(Xapian::docid did, Xapian::doccount period)
+{
+    const uint8 mult = (uint8(0x9e3779b9) << 32) | 0x7f4a7c15;
+    return ((uint8(did) * mult) >> 32) % period == 0;
+}
+
+ValueCountMatchSpy::ValueCountMatchSpy(Xapian::valueno slot_)
+    : internal(new Internal(slot_))
+{
+}
+
+ValueCountMatchSpy::ValueCountMatchSpy(Xapian::valueno slot_,
+				       Xapian::doccount sample_period_)
+    : internal(new Internal(slot_))
+{
+    if (sample_period_ > 1)
+	internal->counts = new Internal::Counts(sample_period_, 0);
 }
 
 void
 ValueCountMatchSpy::operator()(const Document &doc, double) {
     Assert(internal.get());
+    Internal::Counts & counts = get_counts(*internal);
     ++(internal->total);
+    if (counts.sample_period > 1 &&
+	!in_sample(doc.get_docid(), counts.sample_period)) {
+	return;
+    }
+    ++counts.counted;
     string val(doc.get_value(internal->slot));
-    if (!val.empty()) ++(internal->values[val]);
+    if (!val.empty()) counts.add(val);
 }
 
 TermIterator
@@ -317,7 +627,30 @@ ValueCountMatchSpy::top_values_begin(size_t maxvalues) const
 {
     Assert(internal.get());
     AutoPtr<StringAndFreqTermList> termlist(new StringAndFreqTermList);
-    get_most_frequent_items(termlist->values, internal->values, maxvalues);
+    MostFrequentItems top(termlist->values, maxvalues);
+    if (internal->values.empty() && internal->counts) {
+	// All the counts are pending, so select from them directly rather
+	// than building the map.
+	internal->counts->get_most_frequent(top);
+    } else {
+	flush_counts(*internal);
+	map<string, doccount>::const_iterator i;
+	for (i = internal->values.begin(); i != internal->values.end(); ++i) {
+	    top.add(i->first, i->second);
+	}
+    }
+    top.finish();
+    if (get_counted(*internal) != internal->total) {
+	// Only a sample was counted, so scale up the frequencies.  Scaling
+	// can make frequencies equal, so sort again to order those by value.
+	vector<StringAndFrequency> & v = termlist->values;
+	vector<StringAndFrequency>::iterator i;
+	for (i = v.begin(); i != v.end(); ++i) {
+	    *i = StringAndFrequency(i->get_string(),
+				    scale_freq(*internal, i->get_frequency()));
+	}
+	sort(v.begin(), v.end(), StringAndFreqCmpByFreq());
+    }
     termlist->init();
     return Xapian::TermIterator(termlist.release());
 }
@@ -325,7 +658,8 @@ ValueCountMatchSpy::top_values_begin(size_t maxvalues) const
 MatchSpy *
 ValueCountMatchSpy::clone() const {
     Assert(internal.get());
-    return new ValueCountMatchSpy(internal->slot);
+    return new ValueCountMatchSpy(internal->slot,
+				  get_sample_period(*internal));
 }
 
 string
@@ -338,6 +672,8 @@ ValueCountMatchSpy::serialise() const {
     Assert(internal.get());
     string result;
     result += encode_length(internal->slot);
+    if (get_sample_period(*internal) > 1)
+	result += encode_length(get_sample_period(*internal));
     return result;
 }
 
@@ -348,17 +684,20 @@ ValueCountMatchSpy::unserialise(const string & s, const Registry &) const
     const char * end = p + s.size();
 
     valueno new_slot = decode_length(&p, end, false);
+    doccount new_sample_period = 1;
+    if (p != end) new_sample_period = decode_length(&p, end, false);
     if (p != end) {
 	throw NetworkError("Junk at end of serialised ValueCountMatchSpy");
     }
 
-    return new ValueCountMatchSpy(new_slot);
+    return new ValueCountMatchSpy(new_slot, new_sample_period);
 }
 
 string
 ValueCountMatchSpy::serialise_results() const {
     LOGCALL(REMOTE, string, "ValueCountMatchSpy::serialise_results", NO_ARGS);
     Assert(internal.get());
+    flush_counts(*internal);
     string result;
     result += encode_length(internal->total);
     result += encode_length(internal->values.size());
@@ -368,6 +707,9 @@ ValueCountMatchSpy::serialise_results() const {
 	result += i->first;
 	result += encode_length(i->second);
     }
+    // The number of documents counted is only needed if we're sampling.
+    if (get_counted(*internal) != internal->total)
+	result += encode_length(get_counted(*internal));
     RETURN(result);
 }
 
@@ -378,25 +720,35 @@ ValueCountMatchSpy::merge_results(const string & s) {
     const char * p = s.data();
     const char * end = p + s.size();
 
-    internal->total += decode_length(&p, end, false);
+    doccount total = decode_length(&p, end, false);
+    // Create the counts before updating total, so they record that every
+    // document seen so far was counted.
+    Internal::Counts & counts = get_counts(*internal);
+    internal->total += total;
 
     map<string, doccount>::size_type items = decode_length(&p, end, false);
-    while (p != end) {
-	while (items != 0) {
-	    size_t vallen = decode_length(&p, end, true);
-	    string val(p, vallen);
-	    p += vallen;
-	    doccount freq = decode_length(&p, end, false);
-	    internal->values[val] += freq;
-	    --items;
-	}
+    while (items != 0) {
+	size_t vallen = decode_length(&p, end, true);
+	string val(p, vallen);
+	p += vallen;
+	doccount freq = decode_length(&p, end, false);
+	internal->values[val] += freq;
+	--items;
+    }
+
+    doccount counted = total;
+    if (p != end) counted = decode_length(&p, end, false);
+    if (p != end) {
+	throw NetworkError("Junk at end of serialised ValueCountMatchSpy results");
     }
+    counts.counted += counted;
 }
 
 string
 ValueCountMatchSpy::get_description() const {
     string d = "ValueCountMatchSpy(";
     if (internal.get()) {
+	flush_counts(*internal);
 	d += str(internal->total);
 	d += " docs seen, looking in ";
 	d += str(internal->values.size());
@@ -0,0 +1,251 @@
+/** @file msetcache.cc
+ * @brief Process-wide cache of match results.
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include "msetcache.h"
+
+#include "xapian/cache.h"
+
+#include "debuglog.h"
+#include "omassert.h"
+#include "omenquireinternal.h"
+
+#include <cstdlib>
+
+using namespace std;
+
+/// The process-wide instance.
+static SharedMSetCache shared_mset_cache;
+
+/** Make a copy of @a mset which shares no state with it.
+ *
+ *  The copy doesn't point to an Enquire object, and has no cached documents.
+ */
+static Xapian::MSet
+copy_mset(const Xapian::MSet & mset)
+{
+    const Xapian::MSet::Internal & src = *mset.internal;
+    vector<Xapian::Internal::MSetItem> items(src.items);
+    return Xapian::MSet(new Xapian::MSet::Internal(
+				       src.firstitem,
+				       src.matches_upper_bound,
+				       src.matches_lower_bound,
+				       src.matches_estimated,
+				       src.uncollapsed_upper_bound,
+				       src.uncollapsed_lower_bound,
+				       src.uncollapsed_estimated,
+				       src.max_possible,
+				       src.max_attained,
+				       items,
+				       src.termfreqandwts,
+				       src.percent_factor));
+}
+
+/// Estimate the number of bytes used to cache @a mset under @a key.
+static size_t
+estimate_size(const string & key, const Xapian::MSet & mset)
+{
+    const Xapian::MSet::Internal & src = *mset.internal;
+    size_t size = key.size() + sizeof(Xapian::MSet::Internal);
+    vector<Xapian::Internal::MSetItem>::const_iterator i;
+    for (i = src.items.begin(); i != src.items.end(); ++i) {
+	size += sizeof(*i) + i->collapse_key.size() + i->sort_key.size();
+    }
+    map<string, Xapian::MSet::Internal::TermFreqAndWeight>::const_iterator j;
+    for (j = src.termfreqandwts.begin(); j != src.termfreqandwts.end(); ++j) {
+	// Allow for the overhead of the map node too.
+	size += j->first.size() + sizeof(*j) + 4 * sizeof(void*);
+    }
+    return size;
+}
+
+SharedMSetCache::SharedMSetCache()
+    : max_size(0), size(0), hits(0), misses(0)
+{
+    const char *p = getenv("XAPIAN_MSET_CACHE_SIZE");
+    if (p) {
+	long v = atol(p);
+	if (v > 0) max_size = size_t(v);
+    }
+}
+
+SharedMSetCache::~SharedMSetCache()
+{
+    evict(0);
+}
+
+SharedMSetCache &
+SharedMSetCache::instance()
+{
+    return shared_mset_cache;
+}
+
+void
+SharedMSetCache::evict(size_t limit)
+{
+    while (size > limit) {
+	Assert(!lru.empty());
+	Entry & e = lru.back();
+	index.erase(e.key);
+	size -= e.size;
+	lru.pop_back();
+    }
+}
+
+bool
+SharedMSetCache::get(const string & key, Xapian::MSet & mset)
+{
+    LOGCALL(MATCH, bool, "SharedMSetCache::get", key);
+    MutexLock lock(mutex);
+    index_type::iterator i = index.find(key);
+    if (i == index.end()) {
+	++misses;
+	RETURN(false);
+    }
+    list<Entry>::iterator e = i->second;
+    // Move to the front of the LRU list.
+    lru.splice(lru.begin(), lru, e);
+    mset = copy_mset(e->mset);
+    ++hits;
+    RETURN(true);
+}
+
+void
+SharedMSetCache::add(const string & key, const Xapian::MSet & mset)
+{
+    LOGCALL_VOID(MATCH, "SharedMSetCache::add", key | mset);
+    // Copy and size the MSet before taking the lock.
+    Xapian::MSet copy = copy_mset(mset);
+    size_t entry_size = estimate_size(key, copy);
+    MutexLock lock(mutex);
+    if (entry_size > max_size) return;
+    if (index.find(key) != index.end()) {
+	// Another thread got there first.
+	return;
+    }
+    evict(max_size - entry_size);
+    lru.push_front(Entry(key, copy, entry_size));
+    index.insert(make_pair(key, lru.begin()));
+    size += entry_size;
+    // The cache now shares copy's MSet::Internal, so release our reference
+    // while we still hold the lock, since the reference count isn't atomic.
+    copy = Xapian::MSet();
+}
+
+bool
+SharedMSetCache::enabled()
+{
+    MutexLock lock(mutex);
+    return max_size != 0;
+}
+
+void
+SharedMSetCache::set_max_size(size_t max_size_)
+{
+    MutexLock lock(mutex);
+    max_size = max_size_;
+    evict(max_size);
+}
+
+size_t
+SharedMSetCache::get_max_size()
+{
+    MutexLock lock(mutex);
+    return max_size;
+}
+
+size_t
+SharedMSetCache::get_size()
+{
+    MutexLock lock(mutex);
+    return size;
+}
+
+unsigned long
+SharedMSetCache::get_hits()
+{
+    MutexLock lock(mutex);
+    return hits;
+}
+
+unsigned long
+SharedMSetCache::get_misses()
+{
+    MutexLock lock(mutex);
+    return misses;
+}
+
+void
+SharedMSetCache::clear()
+{
+    MutexLock lock(mutex);
+    evict(0);
+    hits = misses = 0;
+}
+
+namespace Xapian {
+
+namespace MSetCache {
+
+void
+set_max_size(size_t max_size)
+{
+    LOGCALL_STATIC_VOID(API, "Xapian::MSetCache::set_max_size", max_size);
+    SharedMSetCache::instance().set_max_size(max_size);
+}
+
+size_t
+get_max_size()
+{
+    LOGCALL_STATIC(API, size_t, "Xapian::MSetCache::get_max_size", NO_ARGS);
+    RETURN(SharedMSetCache::instance().get_max_size());
+}
+
+size_t
+get_size()
+{
+    LOGCALL_STATIC(API, size_t, "Xapian::MSetCache::get_size", NO_ARGS);
+    RETURN(SharedMSetCache::instance().get_size());
+}
+
+unsigned long
+get_hits()
+{
+    LOGCALL_STATIC(API, unsigned long, "Xapian::MSetCache::get_hits", NO_ARGS);
+    RETURN(SharedMSetCache::instance().get_hits());
+}
+
+unsigned long
+get_misses()
+{
+    LOGCALL_STATIC(API, unsigned long, "Xapian::MSetCache::get_misses", NO_ARGS);
+    RETURN(SharedMSetCache::instance().get_misses());
+}
+
+void
+clear()
+{
+    LOGCALL_STATIC_VOID(API, "Xapian::MSetCache::clear", NO_ARGS);
+    SharedMSetCache::instance().clear();
+}
+
+}
+
+}
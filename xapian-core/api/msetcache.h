@@ -0,0 +1,141 @@
+/** @file msetcache.h
+ * @brief Process-wide cache of match results.
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#ifndef XAPIAN_INCLUDED_MSETCACHE_H
+#define XAPIAN_INCLUDED_MSETCACHE_H
+
+#include <cstddef>
+#include <list>
+#include <map>
+#include <string>
+
+#include "xapian/enquire.h"
+
+#include "mutex.h"
+
+/** A size-bounded LRU cache of MSets, shared by the whole process.
+ *
+ *  The key must identify everything which affects the results, including
+ *  the revision of each database searched, so that results are never
+ *  returned for a revision other than the one they were computed against.
+ *
+ *  The cache holds its own copies of the MSets, so an MSet added or
+ *  returned can be used (and its documents fetched) without affecting the
+ *  cached copy.
+ *
+ *  All methods are safe to call from multiple threads concurrently.
+ */
+class SharedMSetCache {
+    /// Don't allow copying.
+    SharedMSetCache(const SharedMSetCache &);
+
+    /// Don't allow assignment.
+    void operator=(const SharedMSetCache &);
+
+    struct Entry {
+	std::string key;
+
+	/** The cached MSet.
+	 *
+	 *  This is only copied while the mutex is held, since the reference
+	 *  count isn't atomic.
+	 */
+	Xapian::MSet mset;
+
+	/// Approximate number of bytes used by this entry.
+	size_t size;
+
+	Entry(const std::string & key_, const Xapian::MSet & mset_,
+	      size_t size_)
+	    : key(key_), mset(mset_), size(size_) { }
+    };
+
+    /// Cached MSets, most recently used first.
+    std::list<Entry> lru;
+
+    typedef std::map<std::string, std::list<Entry>::iterator> index_type;
+
+    /// Map from key to position in @a lru.
+    index_type index;
+
+    /// Maximum number of bytes to hold (0 means disabled).
+    size_t max_size;
+
+    /// Approximate number of bytes currently held.
+    size_t size;
+
+    unsigned long hits;
+
+    unsigned long misses;
+
+    Mutex mutex;
+
+    /// Discard least recently used MSets until size <= @a limit.
+    void evict(size_t limit);
+
+  public:
+    /** Construct the cache.
+     *
+     *  The initial maximum size is taken from XAPIAN_MSET_CACHE_SIZE in the
+     *  environment, if set.
+     */
+    SharedMSetCache();
+
+    ~SharedMSetCache();
+
+    /// Return the process-wide instance.
+    static SharedMSetCache & instance();
+
+    /** Is the cache enabled?
+     *
+     *  The cache may be disabled by another thread before get() or add() is
+     *  called, but they handle that.
+     */
+    bool enabled();
+
+    /** Look up an MSet.
+     *
+     *  @param key	The key the MSet was added with.
+     *  @param mset	Set to a copy of the cached MSet if found.
+     *
+     *  @return true if the MSet was found.
+     */
+    bool get(const std::string & key, Xapian::MSet & mset);
+
+    /** Add an MSet to the cache.
+     *
+     *  A copy of @a mset is stored, so the caller can continue to use it.
+     */
+    void add(const std::string & key, const Xapian::MSet & mset);
+
+    void set_max_size(size_t max_size_);
+
+    size_t get_max_size();
+
+    size_t get_size();
+
+    unsigned long get_hits();
+
+    unsigned long get_misses();
+
+    /// Discard all cached MSets and zero the hit and miss counts.
+    void clear();
+};
+
+#endif // XAPIAN_INCLUDED_MSETCACHE_H
@@ -800,6 +800,39 @@ WritableDatabase::commit()
 	internal[i]->commit();
 }
 
+void
+WritableDatabase::commit_async()
+{
+    LOGCALL_VOID(API, "WritableDatabase::commit_async", NO_ARGS);
+    size_t n_dbs = internal.size();
+    if (rare(n_dbs == 0))
+	no_subdatabases();
+    for (size_t i = 0; i != n_dbs; ++i)
+	internal[i]->commit_async();
+}
+
+void
+WritableDatabase::wait_for_commit()
+{
+    LOGCALL_VOID(API, "WritableDatabase::wait_for_commit", NO_ARGS);
+    size_t n_dbs = internal.size();
+    if (rare(n_dbs == 0))
+	no_subdatabases();
+    for (size_t i = 0; i != n_dbs; ++i)
+	internal[i]->wait_for_commit();
+}
+
+void
+WritableDatabase::set_sync_window(double seconds)
+{
+    LOGCALL_VOID(API, "WritableDatabase::set_sync_window", seconds);
+    size_t n_dbs = internal.size();
+    if (rare(n_dbs == 0))
+	no_subdatabases();
+    for (size_t i = 0; i != n_dbs; ++i)
+	internal[i]->set_sync_window(seconds);
+}
+
 void
 WritableDatabase::begin_transaction(bool flushed)
 {
@@ -857,6 +890,26 @@ WritableDatabase::add_document(const Document & document)
     RETURN(did);
 }
 
+Xapian::docid
+WritableDatabase::add_documents(const vector<Document> & documents,
+				unsigned threads)
+{
+    LOGCALL(API, Xapian::docid, "WritableDatabase::add_documents", documents.size() | threads);
+    size_t n_dbs = internal.size();
+    if (rare(n_dbs == 0))
+	no_subdatabases();
+    if (n_dbs == 1)
+	RETURN(internal[0]->add_documents(documents, threads));
+
+    Xapian::docid first_did = 0;
+    vector<Document>::const_iterator i;
+    for (i = documents.begin(); i != documents.end(); ++i) {
+	Xapian::docid did = add_document(*i);
+	if (first_did == 0) first_did = did;
+    }
+    RETURN(first_did);
+}
+
 void
 WritableDatabase::delete_document(Xapian::docid did)
 {
@@ -32,6 +32,7 @@
 #include "xapian/termiterator.h"
 #include "xapian/weight.h"
 
+#include "matchprofileinternal.h"
 #include "vectortermlist.h"
 
 #include "backends/database.h"
@@ -39,8 +40,12 @@
 #include "expand/esetinternal.h"
 #include "expand/expandweight.h"
 #include "matcher/multimatch.h"
+#include "msetcache.h"
 #include "omassert.h"
 #include "api/omenquireinternal.h"
+#include "pack.h"
+#include "realtime.h"
+#include "serialise-double.h"
 #include "str.h"
 #include "weight/weightinternal.h"
 
@@ -311,6 +316,13 @@ MSet::get_max_attained() const
     return internal->max_attained;
 }
 
+Xapian::MatchProfile
+MSet::get_profile() const
+{
+    Assert(internal.get() != 0);
+    return internal->profile;
+}
+
 Xapian::doccount
 MSet::size() const
 {
@@ -633,9 +645,11 @@ MSetIterator::get_description() const
 
 Enquire::Internal::Internal(const Database &db_, ErrorHandler * errorhandler_)
   : db(db_), query(), collapse_key(Xapian::BAD_VALUENO), collapse_max(0),
+    collapse_limit(0), collapse_approximate(false),
     order(Enquire::ASCENDING), percent_cutoff(0), weight_cutoff(0),
     sort_key(Xapian::BAD_VALUENO), sort_by(REL), sort_value_forward(true),
-    sorter(0), time_limit(0.0), errorhandler(errorhandler_), weight(0),
+    sorter(0), time_limit(0.0), match_threads(1), profiling(false),
+    errorhandler(errorhandler_), weight(0),
     eweightname("trad"), expand_k(1.0)
 {
     if (db.internal.empty()) {
@@ -662,6 +676,74 @@ Enquire::Internal::get_query()
     return query;
 }
 
+string
+Enquire::Internal::get_mset_cache_key(Xapian::doccount first,
+				      Xapian::doccount maxitems,
+				      Xapian::doccount check_at_least,
+				      const RSet *rset,
+				      const MatchDecider *mdecider) const
+{
+    // The results of these depend on more than the parameters we can put in
+    // the key, or (in the case of matchspies) we need to actually run the
+    // match for them to see the documents.
+    if (mdecider || sorter || !spies.empty() || errorhandler ||
+	time_limit > 0.0 || profiling) {
+	return string();
+    }
+
+    string key;
+    size_t n_dbs = db.internal.size();
+    pack_uint(key, n_dbs);
+    for (size_t i = 0; i != n_dbs; ++i) {
+	string db_key = db.internal[i]->get_revision_key();
+	if (db_key.empty()) return string();
+	pack_string(key, db_key);
+    }
+
+    string wt_name = weight->name();
+    if (wt_name.empty()) return string();
+    try {
+	pack_string(key, query.serialise());
+	pack_string(key, wt_name);
+	pack_string(key, weight->serialise());
+    } catch (const Xapian::UnimplementedError &) {
+	// A PostingSource or Weight subclass which doesn't support
+	// serialisation.
+	return string();
+    }
+    pack_uint(key, qlen);
+
+    pack_uint(key, collapse_key);
+    pack_uint(key, collapse_max);
+    pack_uint(key, collapse_limit);
+    pack_bool(key, collapse_approximate);
+    pack_uint(key, unsigned(order));
+    pack_uint(key, unsigned(percent_cutoff));
+    key += serialise_double(weight_cutoff);
+    pack_uint(key, sort_key);
+    pack_uint(key, unsigned(sort_by));
+    pack_bool(key, sort_value_forward);
+    // A parallel match can give different estimates and collapse counts.
+    pack_uint(key, match_threads);
+
+    pack_uint(key, first);
+    pack_uint(key, maxitems);
+    pack_uint(key, check_at_least);
+
+    if (rset) {
+	const set<Xapian::docid> & items = rset->internal->get_items();
+	pack_uint(key, items.size());
+	set<Xapian::docid>::const_iterator i;
+	for (i = items.begin(); i != items.end(); ++i) {
+	    pack_uint(key, *i);
+	}
+    } else {
+	pack_uint(key, 0u);
+    }
+
+    return key;
+}
+
 MSet
 Enquire::Internal::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 			    Xapian::doccount check_at_least, const RSet *rset,
@@ -677,6 +759,18 @@ Enquire::Internal::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 	weight = new BM25Weight;
     }
 
+    string cache_key;
+    SharedMSetCache & cache = SharedMSetCache::instance();
+    if (cache.enabled()) {
+	cache_key = get_mset_cache_key(first, maxitems, check_at_least,
+				       rset, mdecider);
+	MSet cached;
+	if (!cache_key.empty() && cache.get(cache_key, cached)) {
+	    cached.internal->enquire = this;
+	    RETURN(cached);
+	}
+    }
+
     Xapian::doccount first_orig = first;
     {
 	Xapian::doccount docs = db.get_doccount();
@@ -686,18 +780,28 @@ Enquire::Internal::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 	check_at_least = max(check_at_least, maxitems);
     }
 
+    double start_time = profiling ? RealTime::now() : 0.0;
+    Xapian::MatchProfile profile;
+    if (profiling) profile.internal = new Xapian::MatchProfile::Internal;
     Xapian::Weight::Internal stats;
     ::MultiMatch match(db, query, qlen, rset,
 		       collapse_max, collapse_key,
+		       collapse_limit, collapse_approximate,
 		       percent_cutoff, weight_cutoff,
 		       order, sort_key, sort_by, sort_value_forward,
-		       time_limit, errorhandler, stats, weight, spies,
+		       time_limit, match_threads, errorhandler, stats, weight,
+		       spies,
 		       (sorter != NULL),
 		       (mdecider != NULL));
+    if (profiling) match.set_profile(profile.internal.get());
     // Run query and put results into supplied Xapian::MSet object.
     MSet retval;
     match.get_mset(first, maxitems, check_at_least, retval,
 		   stats, mdecider, sorter);
+    if (profiling) {
+	profile.internal->total_time = RealTime::now() - start_time;
+	retval.internal->profile = profile;
+    }
     if (first_orig != first && retval.internal.get()) {
 	retval.internal->firstitem = first_orig;
     }
@@ -710,6 +814,8 @@ Enquire::Internal::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
     // networked case.
     retval.internal->enquire = this;
 
+    if (!cache_key.empty()) cache.add(cache_key, retval);
+
     return retval;
 }
 
@@ -970,6 +1076,13 @@ Enquire::set_collapse_key(Xapian::valueno collapse_key, Xapian::doccount collaps
     internal->collapse_max = collapse_max;
 }
 
+void
+Enquire::set_collapse_limit(Xapian::doccount max_keys, bool approximate)
+{
+    internal->collapse_limit = max_keys;
+    internal->collapse_approximate = approximate;
+}
+
 void
 Enquire::set_docid_order(Enquire::docid_order order)
 {
@@ -1052,6 +1165,18 @@ Enquire::set_time_limit(double time_limit)
     internal->time_limit = time_limit;
 }
 
+void
+Enquire::set_match_threads(unsigned threads)
+{
+    internal->match_threads = threads;
+}
+
+void
+Enquire::set_profiling(bool profiling)
+{
+    internal->profiling = profiling;
+}
+
 MSet
 Enquire::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 		  Xapian::doccount check_at_least, const RSet *rset,
@@ -130,6 +130,19 @@ class Enquire::Internal : public Xapian::Internal::intrusive_base {
 	/// Assignment not allowed
 	void operator=(const Internal &);
 
+	/** Build the key to cache the results of a get_mset() call under.
+	 *
+	 *  Parameters are as for get_mset().
+	 *
+	 *  @return	The key, or an empty string if the results shouldn't
+	 *		be cached.
+	 */
+	string get_mset_cache_key(Xapian::doccount first,
+				  Xapian::doccount maxitems,
+				  Xapian::doccount check_at_least,
+				  const RSet *omrset,
+				  const MatchDecider *mdecider) const;
+
     public:
 	typedef enum { REL, VAL, VAL_REL, REL_VAL } sort_setting;
 
@@ -137,6 +150,12 @@ class Enquire::Internal : public Xapian::Internal::intrusive_base {
 
 	Xapian::doccount collapse_max;
 
+	/// The number of collapse key values to track (0 for no limit).
+	Xapian::doccount collapse_limit;
+
+	/// Only track the hash of each collapse key value?
+	bool collapse_approximate;
+
 	Xapian::Enquire::docid_order order;
 
 	int percent_cutoff;
@@ -151,6 +170,12 @@ class Enquire::Internal : public Xapian::Internal::intrusive_base {
 
 	double time_limit;
 
+	/// The number of threads to match sub-databases in parallel with.
+	unsigned match_threads;
+
+	/// Should matches be profiled?
+	bool profiling;
+
 	/** The error handler, if set.  (0 if not set).
 	 */
 	ErrorHandler * errorhandler;
@@ -267,6 +292,9 @@ class MSet::Internal : public Xapian::Internal::intrusive_base {
 
 	double max_attained;
 
+	/// Where the match spent its time, if it was profiled.
+	Xapian::MatchProfile profile;
+
 	Internal()
 		: percent_factor(0),
 		  firstitem(0),
@@ -52,6 +52,12 @@ PostingIterator::Internal::get_collapse_key() const
     return NULL;
 }
 
+const string *
+PostingIterator::Internal::get_sort_key() const
+{
+    return NULL;
+}
+
 PositionList *
 PostList::read_position_list()
 {
@@ -71,6 +77,12 @@ PostList::check(Xapian::docid did, double w_min, bool &valid)
     return skip_to(did, w_min);
 }
 
+bool
+PostList::is_expensive() const
+{
+    return false;
+}
+
 Xapian::termcount
 PostList::count_matching_subqs() const
 {
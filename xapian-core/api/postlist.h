@@ -100,6 +100,14 @@ class Xapian::PostingIterator::Internal : public Xapian::Internal::intrusive_bas
      */
     virtual const std::string * get_collapse_key() const;
 
+    /** If the sort key is already known, return it.
+     *
+     *  This is implemented by MSetPostList (and MergePostList).  Other
+     *  subclasses rely on the default implementation which just returns
+     *  NULL.
+     */
+    virtual const std::string * get_sort_key() const;
+
     /// Return true if the current position is past the last entry in this list.
     virtual bool at_end() const = 0;
 
@@ -179,6 +187,17 @@ class Xapian::PostingIterator::Internal : public Xapian::Internal::intrusive_bas
      */
     virtual Internal * check(Xapian::docid did, double w_min, bool &valid);
 
+    /** Return true if advancing this postlist is expensive.
+     *
+     *  Such postlists (e.g. value ranges, external posting sources and
+     *  phrase checks) are better used to check candidates found by other
+     *  postlists than to find candidates, whatever their termfreq estimate
+     *  says.
+     *
+     *  The default implementation returns false.
+     */
+    virtual bool is_expensive() const;
+
     /** Advance the current position to the next document in the postlist.
      *
      *  Any weight contribution is acceptable.
@@ -524,7 +524,7 @@ Query::Internal::postlist_sub_and_like(AndContext& ctx,
 				       QueryOptimiser * qopt,
 				       double factor) const
 {
-    ctx.add_postlist(postlist(qopt, factor));
+    ctx.add_postlist(qopt->make_postlist(this, factor));
 }
 
 void
@@ -532,7 +532,7 @@ Query::Internal::postlist_sub_or_like(OrContext& ctx,
 				      QueryOptimiser * qopt,
 				      double factor) const
 {
-    ctx.add_postlist(postlist(qopt, factor));
+    ctx.add_postlist(qopt->make_postlist(this, factor));
 }
 
 void
@@ -540,7 +540,7 @@ Query::Internal::postlist_sub_xor(XorContext& ctx,
 				  QueryOptimiser * qopt,
 				  double factor) const
 {
-    ctx.add_postlist(postlist(qopt, factor));
+    ctx.add_postlist(qopt->make_postlist(this, factor));
 }
 
 namespace Internal {
@@ -1276,7 +1276,7 @@ QueryAndNot::postlist(QueryOptimiser * qopt, double factor) const
 {
     LOGCALL(QUERY, PostingIterator::Internal *, "QueryAndNot::postlist", qopt | factor);
     // FIXME: Combine and-like side with and-like stuff above.
-    AutoPtr<PostList> l(subqueries[0].internal->postlist(qopt, factor));
+    AutoPtr<PostList> l(qopt->make_postlist(subqueries[0].internal.get(), factor));
     OrContext ctx(subqueries.size() - 1);
     do_or_like(ctx, qopt, 0.0, 0, 1);
     AutoPtr<PostList> r(ctx.postlist(qopt));
@@ -1309,7 +1309,7 @@ QueryAndMaybe::postlist(QueryOptimiser * qopt, double factor) const
 {
     LOGCALL(QUERY, PostingIterator::Internal *, "QueryAndMaybe::postlist", qopt | factor);
     // FIXME: Combine and-like side with and-like stuff above.
-    AutoPtr<PostList> l(subqueries[0].internal->postlist(qopt, factor));
+    AutoPtr<PostList> l(qopt->make_postlist(subqueries[0].internal.get(), factor));
     OrContext ctx(subqueries.size() - 1);
     do_or_like(ctx, qopt, factor, 0, 1);
     AutoPtr<PostList> r(ctx.postlist(qopt));
@@ -1324,8 +1324,8 @@ QueryFilter::postlist(QueryOptimiser * qopt, double factor) const
     // FIXME: Combine and-like stuff, like QueryOptimiser.
     AssertEq(subqueries.size(), 2);
     PostList * pls[2];
-    AutoPtr<PostList> l(subqueries[0].internal->postlist(qopt, factor));
-    pls[1] = subqueries[1].internal->postlist(qopt, 0.0);
+    AutoPtr<PostList> l(qopt->make_postlist(subqueries[0].internal.get(), factor));
+    pls[1] = qopt->make_postlist(subqueries[1].internal.get(), 0.0);
     pls[0] = l.release();
     RETURN(new MultiAndPostList(pls, pls + 2, qopt->matcher, qopt->db_size));
 }
@@ -1353,7 +1353,7 @@ QueryWindowed::postlist_windowed(Query::op op, AndContext& ctx, QueryOptimiser *
 	    // MatchNothing subqueries should have been removed by done().
 	    Assert((*i).internal.get());
 	    // FIXME: postlist_sub_positional?
-	    ctx.add_postlist((*i).internal->postlist(qopt, factor));
+	    ctx.add_postlist(qopt->make_postlist((*i).internal.get(), factor));
 	}
 	// Record the positional filter to apply higher up the tree.
 	ctx.add_pos_filter(op, subqueries.size(), window);
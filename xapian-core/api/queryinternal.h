@@ -70,6 +70,9 @@ class QueryPostingSource : public Query::Internal {
 
     ~QueryPostingSource();
 
+    /// Return the PostingSource this query uses.
+    const PostingSource * get_source() const { return source; }
+
     PostingIterator::Internal * postlist(QueryOptimiser *qopt, double factor) const;
 
     void serialise(std::string & result) const;
@@ -47,6 +47,7 @@
 #include "unicode/description_append.h"
 
 #include "autoptr.h"
+#include <algorithm>
 #include <cstdio> // For rename().
 #include <fstream>
 #include <string>
@@ -59,6 +60,9 @@ using namespace Xapian;
 "# Automatically generated by Xapian::DatabaseReplica v"XAPIAN_VERSION".\n" \
 "# Do not manually edit - replication operations may regenerate this file.\n"
 
+/// How often DatabaseMaster::wait_for_changes() checks for a new revision.
+const double CHANGES_POLL_INTERVAL = 0.02;
+
 void
 DatabaseMaster::write_changesets_to_fd(int fd,
 				       const string & start_revision,
@@ -102,6 +106,31 @@ DatabaseMaster::write_changesets_to_fd(int fd,
     db.internal[0]->write_changesets_to_fd(fd, revision, need_whole_db, info);
 }
 
+bool
+DatabaseMaster::wait_for_changes(const string & revision, double timeout) const
+{
+    LOGCALL(REPLICA, bool, "DatabaseMaster::wait_for_changes", revision | timeout);
+    double end_time = RealTime::now() + timeout;
+    Database db(path);
+    if (db.internal.size() != 1) {
+	throw Xapian::InvalidOperationError("DatabaseMaster needs to be pointed at exactly one subdatabase");
+    }
+    while (true) {
+	// Build the revision in the same form as
+	// DatabaseReplica::get_revision_info().
+	string uuid = db.internal[0]->get_uuid();
+	string db_revision = encode_length(uuid.size());
+	db_revision += uuid;
+	db_revision += db.internal[0]->get_revision_info();
+	if (db_revision != revision) RETURN(true);
+
+	double now = RealTime::now();
+	if (now >= end_time) RETURN(false);
+	RealTime::sleep(min(now + CHANGES_POLL_INTERVAL, end_time));
+	db.reopen();
+    }
+}
+
 string
 DatabaseMaster::get_description() const
 {
@@ -164,6 +193,12 @@ class DatabaseReplica::Internal : public Xapian::Internal::intrusive_base {
     /// The remote connection we're using.
     RemoteConnection * conn;
 
+    /** How long to wait for the start of the next changeset (in seconds).
+     *
+     *  0.0 means wait indefinitely.
+     */
+    double read_timeout;
+
     /** Update the stub database which points to a single database.
      *
      *  The stub database file is created at a separate path, and then
@@ -213,6 +248,9 @@ class DatabaseReplica::Internal : public Xapian::Internal::intrusive_base {
     /// Set the file descriptor to read changesets from.
     void set_read_fd(int fd);
 
+    /// Set how long to wait for the start of the next changeset.
+    void set_read_timeout(double timeout) { read_timeout = timeout; }
+
     /// Read and apply the next changeset.
     bool apply_next_changeset(ReplicationInfo * info,
 			      double reader_close_time);
@@ -271,6 +309,15 @@ DatabaseReplica::set_read_fd(int fd)
     internal->set_read_fd(fd);
 }
 
+void
+DatabaseReplica::set_read_timeout(double timeout)
+{
+    LOGCALL_VOID(REPLICA, "DatabaseReplica::set_read_timeout", timeout);
+    if (internal.get() == NULL)
+	throw Xapian::InvalidOperationError("Attempt to call DatabaseReplica::set_read_timeout on a closed replica.");
+    internal->set_read_timeout(timeout);
+}
+
 bool
 DatabaseReplica::apply_next_changeset(ReplicationInfo * info,
 				      double reader_close_time)
@@ -325,7 +372,7 @@ DatabaseReplica::Internal::update_stub_database() const
 DatabaseReplica::Internal::Internal(const string & path_)
 	: path(path_), live_id(0), live_db(), have_offline_db(false),
 	  need_copy_next(false), offline_revision(), offline_needed_revision(),
-	  last_live_changeset_time(), conn(NULL)
+	  last_live_changeset_time(), conn(NULL), read_timeout(0.0)
 {
     LOGCALL_CTOR(REPLICA, "DatabaseReplica::Internal", path_);
 #if !defined XAPIAN_HAS_CHERT_BACKEND && !defined XAPIAN_HAS_BRASS_BACKEND
@@ -513,8 +560,18 @@ DatabaseReplica::Internal::apply_next_changeset(ReplicationInfo * info,
 	throw Xapian::InvalidOperationError("DatabaseReplica needs to be pointed at exactly one subdatabase");
 
     while (true) {
-	char type = conn->sniff_next_message_type(0.0);
+	double end_time = 0.0;
+	if (read_timeout > 0.0)
+	    end_time = RealTime::end_time(read_timeout);
+	char type = conn->sniff_next_message_type(end_time);
 	switch (type) {
+	    case REPL_REPLY_KEEPALIVE: {
+		// A streaming master is waiting for changes - the deadline
+		// for the next message starts again.
+		string buf;
+		(void)conn->get_message(buf, end_time);
+		break;
+	    }
 	    case REPL_REPLY_END_OF_CHANGES: {
 		string buf;
 		(void)conn->get_message(buf, 0.0);
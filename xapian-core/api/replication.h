@@ -103,6 +103,23 @@ class XAPIAN_VISIBILITY_DEFAULT DatabaseMaster {
 				const std::string & start_revision,
 				ReplicationInfo * info) const;
 
+    /** Wait for the database to move on from a revision.
+     *
+     *  The database is checked for new revisions every few hundredths of a
+     *  second, which allows changesets to be sent to a replica as soon as
+     *  they have been committed.
+     *
+     *  @param revision	The revision of a replica, as returned by
+     *			DatabaseReplica::get_revision_info().
+     *  @param timeout	The longest time to wait, in seconds.  The database
+     *			is always checked at least once.
+     *
+     *  @return true if the database's current revision is different from
+     *		@a revision; false if the timeout was reached first.
+     */
+    bool wait_for_changes(const std::string & revision,
+			  double timeout) const;
+
     /// Return a string describing this object.
     std::string get_description() const;
 };
@@ -164,6 +181,17 @@ class XAPIAN_VISIBILITY_DEFAULT DatabaseReplica {
      */
     void set_read_fd(int fd);
 
+    /** Set how long to wait for the next changeset to start arriving.
+     *
+     *  If nothing arrives in time, apply_next_changeset() throws
+     *  Xapian::NetworkTimeoutError.  Keepalive messages from a streaming
+     *  master restart the wait.
+     *
+     *  @param timeout	The timeout in seconds, or 0.0 (the default) to wait
+     *			indefinitely.
+     */
+    void set_read_timeout(double timeout);
+
     /** Read and apply the next changeset.
      *
      *  If no changesets are found on the file descriptor, returns false
@@ -1,5 +1,6 @@
 noinst_HEADERS +=\
 	backends/alltermslist.h\
+	backends/blockcache.h\
 	backends/byte_length_strings.h\
 	backends/contiguousalldocspostlist.h\
 	backends/database.h\
@@ -8,6 +9,7 @@ noinst_HEADERS +=\
 	backends/flint_lock.h\
 	backends/multivaluelist.h\
 	backends/positionlist.h\
+	backends/postlistcache.h\
 	backends/prefix_compressed_strings.h\
 	backends/slowvaluelist.h\
 	backends/valuelist.h\
@@ -19,10 +21,12 @@ EXTRA_DIST +=\
 
 lib_src +=\
 	backends/alltermslist.cc\
+	backends/blockcache.cc\
 	backends/dbcheck.cc\
 	backends/database.cc\
 	backends/databasereplicator.cc\
 	backends/dbfactory.cc\
+	backends/postlistcache.cc\
 	backends/slowvaluelist.cc\
 	backends/valuelist.cc
 
@@ -0,0 +1,214 @@
+/** @file blockcache.cc
+ * @brief Process-wide cache of blocks read from disk-based databases.
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include "blockcache.h"
+
+#include "xapian/cache.h"
+
+#include "debuglog.h"
+#include "omassert.h"
+
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+
+/// The process-wide instance.
+static SharedBlockCache shared_block_cache;
+
+SharedBlockCache::SharedBlockCache()
+    : max_size(0), size(0), hits(0), misses(0)
+{
+    const char *p = getenv("XAPIAN_BLOCK_CACHE_SIZE");
+    if (p) {
+	long v = atol(p);
+	if (v > 0) max_size = size_t(v);
+    }
+}
+
+SharedBlockCache::~SharedBlockCache()
+{
+    evict(0);
+}
+
+SharedBlockCache &
+SharedBlockCache::instance()
+{
+    return shared_block_cache;
+}
+
+void
+SharedBlockCache::evict(size_t limit)
+{
+    while (size > limit) {
+	Assert(!lru.empty());
+	Entry & e = lru.back();
+	index.erase(e.key);
+	size -= e.size;
+	delete [] e.data;
+	lru.pop_back();
+    }
+}
+
+bool
+SharedBlockCache::enabled()
+{
+    MutexLock lock(mutex);
+    return max_size != 0;
+}
+
+bool
+SharedBlockCache::get(const string & table_id, uint4 revision, uint4 n,
+		      byte * p, size_t block_size)
+{
+    LOGCALL(DB, bool, "SharedBlockCache::get", table_id | revision | n | (void*)p | block_size);
+    MutexLock lock(mutex);
+    index_type::iterator i = index.find(Key(table_id, revision, n));
+    if (i == index.end()) {
+	++misses;
+	RETURN(false);
+    }
+    list<Entry>::iterator e = i->second;
+    if (rare(e->size != block_size)) {
+	// The caller must be confused about the block size.
+	++misses;
+	RETURN(false);
+    }
+    // Move to the front of the LRU list.
+    lru.splice(lru.begin(), lru, e);
+    memcpy(p, e->data, block_size);
+    ++hits;
+    RETURN(true);
+}
+
+void
+SharedBlockCache::add(const string & table_id, uint4 revision, uint4 n,
+		      const byte * p, size_t block_size)
+{
+    LOGCALL_VOID(DB, "SharedBlockCache::add", table_id | revision | n | (void*)p | block_size);
+    MutexLock lock(mutex);
+    if (block_size > max_size) return;
+    Key key(table_id, revision, n);
+    if (index.find(key) != index.end()) {
+	// Another reader got there first.
+	return;
+    }
+    evict(max_size - block_size);
+    byte * data = new byte[block_size];
+    memcpy(data, p, block_size);
+    lru.push_front(Entry(key, data, block_size));
+    index.insert(make_pair(key, lru.begin()));
+    size += block_size;
+}
+
+void
+SharedBlockCache::set_max_size(size_t max_size_)
+{
+    MutexLock lock(mutex);
+    max_size = max_size_;
+    evict(max_size);
+}
+
+size_t
+SharedBlockCache::get_max_size()
+{
+    MutexLock lock(mutex);
+    return max_size;
+}
+
+size_t
+SharedBlockCache::get_size()
+{
+    MutexLock lock(mutex);
+    return size;
+}
+
+unsigned long
+SharedBlockCache::get_hits()
+{
+    MutexLock lock(mutex);
+    return hits;
+}
+
+unsigned long
+SharedBlockCache::get_misses()
+{
+    MutexLock lock(mutex);
+    return misses;
+}
+
+void
+SharedBlockCache::clear()
+{
+    MutexLock lock(mutex);
+    evict(0);
+    hits = misses = 0;
+}
+
+namespace Xapian {
+
+namespace BlockCache {
+
+void
+set_max_size(size_t max_size)
+{
+    LOGCALL_STATIC_VOID(API, "Xapian::BlockCache::set_max_size", max_size);
+    SharedBlockCache::instance().set_max_size(max_size);
+}
+
+size_t
+get_max_size()
+{
+    LOGCALL_STATIC(API, size_t, "Xapian::BlockCache::get_max_size", NO_ARGS);
+    RETURN(SharedBlockCache::instance().get_max_size());
+}
+
+size_t
+get_size()
+{
+    LOGCALL_STATIC(API, size_t, "Xapian::BlockCache::get_size", NO_ARGS);
+    RETURN(SharedBlockCache::instance().get_size());
+}
+
+unsigned long
+get_hits()
+{
+    LOGCALL_STATIC(API, unsigned long, "Xapian::BlockCache::get_hits", NO_ARGS);
+    RETURN(SharedBlockCache::instance().get_hits());
+}
+
+unsigned long
+get_misses()
+{
+    LOGCALL_STATIC(API, unsigned long, "Xapian::BlockCache::get_misses", NO_ARGS);
+    RETURN(SharedBlockCache::instance().get_misses());
+}
+
+void
+clear()
+{
+    LOGCALL_STATIC_VOID(API, "Xapian::BlockCache::clear", NO_ARGS);
+    SharedBlockCache::instance().clear();
+}
+
+}
+
+}
@@ -0,0 +1,153 @@
+/** @file blockcache.h
+ * @brief Process-wide cache of blocks read from disk-based databases.
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#ifndef XAPIAN_INCLUDED_BLOCKCACHE_H
+#define XAPIAN_INCLUDED_BLOCKCACHE_H
+
+#include <cstddef>
+#include <list>
+#include <map>
+#include <string>
+
+#include "internaltypes.h"
+#include "mutex.h"
+
+/** A size-bounded LRU cache of database blocks, shared by the whole process.
+ *
+ *  Blocks are keyed by a string identifying the table they come from (which
+ *  the caller must make unique to a particular database and table, e.g. by
+ *  including the database's UUID and the table file's inode), the revision the table was opened at, and
+ *  the block number.  Only blocks which are valid for the keyed revision
+ *  should be added, since any reader of that revision may be given them.
+ *
+ *  All methods are safe to call from multiple threads concurrently.
+ */
+class SharedBlockCache {
+    /// Don't allow copying.
+    SharedBlockCache(const SharedBlockCache &);
+
+    /// Don't allow assignment.
+    void operator=(const SharedBlockCache &);
+
+    struct Key {
+	std::string table_id;
+
+	uint4 revision;
+
+	uint4 n;
+
+	Key(const std::string & table_id_, uint4 revision_, uint4 n_)
+	    : table_id(table_id_), revision(revision_), n(n_) { }
+
+	bool operator<(const Key & o) const {
+	    if (n != o.n) return n < o.n;
+	    if (revision != o.revision) return revision < o.revision;
+	    return table_id < o.table_id;
+	}
+    };
+
+    struct Entry {
+	Key key;
+
+	byte * data;
+
+	size_t size;
+
+	Entry(const Key & key_, byte * data_, size_t size_)
+	    : key(key_), data(data_), size(size_) { }
+    };
+
+    /// Cached blocks, most recently used first.
+    std::list<Entry> lru;
+
+    typedef std::map<Key, std::list<Entry>::iterator> index_type;
+
+    /// Map from key to position in @a lru.
+    index_type index;
+
+    /// Maximum number of bytes of block data to hold (0 means disabled).
+    size_t max_size;
+
+    /// Number of bytes of block data currently held.
+    size_t size;
+
+    unsigned long hits;
+
+    unsigned long misses;
+
+    Mutex mutex;
+
+    /// Discard least recently used blocks until size <= @a limit.
+    void evict(size_t limit);
+
+  public:
+    /** Construct the cache.
+     *
+     *  The initial maximum size is taken from XAPIAN_BLOCK_CACHE_SIZE in the
+     *  environment, if set.
+     */
+    SharedBlockCache();
+
+    ~SharedBlockCache();
+
+    /// Return the process-wide instance.
+    static SharedBlockCache & instance();
+
+    /** Is the cache enabled?
+     *
+     *  The cache may be disabled by another thread before get() or add() is
+     *  called, but they handle that.
+     */
+    bool enabled();
+
+    /** Look up a block.
+     *
+     *  @param table_id	Identifies the table.
+     *  @param revision	The revision the table is open at.
+     *  @param n		The block number.
+     *  @param p		Buffer to copy the block into if found.
+     *  @param block_size	The size of the block.
+     *
+     *  @return true if the block was found (and copied to @a p).
+     */
+    bool get(const std::string & table_id, uint4 revision, uint4 n,
+	     byte * p, size_t block_size);
+
+    /** Add a block to the cache.
+     *
+     *  Parameters are as for get().
+     */
+    void add(const std::string & table_id, uint4 revision, uint4 n,
+	     const byte * p, size_t block_size);
+
+    void set_max_size(size_t max_size_);
+
+    size_t get_max_size();
+
+    size_t get_size();
+
+    unsigned long get_hits();
+
+    unsigned long get_misses();
+
+    /// Discard all cached blocks and zero the hit and miss counts.
+    void clear();
+};
+
+#endif // XAPIAN_INCLUDED_BLOCKCACHE_H
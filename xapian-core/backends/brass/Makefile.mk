@@ -7,6 +7,7 @@ noinst_HEADERS +=\
 	backends/brass/brass_alldocspostlist.h\
 	backends/brass/brass_alltermslist.h\
 	backends/brass/brass_btreebase.h\
+	backends/brass/brass_bulkload.h\
 	backends/brass/brass_changes.h\
 	backends/brass/brass_check.h\
 	backends/brass/brass_compact.h\
@@ -22,6 +23,7 @@ noinst_HEADERS +=\
 	backends/brass/brass_metadata.h\
 	backends/brass/brass_positionlist.h\
 	backends/brass/brass_postlist.h\
+	backends/brass/brass_prepareddoc.h\
 	backends/brass/brass_record.h\
 	backends/brass/brass_replicate_internal.h\
 	backends/brass/brass_spelling.h\
@@ -39,6 +41,7 @@ lib_src +=\
 	backends/brass/brass_alldocspostlist.cc\
 	backends/brass/brass_alltermslist.cc\
 	backends/brass/brass_btreebase.cc\
+	backends/brass/brass_bulkload.cc\
 	backends/brass/brass_changes.cc\
 	backends/brass/brass_check.cc\
 	backends/brass/brass_compact.cc\
@@ -53,6 +56,7 @@ lib_src +=\
 	backends/brass/brass_metadata.cc\
 	backends/brass/brass_positionlist.cc\
 	backends/brass/brass_postlist.cc\
+	backends/brass/brass_prepareddoc.cc\
 	backends/brass/brass_record.cc\
 	backends/brass/brass_spelling.cc\
 	backends/brass/brass_spellingwordslist.cc\
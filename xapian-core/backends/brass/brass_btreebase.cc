@@ -184,7 +184,8 @@ void
 BrassTable_base::write_to_file(const string &filename,
 			       char base_letter,
 			       const char * tablename,
-			       BrassChanges * changes)
+			       BrassChanges * changes,
+			       bool sync)
 {
     string buf;
     BrassFreeList::pack(buf);
@@ -230,6 +231,6 @@ BrassTable_base::write_to_file(const string &filename,
 	changes->write_block(buf);
     }
 
-    if (!no_sync)
+    if (sync && !no_sync)
 	io_sync(h);
 }
@@ -74,11 +74,16 @@ class BrassTable_base : public BrassFreeList {
 	    sequential = sequential_;
 	}
 
-	/** Write the btree base file to disk. */
+	/** Write the btree base file to disk.
+	 *
+	 *  @param sync	Sync the file to disk (unless the table was opened
+	 *		with Xapian::DB_NO_SYNC)?
+	 */
 	void write_to_file(const std::string &filename,
 			   char base_letter,
 			   const char * tablename,
-			   BrassChanges * changes);
+			   BrassChanges * changes,
+			   bool sync = true);
 
 	void swap(BrassTable_base &other);
 
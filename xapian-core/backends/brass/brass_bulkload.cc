@@ -0,0 +1,209 @@
+/** @file brass_bulkload.cc
+ * @brief Build the postlist and position tables of a new brass database.
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include "brass_bulkload.h"
+
+#include "xapian/constants.h"
+#include "xapian/error.h"
+
+#include "brass_compact.h"
+#include "brass_inverter.h"
+#include "brass_positionlist.h"
+#include "brass_postlist.h"
+#include "debuglog.h"
+#include "fileutils.h"
+#include "str.h"
+#include "stringutils.h"
+
+#include "safedirent.h"
+#include "safeerrno.h"
+#include "safesysstat.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+/// Runs are temporary, so there's no point syncing them to disk.
+const int RUN_FLAGS = Xapian::DB_DANGEROUS | Xapian::DB_NO_SYNC;
+
+/// Use the maximum blocksize for runs, as for temporary compaction tables.
+const unsigned RUN_BLOCKSIZE = 65536;
+
+/** The most runs to merge at once.
+ *
+ *  Each run being merged holds open a file for each of its tables, so we
+ *  merge groups of runs first if there are more than this.
+ */
+const size_t MAX_RUNS_PER_MERGE = 32;
+
+BrassBulkLoader::~BrassBulkLoader()
+{
+    try {
+	discard();
+    } catch (...) {
+	// We can't safely throw exceptions from a destructor in case an
+	// exception is already active and causing us to be destroyed.
+    }
+}
+
+string
+BrassBulkLoader::new_run_dir()
+{
+    string dir = db_dir;
+    dir += "/bulk";
+    dir += str(next_run++);
+    // Remove any run left behind if a previous bulk load didn't finish.
+    removedir(dir);
+    if (mkdir(dir.c_str(), 0755) == -1) {
+	throw Xapian::DatabaseError("Cannot create directory '" + dir + "'",
+				    errno);
+    }
+    return dir;
+}
+
+void
+BrassBulkLoader::add_run(Inverter & inverter)
+{
+    LOGCALL_VOID(DB, "BrassBulkLoader::add_run", NO_ARGS);
+    string dir = new_run_dir();
+    runs.push_back(dir);
+
+    // The inverter flushes changes in key order, so these tables are written
+    // sequentially.
+    BrassPostListTable postlist_table(dir, false);
+    postlist_table.create_and_open(RUN_FLAGS, RUN_BLOCKSIZE);
+    postlist_table.set_full_compaction(true);
+    inverter.flush(postlist_table);
+    postlist_table.flush_db();
+    postlist_table.commit(1);
+
+    BrassPositionListTable position_table(dir, false);
+    position_table.create_and_open(RUN_FLAGS, RUN_BLOCKSIZE);
+    position_table.set_full_compaction(true);
+    inverter.flush_pos_lists(position_table);
+    position_table.flush_db();
+    position_table.commit(1);
+}
+
+void
+BrassBulkLoader::merge_runs(size_t begin, size_t end)
+{
+    LOGCALL_VOID(DB, "BrassBulkLoader::merge_runs", begin | end);
+    if (end - begin < 2) return;
+
+    vector<string> postlists, positions;
+    for (size_t i = begin; i != end; ++i) {
+	postlists.push_back(runs[i] + "/postlist.");
+	positions.push_back(runs[i] + "/position.");
+    }
+
+    string dir = new_run_dir();
+    try {
+	BrassPostListTable postlist_table(dir, false);
+	postlist_table.create_and_open(RUN_FLAGS, RUN_BLOCKSIZE);
+	postlist_table.set_full_compaction(true);
+	merge_brass_postlist_runs(&postlist_table, postlists);
+	postlist_table.flush_db();
+	postlist_table.commit(1);
+
+	BrassPositionListTable position_table(dir, false);
+	position_table.create_and_open(RUN_FLAGS, RUN_BLOCKSIZE);
+	position_table.set_full_compaction(true);
+	merge_brass_position_runs(&position_table, positions);
+	position_table.flush_db();
+	position_table.commit(1);
+    } catch (...) {
+	removedir(dir);
+	throw;
+    }
+
+    for (size_t i = begin; i != end; ++i) {
+	removedir(runs[i]);
+    }
+    runs[begin] = dir;
+    runs.erase(runs.begin() + begin + 1, runs.begin() + end);
+}
+
+void
+BrassBulkLoader::merge(BrassPostListTable & postlist_table,
+		       BrassPositionListTable & position_table)
+{
+    LOGCALL_VOID(DB, "BrassBulkLoader::merge", NO_ARGS);
+    while (runs.size() > MAX_RUNS_PER_MERGE) {
+	for (size_t i = 0; i < runs.size(); ++i) {
+	    merge_runs(i, min(i + MAX_RUNS_PER_MERGE, runs.size()));
+	}
+    }
+
+    vector<string> postlists, positions;
+    for (size_t i = 0; i != runs.size(); ++i) {
+	postlists.push_back(runs[i] + "/postlist.");
+	positions.push_back(runs[i] + "/position.");
+    }
+
+    postlist_table.set_full_compaction(true);
+    merge_brass_postlist_runs(&postlist_table, postlists);
+    postlist_table.set_full_compaction(false);
+
+    position_table.set_full_compaction(true);
+    merge_brass_position_runs(&position_table, positions);
+    position_table.set_full_compaction(false);
+
+    discard();
+}
+
+void
+BrassBulkLoader::discard()
+{
+    LOGCALL_VOID(DB, "BrassBulkLoader::discard", NO_ARGS);
+    while (!runs.empty()) {
+	removedir(runs.back());
+	runs.pop_back();
+    }
+}
+
+void
+BrassBulkLoader::remove_stale_runs(const string & db_dir)
+{
+    LOGCALL_STATIC_VOID(DB, "BrassBulkLoader::remove_stale_runs", db_dir);
+    DIR * dir = opendir(db_dir.c_str());
+    if (dir == NULL) return;
+
+    // Collect the names first, as removing entries while reading the
+    // directory isn't portable.
+    vector<string> stale;
+    while (true) {
+	struct dirent * entry = readdir(dir);
+	if (entry == NULL) break;
+	const char * name = entry->d_name;
+	if (strncmp(name, "bulk", 4) != 0) continue;
+	const char * p = name + 4;
+	if (!C_isdigit(*p)) continue;
+	while (C_isdigit(*p)) ++p;
+	if (*p == '\0') stale.push_back(db_dir + "/" + name);
+    }
+    closedir(dir);
+
+    for (size_t i = 0; i != stale.size(); ++i) {
+	removedir(stale[i]);
+    }
+}
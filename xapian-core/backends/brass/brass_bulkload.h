@@ -0,0 +1,102 @@
+/** @file brass_bulkload.h
+ * @brief Build the postlist and position tables of a new brass database.
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#ifndef XAPIAN_INCLUDED_BRASS_BULKLOAD_H
+#define XAPIAN_INCLUDED_BRASS_BULKLOAD_H
+
+#include <string>
+#include <vector>
+
+class BrassPositionListTable;
+class BrassPostListTable;
+class Inverter;
+
+/** Build the postlist and position tables of a new database bottom-up.
+ *
+ *  Merging each batch of buffered changes into the postlist and position
+ *  tables means rewriting the last chunk of every term's postlist and
+ *  inserting into the middle of the tables, which leaves blocks half full.
+ *  Instead, each batch is written as a sorted "run" (a small temporary table
+ *  written in key order), and the runs are merged at the end, which writes
+ *  the real tables in key order with full blocks, just like compaction does.
+ */
+class BrassBulkLoader {
+    /// Don't allow copying.
+    BrassBulkLoader(const BrassBulkLoader &);
+
+    /// Don't allow assignment.
+    void operator=(const BrassBulkLoader &);
+
+    /// The directory the database is in.
+    std::string db_dir;
+
+    /// The directory of each run written so far, in docid order.
+    std::vector<std::string> runs;
+
+    /// The number to use in the name of the next run's directory.
+    unsigned next_run;
+
+    /// Create a directory for a new run and return its path.
+    std::string new_run_dir();
+
+    /** Merge the runs [begin, end) into a single run.
+     *
+     *  The inputs are removed and replaced by the new run.
+     */
+    void merge_runs(size_t begin, size_t end);
+
+  public:
+    /// Construct a bulk loader for the database in @a db_dir_.
+    explicit BrassBulkLoader(const std::string & db_dir_)
+	: db_dir(db_dir_), next_run(0) { }
+
+    /// Destructor, which removes any runs not yet merged.
+    ~BrassBulkLoader();
+
+    /// Have any runs been written?
+    bool empty() const { return runs.empty(); }
+
+    /** Write the changes buffered in @a inverter as a new run.
+     *
+     *  The postlist and positional changes are removed from @a inverter.
+     *  The documents must all have higher docids than those in earlier runs.
+     */
+    void add_run(Inverter & inverter);
+
+    /** Merge all the runs into @a postlist_table and @a position_table.
+     *
+     *  Neither table may contain any postings or positional data yet, so the
+     *  merged entries are all appended.  The runs are removed afterwards.
+     */
+    void merge(BrassPostListTable & postlist_table,
+	       BrassPositionListTable & position_table);
+
+    /// Remove all the runs without merging them.
+    void discard();
+
+    /** Remove any runs left in @a db_dir by a bulk load which didn't finish.
+     *
+     *  Nothing is committed while bulk loading, so if the process doing it
+     *  dies, its runs are never needed again.  This should be called with
+     *  the database's write lock held.
+     */
+    static void remove_stale_runs(const std::string & db_dir);
+};
+
+#endif // XAPIAN_INCLUDED_BRASS_BULKLOAD_H
@@ -28,6 +28,7 @@
 
 #include <algorithm>
 #include <queue>
+#include <vector>
 
 #include <cstdio>
 
@@ -36,9 +37,12 @@
 #include "brass_table.h"
 #include "brass_compact.h"
 #include "brass_cursor.h"
+#include "brass_postlist.h"
 #include "filetests.h"
 #include "internaltypes.h"
+#include "mutex.h"
 #include "pack.h"
+#include "thread.h"
 #include "backends/valuestats.h"
 
 #include "../byte_length_strings.h"
@@ -50,6 +54,168 @@ using namespace std;
 // the same name in other flint-derived backends.
 namespace BrassCompact {
 
+/** Passes on calls to a Compactor's callbacks one at a time.
+ *
+ *  Used when compacting with several threads, since the user's subclass
+ *  won't expect concurrent calls.
+ */
+class LockedCompactor : public Xapian::Compactor {
+    Xapian::Compactor & compactor;
+
+    Mutex mutex;
+
+  public:
+    explicit LockedCompactor(Xapian::Compactor & compactor_)
+	: compactor(compactor_) { }
+
+    void set_status(const string & table, const string & status) {
+	MutexLock lock(mutex);
+	compactor.set_status(table, status);
+    }
+
+    string resolve_duplicate_metadata(const string & key, size_t num_tags,
+				      const string tags[]) {
+	MutexLock lock(mutex);
+	return compactor.resolve_duplicate_metadata(key, num_tags, tags);
+    }
+};
+
+/** The number of threads which may still be started.
+ *
+ *  Shared by the table jobs and the postlist merges (which run inside one of
+ *  the table jobs) so that together they don't use more threads than asked
+ *  for.
+ */
+class ThreadBudget {
+    /// Mutex protecting spare.
+    Mutex mutex;
+
+    /// How many more threads may be started.
+    unsigned spare;
+
+  public:
+    /// Allow @a threads threads in all, including the calling thread.
+    explicit ThreadBudget(unsigned threads)
+	: spare(threads > 1 ? threads - 1 : 0) { }
+
+    /// Reserve up to @a wanted threads, returning how many we got.
+    unsigned take(unsigned wanted) {
+	MutexLock lock(mutex);
+	if (wanted > spare) wanted = spare;
+	spare -= wanted;
+	return wanted;
+    }
+
+    /// Return a thread reserved by take() once it's finished.
+    void give_back() {
+	MutexLock lock(mutex);
+	++spare;
+    }
+};
+
+/** A number of independent jobs, which may be run concurrently.
+ *
+ *  If a job fails in a worker thread, we can't propagate the exception, so
+ *  it is run again in the calling thread once the other jobs are done so
+ *  that any error is reported in the usual way.  Jobs must therefore be
+ *  safe to repeat.
+ */
+class Jobs {
+    friend class JobThread;
+
+    /// Index of the next job to run.
+    size_t next_job;
+
+    /// Mutex protecting next_job.
+    Mutex mutex;
+
+    /** Which jobs failed in a worker thread.
+     *
+     *  Not vector<bool>, as threads set different entries concurrently.
+     */
+    vector<char> failed;
+
+  public:
+    virtual ~Jobs() { }
+
+    /// Run job @a i.
+    virtual void do_job(size_t i) = 0;
+
+    /** Run jobs 0 to @a n - 1.
+     *
+     *  The calling thread runs jobs too, helped by as many threads as
+     *  @a budget currently has spare (but no more than are useful).
+     */
+    void run(size_t n, ThreadBudget & budget);
+};
+
+/// Thread which runs jobs until there are none left.
+class JobThread : public Thread {
+    Jobs & jobs;
+
+    /// Budget to give our thread back to when done, or NULL.
+    ThreadBudget * budget;
+
+  public:
+    JobThread(Jobs & jobs_, ThreadBudget * budget_)
+	: jobs(jobs_), budget(budget_) { }
+
+    void run();
+};
+
+void
+JobThread::run()
+{
+    while (true) {
+	size_t i;
+	{
+	    MutexLock lock(jobs.mutex);
+	    if (jobs.next_job == jobs.failed.size()) break;
+	    i = jobs.next_job++;
+	}
+	try {
+	    jobs.do_job(i);
+	} catch (...) {
+	    jobs.failed[i] = true;
+	}
+    }
+    // Let a job still running elsewhere use this thread's share.
+    if (budget) budget->give_back();
+}
+
+void
+Jobs::run(size_t n, ThreadBudget & budget)
+{
+    unsigned threads = (n > 1 ? budget.take(n - 1) : 0) + 1;
+    if (threads == 1) {
+	for (size_t i = 0; i != n; ++i) do_job(i);
+	return;
+    }
+
+    next_job = 0;
+    failed.assign(n, false);
+    vector<JobThread *> workers;
+    workers.reserve(threads);
+    // The calling thread isn't ours to give back.
+    workers.push_back(new JobThread(*this, NULL));
+    for (unsigned t = 1; t != threads; ++t) {
+	workers.push_back(new JobThread(*this, &budget));
+    }
+    // This thread does its share of the work rather than just waiting.
+    for (unsigned t = 1; t != threads; ++t) {
+	workers[t]->start();
+    }
+    workers[0]->run();
+    for (unsigned t = 0; t != threads; ++t) {
+	workers[t]->join();
+	delete workers[t];
+    }
+
+    for (size_t i = 0; i != n; ++i) {
+	if (failed[i]) do_job(i);
+    }
+}
+
 static inline bool
 is_metainfo_key(const string & key)
 {
@@ -194,12 +360,21 @@ encode_valuestats(Xapian::doccount freq,
     return value;
 }
 
+/// Set or clear the Brass::CHUNK_LAST flag of a non-initial postlist chunk.
+static inline void
+set_last_chunk_flag(string & tag, bool is_last_chunk)
+{
+    // The flags are a pack_uint() value which always fits in one byte.
+    tag[0] &= ~char(Brass::CHUNK_LAST);
+    if (is_last_chunk) tag[0] |= char(Brass::CHUNK_LAST);
+}
+
 static void
 merge_postlists(Xapian::Compactor & compactor,
 		BrassTable * out, vector<Xapian::docid>::const_iterator offset,
 		vector<string>::const_iterator b,
 		vector<string>::const_iterator e,
-		Xapian::docid last_docid)
+		Xapian::docid last_docid, bool pack_postlists)
 {
     totlen_t tot_totlen = 0;
     Xapian::termcount doclen_lbound = static_cast<Xapian::termcount>(-1);
@@ -419,7 +594,8 @@ merge_postlists(Xapian::Compactor & compactor,
 		pack_uint(first_tag, cf);
 		pack_uint(first_tag, tags[0].first - 1);
 		string tag = tags[0].second;
-		tag[0] = (tags.size() == 1) ? '1' : '0';
+		set_last_chunk_flag(tag, tags.size() == 1);
+		if (pack_postlists) Brass::pack_chunk(tag, tags[0].first);
 		first_tag += tag;
 		out->add(last_key, first_tag);
 
@@ -435,7 +611,8 @@ merge_postlists(Xapian::Compactor & compactor,
 		i = tags.begin();
 		while (++i != tags.end()) {
 		    tag = i->second;
-		    tag[0] = (i + 1 == tags.end()) ? '1' : '0';
+		    set_last_chunk_flag(tag, i + 1 == tags.end());
+		    if (pack_postlists) Brass::pack_chunk(tag, i->first);
 		    out->add(pack_brass_postlist_key(term, i->first), tag);
 		}
 	    }
@@ -675,53 +852,93 @@ merge_synonyms(BrassTable * out,
     }
 }
 
-static void
-multimerge_postlists(Xapian::Compactor & compactor,
-		     BrassTable * out, const char * tmpdir,
-		     Xapian::docid last_docid,
-		     vector<string> tmp, vector<Xapian::docid> off)
-{
-    unsigned int c = 0;
-    while (tmp.size() > 3) {
-	vector<string> tmpout;
-	tmpout.reserve(tmp.size() / 2);
-	vector<Xapian::docid> newoff;
-	newoff.resize(tmp.size() / 2);
-	for (unsigned int i = 0, j; i < tmp.size(); i = j) {
+/// The merges making up one pass of multimerge_postlists().
+class MergeJobs : public Jobs {
+    Xapian::Compactor & compactor;
+
+    Xapian::docid last_docid;
+
+    /// Which pass this is (0 for the first).
+    unsigned pass;
+
+    const vector<string> & tmp;
+
+    const vector<Xapian::docid> & off;
+
+    /// The first input to each merge (the last merge also ends the list).
+    vector<size_t> starts;
+
+  public:
+    /// The output of each merge.
+    vector<string> tmpout;
+
+    MergeJobs(Xapian::Compactor & compactor_, const char * tmpdir,
+	      Xapian::docid last_docid_, unsigned pass_,
+	      const vector<string> & tmp_, const vector<Xapian::docid> & off_)
+	: compactor(compactor_), last_docid(last_docid_), pass(pass_),
+	  tmp(tmp_), off(off_)
+    {
+	for (size_t i = 0, j; i < tmp.size(); i = j) {
 	    j = i + 2;
 	    if (j == tmp.size() - 1) ++j;
 
 	    string dest = tmpdir;
 	    char buf[64];
-	    sprintf(buf, "/tmp%u_%u.", c, i / 2);
+	    sprintf(buf, "/tmp%u_%u.", pass, unsigned(i / 2));
 	    dest += buf;
+	    starts.push_back(i);
+	    tmpout.push_back(dest);
+	}
+	starts.push_back(tmp.size());
+    }
 
-	    // Don't compress temporary tables, even if the final table would
-	    // be.
-	    BrassTable tmptab("postlist", dest, false);
-	    // Use maximum blocksize for temporary tables.
-	    tmptab.create_and_open(Xapian::DB_DANGEROUS|Xapian::DB_NO_SYNC,
-				   65536);
-
-	    merge_postlists(compactor, &tmptab, off.begin() + i,
-			    tmp.begin() + i, tmp.begin() + j, last_docid);
-	    if (c > 0) {
-		for (unsigned int k = i; k < j; ++k) {
-		    unlink((tmp[k] + "DB").c_str());
-		    unlink((tmp[k] + "baseA").c_str());
-		    unlink((tmp[k] + "baseB").c_str());
-		}
+    void do_job(size_t k) {
+	size_t i = starts[k];
+	size_t j = starts[k + 1];
+
+	// Don't compress temporary tables, even if the final table would be.
+	BrassTable tmptab("postlist", tmpout[k], false);
+	// Use maximum blocksize for temporary tables.
+	tmptab.create_and_open(Xapian::DB_DANGEROUS|Xapian::DB_NO_SYNC, 65536);
+
+	// Only bit-pack the final output.
+	merge_postlists(compactor, &tmptab, off.begin() + i,
+			tmp.begin() + i, tmp.begin() + j, last_docid, false);
+	tmptab.flush_db();
+	tmptab.commit(1);
+
+	// Only remove the inputs once we're done with them, as this merge
+	// may need to be repeated if it fails.
+	if (pass > 0) {
+	    for (size_t n = i; n < j; ++n) {
+		unlink((tmp[n] + "DB").c_str());
+		unlink((tmp[n] + "baseA").c_str());
+		unlink((tmp[n] + "baseB").c_str());
 	    }
-	    tmpout.push_back(dest);
-	    tmptab.flush_db();
-	    tmptab.commit(1);
 	}
-	swap(tmp, tmpout);
+    }
+};
+
+static void
+multimerge_postlists(Xapian::Compactor & compactor,
+		     BrassTable * out, const char * tmpdir,
+		     Xapian::docid last_docid, bool pack_postlists,
+		     ThreadBudget & budget,
+		     vector<string> tmp, vector<Xapian::docid> off)
+{
+    unsigned int c = 0;
+    while (tmp.size() > 3) {
+	MergeJobs merges(compactor, tmpdir, last_docid, c, tmp, off);
+	merges.run(merges.tmpout.size(), budget);
+	vector<Xapian::docid> newoff;
+	newoff.resize(merges.tmpout.size());
+	swap(tmp, merges.tmpout);
 	swap(off, newoff);
 	++c;
     }
     merge_postlists(compactor,
-		    out, off.begin(), tmp.begin(), tmp.end(), last_docid);
+		    out, off.begin(), tmp.begin(), tmp.end(), last_docid,
+		    pack_postlists);
     if (c > 0) {
 	for (size_t k = 0; k < tmp.size(); ++k) {
 	    unlink((tmp[k] + "DB").c_str());
@@ -774,6 +991,210 @@ merge_docid_keyed(const char * tablename,
     }
 }
 
+enum table_type {
+    POSTLIST, RECORD, TERMLIST, POSITION, VALUE, SPELLING, SYNONYM
+};
+struct table_list {
+    // The "base name" of the table.
+    const char * name;
+    // The type.
+    table_type type;
+    // zlib compression strategy to use on tags.
+    int compress_strategy;
+    // Create tables after position lazily.
+    bool lazy;
+};
+
+static const table_list tables[] = {
+    // name      type        compress_strategy   lazy
+    { "postlist", POSTLIST,   DONT_COMPRESS,      false },
+    { "record",   RECORD,     Z_DEFAULT_STRATEGY, false },
+    { "termlist", TERMLIST,   Z_DEFAULT_STRATEGY, false },
+    { "position", POSITION,   DONT_COMPRESS,      true },
+    { "spelling", SPELLING,   Z_DEFAULT_STRATEGY, true },
+    { "synonym",  SYNONYM,    Z_DEFAULT_STRATEGY, true }
+};
+
+/// Compacts the tables, with a job for each.
+class TableJobs : public Jobs {
+    Xapian::Compactor & compactor;
+
+    const char * destdir;
+
+    const vector<string> & sources;
+
+    const vector<Xapian::docid> & offset;
+
+    size_t block_size;
+
+    Xapian::Compactor::compaction_level compaction;
+
+    bool multipass;
+
+    bool pack_postlists;
+
+    ThreadBudget & budget;
+
+    Xapian::docid last_docid;
+
+  public:
+    TableJobs(Xapian::Compactor & compactor_,
+	      const char * destdir_, const vector<string> & sources_,
+	      const vector<Xapian::docid> & offset_, size_t block_size_,
+	      Xapian::Compactor::compaction_level compaction_,
+	      bool multipass_, bool pack_postlists_, ThreadBudget & budget_,
+	      Xapian::docid last_docid_)
+	: compactor(compactor_), destdir(destdir_), sources(sources_),
+	  offset(offset_), block_size(block_size_), compaction(compaction_),
+	  multipass(multipass_), pack_postlists(pack_postlists_),
+	  budget(budget_), last_docid(last_docid_) { }
+
+    void do_job(size_t i);
+};
+
+void
+TableJobs::do_job(size_t i)
+{
+    const table_list * t = tables + i;
+    // The postlist table requires an N-way merge, adjusting the
+    // headers of various blocks.  The spelling and synonym tables also
+    // need special handling.  The other tables have keys sorted in
+    // docid order, so we can merge them by simply copying all the keys
+    // from each source table in turn.
+    compactor.set_status(t->name, string());
+
+    string dest = destdir;
+    dest += '/';
+    dest += t->name;
+    dest += '.';
+
+    bool output_will_exist = !t->lazy;
+
+    // Sometimes stat can fail for benign reasons (e.g. >= 2GB file
+    // on certain systems).
+    bool bad_stat = false;
+
+    off_t in_size = 0;
+
+    vector<string> inputs;
+    inputs.reserve(sources.size());
+    size_t inputs_present = 0;
+    for (vector<string>::const_iterator src = sources.begin();
+	 src != sources.end(); ++src) {
+	string s(*src);
+	s += t->name;
+	s += '.';
+
+	off_t db_size = file_size(s + "DB");
+	if (errno == 0) {
+	    in_size += db_size / 1024;
+	    output_will_exist = true;
+	    ++inputs_present;
+	} else if (errno != ENOENT) {
+	    // We get ENOENT for an optional table.
+	    bad_stat = true;
+	    output_will_exist = true;
+	    ++inputs_present;
+	}
+	inputs.push_back(s);
+    }
+
+    // If any inputs lack a termlist table, suppress it in the output.
+    if (t->type == TERMLIST && inputs_present != sources.size()) {
+	if (inputs_present != 0) {
+	    string m = str(inputs_present);
+	    m += " of ";
+	    m += str(sources.size());
+	    m += " inputs present, so suppressing output";
+	    compactor.set_status(t->name, m);
+	    return;
+	}
+	output_will_exist = false;
+    }
+
+    if (!output_will_exist) {
+	compactor.set_status(t->name, "doesn't exist");
+	return;
+    }
+
+    BrassTable out(t->name, dest, false, t->compress_strategy, t->lazy);
+    if (!t->lazy) {
+	out.create_and_open(Xapian::DB_DANGEROUS, block_size);
+    } else {
+	out.erase();
+	out.set_block_size(Xapian::DB_DANGEROUS, block_size);
+    }
+
+    out.set_full_compaction(compaction != compactor.STANDARD);
+    if (compaction == compactor.FULLER) out.set_max_item_size(1);
+
+    switch (t->type) {
+	case POSTLIST:
+	    if (multipass && inputs.size() > 3) {
+		multimerge_postlists(compactor, &out, destdir, last_docid,
+				     pack_postlists, budget, inputs,
+				     offset);
+	    } else {
+		merge_postlists(compactor, &out, offset.begin(),
+				inputs.begin(), inputs.end(),
+				last_docid, pack_postlists);
+	    }
+	    break;
+	case SPELLING:
+	    merge_spellings(&out, inputs.begin(), inputs.end());
+	    break;
+	case SYNONYM:
+	    merge_synonyms(&out, inputs.begin(), inputs.end());
+	    break;
+	default:
+	    // Position, Record, Termlist
+	    merge_docid_keyed(t->name, &out, inputs, offset, t->lazy);
+	    break;
+    }
+
+    // Commit as revision 1.
+    out.flush_db();
+    out.commit(1);
+
+    off_t out_size = 0;
+    if (!bad_stat) {
+	off_t db_size = file_size(dest + "DB");
+	if (errno == 0) {
+	    out_size = db_size / 1024;
+	} else {
+	    bad_stat = (errno != ENOENT);
+	}
+    }
+    if (bad_stat) {
+	compactor.set_status(t->name, "Done (couldn't stat all the DB files)");
+    } else {
+	string status;
+	if (out_size == in_size) {
+	    status = "Size unchanged (";
+	} else {
+	    off_t delta;
+	    if (out_size < in_size) {
+		delta = in_size - out_size;
+		status = "Reduced by ";
+	    } else {
+		delta = out_size - in_size;
+		status = "INCREASED by ";
+	    }
+	    if (in_size) {
+		status += str(100 * delta / in_size);
+		status += "% ";
+	    }
+	    status += str(delta);
+	    status += "K (";
+	    status += str(in_size);
+	    status += "K -> ";
+	}
+	status += str(out_size);
+	status += "K)";
+	compactor.set_status(t->name, status);
+    }
+}
+
 }
 
 using namespace BrassCompact;
@@ -783,169 +1204,59 @@ compact_brass(Xapian::Compactor & compactor,
 	      const char * destdir, const vector<string> & sources,
 	      const vector<Xapian::docid> & offset, size_t block_size,
 	      Xapian::Compactor::compaction_level compaction, bool multipass,
+	      bool pack_postlists, unsigned threads,
 	      Xapian::docid last_docid) {
-    enum table_type {
-	POSTLIST, RECORD, TERMLIST, POSITION, VALUE, SPELLING, SYNONYM
-    };
-    struct table_list {
-	// The "base name" of the table.
-	const char * name;
-	// The type.
-	table_type type;
-	// zlib compression strategy to use on tags.
-	int compress_strategy;
-	// Create tables after position lazily.
-	bool lazy;
-    };
-
-    static const table_list tables[] = {
-	// name		type		compress_strategy	lazy
-	{ "postlist",	POSTLIST,	DONT_COMPRESS,		false },
-	{ "record",	RECORD,		Z_DEFAULT_STRATEGY,	false },
-	{ "termlist",	TERMLIST,	Z_DEFAULT_STRATEGY,	false },
-	{ "position",	POSITION,	DONT_COMPRESS,		true },
-	{ "spelling",	SPELLING,	Z_DEFAULT_STRATEGY,	true },
-	{ "synonym",	SYNONYM,	Z_DEFAULT_STRATEGY,	true }
-    };
-    const table_list * tables_end = tables +
-	(sizeof(tables) / sizeof(tables[0]));
-
-    for (const table_list * t = tables; t < tables_end; ++t) {
-	// The postlist table requires an N-way merge, adjusting the
-	// headers of various blocks.  The spelling and synonym tables also
-	// need special handling.  The other tables have keys sorted in
-	// docid order, so we can merge them by simply copying all the keys
-	// from each source table in turn.
-	compactor.set_status(t->name, string());
-
-	string dest = destdir;
-	dest += '/';
-	dest += t->name;
-	dest += '.';
-
-	bool output_will_exist = !t->lazy;
-
-	// Sometimes stat can fail for benign reasons (e.g. >= 2GB file
-	// on certain systems).
-	bool bad_stat = false;
-
-	off_t in_size = 0;
-
-	vector<string> inputs;
-	inputs.reserve(sources.size());
-	size_t inputs_present = 0;
-	for (vector<string>::const_iterator src = sources.begin();
-	     src != sources.end(); ++src) {
-	    string s(*src);
-	    s += t->name;
-	    s += '.';
-
-	    off_t db_size = file_size(s + "DB");
-	    if (errno == 0) {
-		in_size += db_size / 1024;
-		output_will_exist = true;
-		++inputs_present;
-	    } else if (errno != ENOENT) {
-		// We get ENOENT for an optional table.
-		bad_stat = true;
-		output_will_exist = true;
-		++inputs_present;
-	    }
-	    inputs.push_back(s);
-	}
-
-	// If any inputs lack a termlist table, suppress it in the output.
-	if (t->type == TERMLIST && inputs_present != sources.size()) {
-	    if (inputs_present != 0) {
-		string m = str(inputs_present);
-		m += " of ";
-		m += str(sources.size());
-		m += " inputs present, so suppressing output";
-		compactor.set_status(t->name, m);
-		continue;
-	    }
-	    output_will_exist = false;
-	}
-
-	if (!output_will_exist) {
-	    compactor.set_status(t->name, "doesn't exist");
-	    continue;
-	}
+    // The tables are independent, so with several threads we build them
+    // concurrently.  The postlist table is first in the list, so work on
+    // it (which usually takes longest) starts straight away.  Threads which
+    // run out of tables to build can then help with its merges.
+    LockedCompactor locked_compactor(compactor);
+    ThreadBudget budget(threads);
+    TableJobs jobs(locked_compactor, destdir, sources, offset, block_size,
+		   compaction, multipass, pack_postlists, budget, last_docid);
+    jobs.run(sizeof(tables) / sizeof(tables[0]), budget);
+}
+
+void
+merge_brass_postlist_runs(BrassTable * out,
+			  const vector<string> & runs)
+{
+    // Runs contain no user metadata, so the compactor is never asked to
+    // resolve duplicates.
+    Xapian::Compactor compactor;
+    vector<Xapian::docid> offset(runs.size(), 0);
+    merge_postlists(compactor, out, offset.begin(), runs.begin(), runs.end(),
+		    0, false);
+}
 
-	BrassTable out(t->name, dest, false, t->compress_strategy, t->lazy);
-	if (!t->lazy) {
-	    out.create_and_open(Xapian::DB_DANGEROUS, block_size);
+void
+merge_brass_position_runs(BrassTable * out,
+			  const vector<string> & runs)
+{
+    priority_queue<MergeCursor *, vector<MergeCursor *>, CursorGt> pq;
+    for (vector<string>::const_iterator b = runs.begin(); b != runs.end(); ++b) {
+	BrassTable *in = new BrassTable("position", *b, true, DONT_COMPRESS, true);
+	in->open(0);
+	if (!in->empty()) {
+	    // The MergeCursor takes ownership of BrassTable in and is
+	    // responsible for deleting it.
+	    pq.push(new MergeCursor(in));
 	} else {
-	    out.erase();
-	    out.set_block_size(Xapian::DB_DANGEROUS, block_size);
+	    delete in;
 	}
+    }
 
-	out.set_full_compaction(compaction != compactor.STANDARD);
-	if (compaction == compactor.FULLER) out.set_max_item_size(1);
-
-	switch (t->type) {
-	    case POSTLIST:
-		if (multipass && inputs.size() > 3) {
-		    multimerge_postlists(compactor, &out, destdir, last_docid,
-					 inputs, offset);
-		} else {
-		    merge_postlists(compactor, &out, offset.begin(),
-				    inputs.begin(), inputs.end(),
-				    last_docid);
-		}
-		break;
-	    case SPELLING:
-		merge_spellings(&out, inputs.begin(), inputs.end());
-		break;
-	    case SYNONYM:
-		merge_synonyms(&out, inputs.begin(), inputs.end());
-		break;
-	    default:
-		// Position, Record, Termlist
-		merge_docid_keyed(t->name, &out, inputs, offset, t->lazy);
-		break;
-	}
-
-	// Commit as revision 1.
-	out.flush_db();
-	out.commit(1);
-
-	off_t out_size = 0;
-	if (!bad_stat) {
-	    off_t db_size = file_size(dest + "DB");
-	    if (errno == 0) {
-		out_size = db_size / 1024;
-	    } else {
-		bad_stat = (errno != ENOENT);
-	    }
-	}
-	if (bad_stat) {
-	    compactor.set_status(t->name, "Done (couldn't stat all the DB files)");
+    // Each run is for different documents, so the keys are all distinct and
+    // we just need to interleave them.
+    while (!pq.empty()) {
+	MergeCursor * cur = pq.top();
+	pq.pop();
+	bool compressed = cur->read_tag(true);
+	out->add(cur->current_key, cur->current_tag, compressed);
+	if (cur->next()) {
+	    pq.push(cur);
 	} else {
-	    string status;
-	    if (out_size == in_size) {
-		status = "Size unchanged (";
-	    } else {
-		off_t delta;
-		if (out_size < in_size) {
-		    delta = in_size - out_size;
-		    status = "Reduced by ";
-		} else {
-		    delta = out_size - in_size;
-		    status = "INCREASED by ";
-		}
-		if (in_size) {
-		    status += str(100 * delta / in_size);
-		    status += "% ";
-		}
-		status += str(delta);
-		status += "K (";
-		status += str(in_size);
-		status += "K -> ";
-	    }
-	    status += str(out_size);
-	    status += "K)";
-	    compactor.set_status(t->name, status);
+	    delete cur;
 	}
     }
 }
@@ -28,11 +28,38 @@
 #include "xapian/compactor.h"
 #include "xapian/types.h"
 
+class BrassTable;
+
 void
 compact_brass(Xapian::Compactor & compactor,
 	      const char * destdir, const std::vector<std::string> & sources,
 	      const std::vector<Xapian::docid> & offset, size_t block_size,
 	      Xapian::Compactor::compaction_level compaction, bool multipass,
+	      bool pack_postlists, unsigned threads,
 	      Xapian::docid last_docid);
 
+/** Merge sorted runs of postlist tables into @a out.
+ *
+ *  Used to build a postlist table bottom-up when bulk loading.  The runs must
+ *  each hold postings for a different range of document ids, and @a out must
+ *  not yet contain any postings.
+ *
+ *  @param out	The table to write to.
+ *  @param runs	The path of each run table (e.g. "/path/to/run/postlist.").
+ */
+void
+merge_brass_postlist_runs(BrassTable * out,
+			  const std::vector<std::string> & runs);
+
+/** Merge sorted runs of position tables into @a out.
+ *
+ *  The runs must each hold positional data for different documents.
+ *
+ *  @param out	The table to write to.
+ *  @param runs	The path of each run table (e.g. "/path/to/run/position.").
+ */
+void
+merge_brass_position_runs(BrassTable * out,
+			  const std::vector<std::string> & runs);
+
 #endif
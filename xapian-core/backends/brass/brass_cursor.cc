@@ -56,10 +56,13 @@ BrassCursor::BrassCursor(const BrassTable *B_, const Brass::Cursor * C_)
 	: is_positioned(false),
 	  is_after_end(false),
 	  tag_status(UNREAD),
-	  B(B_),
-	  version(B_->cursor_version),
-	  level(B_->level)
+	  B(B_)
 {
+    // A cursor copies the table's position, so mustn't be created while
+    // another thread is writing the table.
+    B->wait_for_writer();
+    version = B->cursor_version;
+    level = B->level;
     B->cursor_created_since_last_modification = true;
     C = new Brass::Cursor[level + 1];
     if (!C_) C_ = B->C;
@@ -102,6 +105,7 @@ BrassCursor::prev()
 {
     LOGCALL(DB, bool, "BrassCursor::prev", NO_ARGS);
     Assert(!is_after_end);
+    B->wait_for_writer();
     if (B->cursor_version != version || !is_positioned) {
 	// Either the cursor needs rebuilding (in which case find_entry() will
 	// call rebuild() and then reposition the cursor), or we've read the
@@ -146,6 +150,7 @@ BrassCursor::next()
 {
     LOGCALL(DB, bool, "BrassCursor::next", NO_ARGS);
     Assert(!is_after_end);
+    B->wait_for_writer();
     if (B->cursor_version != version) {
 	// find_entry() will call rebuild().
 	(void)find_entry(current_key);
@@ -182,6 +187,7 @@ bool
 BrassCursor::find_entry(const string &key)
 {
     LOGCALL(DB, bool, "BrassCursor::find_entry", key);
+    B->wait_for_writer();
     if (B->cursor_version != version) {
 	rebuild();
     }
@@ -230,6 +236,7 @@ bool
 BrassCursor::find_exact(const string &key)
 {
     LOGCALL(DB, bool, "BrassCursor::find_exact", key);
+    B->wait_for_writer();
     is_after_end = false;
     is_positioned = false;
     if (rare(key.size() > BRASS_BTREE_MAX_KEY_LEN)) {
@@ -255,6 +262,7 @@ bool
 BrassCursor::find_entry_ge(const string &key)
 {
     LOGCALL(DB, bool, "BrassCursor::find_entry_ge", key);
+    B->wait_for_writer();
     if (B->cursor_version != version) {
 	rebuild();
     }
@@ -306,6 +314,7 @@ BrassCursor::read_tag(bool keep_compressed)
 {
     LOGCALL(DB, bool, "BrassCursor::read_tag", keep_compressed);
     if (tag_status == UNREAD) {
+	B->wait_for_writer();
 	Assert(B->level <= level);
 	Assert(is_positioned);
 
@@ -33,6 +33,7 @@
 #include "xapian/error.h"
 #include "xapian/valueiterator.h"
 
+#include "backends/blockcache.h"
 #include "backends/contiguousalldocspostlist.h"
 #include "brass_alldocspostlist.h"
 #include "brass_alltermslist.h"
@@ -56,8 +57,10 @@
 #include "replicationprotocol.h"
 #include "net/length.h"
 #include "posixy_wrapper.h"
+#include "realtime.h"
 #include "str.h"
 #include "stringutils.h"
+#include "thread.h"
 #include "backends/valuestats.h"
 
 #include "safeerrno.h"
@@ -87,6 +90,13 @@ using Xapian::Internal::intrusive_ptr;
 // byte in the term).
 #define MAX_SAFE_TERM_LENGTH 245
 
+/** How many documents to give each thread in a batch for add_documents().
+ *
+ *  Preparing a typical document takes tens of microseconds, so this is
+ *  enough to make starting the threads for each batch worthwhile.
+ */
+#define DOCS_PER_PREPARE_THREAD 64
+
 /** Maximum number of times to try opening the tables to get them at a
  *  consistent revision.
  *
@@ -95,12 +105,32 @@ using Xapian::Internal::intrusive_ptr;
  */
 const int MAX_OPEN_RETRIES = 100;
 
+/** The most commits in a row which are deferred by the sync window.
+ *
+ *  This limits how much can be lost in a crash if commits are made
+ *  continually, however long the window is.
+ */
+const unsigned MAX_DEFERRED_COMMITS = 100;
+
+#ifdef HAVE_SYNCFS
+/// Ensure everything written to the filesystem containing @a dir is on disk.
+static void
+sync_filesystem(const string & dir)
+{
+    FD fd(posixy_open(dir.c_str(), O_RDONLY | O_CLOEXEC));
+    if (fd < 0 || !io_sync_filesystem(fd)) {
+	throw Xapian::DatabaseError("Can't sync database '" + dir +
+				    "' to disk", errno);
+    }
+}
+#endif
+
 /* This finds the tables, opens them at consistent revisions, manages
  * determining the current and next revision numbers, and stores handles
  * to the tables.
  */
 BrassDatabase::BrassDatabase(const string &brass_dir, int flags,
-			     unsigned int block_size)
+			     unsigned int block_size, int readonly_flags)
 	: db_dir(brass_dir),
 	  readonly(flags == Xapian::DB_READONLY_),
 	  version_file(db_dir),
@@ -112,12 +142,13 @@ BrassDatabase::BrassDatabase(const string &brass_dir, int flags,
 	  spelling_table(db_dir, readonly),
 	  record_table(db_dir, readonly),
 	  lock(db_dir),
-	  changes(db_dir)
+	  changes(db_dir),
+	  snapshot_revision(0)
 {
-    LOGCALL_CTOR(DB, "BrassDatabase", brass_dir | flags | block_size);
+    LOGCALL_CTOR(DB, "BrassDatabase", brass_dir | flags | block_size | readonly_flags);
 
     if (readonly) {
-	open_tables_consistent(0);
+	open_tables_consistent(readonly_flags & Xapian::DB_MMAP);
 	return;
     }
 
@@ -235,6 +266,13 @@ BrassDatabase::open_tables_consistent(int flags)
 	RETURN(false);
     }
 
+    if (cur_rev && readonly && SharedBlockCache::instance().enabled()) {
+	// Blocks in the shared block cache are identified using the
+	// database's UUID, so we need to recheck it in case the database has
+	// been replaced by a new one with a different UUID.
+	version_file.read_and_check();
+    }
+
     // Set the block_size for optional tables as they may not currently exist.
     unsigned int block_size = record_table.get_block_size();
     position_table.set_block_size(flags, block_size);
@@ -282,6 +320,16 @@ BrassDatabase::open_tables_consistent(int flags)
 	throw Xapian::DatabaseModifiedError("Cannot open tables at stable revision - changing too fast");
     }
 
+    if (readonly) {
+	string uuid(version_file.get_uuid(), 16);
+	postlist_table.set_block_cache_id(uuid);
+	position_table.set_block_cache_id(uuid);
+	termlist_table.set_block_cache_id(uuid);
+	synonym_table.set_block_cache_id(uuid);
+	spelling_table.set_block_cache_id(uuid);
+	record_table.set_block_cache_id(uuid);
+    }
+
     stats.read(postlist_table);
 
     if (!readonly) {
@@ -400,12 +448,43 @@ BrassDatabase::set_revision_number(int flags, brass_revision_number_t new_revisi
     spelling_table.flush_db();
     record_table.flush_db();
 
-    postlist_table.commit(new_revision);
-    position_table.commit(new_revision);
-    termlist_table.commit(new_revision);
-    synonym_table.commit(new_revision);
-    spelling_table.commit(new_revision);
-    record_table.commit(new_revision);
+    // The record table must be committed last (see the comment on
+    // record_table).
+    BrassTable * tables[] = {
+	&postlist_table, &position_table, &termlist_table,
+	&synonym_table, &spelling_table, &record_table
+    };
+    const size_t n_tables = sizeof(tables) / sizeof(tables[0]);
+
+    bool sync = !(flags & Xapian::DB_NO_SYNC);
+#ifdef HAVE_SYNCFS
+    bool sync_fs = sync && (flags & Xapian::DB_SYNC_FILESYSTEM);
+#else
+    const bool sync_fs = false;
+#endif
+
+    // Write all the tables before syncing any of them so that the writes can
+    // proceed together, and so no table's new revision becomes live until
+    // every table's new revision is on disk.
+    for (size_t i = 0; i != n_tables; ++i) {
+	tables[i]->write_commit(new_revision, sync && !sync_fs);
+    }
+    if (sync_fs) {
+#ifdef HAVE_SYNCFS
+	sync_filesystem(db_dir);
+#endif
+    } else if (sync) {
+	for (size_t i = 0; i != n_tables; ++i) {
+	    tables[i]->start_sync();
+	}
+	for (size_t i = 0; i != n_tables; ++i) {
+	    tables[i]->sync_commit();
+	}
+    }
+    for (size_t i = 0; i != n_tables; ++i) {
+	tables[i]->finish_commit();
+    }
+
     changes.commit(new_revision, flags);
 }
 
@@ -421,6 +500,7 @@ void
 BrassDatabase::close()
 {
     LOGCALL_VOID(DB, "BrassDatabase::close", NO_ARGS);
+    snapshots.clear();
     postlist_table.close(true);
     position_table.close(true);
     termlist_table.close(true);
@@ -640,6 +720,14 @@ BrassDatabase::modifications_failed(brass_revision_number_t old_revision,
 				    "revision numbers: " + e.get_msg());
     }
 
+    start_changes(old_revision, new_revision, flags);
+}
+
+void
+BrassDatabase::start_changes(brass_revision_number_t old_revision,
+			     brass_revision_number_t new_revision,
+			     int flags)
+{
     BrassChanges * p;
     p = changes.start(old_revision, new_revision, flags);
     postlist_table.set_changes(p);
@@ -650,17 +738,23 @@ BrassDatabase::modifications_failed(brass_revision_number_t old_revision,
     record_table.set_changes(p);
 }
 
+bool
+BrassDatabase::is_modified() const
+{
+    return postlist_table.is_modified() ||
+	position_table.is_modified() ||
+	termlist_table.is_modified() ||
+	value_manager.is_modified() ||
+	synonym_table.is_modified() ||
+	spelling_table.is_modified() ||
+	record_table.is_modified();
+}
+
 void
 BrassDatabase::apply()
 {
     LOGCALL_VOID(DB, "BrassDatabase::apply", NO_ARGS);
-    if (!postlist_table.is_modified() &&
-	!position_table.is_modified() &&
-	!termlist_table.is_modified() &&
-	!value_manager.is_modified() &&
-	!synonym_table.is_modified() &&
-	!spelling_table.is_modified() &&
-	!record_table.is_modified()) {
+    if (!is_modified()) {
 	return;
     }
 
@@ -678,14 +772,7 @@ BrassDatabase::apply()
 	throw;
     }
 
-    BrassChanges * p;
-    p = changes.start(new_revision, new_revision + 1, flags);
-    postlist_table.set_changes(p);
-    position_table.set_changes(p);
-    termlist_table.set_changes(p);
-    synonym_table.set_changes(p);
-    spelling_table.set_changes(p);
-    record_table.set_changes(p);
+    start_changes(new_revision, new_revision + 1, flags);
 }
 
 void
@@ -826,6 +913,14 @@ BrassDatabase::open_post_list(const string& term) const
 	RETURN(new BrassAllDocsPostList(ptrtothis, doccount));
     }
 
+    if (readonly && DecodedPostListCache::enabled()) {
+	LeafPostList * pl = postlist_cache.open_post_list(this, term,
+							  get_revision_number());
+	if (pl) RETURN(pl);
+	RETURN(postlist_cache.add(this, term,
+				  new BrassPostList(ptrtothis, term, true)));
+    }
+
     RETURN(new BrassPostList(ptrtothis, term, true));
 }
 
@@ -958,6 +1053,48 @@ BrassDatabase::get_uuid() const
     RETURN(version_file.get_uuid_string());
 }
 
+string
+BrassDatabase::get_revision_key() const
+{
+    LOGCALL(DB, string, "BrassDatabase::get_revision_key", NO_ARGS);
+    // A writable database may have uncommitted changes which aren't
+    // reflected in the revision number.
+    if (!readonly) RETURN(string());
+    string key(version_file.get_uuid(), 16);
+    pack_uint(key, get_revision_number());
+    RETURN(key);
+}
+
+Xapian::Database::Internal *
+BrassDatabase::open_snapshot(size_t n) const
+{
+    LOGCALL(DB, Xapian::Database::Internal *, "BrassDatabase::open_snapshot", n);
+    // A writable database may have changes which haven't been committed.
+    if (!readonly) RETURN(NULL);
+    brass_revision_number_t revision = get_revision_number();
+    if (revision != snapshot_revision) {
+	snapshots.clear();
+	snapshot_revision = revision;
+    }
+    if (n < snapshots.size() && snapshots[n].get()) RETURN(snapshots[n].get());
+    try {
+	// Open the snapshot the same way we were opened (e.g. with DB_MMAP).
+	int flags = postlist_table.get_flags();
+	AutoPtr<BrassDatabase> snapshot(
+	    new BrassDatabase(db_dir, Xapian::DB_READONLY_, 0, flags));
+	if (snapshot->get_revision_number() != revision) {
+	    // Another revision has been committed since we opened, so try to
+	    // open the revision we're reading.
+	    snapshot->open_tables(flags, revision);
+	}
+	if (n >= snapshots.size()) snapshots.resize(n + 1);
+	snapshots[n] = snapshot.release();
+	RETURN(snapshots[n].get());
+    } catch (const Xapian::Error &) {
+	RETURN(NULL);
+    }
+}
+
 void
 BrassDatabase::throw_termlist_table_close_exception() const
 {
@@ -970,55 +1107,345 @@ BrassDatabase::throw_termlist_table_close_exception() const
 
 ///////////////////////////////////////////////////////////////////////////
 
+/// Commit a snapshot of a database's changes in the background.
+class BrassCommitThread : public Thread {
+    BrassWritableDatabase & db;
+
+  public:
+    explicit BrassCommitThread(BrassWritableDatabase & db_) : db(db_) { }
+
+    void run() { db.commit_snapshot(); }
+};
+
 BrassWritableDatabase::BrassWritableDatabase(const string &dir, int flags,
 					       int block_size)
 	: BrassDatabase(dir, flags, block_size),
 	  change_count(0),
 	  flush_threshold(0),
+	  flush_threshold_bytes(size_t(-1)),
+	  sync_window(0),
+	  last_commit_time(0),
+	  deferred_commits(0),
 	  modify_shortcut_document(NULL),
-	  modify_shortcut_docid(0)
+	  modify_shortcut_docid(0),
+	  commit_value_manager(&postlist_table, &termlist_table),
+	  commit_old_revision(0),
+	  commit_new_revision(0),
+	  pending_bytes(0)
 {
     LOGCALL_CTOR(DB, "BrassWritableDatabase", dir | flags | block_size);
 
     const char *p = getenv("XAPIAN_FLUSH_THRESHOLD");
-    if (p)
-	flush_threshold = atoi(p);
+    if (p) {
+	// A number with a K, M or G suffix is an amount of memory to let
+	// buffered changes use - otherwise it's a number of documents.
+	char * end;
+	unsigned long n = strtoul(p, &end, 10);
+	size_t multiplier = 0;
+	switch (*end) {
+	    case 'K': case 'k':
+		multiplier = 1024;
+		break;
+	    case 'M': case 'm':
+		multiplier = 1024 * 1024;
+		break;
+	    case 'G': case 'g':
+		multiplier = 1024 * 1024 * 1024;
+		break;
+	}
+	if (multiplier) {
+	    if (n) {
+		// Clamp rather than overflow (e.g. "8G" with 32-bit size_t).
+		if (n > size_t(-1) / multiplier) {
+		    flush_threshold_bytes = size_t(-1);
+		} else {
+		    flush_threshold_bytes = n * multiplier;
+		}
+		flush_threshold = Xapian::doccount(-1);
+	    }
+	} else {
+	    flush_threshold = n;
+	}
+    }
     if (flush_threshold == 0)
 	flush_threshold = 10000;
+
+    p = getenv("XAPIAN_SYNC_WINDOW");
+    if (p) sync_window = strtod(p, NULL);
+
+    // A bulk load which didn't finish leaves its runs behind, whether or
+    // not we're bulk loading this time.
+    BrassBulkLoader::remove_stale_runs(db_dir);
+
+    // Bulk loading needs the postlist and position tables to be empty, so
+    // only do it for a database with no documents yet.
+    if ((flags & Xapian::DB_BULK_LOAD) && stats.get_last_docid() == 0)
+	bulk_loader.reset(new BrassBulkLoader(db_dir));
 }
 
 BrassWritableDatabase::~BrassWritableDatabase()
 {
     LOGCALL_DTOR(DB, "BrassWritableDatabase");
+    // Don't defer the final commit.
+    sync_window = 0;
     dtor_called();
 }
 
+bool
+BrassWritableDatabase::defer_commit()
+{
+    if (sync_window <= 0 || (postlist_table.get_flags() & Xapian::DB_NO_SYNC))
+	return false;
+    double now = RealTime::now();
+    if (now - last_commit_time < sync_window &&
+	deferred_commits < MAX_DEFERRED_COMMITS) {
+	++deferred_commits;
+	return true;
+    }
+    return false;
+}
+
 void
 BrassWritableDatabase::commit()
 {
     if (transaction_active())
 	throw Xapian::InvalidOperationError("Can't commit during a transaction");
+    if (defer_commit()) return;
+    commit_now();
+}
+
+void
+BrassWritableDatabase::commit_now()
+{
+    last_commit_time = RealTime::now();
+    deferred_commits = 0;
+    finish_commit();
+    end_bulk_load();
     if (change_count) flush_postlist_changes();
     apply();
 }
 
+void
+BrassWritableDatabase::commit_async()
+{
+    LOGCALL_VOID(DB, "BrassWritableDatabase::commit_async", NO_ARGS);
+    if (transaction_active())
+	throw Xapian::InvalidOperationError("Can't commit during a transaction");
+    if (defer_commit()) return;
+    last_commit_time = RealTime::now();
+    deferred_commits = 0;
+    // Only one commit runs in the background at once.
+    finish_commit();
+    end_bulk_load();
+
+    // Take the buffered changes, leaving empty buffers for documents added
+    // while the commit runs.  Updating the tables is left to the background
+    // thread.
+    if (change_count) {
+	stats.set_oldest_changeset(changes.get_oldest_changeset());
+	stats.write(postlist_table);
+	change_count = 0;
+    }
+    inverter.swap_changes(commit_inverter);
+    swap(value_stats, commit_value_stats);
+    value_manager.swap_changes(commit_value_manager);
+    commit_error.resize(0);
+    commit_thread.reset(new BrassCommitThread(*this));
+    set_tables_writer(this);
+    commit_thread->start();
+}
+
+void
+BrassWritableDatabase::wait_for_commit()
+{
+    LOGCALL_VOID(DB, "BrassWritableDatabase::wait_for_commit", NO_ARGS);
+    finish_commit();
+}
+
+void
+BrassWritableDatabase::set_sync_window(double seconds)
+{
+    LOGCALL_VOID(DB, "BrassWritableDatabase::set_sync_window", seconds);
+    sync_window = seconds;
+    if (sync_window <= 0 && deferred_commits && !transaction_active())
+	commit_now();
+}
+
+void
+BrassWritableDatabase::begin_transaction(bool flushed)
+{
+    LOGCALL_VOID(DB, "BrassWritableDatabase::begin_transaction", flushed);
+    // Cancelling a transaction discards all the changes which haven't been
+    // written, so write those of any deferred commits first.
+    if (deferred_commits && !transaction_active()) commit_now();
+    BrassDatabase::begin_transaction(flushed);
+}
+
+void
+BrassWritableDatabase::commit_snapshot()
+{
+    // This is apply(), except that if the commit fails we leave recovering
+    // to finish_commit_(), which runs in the thread which owns the database.
+    commit_old_revision = get_revision_number();
+    commit_new_revision = get_next_revision_number();
+    try {
+	commit_inverter.flush(postlist_table);
+	commit_inverter.flush_pos_lists(position_table);
+	commit_value_manager.set_value_stats(commit_value_stats);
+	commit_value_manager.merge_changes();
+	if (!is_modified()) {
+	    commit_new_revision = 0;
+	    return;
+	}
+	set_revision_number(postlist_table.get_flags(), commit_new_revision);
+    } catch (const Xapian::Error & e) {
+	commit_error = e.get_description();
+    } catch (...) {
+	commit_error = "Unknown error";
+    }
+}
+
+void
+BrassWritableDatabase::finish_commit_() const
+{
+    LOGCALL_VOID(DB, "BrassWritableDatabase::finish_commit_", NO_ARGS);
+    // Finishing the commit completes a modification which commit_async()
+    // started, even if we're called from a method which only reads.
+    BrassWritableDatabase * self = const_cast<BrassWritableDatabase *>(this);
+    commit_thread->join();
+    commit_thread.reset();
+    self->set_tables_writer(NULL);
+    value_manager.reset();
+
+    deque<PendingDocument> docs;
+    docs.swap(self->pending_documents);
+    self->pending_bytes = 0;
+    if (!commit_error.empty()) {
+	// As when commit() fails, the changes since the last successful
+	// commit are lost, which includes the documents added while this
+	// commit was running.
+	self->commit_inverter.clear();
+	self->commit_value_stats.clear();
+	self->commit_value_manager.cancel();
+	self->modifications_failed(commit_old_revision, commit_new_revision,
+				   commit_error);
+	throw Xapian::DatabaseError("Background commit failed: " +
+				    commit_error);
+    }
+
+    if (commit_new_revision) {
+	self->start_changes(commit_new_revision, commit_new_revision + 1,
+			    postlist_table.get_flags());
+    }
+
+    while (!docs.empty()) {
+	PendingDocument & doc = docs.front();
+	(void)self->add_document_(doc.did, doc.document, &doc.prepared);
+	docs.pop_front();
+    }
+}
+
+void
+BrassWritableDatabase::set_tables_writer(const BrassTableWriter * writer)
+{
+    postlist_table.set_writer(writer);
+    position_table.set_writer(writer);
+    termlist_table.set_writer(writer);
+    synonym_table.set_writer(writer);
+    spelling_table.set_writer(writer);
+    record_table.set_writer(writer);
+}
+
+void
+BrassWritableDatabase::wait_for_writer() const
+{
+    if (commit_thread.get() && !commit_thread->is_current()) finish_commit_();
+}
+
+Xapian::docid
+BrassWritableDatabase::queue_document(Xapian::docid did,
+				      const Xapian::Document & document)
+{
+    LOGCALL(DB, Xapian::docid, "BrassWritableDatabase::queue_document", did | document);
+    // Don't let documents pile up in memory without limit if the commit is
+    // slow.  The limits are those which trigger an automatic flush, since
+    // the queued documents need to fit in the inverter once the commit
+    // finishes.
+    if (pending_documents.size() >= flush_threshold ||
+	pending_bytes >= flush_threshold_bytes) {
+	finish_commit();
+	RETURN(add_document_(did, document));
+    }
+
+    pending_documents.push_back(PendingDocument(did));
+    try {
+	PendingDocument & doc = pending_documents.back();
+	doc.prepared.prepare(document, position_table,
+			     termlist_table.is_open());
+	vector<BrassPreparedDocument::Term>::const_iterator term;
+	for (term = doc.prepared.terms.begin();
+	     term != doc.prepared.terms.end(); ++term) {
+	    const string & tname = term->name;
+	    if (tname.size() > MAX_SAFE_TERM_LENGTH)
+		throw Xapian::InvalidArgumentError("Term too long (> "STRINGIZE(MAX_SAFE_TERM_LENGTH)"): " + tname);
+	}
+	// The caller may modify the document once we return, so copy the
+	// data and values.
+	string data = document.get_data();
+	size_t bytes = doc.prepared.get_memory_used() + data.size();
+	doc.document.set_data(data);
+	Xapian::ValueIterator value = document.values_begin();
+	for ( ; value != document.values_end(); ++value) {
+	    const string & v = *value;
+	    bytes += v.size();
+	    doc.document.add_value(value.get_valueno(), v);
+	}
+	pending_bytes += bytes;
+    } catch (...) {
+	pending_documents.pop_back();
+	// Give back the docid, as add_document() does if it fails.
+	stats.set_last_docid(did - 1);
+	throw;
+    }
+    RETURN(did);
+}
+
 void
 BrassWritableDatabase::flush_postlist_changes() const
 {
     stats.set_oldest_changeset(changes.get_oldest_changeset());
     stats.write(postlist_table);
-    inverter.flush(postlist_table);
-    inverter.flush_pos_lists(position_table);
+    if (bulk_loader.get()) {
+	// Values are stored in the postlist table but are written in the
+	// usual way.  As we don't commit until bulk loading ends, write them
+	// now so they don't pile up in memory.
+	value_manager.merge_changes();
+	bulk_loader->add_run(inverter);
+    } else {
+	inverter.flush(postlist_table);
+	inverter.flush_pos_lists(position_table);
+    }
 
     change_count = 0;
 }
 
+void
+BrassWritableDatabase::end_bulk_load_() const
+{
+    LOGCALL_VOID(DB, "BrassWritableDatabase::end_bulk_load_", NO_ARGS);
+    // Write any buffered changes as the final run.
+    if (change_count) flush_postlist_changes();
+    bulk_loader->merge(postlist_table, position_table);
+    bulk_loader.reset();
+}
+
 void
 BrassWritableDatabase::close()
 {
     LOGCALL_VOID(DB, "BrassWritableDatabase::close", NO_ARGS);
+    finish_commit();
     if (!transaction_active()) {
-	commit();
+	commit_now();
 	// FIXME: if commit() throws, should we still close?
     }
     BrassDatabase::close();
@@ -1038,45 +1465,99 @@ BrassWritableDatabase::add_document(const Xapian::Document & document)
     // Make sure the docid counter doesn't overflow.
     if (stats.get_last_docid() == Xapian::docid(-1))
 	throw Xapian::DatabaseError("Run out of docids - you'll have to use copydatabase to eliminate any gaps before you can add more documents");
+    // Documents from this database need to read the tables, so have to
+    // wait for any commit running in the background.
+    if (commit_thread.get() && !document.internal->is_from(this))
+	RETURN(queue_document(stats.get_next_docid(), document));
+    finish_commit();
     // Use the next unused document ID.
     RETURN(add_document_(stats.get_next_docid(), document));
 }
 
+Xapian::docid
+BrassWritableDatabase::add_documents(const vector<Xapian::Document> & documents,
+				     unsigned threads)
+{
+    LOGCALL(DB, Xapian::docid, "BrassWritableDatabase::add_documents", documents.size() | threads);
+    finish_commit();
+    if (threads <= 1 || documents.size() <= 1)
+	RETURN(Database::Internal::add_documents(documents, threads));
+
+    // Prepare each batch in the worker threads while this thread adds the
+    // previous batch to the tables.  Only two batches are held at once, so
+    // the memory used by prepared documents stays modest.
+    size_t batch_size = threads * DOCS_PER_PREPARE_THREAD;
+    vector<BrassPreparedDocument> batch, next_batch;
+    BrassDocumentPreparer preparer(position_table, termlist_table.is_open(),
+				   threads);
+    Xapian::docid first_did = 0;
+    size_t begin = 0;
+    size_t end = min(documents.size(), batch_size);
+    preparer.start(documents, begin, end, next_batch);
+    while (begin != end) {
+	preparer.wait();
+	swap(batch, next_batch);
+	size_t next_end = min(documents.size(), end + batch_size);
+	if (next_end != end)
+	    preparer.start(documents, end, next_end, next_batch);
+
+	for (size_t i = begin; i != end; ++i) {
+	    // Make sure the docid counter doesn't overflow.
+	    if (stats.get_last_docid() == Xapian::docid(-1))
+		throw Xapian::DatabaseError("Run out of docids - you'll have to use copydatabase to eliminate any gaps before you can add more documents");
+	    const BrassPreparedDocument & prepared = batch[i - begin];
+	    Xapian::docid did = add_document_(stats.get_next_docid(),
+					      documents[i],
+					      prepared.prepared ? &prepared : NULL);
+	    if (first_did == 0) first_did = did;
+	}
+
+	begin = end;
+	end = next_end;
+    }
+    RETURN(first_did);
+}
+
 Xapian::docid
 BrassWritableDatabase::add_document_(Xapian::docid did,
-				     const Xapian::Document & document)
+				     const Xapian::Document & document,
+				     const BrassPreparedDocument * prepared)
 {
-    LOGCALL(DB, Xapian::docid, "BrassWritableDatabase::add_document_", did | document);
+    LOGCALL(DB, Xapian::docid, "BrassWritableDatabase::add_document_", did | document | prepared);
     Assert(did != 0);
     try {
+	BrassPreparedDocument prepared_here;
+	if (!prepared) {
+	    prepared_here.prepare(document, position_table,
+				  termlist_table.is_open());
+	    prepared = &prepared_here;
+	}
+
 	// Add the record using that document ID.
 	record_table.replace_record(document.get_data(), did);
 
 	// Set the values.
 	value_manager.add_document(did, document, value_stats);
 
-	brass_doclen_t new_doclen = 0;
-	{
-	    Xapian::TermIterator term = document.termlist_begin();
-	    for ( ; term != document.termlist_end(); ++term) {
-		termcount wdf = term.get_wdf();
-		// Calculate the new document length
-		new_doclen += wdf;
-		stats.check_wdf(wdf);
-
-		string tname = *term;
-		if (tname.size() > MAX_SAFE_TERM_LENGTH)
-		    throw Xapian::InvalidArgumentError("Term too long (> "STRINGIZE(MAX_SAFE_TERM_LENGTH)"): " + tname);
-
-		inverter.add_posting(did, tname, wdf);
-		inverter.set_positionlist(position_table, did, tname, term);
-	    }
+	vector<BrassPreparedDocument::Term>::const_iterator term;
+	for (term = prepared->terms.begin(); term != prepared->terms.end();
+	     ++term) {
+	    stats.check_wdf(term->wdf);
+
+	    const string & tname = term->name;
+	    if (tname.size() > MAX_SAFE_TERM_LENGTH)
+		throw Xapian::InvalidArgumentError("Term too long (> "STRINGIZE(MAX_SAFE_TERM_LENGTH)"): " + tname);
+
+	    inverter.add_posting(did, tname, term->wdf);
+	    if (!term->positions.empty())
+		inverter.set_positionlist(did, tname, term->positions);
 	}
+	brass_doclen_t new_doclen = prepared->doclen;
 	LOGLINE(DB, "Calculated doclen for new document " << did << " as " << new_doclen);
 
 	// Set the termlist.
 	if (termlist_table.is_open())
-	    termlist_table.set_termlist(did, document, new_doclen);
+	    termlist_table.set_encoded_termlist(did, prepared->termlist_tag);
 
 	// Set the new document length
 	inverter.set_doclength(did, new_doclen, true);
@@ -1090,12 +1571,12 @@ BrassWritableDatabase::add_document_(Xapian::docid did,
 	throw;
     }
 
-    // FIXME: this should be done by checking memory usage, not the number of
-    // changes.  We could also look at the amount of data the inverter object
-    // currently holds.
-    if (++change_count >= flush_threshold) {
+    if (++change_count >= flush_threshold ||
+	inverter.get_memory_used() >= flush_threshold_bytes) {
 	flush_postlist_changes();
-	if (!transaction_active()) apply();
+	// When bulk loading, the postings aren't in the postlist table until
+	// bulk loading ends, so don't commit until then.
+	if (!transaction_active() && !bulk_loader.get()) apply();
     }
 
     RETURN(did);
@@ -1110,6 +1591,10 @@ BrassWritableDatabase::delete_document(Xapian::docid did)
     if (!termlist_table.is_open())
 	throw_termlist_table_close_exception();
 
+    finish_commit();
+    // The runs can't represent removing a posting from an earlier run.
+    end_bulk_load();
+
     if (rare(modify_shortcut_docid == did)) {
 	// The modify_shortcut document can't be used for a modification
 	// shortcut now, because it's been deleted!
@@ -1157,7 +1642,8 @@ BrassWritableDatabase::delete_document(Xapian::docid did)
 	throw;
     }
 
-    if (++change_count >= flush_threshold) {
+    if (++change_count >= flush_threshold ||
+	inverter.get_memory_used() >= flush_threshold_bytes) {
 	flush_postlist_changes();
 	if (!transaction_active()) apply();
     }
@@ -1169,6 +1655,7 @@ BrassWritableDatabase::replace_document(Xapian::docid did,
 {
     LOGCALL_VOID(DB, "BrassWritableDatabase::replace_document", did | document);
     Assert(did != 0);
+    finish_commit();
 
     try {
 	if (did > stats.get_last_docid()) {
@@ -1179,6 +1666,9 @@ BrassWritableDatabase::replace_document(Xapian::docid did,
 	    return;
 	}
 
+	// The runs can't represent changing a document in an earlier run.
+	end_bulk_load();
+
 	if (!termlist_table.is_open()) {
 	    // We can replace an *unused* docid <= last_docid too.
 	    intrusive_ptr<const BrassDatabase> ptrtothis(this);
@@ -1317,7 +1807,8 @@ BrassWritableDatabase::replace_document(Xapian::docid did,
 	throw;
     }
 
-    if (++change_count >= flush_threshold) {
+    if (++change_count >= flush_threshold ||
+	inverter.get_memory_used() >= flush_threshold_bytes) {
 	flush_postlist_changes();
 	if (!transaction_active()) apply();
     }
@@ -1327,6 +1818,7 @@ Xapian::Document::Internal *
 BrassWritableDatabase::open_document(Xapian::docid did, bool lazy) const
 {
     LOGCALL(DB, Xapian::Document::Internal *, "BrassWritableDatabase::open_document", did | lazy);
+    finish_commit();
     modify_shortcut_document = BrassDatabase::open_document(did, lazy);
     // Store the docid only after open_document() successfully returns, so an
     // attempt to open a missing document doesn't overwrite this.
@@ -1338,6 +1830,8 @@ Xapian::termcount
 BrassWritableDatabase::get_doclength(Xapian::docid did) const
 {
     LOGCALL(DB, Xapian::termcount, "BrassWritableDatabase::get_doclength", did);
+    finish_commit();
+    end_bulk_load();
     Xapian::termcount doclen;
     if (inverter.get_doclength(did, doclen))
 	RETURN(doclen);
@@ -1348,6 +1842,8 @@ Xapian::doccount
 BrassWritableDatabase::get_termfreq(const string & term) const
 {
     LOGCALL(DB, Xapian::doccount, "BrassWritableDatabase::get_termfreq", term);
+    finish_commit();
+    end_bulk_load();
     RETURN(BrassDatabase::get_termfreq(term) + inverter.get_tfdelta(term));
 }
 
@@ -1355,6 +1851,8 @@ Xapian::termcount
 BrassWritableDatabase::get_collection_freq(const string & term) const
 {
     LOGCALL(DB, Xapian::termcount, "BrassWritableDatabase::get_collection_freq", term);
+    finish_commit();
+    end_bulk_load();
     RETURN(BrassDatabase::get_collection_freq(term) + inverter.get_cfdelta(term));
 }
 
@@ -1362,6 +1860,7 @@ Xapian::doccount
 BrassWritableDatabase::get_value_freq(Xapian::valueno slot) const
 {
     LOGCALL(DB, Xapian::doccount, "BrassWritableDatabase::get_value_freq", slot);
+    finish_commit();
     map<Xapian::valueno, ValueStats>::const_iterator i;
     i = value_stats.find(slot);
     if (i != value_stats.end()) RETURN(i->second.freq);
@@ -1372,6 +1871,7 @@ std::string
 BrassWritableDatabase::get_value_lower_bound(Xapian::valueno slot) const
 {
     LOGCALL(DB, std::string, "BrassWritableDatabase::get_value_lower_bound", slot);
+    finish_commit();
     map<Xapian::valueno, ValueStats>::const_iterator i;
     i = value_stats.find(slot);
     if (i != value_stats.end()) RETURN(i->second.lower_bound);
@@ -1382,12 +1882,55 @@ std::string
 BrassWritableDatabase::get_value_upper_bound(Xapian::valueno slot) const
 {
     LOGCALL(DB, std::string, "BrassWritableDatabase::get_value_upper_bound", slot);
+    finish_commit();
     map<Xapian::valueno, ValueStats>::const_iterator i;
     i = value_stats.find(slot);
     if (i != value_stats.end()) RETURN(i->second.upper_bound);
     RETURN(BrassDatabase::get_value_upper_bound(slot));
 }
 
+Xapian::doccount
+BrassWritableDatabase::get_doccount() const
+{
+    finish_commit();
+    return BrassDatabase::get_doccount();
+}
+
+totlen_t
+BrassWritableDatabase::get_total_length() const
+{
+    finish_commit();
+    return BrassDatabase::get_total_length();
+}
+
+Xapian::doclength
+BrassWritableDatabase::get_avlength() const
+{
+    finish_commit();
+    return BrassDatabase::get_avlength();
+}
+
+Xapian::termcount
+BrassWritableDatabase::get_doclength_lower_bound() const
+{
+    finish_commit();
+    return BrassDatabase::get_doclength_lower_bound();
+}
+
+Xapian::termcount
+BrassWritableDatabase::get_doclength_upper_bound() const
+{
+    finish_commit();
+    return BrassDatabase::get_doclength_upper_bound();
+}
+
+Xapian::termcount
+BrassWritableDatabase::get_wdf_upper_bound(const string & term) const
+{
+    finish_commit();
+    return BrassDatabase::get_wdf_upper_bound(term);
+}
+
 bool
 BrassWritableDatabase::term_exists(const string & tname) const
 {
@@ -1398,6 +1941,8 @@ BrassWritableDatabase::term_exists(const string & tname) const
 bool
 BrassWritableDatabase::has_positions() const
 {
+    finish_commit();
+    end_bulk_load();
     return inverter.has_positions(position_table);
 }
 
@@ -1405,6 +1950,8 @@ LeafPostList *
 BrassWritableDatabase::open_post_list(const string& tname) const
 {
     LOGCALL(DB, LeafPostList *, "BrassWritableDatabase::open_post_list", tname);
+    finish_commit();
+    end_bulk_load();
     intrusive_ptr<const BrassWritableDatabase> ptrtothis(this);
 
     if (tname.empty()) {
@@ -1427,6 +1974,7 @@ ValueList *
 BrassWritableDatabase::open_value_list(Xapian::valueno slot) const
 {
     LOGCALL(DB, ValueList *, "BrassWritableDatabase::open_value_list", slot);
+    finish_commit();
     // If there are changes, we don't have code to iterate the modified value
     // list so we need to flush (but don't commit - there may be a transaction
     // in progress).
@@ -1438,6 +1986,8 @@ TermList *
 BrassWritableDatabase::open_term_list(Xapian::docid did) const
 {
     LOGCALL(DB, TermList *, "BrassWritableDatabase::open_term_list", did);
+    finish_commit();
+    end_bulk_load();
     Assert(did != 0);
     inverter.flush_pos_lists(position_table);
     RETURN(BrassDatabase::open_term_list(did));
@@ -1447,6 +1997,8 @@ PositionList *
 BrassWritableDatabase::open_position_list(Xapian::docid did, const string & term) const
 {
     Assert(did != 0);
+    finish_commit();
+    end_bulk_load();
 
     AutoPtr<BrassPositionList> poslist(new BrassPositionList);
 
@@ -1466,6 +2018,8 @@ TermList *
 BrassWritableDatabase::open_allterms(const string & prefix) const
 {
     LOGCALL(DB, TermList *, "BrassWritableDatabase::open_allterms", NO_ARGS);
+    finish_commit();
+    end_bulk_load();
     if (change_count) {
 	// There are changes, and terms may have been added or removed, and so
 	// we need to flush changes for terms with the specified prefix (but
@@ -1485,8 +2039,11 @@ BrassWritableDatabase::open_allterms(const string & prefix) const
 void
 BrassWritableDatabase::cancel()
 {
+    finish_commit();
     BrassDatabase::cancel();
     stats.read(postlist_table);
+    // Nothing is committed while bulk loading, so all the runs are discarded.
+    if (bulk_loader.get()) bulk_loader->discard();
 
     inverter.clear();
     value_stats.clear();
@@ -1497,6 +2054,7 @@ void
 BrassWritableDatabase::add_spelling(const string & word,
 				    Xapian::termcount freqinc) const
 {
+    finish_commit();
     spelling_table.add_word(word, freqinc);
 }
 
@@ -1504,19 +2062,43 @@ void
 BrassWritableDatabase::remove_spelling(const string & word,
 				       Xapian::termcount freqdec) const
 {
+    finish_commit();
     spelling_table.remove_word(word, freqdec);
 }
 
+TermList *
+BrassWritableDatabase::open_spelling_termlist(const string & word) const
+{
+    finish_commit();
+    return BrassDatabase::open_spelling_termlist(word);
+}
+
 TermList *
 BrassWritableDatabase::open_spelling_wordlist() const
 {
+    finish_commit();
     spelling_table.merge_changes();
     return BrassDatabase::open_spelling_wordlist();
 }
 
+Xapian::doccount
+BrassWritableDatabase::get_spelling_frequency(const string & word) const
+{
+    finish_commit();
+    return BrassDatabase::get_spelling_frequency(word);
+}
+
+TermList *
+BrassWritableDatabase::open_synonym_termlist(const string & term) const
+{
+    finish_commit();
+    return BrassDatabase::open_synonym_termlist(term);
+}
+
 TermList *
 BrassWritableDatabase::open_synonym_keylist(const string & prefix) const
 {
+    finish_commit();
     synonym_table.merge_changes();
     return BrassDatabase::open_synonym_keylist(prefix);
 }
@@ -1525,6 +2107,7 @@ void
 BrassWritableDatabase::add_synonym(const string & term,
 				   const string & synonym) const
 {
+    finish_commit();
     synonym_table.add_synonym(term, synonym);
 }
 
@@ -1532,19 +2115,36 @@ void
 BrassWritableDatabase::remove_synonym(const string & term,
 				      const string & synonym) const
 {
+    finish_commit();
     synonym_table.remove_synonym(term, synonym);
 }
 
 void
 BrassWritableDatabase::clear_synonyms(const string & term) const
 {
+    finish_commit();
     synonym_table.clear_synonyms(term);
 }
 
+string
+BrassWritableDatabase::get_metadata(const string & key) const
+{
+    finish_commit();
+    return BrassDatabase::get_metadata(key);
+}
+
+TermList *
+BrassWritableDatabase::open_metadata_keylist(const std::string & prefix) const
+{
+    finish_commit();
+    return BrassDatabase::open_metadata_keylist(prefix);
+}
+
 void
 BrassWritableDatabase::set_metadata(const string & key, const string & value)
 {
     LOGCALL_VOID(DB, "BrassWritableDatabase::set_metadata", key | value);
+    finish_commit();
     string btree_key("\x00\xc0", 2);
     btree_key += key;
     if (value.empty()) {
@@ -1554,6 +2154,13 @@ BrassWritableDatabase::set_metadata(const string & key, const string & value)
     }
 }
 
+string
+BrassWritableDatabase::get_revision_info() const
+{
+    finish_commit();
+    return BrassDatabase::get_revision_info();
+}
+
 void
 BrassWritableDatabase::invalidate_doc_object(Xapian::Document::Internal * obj) const
 {
@@ -26,11 +26,13 @@
 #define OM_HGUARD_BRASS_DATABASE_H
 
 #include "backends/database.h"
+#include "brass_bulkload.h"
 #include "brass_changes.h"
 #include "brass_dbstats.h"
 #include "brass_inverter.h"
 #include "brass_positionlist.h"
 #include "brass_postlist.h"
+#include "brass_prepareddoc.h"
 #include "brass_record.h"
 #include "brass_spelling.h"
 #include "brass_synonym.h"
@@ -39,14 +41,19 @@
 #include "brass_version.h"
 #include "../flint_lock.h"
 #include "brass_types.h"
+#include "backends/postlistcache.h"
 #include "backends/valuestats.h"
 
+#include "autoptr.h"
 #include "noreturn.h"
 
 #include "xapian/constants.h"
 
+#include <deque>
 #include <map>
+#include <vector>
 
+class BrassCommitThread;
 class BrassTermList;
 class BrassAllDocsPostList;
 class RemoteConnection;
@@ -121,6 +128,19 @@ class BrassDatabase : public Xapian::Database::Internal {
 	/// Replication changesets.
 	BrassChanges changes;
 
+	/// Decoded posting lists of frequently used terms.
+	mutable DecodedPostListCache postlist_cache;
+
+	/** Snapshots returned by open_snapshot(), indexed by its argument.
+	 *
+	 *  Reusing these for later matches saves reopening the tables, and
+	 *  keeps their postlist caches warm.
+	 */
+	mutable std::vector<Xapian::Internal::intrusive_ptr<Xapian::Database::Internal> > snapshots;
+
+	/// The revision the entries in snapshots are open at.
+	mutable brass_revision_number_t snapshot_revision;
+
 	/** Return true if a database exists at the path specified for this
 	 *  database.
 	 */
@@ -194,6 +214,16 @@ class BrassDatabase : public Xapian::Database::Internal {
 				  brass_revision_number_t new_revision,
 				  const std::string & msg);
 
+	/** Start recording the changes from revision @a old_revision to
+	 *  @a new_revision for replication.
+	 */
+	void start_changes(brass_revision_number_t old_revision,
+			   brass_revision_number_t new_revision,
+			   int flags);
+
+	/// Are there any outstanding changes to the tables?
+	bool is_modified() const;
+
 	/** Apply any outstanding changes to the tables.
 	 *
 	 *  If an error occurs during this operation, this will be signalled
@@ -237,9 +267,13 @@ class BrassDatabase : public Xapian::Database::Internal {
 	 *                    tables.  This is only important, and has the
 	 *                    correct value, when the database is being
 	 *                    created.
+	 *
+	 *  @param readonly_flags Flags to open the tables with when opening
+	 *			  read-only (e.g. Xapian::DB_MMAP).  Ignored
+	 *			  when opening for writing.
 	 */
 	BrassDatabase(const string &db_dir_, int flags = Xapian::DB_READONLY_,
-		      unsigned int block_size = 0u);
+		      unsigned int block_size = 0u, int readonly_flags = 0);
 
 	~BrassDatabase();
 
@@ -296,6 +330,10 @@ class BrassDatabase : public Xapian::Database::Internal {
 				    Xapian::ReplicationInfo * info);
 	string get_revision_info() const;
 	string get_uuid() const;
+	string get_revision_key() const;
+
+	/// Open a read-only snapshot (not supported for writable databases).
+	Xapian::Database::Internal * open_snapshot(size_t n) const;
 	//@}
 
 	XAPIAN_NORETURN(void throw_termlist_table_close_exception() const);
@@ -303,7 +341,22 @@ class BrassDatabase : public Xapian::Database::Internal {
 
 /** A writable brass database.
  */
-class BrassWritableDatabase : public BrassDatabase {
+class BrassWritableDatabase : public BrassDatabase, public BrassTableWriter {
+	friend class BrassCommitThread;
+
+	/// A document added while a commit runs in the background.
+	struct PendingDocument {
+	    Xapian::docid did;
+
+	    /// A copy of the document's data and values.
+	    Xapian::Document document;
+
+	    /// The document's terms and positions.
+	    BrassPreparedDocument prepared;
+
+	    explicit PendingDocument(Xapian::docid did_) : did(did_) { }
+	};
+
 	mutable Inverter inverter;
 
 	mutable map<Xapian::valueno, ValueStats> value_stats;
@@ -316,6 +369,32 @@ class BrassWritableDatabase : public BrassDatabase {
 	/// If change_count reaches this threshold we automatically flush.
 	Xapian::doccount flush_threshold;
 
+	/** If the inverter's buffered changes use this much memory we
+	 *  automatically flush.
+	 */
+	size_t flush_threshold_bytes;
+
+	/** Defer commits made less than this many seconds after the last
+	 *  commit which was written (0 means write every commit).
+	 */
+	double sync_window;
+
+	/// When the last commit was written.
+	double last_commit_time;
+
+	/// The number of commits deferred since the last one was written.
+	unsigned deferred_commits;
+
+	/** Should a commit be deferred because of the sync window?
+	 *
+	 *  Deferring a commit leaves its changes buffered, to be written
+	 *  with those of a later commit.
+	 */
+	bool defer_commit();
+
+	/// Write the changes, including those of any deferred commits.
+	void commit_now();
+
 	/** A pointer to the last document which was returned by
 	 *  open_document(), or NULL if there is no such valid document.  This
 	 *  is used purely for comparing with a supplied document to help with
@@ -328,9 +407,102 @@ class BrassWritableDatabase : public BrassDatabase {
 	 */
 	mutable Xapian::docid modify_shortcut_docid;
 
+	/** Builds the postlist and position tables while bulk loading.
+	 *
+	 *  NULL unless the database was new when opened with
+	 *  Xapian::DB_BULK_LOAD and bulk loading hasn't yet ended.
+	 */
+	mutable AutoPtr<BrassBulkLoader> bulk_loader;
+
 	/// Flush any unflushed postlist changes, but don't commit them.
 	void flush_postlist_changes() const;
 
+	/** End bulk loading, if it's in progress.
+	 *
+	 *  Merges the runs written so far into the postlist and position
+	 *  tables, after which changes are made in the usual way.
+	 */
+	void end_bulk_load() const {
+	    if (bulk_loader.get()) end_bulk_load_();
+	}
+
+	/// Out of line part of end_bulk_load().
+	void end_bulk_load_() const;
+
+	/// The buffered postlist changes being committed in the background.
+	Inverter commit_inverter;
+
+	/// The value statistics being committed in the background.
+	map<Xapian::valueno, ValueStats> commit_value_stats;
+
+	/// The value changes being committed in the background.
+	BrassValueManager commit_value_manager;
+
+	/// The revision before the commit in the background.
+	brass_revision_number_t commit_old_revision;
+
+	/// The revision the commit in the background is writing.
+	brass_revision_number_t commit_new_revision;
+
+	/// Why the commit in the background failed (empty if it didn't).
+	std::string commit_error;
+
+	/** Documents added while a commit is running in the background.
+	 *
+	 *  These are added to the tables once the commit has finished.
+	 */
+	std::deque<PendingDocument> pending_documents;
+
+	/// Approximately how much memory pending_documents uses, in bytes.
+	size_t pending_bytes;
+
+	/** The thread performing a commit in the background.
+	 *
+	 *  NULL unless a commit started by commit_async() may still be
+	 *  running.  This is declared last so that the destructor joins the
+	 *  thread before the objects it uses are destroyed.
+	 */
+	mutable AutoPtr<BrassCommitThread> commit_thread;
+
+	/** Write the changes snapshotted by commit_async() to the tables.
+	 *
+	 *  This runs in the background thread.
+	 */
+	void commit_snapshot();
+
+	/** Wait for any commit running in the background to finish.
+	 *
+	 *  Anything other than adding documents needs to do this first, since
+	 *  the tables are being written by the background thread.  If the
+	 *  commit failed, the changes since the previous commit are discarded
+	 *  and an exception is thrown.
+	 */
+	void finish_commit() const {
+	    if (commit_thread.get()) finish_commit_();
+	}
+
+	/// Out of line part of finish_commit().
+	void finish_commit_() const;
+
+	/** Set what each table waits for before it is read.
+	 *
+	 *  @param writer	Object to wait for, or NULL for nothing.
+	 */
+	void set_tables_writer(const BrassTableWriter * writer);
+
+	/** Wait for a commit running in the background, unless called from
+	 *  its thread.
+	 *
+	 *  The tables call this before being read, so iterators which were
+	 *  open when commit_async() was called wait for the commit rather
+	 *  than reading tables which are being written.
+	 */
+	void wait_for_writer() const;
+
+	/// Add a document while a commit is running in the background.
+	Xapian::docid queue_document(Xapian::docid did,
+				     const Xapian::Document & document);
+
 	/// Close all the tables permanently.
 	void close();
 
@@ -343,11 +515,29 @@ class BrassWritableDatabase : public BrassDatabase {
 	 */
 	void commit();
 
+	void commit_async();
+
+	void wait_for_commit();
+
+	void set_sync_window(double seconds);
+
+	void begin_transaction(bool flushed);
+
 	/** Cancel pending modifications to the database. */
 	void cancel();
 
 	Xapian::docid add_document(const Xapian::Document & document);
-	Xapian::docid add_document_(Xapian::docid did, const Xapian::Document & document);
+	Xapian::docid add_documents(const std::vector<Xapian::Document> & documents,
+				    unsigned threads);
+
+	/** Add @a document with docid @a did.
+	 *
+	 *  @param prepared	@a document already encoded, or NULL to encode
+	 *			it here.
+	 */
+	Xapian::docid add_document_(Xapian::docid did,
+				    const Xapian::Document & document,
+				    const BrassPreparedDocument * prepared = NULL);
 	// Stop the default implementation of delete_document(term) and
 	// replace_document(term) from being hidden.  This isn't really
 	// a problem as we only try to call them through the base class
@@ -383,6 +573,12 @@ class BrassWritableDatabase : public BrassDatabase {
 
 	/** Virtual methods of Database::Internal. */
 	//@{
+	Xapian::doccount get_doccount() const;
+	totlen_t get_total_length() const;
+	Xapian::doclength get_avlength() const;
+	Xapian::termcount get_doclength_lower_bound() const;
+	Xapian::termcount get_doclength_upper_bound() const;
+	Xapian::termcount get_wdf_upper_bound(const string & term) const;
 	Xapian::termcount get_doclength(Xapian::docid did) const;
 	Xapian::doccount get_termfreq(const string & tname) const;
 	Xapian::termcount get_collection_freq(const string & tname) const;
@@ -400,14 +596,20 @@ class BrassWritableDatabase : public BrassDatabase {
 
 	void add_spelling(const string & word, Xapian::termcount freqinc) const;
 	void remove_spelling(const string & word, Xapian::termcount freqdec) const;
+	TermList * open_spelling_termlist(const string & word) const;
 	TermList * open_spelling_wordlist() const;
+	Xapian::doccount get_spelling_frequency(const string & word) const;
 
+	TermList * open_synonym_termlist(const string & term) const;
 	TermList * open_synonym_keylist(const string & prefix) const;
 	void add_synonym(const string & word, const string & synonym) const;
 	void remove_synonym(const string & word, const string & synonym) const;
 	void clear_synonyms(const string & word) const;
 
+	string get_metadata(const string & key) const;
+	TermList * open_metadata_keylist(const std::string &prefix) const;
 	void set_metadata(const string & key, const string & value);
+	string get_revision_info() const;
 	void invalidate_doc_object(Xapian::Document::Internal * obj) const;
 	//@}
 };
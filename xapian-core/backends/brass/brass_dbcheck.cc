@@ -30,6 +30,7 @@
 
 #include "brass_check.h"
 #include "brass_cursor.h"
+#include "brass_postlist.h"
 #include "brass_table.h"
 #include "brass_types.h"
 #include "pack.h"
@@ -49,6 +50,60 @@ is_user_metadata_key(const string & key)
     return key.size() > 1 && key[0] == '\0' && key[1] == '\xc0';
 }
 
+/** Read the entries of a postlist chunk, in either encoding.
+ *
+ *  @param what	Name for the per-entry value to use in error messages.
+ *
+ *  @return false if the chunk couldn't be read (the problem has been reported
+ *	    and counted in @a errors).
+ */
+static bool
+read_chunk_entries(const char * pos, const char * end, bool is_packed,
+		   Xapian::docid did, const char * what,
+		   vector<Xapian::docid> & dids,
+		   vector<Xapian::termcount> & wdfs,
+		   ostream * out, size_t & errors)
+{
+    if (is_packed) {
+	try {
+	    Brass::unpack_chunk(pos, end, did, dids, wdfs);
+	} catch (const Xapian::Error & e) {
+	    if (out)
+		*out << "Failed to unpack bit-packed chunk: "
+		     << e.get_description() << endl;
+	    ++errors;
+	    return false;
+	}
+	return true;
+    }
+
+    dids.clear();
+    wdfs.clear();
+    while (true) {
+	Xapian::termcount wdf;
+	if (!unpack_uint(&pos, end, &wdf)) {
+	    if (out)
+		*out << "Failed to unpack " << what << endl;
+	    ++errors;
+	    return false;
+	}
+	dids.push_back(did);
+	wdfs.push_back(wdf);
+
+	if (pos == end) return true;
+
+	Xapian::docid inc;
+	if (!unpack_uint(&pos, end, &inc)) {
+	    if (out)
+		*out << "Failed to unpack docid increase" << endl;
+	    ++errors;
+	    return false;
+	}
+	++inc;
+	did += inc;
+    }
+}
+
 struct VStats : public ValueStats {
     Xapian::doccount freq_real;
 
@@ -199,13 +254,16 @@ check_brass_table(const char * tablename, string filename,
 		    }
 		}
 
-		bool is_last_chunk;
-		if (!unpack_bool(&pos, end, &is_last_chunk)) {
+		unsigned flags;
+		if (!unpack_uint(&pos, end, &flags) ||
+		    (flags & ~unsigned(Brass::CHUNK_LAST|Brass::CHUNK_PACKED))) {
 		    if (out)
-			*out << "Failed to unpack last chunk flag for doclen" << endl;
+			*out << "Failed to unpack chunk flags for doclen" << endl;
 		    ++errors;
 		    continue;
 		}
+		bool is_last_chunk = (flags & Brass::CHUNK_LAST) != 0;
+		bool is_packed = (flags & Brass::CHUNK_PACKED) != 0;
 		// Read what the final document ID in this chunk is.
 		if (!unpack_uint(&pos, end, &lastdid)) {
 		    if (out)
@@ -214,15 +272,29 @@ check_brass_table(const char * tablename, string filename,
 		    continue;
 		}
 		lastdid += did;
-		bool bad = false;
-		while (true) {
-		    Xapian::termcount doclen;
-		    if (!unpack_uint(&pos, end, &doclen)) {
+		Xapian::termcount max_doclen;
+		if (!unpack_uint(&pos, end, &max_doclen)) {
+		    if (out)
+			*out << "Failed to unpack max doclen in chunk" << endl;
+		    ++errors;
+		    continue;
+		}
+		vector<Xapian::docid> dids;
+		vector<Xapian::termcount> lens;
+		if (!read_chunk_entries(pos, end, is_packed, did, "doclen",
+					dids, lens, out, errors)) {
+		    continue;
+		}
+		for (size_t i = 0; i != dids.size(); ++i) {
+		    did = dids[i];
+		    Xapian::termcount doclen = lens[i];
+
+		    if (doclen > max_doclen) {
 			if (out)
-			    *out << "Failed to unpack doclen" << endl;
+			    *out << "document id " << did << ": length "
+				 << doclen << " is greater than the max "
+				 << max_doclen << " for the chunk" << endl;
 			++errors;
-			bad = true;
-			break;
 		    }
 
 		    if (did > db_last_docid) {
@@ -250,18 +322,6 @@ check_brass_table(const char * tablename, string filename,
 			}
 		    }
 
-		    if (pos == end) break;
-
-		    Xapian::docid inc;
-		    if (!unpack_uint(&pos, end, &inc)) {
-			if (out)
-			    *out << "Failed to unpack docid increase" << endl;
-			++errors;
-			bad = true;
-			break;
-		    }
-		    ++inc;
-		    did += inc;
 		    if (did > lastdid) {
 			if (out)
 			    *out << "docid " << did << " > last docid "
@@ -269,9 +329,6 @@ check_brass_table(const char * tablename, string filename,
 			++errors;
 		    }
 		}
-		if (bad) {
-		    continue;
-		}
 		if (is_last_chunk) {
 		    if (did != lastdid) {
 			if (out)
@@ -526,13 +583,16 @@ check_brass_table(const char * tablename, string filename,
 		end = pos + cursor->current_tag.size();
 	    }
 
-	    bool is_last_chunk;
-	    if (!unpack_bool(&pos, end, &is_last_chunk)) {
+	    unsigned flags;
+	    if (!unpack_uint(&pos, end, &flags) ||
+		(flags & ~unsigned(Brass::CHUNK_LAST|Brass::CHUNK_PACKED))) {
 		if (out)
-		    *out << "Failed to unpack last chunk flag" << endl;
+		    *out << "Failed to unpack chunk flags" << endl;
 		++errors;
 		continue;
 	    }
+	    bool is_last_chunk = (flags & Brass::CHUNK_LAST) != 0;
+	    bool is_packed = (flags & Brass::CHUNK_PACKED) != 0;
 	    // Read what the final document ID in this chunk is.
 	    if (!unpack_uint(&pos, end, &lastdid)) {
 		if (out)
@@ -541,31 +601,35 @@ check_brass_table(const char * tablename, string filename,
 		continue;
 	    }
 	    lastdid += did;
-	    bool bad = false;
-	    while (true) {
-		Xapian::termcount wdf;
-		if (!unpack_uint(&pos, end, &wdf)) {
-		    if (out)
-			*out << "Failed to unpack wdf" << endl;
-		    ++errors;
-		    bad = true;
-		    break;
-		}
+	    Xapian::termcount max_wdf;
+	    if (!unpack_uint(&pos, end, &max_wdf)) {
+		if (out)
+		    *out << "Failed to unpack max wdf in chunk" << endl;
+		++errors;
+		continue;
+	    }
+	    vector<Xapian::docid> dids;
+	    vector<Xapian::termcount> wdfs;
+	    if (!read_chunk_entries(pos, end, is_packed, did, "wdf",
+				    dids, wdfs, out, errors)) {
+		continue;
+	    }
+	    for (size_t i = 0; i != dids.size(); ++i) {
+		did = dids[i];
+		Xapian::termcount wdf = wdfs[i];
 		++tf;
 		cf += wdf;
 
-		if (pos == end) break;
-
-		Xapian::docid inc;
-		if (!unpack_uint(&pos, end, &inc)) {
+		// The max wdf isn't reduced if entries are deleted, so it only
+		// needs to be an upper bound.
+		if (wdf > max_wdf) {
 		    if (out)
-			*out << "Failed to unpack docid increase" << endl;
+			*out << "docid " << did << ": wdf " << wdf
+			     << " is greater than the max " << max_wdf
+			     << " for the chunk" << endl;
 		    ++errors;
-		    bad = true;
-		    break;
 		}
-		++inc;
-		did += inc;
+
 		if (did > lastdid) {
 		    if (out)
 			*out << "docid " << did << " > last docid " << lastdid
@@ -573,9 +637,6 @@ check_brass_table(const char * tablename, string filename,
 		    ++errors;
 		}
 	    }
-	    if (bad) {
-		continue;
-	    }
 	    if (is_last_chunk) {
 		if (tf != termfreq) {
 		    if (out)
@@ -42,15 +42,15 @@ Inverter::store_positions(const BrassPositionListTable & position_table,
     string s;
     position_table.pack(s, posvec);
     if (modifying) {
-	map<string, map<Xapian::docid, string> >::iterator i;
+	map<string, DocChanges<string> >::iterator i;
 	i = pos_changes.find(tname);
 	if (i != pos_changes.end()) {
-	    map<Xapian::docid, string> & m = i->second;
-	    map<Xapian::docid, string>::iterator j;
-	    j = m.find(did);
-	    if (j != m.end()) {
+	    string * p = i->second.find(did);
+	    if (p) {
 		// Update existing entry.
-		swap(j->second, s);
+		pos_bytes += s.size();
+		pos_bytes -= p->size();
+		swap(*p, s);
 		return;
 	    }
 	}
@@ -96,8 +96,22 @@ Inverter::set_positionlist(Xapian::docid did,
 			   const string & term,
 			   const string & s)
 {
-    pos_changes.insert(make_pair(term, map<Xapian::docid, string>()))
-	.first->second[did] = s;
+    map<string, DocChanges<string> >::iterator i;
+    i = pos_changes.find(term);
+    if (i == pos_changes.end()) {
+	i = pos_changes.insert(make_pair(term, DocChanges<string>())).first;
+	pos_bytes += TERM_OVERHEAD + term.size();
+    }
+    string * p = i->second.find(did);
+    if (p) {
+	// Replace the existing change.
+	pos_bytes += s.size();
+	pos_bytes -= p->size();
+	*p = s;
+	return;
+    }
+    i->second.set(did, s);
+    pos_bytes += POSITIONS_OVERHEAD + s.size();
 }
 
 void
@@ -112,16 +126,14 @@ Inverter::get_positionlist(Xapian::docid did,
 			   const string & term,
 			   string & s) const
 {
-    map<string, map<Xapian::docid, string> >::const_iterator i;
+    map<string, DocChanges<string> >::const_iterator i;
     i = pos_changes.find(term);
     if (i == pos_changes.end())
 	return false;
-    const map<Xapian::docid, string> & m = i->second;
-    map<Xapian::docid, string>::const_iterator j;
-    j = m.find(did);
-    if (j == m.end())
+    const string * p = i->second.find(did);
+    if (!p)
 	return false;
-    s = j->second;
+    s = *p;
     return true;
 }
 
@@ -134,10 +146,10 @@ Inverter::has_positions(const BrassPositionListTable & position_table) const
     // FIXME: Can we cheaply keep track of some things to make this more
     // efficient?  E.g. how many sets and deletes we had in total perhaps.
     brass_tablesize_t changes = 0;
-    map<string, map<Xapian::docid, string> >::const_iterator i;
+    map<string, DocChanges<string> >::const_iterator i;
     for (i = pos_changes.begin(); i != pos_changes.end(); ++i) {
-	const map<Xapian::docid, string> & m = i->second;
-	map<Xapian::docid, string>::const_iterator j;
+	const DocChanges<string> & m = i->second;
+	DocChanges<string>::const_iterator j;
 	for (j = m.begin(); j != m.end(); ++j) {
 	    const string & s = j->second;
 	    if (!s.empty())
@@ -154,6 +166,7 @@ void
 Inverter::flush_doclengths(BrassPostListTable & table)
 {
     table.merge_doclen_changes(doclen_changes);
+    postlist_bytes -= doclen_changes.size() * DOCLEN_OVERHEAD;
     doclen_changes.clear();
 }
 
@@ -166,6 +179,7 @@ Inverter::flush_post_list(BrassPostListTable & table, const string & term)
 
     // Flush buffered changes for just this term's postlist.
     table.merge_changes(term, i->second);
+    postlist_bytes -= term_bytes(term, i->second);
     postlist_changes.erase(i);
 }
 
@@ -177,6 +191,8 @@ Inverter::flush_all_post_lists(BrassPostListTable & table)
 	table.merge_changes(i->first, i->second);
     }
     postlist_changes.clear();
+    // Only document length changes are left.
+    postlist_bytes = doclen_changes.size() * DOCLEN_OVERHEAD;
 }
 
 void
@@ -191,6 +207,7 @@ Inverter::flush_post_lists(BrassPostListTable & table, const string & pfx)
 
     for (i = begin; i != end; ++i) {
 	table.merge_changes(i->first, i->second);
+	postlist_bytes -= term_bytes(i->first, i->second);
     }
 
     // Erase all the entries in one go, as that's:
@@ -208,11 +225,11 @@ Inverter::flush(BrassPostListTable & table)
 void
 Inverter::flush_pos_lists(BrassPositionListTable & table)
 {
-    map<string, map<Xapian::docid, string> >::const_iterator i;
+    map<string, DocChanges<string> >::const_iterator i;
     for (i = pos_changes.begin(); i != pos_changes.end(); ++i) {
 	const string & term = i->first;
-	const map<Xapian::docid, string> & m = i->second;
-	map<Xapian::docid, string>::const_iterator j;
+	const DocChanges<string> & m = i->second;
+	DocChanges<string>::const_iterator j;
 	for (j = m.begin(); j != m.end(); ++j) {
 	    Xapian::docid did = j->first;
 	    const string & s = j->second;
@@ -223,4 +240,5 @@ Inverter::flush_pos_lists(BrassPositionListTable & table)
 	}
     }
     pos_changes.clear();
+    pos_bytes = 0;
 }
@@ -23,6 +23,7 @@
 
 #include "xapian/types.h"
 
+#include <algorithm>
 #include <map>
 #include <string>
 #include <vector>
@@ -45,6 +46,126 @@ const Xapian::termcount DELETED_POSTING = Xapian::termcount(-1);
 class Inverter {
     friend class BrassPostListTable;
 
+  public:
+    /** Buffered changes for one term, each for a different document.
+     *
+     *  Setting a change appends it to a vector, which is much cheaper than
+     *  inserting into a std::map.  Documents are usually added in docid
+     *  order so the vector generally stays sorted, but any changes which
+     *  arrive out of order are kept in a std::map, which is merged into the
+     *  vector once it is larger than the vector (so the merging takes
+     *  amortised constant time per change), or when the changes are
+     *  iterated over.
+     */
+    template<typename T>
+    class DocChanges {
+	typedef std::pair<Xapian::docid, T> change;
+
+	/// The changes, in strictly ascending docid order.
+	mutable std::vector<change> changes;
+
+	/** Changes which arrived out of order.
+	 *
+	 *  These are more recent than any change for the same docid in
+	 *  changes.
+	 */
+	mutable std::map<Xapian::docid, T> tail;
+
+	/// Compare changes by docid.
+	static bool docid_lt(const change & a, const change & b) {
+	    return a.first < b.first;
+	}
+
+	/// Merge tail into changes.
+	void normalise() const {
+	    if (tail.empty()) return;
+	    std::vector<change> merged;
+	    merged.reserve(changes.size() + tail.size());
+	    typename std::vector<change>::iterator i = changes.begin();
+	    typename std::map<Xapian::docid, T>::iterator j = tail.begin();
+	    while (i != changes.end() || j != tail.end()) {
+		if (j == tail.end() ||
+		    (i != changes.end() && i->first < j->first)) {
+		    merged.push_back(change(i->first, T()));
+		    std::swap(merged.back().second, i->second);
+		    ++i;
+		    continue;
+		}
+		if (i != changes.end() && i->first == j->first) ++i;
+		merged.push_back(change(j->first, T()));
+		std::swap(merged.back().second, j->second);
+		++j;
+	    }
+	    changes.swap(merged);
+	    tail.clear();
+	}
+
+      public:
+	typedef typename std::vector<change>::const_iterator const_iterator;
+
+	/// Set the change for document @a did, replacing any earlier one.
+	void set(Xapian::docid did, const T & value) {
+	    if (changes.empty() || changes.back().first < did) {
+		// Any change in tail is for a lower docid, since
+		// changes.back().first only ever increases.
+		changes.push_back(change(did, value));
+		return;
+	    }
+	    if (changes.back().first == did) {
+		changes.back().second = value;
+		return;
+	    }
+	    tail[did] = value;
+	    if (tail.size() > changes.size()) normalise();
+	}
+
+	/// Find the change for document @a did, or NULL if there isn't one.
+	T * find(Xapian::docid did) {
+	    // Any change in tail is more recent.
+	    typename std::map<Xapian::docid, T>::iterator t = tail.find(did);
+	    if (t != tail.end()) return &t->second;
+	    typename std::vector<change>::iterator i;
+	    i = std::lower_bound(changes.begin(), changes.end(),
+				 change(did, T()), docid_lt);
+	    if (i == changes.end() || i->first != did)
+		return NULL;
+	    return &i->second;
+	}
+
+	/// Find the change for document @a did, or NULL if there isn't one.
+	const T * find(Xapian::docid did) const {
+	    return const_cast<DocChanges *>(this)->find(did);
+	}
+
+	/// Iterate the changes in ascending docid order.
+	const_iterator begin() const {
+	    normalise();
+	    return changes.begin();
+	}
+
+	const_iterator end() const {
+	    normalise();
+	    return changes.end();
+	}
+
+	bool empty() const { return changes.empty() && tail.empty(); }
+    };
+
+  private:
+    /// Approximate memory used by each buffered term (besides its name).
+    static const size_t TERM_OVERHEAD = 64;
+
+    /// Approximate memory used by each buffered document length.
+    static const size_t DOCLEN_OVERHEAD = 48;
+
+    /// Approximate memory used by each buffered posting.
+    static const size_t POSTING_SIZE =
+	sizeof(std::pair<Xapian::docid, Xapian::termcount>);
+
+    /// Approximate memory used by each buffered positional data change.
+    static const size_t POSITIONS_OVERHEAD =
+	sizeof(std::pair<Xapian::docid, std::string>);
+
     /// Class for storing the changes in frequencies for a term.
     class PostingChanges {
 	friend class BrassPostListTable;
@@ -56,29 +177,35 @@ class Inverter {
 	Xapian::termcount_diff cf_delta;
 
 	/// Changes to this term's postlist.
-	std::map<Xapian::docid, Xapian::termcount> pl_changes;
+	DocChanges<Xapian::termcount> pl_changes;
+
+	/// The number of changes made (some may have been replaced since).
+	size_t n_changes;
 
       public:
 	/// Constructor for an added posting.
 	PostingChanges(Xapian::docid did, Xapian::termcount wdf)
-	    : tf_delta(1), cf_delta(Xapian::termcount_diff(wdf))
+	    : tf_delta(1), cf_delta(Xapian::termcount_diff(wdf)),
+	      n_changes(1)
 	{
-	    pl_changes.insert(std::make_pair(did, wdf));
+	    pl_changes.set(did, wdf);
 	}
 
 	/// Constructor for a removed posting.
 	PostingChanges(Xapian::docid did, Xapian::termcount wdf, bool)
-	    : tf_delta(-1), cf_delta(-Xapian::termcount_diff(wdf))
+	    : tf_delta(-1), cf_delta(-Xapian::termcount_diff(wdf)),
+	      n_changes(1)
 	{
-	    pl_changes.insert(std::make_pair(did, DELETED_POSTING));
+	    pl_changes.set(did, DELETED_POSTING);
 	}
 
 	/// Constructor for an updated posting.
 	PostingChanges(Xapian::docid did, Xapian::termcount old_wdf,
 		       Xapian::termcount new_wdf)
-	    : tf_delta(0), cf_delta(Xapian::termcount_diff(new_wdf - old_wdf))
+	    : tf_delta(0), cf_delta(Xapian::termcount_diff(new_wdf - old_wdf)),
+	      n_changes(1)
 	{
-	    pl_changes.insert(std::make_pair(did, new_wdf));
+	    pl_changes.set(did, new_wdf);
 	}
 
 	/// Add a posting.
@@ -86,7 +213,8 @@ class Inverter {
 	    ++tf_delta;
 	    cf_delta += wdf;
 	    // Add did to term's postlist
-	    pl_changes[did] = wdf;
+	    pl_changes.set(did, wdf);
+	    ++n_changes;
 	}
 
 	/// Remove a posting.
@@ -94,14 +222,16 @@ class Inverter {
 	    --tf_delta;
 	    cf_delta -= wdf;
 	    // Remove did from term's postlist.
-	    pl_changes[did] = DELETED_POSTING;
+	    pl_changes.set(did, DELETED_POSTING);
+	    ++n_changes;
 	}
 
 	/// Update a posting.
 	void update_posting(Xapian::docid did, Xapian::termcount old_wdf,
 			    Xapian::termcount new_wdf) {
 	    cf_delta += new_wdf - old_wdf;
-	    pl_changes[did] = new_wdf;
+	    pl_changes.set(did, new_wdf);
+	    ++n_changes;
 	}
 
 	/// Get the term frequency delta.
@@ -109,13 +239,29 @@ class Inverter {
 
 	/// Get the collection frequency delta.
 	Xapian::termcount_diff get_cfdelta() const { return cf_delta; }
+
+	/// Get the number of changes made.
+	size_t get_changes_count() const { return n_changes; }
     };
 
     /// Buffered changes to postlists.
     std::map<std::string, PostingChanges> postlist_changes;
 
     /// Buffered changes to positional data.
-    std::map<std::string, std::map<Xapian::docid, std::string> > pos_changes;
+    std::map<std::string, DocChanges<std::string> > pos_changes;
+
+    /// Approximate memory used by postlist and document length changes.
+    size_t postlist_bytes;
+
+    /// Approximate memory used by positional data changes.
+    size_t pos_bytes;
+
+    /// Approximate memory used by the changes for @a term.
+    static size_t term_bytes(const std::string & term,
+			     const PostingChanges & changes) {
+	return TERM_OVERHEAD + term.size() +
+	    changes.get_changes_count() * POSTING_SIZE;
+    }
 
     void store_positions(const BrassPositionListTable & position_table,
 			 Xapian::docid did,
@@ -123,15 +269,13 @@ class Inverter {
 			 const std::vector<Xapian::termpos> & posvec,
 			 bool modifying);
 
-    void set_positionlist(Xapian::docid did,
-			  const std::string & term,
-			  const std::string & s);
-
   public:
     /// Buffered changes to document lengths.
     std::map<Xapian::docid, Xapian::termcount> doclen_changes;
 
   public:
+    Inverter() : postlist_bytes(0), pos_bytes(0) { }
+
     void add_posting(Xapian::docid did, const std::string & term,
 		     Xapian::doccount wdf) {
 	std::map<std::string, PostingChanges>::iterator i;
@@ -139,9 +283,11 @@ class Inverter {
 	if (i == postlist_changes.end()) {
 	    postlist_changes.insert(
 		std::make_pair(term, PostingChanges(did, wdf)));
+	    postlist_bytes += TERM_OVERHEAD + term.size();
 	} else {
 	    i->second.add_posting(did, wdf);
 	}
+	postlist_bytes += POSTING_SIZE;
     }
 
     void remove_posting(Xapian::docid did, const std::string & term,
@@ -151,9 +297,11 @@ class Inverter {
 	if (i == postlist_changes.end()) {
 	    postlist_changes.insert(
 		std::make_pair(term, PostingChanges(did, wdf, false)));
+	    postlist_bytes += TERM_OVERHEAD + term.size();
 	} else {
 	    i->second.remove_posting(did, wdf);
 	}
+	postlist_bytes += POSTING_SIZE;
     }
 
     void update_posting(Xapian::docid did, const std::string & term,
@@ -164,9 +312,11 @@ class Inverter {
 	if (i == postlist_changes.end()) {
 	    postlist_changes.insert(
 		std::make_pair(term, PostingChanges(did, old_wdf, new_wdf)));
+	    postlist_bytes += TERM_OVERHEAD + term.size();
 	} else {
 	    i->second.update_posting(did, old_wdf, new_wdf);
 	}
+	postlist_bytes += POSTING_SIZE;
     }
 
     void set_positionlist(const BrassPositionListTable & position_table,
@@ -175,6 +325,16 @@ class Inverter {
 			  const Xapian::TermIterator & term,
 			  bool modifying = false);
 
+    /** Set the position list for @a term in document @a did.
+     *
+     *  @param s	The position list, packed by
+     *			BrassPositionListTable::pack() (or empty to delete
+     *			the position list).
+     */
+    void set_positionlist(Xapian::docid did,
+			  const std::string & term,
+			  const std::string & s);
+
     void delete_positionlist(Xapian::docid did,
 			     const std::string & term);
 
@@ -188,18 +348,38 @@ class Inverter {
 	doclen_changes.clear();
 	postlist_changes.clear();
 	pos_changes.clear();
+	postlist_bytes = 0;
+	pos_bytes = 0;
     }
 
+    /// Swap the buffered changes with those in @a o.
+    void swap_changes(Inverter & o) {
+	doclen_changes.swap(o.doclen_changes);
+	postlist_changes.swap(o.postlist_changes);
+	pos_changes.swap(o.pos_changes);
+	std::swap(postlist_bytes, o.postlist_bytes);
+	std::swap(pos_bytes, o.pos_bytes);
+    }
+
+    /// Approximately how much memory the buffered changes use, in bytes.
+    size_t get_memory_used() const { return postlist_bytes + pos_bytes; }
+
     void set_doclength(Xapian::docid did, Xapian::termcount doclen, bool add) {
 	if (add) {
 	    Assert(doclen_changes.find(did) == doclen_changes.end() || doclen_changes[did] == DELETED_POSTING);
 	}
+	size_t old_size = doclen_changes.size();
 	doclen_changes[did] = doclen;
+	if (doclen_changes.size() != old_size)
+	    postlist_bytes += DOCLEN_OVERHEAD;
     }
 
     void delete_doclength(Xapian::docid did) {
 	Assert(doclen_changes.find(did) == doclen_changes.end() || doclen_changes[did] != DELETED_POSTING);
+	size_t old_size = doclen_changes.size();
 	doclen_changes[did] = DELETED_POSTING;
+	if (doclen_changes.size() != old_size)
+	    postlist_bytes += DOCLEN_OVERHEAD;
     }
 
     bool get_doclength(Xapian::docid did, Xapian::termcount & doclen) const  {
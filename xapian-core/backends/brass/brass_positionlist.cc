@@ -197,3 +197,18 @@ BrassPositionList::at_end() const
     Assert(have_started);
     RETURN(current_pos > last);
 }
+
+void
+BrassPositionList::append_positions(vector<Xapian::termpos> & positions)
+{
+    LOGCALL_VOID(DB, "BrassPositionList::append_positions", positions);
+    Assert(!have_started);
+    have_started = true;
+    if (size > 1) {
+	rd.decode_interpolative_all(positions);
+    } else if (size == 1) {
+	positions.push_back(last);
+    }
+    last = 0;
+    current_pos = 1;
+}
@@ -145,6 +145,9 @@ class BrassPositionList : public PositionList {
 
     /// True if we're off the end of the list
     bool at_end() const;
+
+    /// Decode all the positions in one go.
+    void append_positions(std::vector<Xapian::termpos> & positions);
 };
 
 #endif /* XAPIAN_HGUARD_BRASS_POSITIONLIST_H */
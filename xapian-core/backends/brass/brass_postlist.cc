@@ -26,12 +26,17 @@
 
 #include "brass_cursor.h"
 #include "brass_database.h"
+#include "bitpack.h"
 #include "debuglog.h"
 #include "noreturn.h"
 #include "pack.h"
 #include "str.h"
 #include "unicode/description_append.h"
 
+#include "xapian/weight.h"
+
+#include <algorithm>
+
 using Xapian::Internal::intrusive_ptr;
 
 Xapian::doccount
@@ -111,10 +116,11 @@ class Brass::PostlistChunkWriter {
 
 	/// Append a block of raw entries to this chunk.
 	void raw_append(Xapian::docid first_did_, Xapian::docid current_did_,
-			const string & s) {
+			Xapian::termcount max_wdf_, const string & s) {
 	    Assert(!started);
 	    first_did = first_did_;
 	    current_did = current_did_;
+	    max_wdf = max_wdf_;
 	    if (!s.empty()) {
 		chunk.append(s);
 		started = true;
@@ -137,6 +143,9 @@ class Brass::PostlistChunkWriter {
 	Xapian::docid first_did;
 	Xapian::docid current_did;
 
+	/// The highest wdf in the chunk.
+	Xapian::termcount max_wdf;
+
 	string chunk;
 };
 
@@ -235,15 +244,24 @@ static Xapian::docid
 read_start_of_chunk(const char ** posptr,
 		    const char * end,
 		    Xapian::docid first_did_in_chunk,
-		    bool * is_last_chunk_ptr)
+		    bool * is_last_chunk_ptr,
+		    bool * is_packed_ptr,
+		    Xapian::termcount * max_wdf_ptr)
 {
-    LOGCALL_STATIC(DB, Xapian::docid, "read_start_of_chunk", reinterpret_cast<const void*>(posptr) | reinterpret_cast<const void*>(end) | first_did_in_chunk | reinterpret_cast<const void*>(is_last_chunk_ptr));
+    LOGCALL_STATIC(DB, Xapian::docid, "read_start_of_chunk", reinterpret_cast<const void*>(posptr) | reinterpret_cast<const void*>(end) | first_did_in_chunk | reinterpret_cast<const void*>(is_last_chunk_ptr) | reinterpret_cast<const void*>(is_packed_ptr) | reinterpret_cast<const void*>(max_wdf_ptr));
     Assert(is_last_chunk_ptr);
+    Assert(is_packed_ptr);
 
-    // Read whether this is the last chunk
-    if (!unpack_bool(posptr, end, is_last_chunk_ptr))
+    // Read whether this is the last chunk, and how the entries are encoded.
+    unsigned flags;
+    if (!unpack_uint(posptr, end, &flags))
 	report_read_error(*posptr);
+    if (flags & ~unsigned(Brass::CHUNK_LAST | Brass::CHUNK_PACKED))
+	throw Xapian::DatabaseCorruptError("Unknown flags in posting list chunk header");
+    *is_last_chunk_ptr = (flags & Brass::CHUNK_LAST) != 0;
+    *is_packed_ptr = (flags & Brass::CHUNK_PACKED) != 0;
     LOGVALUE(DB, *is_last_chunk_ptr);
+    LOGVALUE(DB, *is_packed_ptr);
 
     // Read what the final document ID in this chunk is.
     Xapian::docid increase_to_last;
@@ -251,6 +269,14 @@ read_start_of_chunk(const char ** posptr,
 	report_read_error(*posptr);
     Xapian::docid last_did_in_chunk = first_did_in_chunk + increase_to_last;
     LOGVALUE(DB, last_did_in_chunk);
+
+    // Read the highest wdf in this chunk.
+    Xapian::termcount max_wdf;
+    if (!unpack_uint(posptr, end, &max_wdf))
+	report_read_error(*posptr);
+    if (max_wdf_ptr)
+	*max_wdf_ptr = max_wdf;
+    LOGVALUE(DB, max_wdf);
     RETURN(last_did_in_chunk);
 }
 
@@ -269,16 +295,31 @@ class Brass::PostlistChunkReader {
     Xapian::docid did;
     Xapian::termcount wdf;
 
+    /// The decoded entries if the chunk is bit-packed, else empty.
+    vector<Xapian::docid> dids;
+    vector<Xapian::termcount> wdfs;
+
+    /// Index of the current entry in dids and wdfs.
+    size_t i;
+
   public:
     /** Initialise the postlist chunk reader.
      *
      *  @param first_did  First document id in this chunk.
      *  @param data       The tag string with the header removed.
+     *  @param packed     Whether the entries are bit-packed.
      */
-    PostlistChunkReader(Xapian::docid first_did, const string & data_)
-	: data(data_), pos(data.data()), end(pos + data.length()), at_end(data.empty()), did(first_did)
+    PostlistChunkReader(Xapian::docid first_did, const string & data_,
+			bool packed)
+	: data(data_), pos(data.data()), end(pos + data.length()), at_end(data.empty()), did(first_did), i(0)
     {
-	if (!at_end) read_wdf(&pos, end, &wdf);
+	if (at_end) return;
+	if (packed) {
+	    Brass::unpack_chunk(pos, end, first_did, dids, wdfs);
+	    wdf = wdfs[0];
+	} else {
+	    read_wdf(&pos, end, &wdf);
+	}
     }
 
     Xapian::docid get_docid() const {
@@ -302,7 +343,14 @@ using Brass::PostlistChunkReader;
 void
 PostlistChunkReader::next()
 {
-    if (pos == end) {
+    if (!dids.empty()) {
+	if (++i == dids.size()) {
+	    at_end = true;
+	} else {
+	    did = dids[i];
+	    wdf = wdfs[i];
+	}
+    } else if (pos == end) {
 	at_end = true;
     } else {
 	read_did_increase(&pos, end, &did);
@@ -317,7 +365,8 @@ PostlistChunkWriter::PostlistChunkWriter(const string &orig_key_,
 	: orig_key(orig_key_),
 	  tname(tname_), is_first_chunk(is_first_chunk_),
 	  is_last_chunk(is_last_chunk_),
-	  started(false)
+	  started(false),
+	  max_wdf(0)
 {
     LOGCALL_CTOR(DB, "PostlistChunkWriter", orig_key_ | is_first_chunk_ | tname_ | is_last_chunk_);
 }
@@ -339,6 +388,7 @@ PostlistChunkWriter::append(BrassTable * table, Xapian::docid did,
 	    is_last_chunk = save_is_last_chunk;
 	    is_first_chunk = false;
 	    first_did = did;
+	    max_wdf = 0;
 	    chunk.resize(0);
 	    orig_key = BrassPostListTable::make_key(tname, first_did);
 	} else {
@@ -346,6 +396,7 @@ PostlistChunkWriter::append(BrassTable * table, Xapian::docid did,
 	}
     }
     current_did = did;
+    if (wdf > max_wdf) max_wdf = wdf;
     pack_uint(chunk, wdf);
 }
 
@@ -367,13 +418,19 @@ make_start_of_first_chunk(Xapian::doccount entries,
  */
 static inline string
 make_start_of_chunk(bool new_is_last_chunk,
+		    bool new_is_packed,
 		    Xapian::docid new_first_did,
-		    Xapian::docid new_final_did)
+		    Xapian::docid new_final_did,
+		    Xapian::termcount new_max_wdf)
 {
     Assert(new_final_did >= new_first_did);
     string chunk;
-    pack_bool(chunk, new_is_last_chunk);
+    unsigned flags = 0;
+    if (new_is_last_chunk) flags |= Brass::CHUNK_LAST;
+    if (new_is_packed) flags |= Brass::CHUNK_PACKED;
+    pack_uint(chunk, flags);
     pack_uint(chunk, new_final_did - new_first_did);
+    pack_uint(chunk, new_max_wdf);
     return chunk;
 }
 
@@ -382,15 +439,18 @@ write_start_of_chunk(string & chunk,
 		     unsigned int start_of_chunk_header,
 		     unsigned int end_of_chunk_header,
 		     bool is_last_chunk,
+		     bool is_packed,
 		     Xapian::docid first_did_in_chunk,
-		     Xapian::docid last_did_in_chunk)
+		     Xapian::docid last_did_in_chunk,
+		     Xapian::termcount max_wdf)
 {
     Assert((size_t)(end_of_chunk_header - start_of_chunk_header) <= chunk.size());
 
     chunk.replace(start_of_chunk_header,
 		  end_of_chunk_header - start_of_chunk_header,
-		  make_start_of_chunk(is_last_chunk, first_did_in_chunk,
-				      last_did_in_chunk));
+		  make_start_of_chunk(is_last_chunk, is_packed,
+				      first_did_in_chunk, last_did_in_chunk,
+				      max_wdf));
 }
 
 void
@@ -481,9 +541,12 @@ PostlistChunkWriter::flush(BrassTable *table)
 
 	    // Read the chunk header
 	    bool new_is_last_chunk;
+	    bool new_is_packed;
+	    Xapian::termcount new_max_wdf;
 	    Xapian::docid new_last_did_in_chunk =
 		read_start_of_chunk(&tagpos, tagend, new_first_did,
-				    &new_is_last_chunk);
+				    &new_is_last_chunk, &new_is_packed,
+				    &new_max_wdf);
 
 	    string chunk_data(tagpos, tagend);
 
@@ -494,8 +557,10 @@ PostlistChunkWriter::flush(BrassTable *table)
 	    string tag;
 	    tag = make_start_of_first_chunk(num_ent, coll_freq, new_first_did);
 	    tag += make_start_of_chunk(new_is_last_chunk,
+					      new_is_packed,
 					      new_first_did,
-					      new_last_did_in_chunk);
+					      new_last_did_in_chunk,
+					      new_max_wdf);
 	    tag += chunk_data;
 	    table->add(orig_key, tag);
 	    return;
@@ -543,10 +608,13 @@ PostlistChunkWriter::flush(BrassTable *table)
 		    report_read_error(keypos);
 	    }
 	    bool wrong_is_last_chunk;
+	    bool prev_is_packed;
+	    Xapian::termcount prev_max_wdf;
 	    string::size_type start_of_chunk_header = tagpos - tag.data();
 	    Xapian::docid last_did_in_chunk =
 		read_start_of_chunk(&tagpos, tagend, first_did_in_chunk,
-				    &wrong_is_last_chunk);
+				    &wrong_is_last_chunk, &prev_is_packed,
+				    &prev_max_wdf);
 	    string::size_type end_of_chunk_header = tagpos - tag.data();
 
 	    // write new is_last flag
@@ -554,8 +622,10 @@ PostlistChunkWriter::flush(BrassTable *table)
 				 start_of_chunk_header,
 				 end_of_chunk_header,
 				 true, // is_last_chunk
+				 prev_is_packed,
 				 first_did_in_chunk,
-				 last_did_in_chunk);
+				 last_did_in_chunk,
+				 prev_max_wdf);
 	    table->add(cursor->current_key, tag);
 	}
     } else {
@@ -593,7 +663,8 @@ PostlistChunkWriter::flush(BrassTable *table)
 
 	    tag = make_start_of_first_chunk(num_ent, coll_freq, first_did);
 
-	    tag += make_start_of_chunk(is_last_chunk, first_did, current_did);
+	    tag += make_start_of_chunk(is_last_chunk, false, first_did,
+				       current_did, max_wdf);
 	    tag += chunk;
 	    table->add(key, tag);
 	    return;
@@ -633,7 +704,8 @@ PostlistChunkWriter::flush(BrassTable *table)
 	}
 
 	// ...and write the start of this chunk.
-	tag = make_start_of_chunk(is_last_chunk, first_did, current_did);
+	tag = make_start_of_chunk(is_last_chunk, false, first_did, current_did,
+				  max_wdf);
 
 	tag += chunk;
 	table->add(new_key, tag);
@@ -664,11 +736,27 @@ void BrassPostList::read_number_of_entries(const char ** posptr,
  *
  *  A chunk (except for the first chunk) contains:
  *
- *  1)  bool - true if this is the last chunk.
+ *  1)  flags - Brass::CHUNK_LAST if this is the last chunk, and
+ *      Brass::CHUNK_PACKED if the entries are bit-packed.
  *  2)  difference between final docid in chunk and first docid.
- *  3)  wdf for the first item.
- *  4)  increment in docid to next item, followed by wdf for the item.
- *  5)  (4) repeatedly.
+ *  3)  the highest wdf of any item in the chunk.
+ *  4)  wdf for the first item.
+ *  5)  increment in docid to next item, followed by wdf for the item.
+ *  6)  (5) repeatedly.
+ *
+ *  If the entries are bit-packed, (4) to (6) are replaced by the number of
+ *  entries followed by blocks of up to BITPACK_BLOCK_SIZE entries.  Each
+ *  block is the bit width of the docid increments, the bit width of the
+ *  wdfs, then the increments (one less than the difference from the
+ *  previous docid, or 0 for the first entry in the chunk) and then the wdfs,
+ *  packed with bitpack_encode().  A whole chunk is decoded at once, which
+ *  is much faster than decoding variable length integers one by one.
+ *  Currently only xapian-compact writes bit-packed chunks; a chunk which is
+ *  updated is written back in the standard form.
+ *
+ *  The highest wdf allows a whole chunk to be skipped when the matcher
+ *  only wants documents with a higher weight than any in the chunk can
+ *  achieve.
  *
  *  The first chunk begins with the number of entries, the collection
  *  frequency, then the docid of the first document, then has the header of a
@@ -713,6 +801,9 @@ BrassPostList::init()
 	end = 0;
 	first_did_in_chunk = 0;
 	last_did_in_chunk = 0;
+	max_wdf_in_chunk = 0;
+	max_weight_in_chunk = 0;
+	chunk_is_packed = false;
 	return;
     }
     cursor->read_tag();
@@ -722,8 +813,10 @@ BrassPostList::init()
     did = read_start_of_first_chunk(&pos, end, &number_of_entries, NULL);
     first_did_in_chunk = did;
     last_did_in_chunk = read_start_of_chunk(&pos, end, first_did_in_chunk,
-					    &is_last_chunk);
-    read_wdf(&pos, end, &wdf);
+					    &is_last_chunk, &chunk_is_packed,
+					    &max_wdf_in_chunk);
+    max_weight_in_chunk = -1.0;
+    read_first_entry();
     LOGLINE(DB, "Initial docid " << did);
 }
 
@@ -740,6 +833,15 @@ BrassPostList::open_nearby_postlist(const std::string & term_) const
 	return NULL;
     if (!this_db.get() || this_db->postlist_table.is_writable())
 	return NULL;
+    if (DecodedPostListCache::enabled()) {
+	DecodedPostListCache & cache = this_db->postlist_cache;
+	LeafPostList * pl =
+	    cache.open_post_list(this_db.get(), term_,
+				 this_db->get_revision_number());
+	if (pl) return pl;
+	return cache.add(this_db.get(), term_,
+			 new BrassPostList(this_db, term_, cursor->clone()));
+    }
     return new BrassPostList(this_db, term_, cursor->clone());
 }
 
@@ -752,10 +854,44 @@ BrassPostList::get_doclength() const
     RETURN(this_db->get_doclength(did));
 }
 
+void
+BrassPostList::read_first_entry()
+{
+    if (!chunk_is_packed) {
+	read_wdf(&pos, end, &wdf);
+	return;
+    }
+    // We already know the first docid, and don't decode the entries until
+    // we need them, since we may yet skip the chunk.
+    chunk_dids.clear();
+    chunk_index = 0;
+}
+
+void
+BrassPostList::unpack_chunk()
+{
+    LOGCALL_VOID(DB, "BrassPostList::unpack_chunk", NO_ARGS);
+    Assert(chunk_is_packed);
+    Assert(chunk_dids.empty());
+    Brass::unpack_chunk(pos, end, first_did_in_chunk, chunk_dids, chunk_wdfs);
+    AssertEq(chunk_dids[0], first_did_in_chunk);
+    AssertEq(chunk_dids.back(), last_did_in_chunk);
+    wdf = chunk_wdfs[chunk_index];
+}
+
 bool
 BrassPostList::next_in_chunk()
 {
     LOGCALL(DB, bool, "BrassPostList::next_in_chunk", NO_ARGS);
+    if (chunk_is_packed) {
+	if (chunk_dids.empty()) unpack_chunk();
+	if (chunk_index + 1 == chunk_dids.size()) RETURN(false);
+	++chunk_index;
+	did = chunk_dids[chunk_index];
+	wdf = chunk_wdfs[chunk_index];
+	RETURN(true);
+    }
+
     if (pos == end) RETURN(false);
 
     read_did_increase(&pos, end, &did);
@@ -811,8 +947,10 @@ BrassPostList::next_chunk()
 
     first_did_in_chunk = did;
     last_did_in_chunk = read_start_of_chunk(&pos, end, first_did_in_chunk,
-					    &is_last_chunk);
-    read_wdf(&pos, end, &wdf);
+					    &is_last_chunk, &chunk_is_packed,
+					    &max_wdf_in_chunk);
+    max_weight_in_chunk = -1.0;
+    read_first_entry();
 }
 
 PositionList *
@@ -832,11 +970,21 @@ BrassPostList::open_position_list() const
     RETURN(new BrassPositionList(&this_db->position_table, did, term));
 }
 
+void
+BrassPostList::skip_chunks_below(double w_min)
+{
+    LOGCALL_VOID(DB, "BrassPostList::skip_chunks_below", w_min);
+    while (!is_at_end && get_chunk_maxweight() < w_min) {
+	LOGLINE(DB, "Skipping chunk " << first_did_in_chunk << ".." <<
+		    last_did_in_chunk << " with max wdf " << max_wdf_in_chunk);
+	next_chunk();
+    }
+}
+
 PostList *
 BrassPostList::next(double w_min)
 {
     LOGCALL(DB, PostList *, "BrassPostList::next", w_min);
-    (void)w_min; // no warning
 
     if (!have_started) {
 	have_started = true;
@@ -844,6 +992,9 @@ BrassPostList::next(double w_min)
 	if (!next_in_chunk()) next_chunk();
     }
 
+    if (w_min > 0.0 && weight) skip_chunks_below(w_min);
+    if (!is_at_end && chunk_is_packed && chunk_dids.empty()) unpack_chunk();
+
     if (is_at_end) {
 	LOGLINE(DB, "Moved to end");
     } else {
@@ -904,8 +1055,10 @@ BrassPostList::move_to_chunk_containing(Xapian::docid desired_did)
 
     first_did_in_chunk = did;
     last_did_in_chunk = read_start_of_chunk(&pos, end, first_did_in_chunk,
-					    &is_last_chunk);
-    read_wdf(&pos, end, &wdf);
+					    &is_last_chunk, &chunk_is_packed,
+					    &max_wdf_in_chunk);
+    max_weight_in_chunk = -1.0;
+    read_first_entry();
 
     // Possible, since desired_did might be after end of this chunk and before
     // the next.
@@ -920,6 +1073,19 @@ BrassPostList::move_forward_in_chunk_to_at_least(Xapian::docid desired_did)
 	RETURN(true);
 
     if (desired_did <= last_did_in_chunk) {
+	if (chunk_is_packed) {
+	    if (chunk_dids.empty()) unpack_chunk();
+	    vector<Xapian::docid>::const_iterator i;
+	    i = lower_bound(chunk_dids.begin() + chunk_index, chunk_dids.end(),
+			    desired_did);
+	    // last_did_in_chunk is the last entry, so we must find one.
+	    Assert(i != chunk_dids.end());
+	    chunk_index = i - chunk_dids.begin();
+	    did = *i;
+	    wdf = chunk_wdfs[chunk_index];
+	    RETURN(true);
+	}
+
 	while (pos != end) {
 	    read_did_increase(&pos, end, &did);
 	    if (did >= desired_did) {
@@ -934,7 +1100,12 @@ BrassPostList::move_forward_in_chunk_to_at_least(Xapian::docid desired_did)
 	Assert(false);
     }
 
-    pos = end;
+    if (chunk_is_packed) {
+	if (chunk_dids.empty()) unpack_chunk();
+	chunk_index = chunk_dids.size() - 1;
+    } else {
+	pos = end;
+    }
     RETURN(false);
 }
 
@@ -942,7 +1113,6 @@ PostList *
 BrassPostList::skip_to(Xapian::docid desired_did, double w_min)
 {
     LOGCALL(DB, PostList *, "BrassPostList::skip_to", desired_did | w_min);
-    (void)w_min; // no warning
     // We've started now - if we hadn't already, we're already positioned
     // at start so there's no need to actually do anything.
     have_started = true;
@@ -963,6 +1133,9 @@ BrassPostList::skip_to(Xapian::docid desired_did, double w_min)
     (void)have_document;
     Assert(have_document);
 
+    if (w_min > 0.0 && weight) skip_chunks_below(w_min);
+    if (!is_at_end && chunk_is_packed && chunk_dids.empty()) unpack_chunk();
+
     if (is_at_end) {
 	LOGLINE(DB, "Skipped to end");
     } else {
@@ -999,6 +1172,7 @@ BrassPostList::jump_to(Xapian::docid desired_did)
 
     // Move to correct position in chunk.
     if (!move_forward_in_chunk_to_at_least(desired_did)) RETURN(false);
+    if (chunk_is_packed && chunk_dids.empty()) unpack_chunk();
     RETURN(desired_did == did);
 }
 
@@ -1062,19 +1236,26 @@ BrassPostListTable::get_chunk(const string &tname,
     }
 
     bool is_last_chunk;
+    bool is_packed;
+    Xapian::termcount max_wdf;
     Xapian::docid last_did_in_chunk;
-    last_did_in_chunk = read_start_of_chunk(&pos, end, first_did_in_chunk, &is_last_chunk);
+    last_did_in_chunk = read_start_of_chunk(&pos, end, first_did_in_chunk,
+					    &is_last_chunk, &is_packed,
+					    &max_wdf);
     *to = new PostlistChunkWriter(cursor->current_key, is_first_chunk, tname,
 				  is_last_chunk);
-    if (did > last_did_in_chunk) {
+    // The writer only produces the standard encoding, so we can't append
+    // to a bit-packed chunk wholesale.
+    if (did > last_did_in_chunk && !is_packed) {
 	// This is the shortcut.  Not very pretty, but I'll leave refactoring
 	// until I've a clearer picture of everything which needs to be done.
 	// (FIXME)
 	*from = NULL;
-	(*to)->raw_append(first_did_in_chunk, last_did_in_chunk,
+	(*to)->raw_append(first_did_in_chunk, last_did_in_chunk, max_wdf,
 			  string(pos, end));
     } else {
-	*from = new PostlistChunkReader(first_did_in_chunk, string(pos, end));
+	*from = new PostlistChunkReader(first_did_in_chunk, string(pos, end),
+					is_packed);
     }
     if (is_last_chunk) RETURN(Xapian::docid(-1));
 
@@ -1113,7 +1294,7 @@ BrassPostListTable::merge_doclen_changes(const map<Xapian::docid, Xapian::termco
     if (!key_exists(current_key)) {
 	LOGLINE(DB, "Adding dummy first chunk");
 	string newtag = make_start_of_first_chunk(0, 0, 0);
-	newtag += make_start_of_chunk(true, 0, 0);
+	newtag += make_start_of_chunk(true, false, 0, 0, 0);
 	add(current_key, newtag);
     }
 
@@ -1182,18 +1363,22 @@ BrassPostListTable::merge_changes(const string &term,
 	Xapian::doccount termfreq;
 	Xapian::termcount collfreq;
 	Xapian::docid firstdid, lastdid;
-	bool islast;
+	bool islast, ispacked;
+	Xapian::termcount maxwdf;
 	if (pos == end) {
 	    termfreq = 0;
 	    collfreq = 0;
 	    firstdid = 0;
 	    lastdid = 0;
 	    islast = true;
+	    ispacked = false;
+	    maxwdf = 0;
 	} else {
 	    firstdid = read_start_of_first_chunk(&pos, end,
 						 &termfreq, &collfreq);
 	    // Handle the generic start of chunk header.
-	    lastdid = read_start_of_chunk(&pos, end, firstdid, &islast);
+	    lastdid = read_start_of_chunk(&pos, end, firstdid, &islast,
+					  &ispacked, &maxwdf);
 	}
 
 	termfreq += changes.get_tfdelta();
@@ -1220,7 +1405,8 @@ BrassPostListTable::merge_changes(const string &term,
 
 	// Rewrite start of first chunk to update termfreq and collfreq.
 	string newhdr = make_start_of_first_chunk(termfreq, collfreq, firstdid);
-	newhdr += make_start_of_chunk(islast, firstdid, lastdid);
+	newhdr += make_start_of_chunk(islast, ispacked, firstdid, lastdid,
+				      maxwdf);
 	if (pos == end) {
 	    add(current_key, newhdr);
 	} else {
@@ -1229,7 +1415,7 @@ BrassPostListTable::merge_changes(const string &term,
 	    add(current_key, tag);
 	}
     }
-    map<Xapian::docid, Xapian::termcount>::const_iterator j;
+    Inverter::DocChanges<Xapian::termcount>::const_iterator j;
     j = changes.pl_changes.begin();
     Assert(j != changes.pl_changes.end()); // This case is caught above.
 
@@ -1277,3 +1463,83 @@ next_chunk:
     to->flush(this);
     delete to;
 }
+
+bool
+Brass::pack_chunk(string & tag, Xapian::docid first_did)
+{
+    LOGCALL_STATIC(DB, bool, "Brass::pack_chunk", tag.size() | first_did);
+    const char * pos = tag.data();
+    const char * end = pos + tag.size();
+    bool is_last_chunk, is_packed;
+    Xapian::termcount max_wdf;
+    Xapian::docid last_did = read_start_of_chunk(&pos, end, first_did,
+						 &is_last_chunk, &is_packed,
+						 &max_wdf);
+    if (is_packed || pos == end) RETURN(false);
+
+    vector<unsigned> increases, wdfs;
+    PostlistChunkReader reader(first_did, string(pos, end), false);
+    Xapian::docid prev_did = first_did - 1;
+    while (!reader.is_at_end()) {
+	Xapian::docid increase = reader.get_docid() - prev_did - 1;
+	Xapian::termcount wdf = reader.get_wdf();
+	// Written like this to avoid a warning if the types are 32 bits.
+	if ((increase >> 16 >> 16) || (wdf >> 16 >> 16)) RETURN(false);
+	increases.push_back(increase);
+	wdfs.push_back(wdf);
+	prev_did = reader.get_docid();
+	reader.next();
+    }
+
+    string packed = make_start_of_chunk(is_last_chunk, true, first_did,
+					last_did, max_wdf);
+    pack_uint(packed, increases.size());
+    for (size_t i = 0; i < increases.size(); i += BITPACK_BLOCK_SIZE) {
+	size_t n = min(increases.size() - i, BITPACK_BLOCK_SIZE);
+	unsigned increase_width = bitpack_width(&increases[i], n);
+	unsigned wdf_width = bitpack_width(&wdfs[i], n);
+	packed += char(increase_width);
+	packed += char(wdf_width);
+	bitpack_encode(packed, &increases[i], n, increase_width);
+	bitpack_encode(packed, &wdfs[i], n, wdf_width);
+    }
+    swap(tag, packed);
+    RETURN(true);
+}
+
+void
+Brass::unpack_chunk(const char * pos, const char * end,
+		    Xapian::docid first_did,
+		    vector<Xapian::docid> & dids,
+		    vector<Xapian::termcount> & wdfs)
+{
+    LOGCALL_STATIC_VOID(DB, "Brass::unpack_chunk", (const void *)pos | (const void *)end | first_did | (void*)&dids | (void*)&wdfs);
+    size_t n;
+    if (!unpack_uint(&pos, end, &n)) report_read_error(pos);
+    // Each block takes at least 2 bytes, so check the count is plausible
+    // before we allocate space for it.
+    if (n == 0 || (n - 1) / BITPACK_BLOCK_SIZE >= size_t(end - pos) / 2)
+	throw Xapian::DatabaseCorruptError("Bad entry count in bit-packed posting list chunk");
+    dids.resize(n);
+    wdfs.resize(n);
+
+    unsigned buf[BITPACK_BLOCK_SIZE];
+    Xapian::docid did = first_did - 1;
+    for (size_t i = 0; i < n; i += BITPACK_BLOCK_SIZE) {
+	size_t len = min(n - i, BITPACK_BLOCK_SIZE);
+	if (end - pos < 2) report_read_error(0);
+	unsigned increase_width = static_cast<unsigned char>(*pos++);
+	unsigned wdf_width = static_cast<unsigned char>(*pos++);
+	if (!bitpack_decode(&pos, end, buf, len, increase_width))
+	    report_read_error(0);
+	for (size_t j = 0; j != len; ++j) {
+	    did += buf[j] + 1;
+	    dids[i + j] = did;
+	}
+	if (!bitpack_decode(&pos, end, buf, len, wdf_width))
+	    report_read_error(0);
+	copy(buf, buf + len, wdfs.begin() + i);
+    }
+    if (pos != end)
+	throw Xapian::DatabaseCorruptError("Junk at end of bit-packed posting list chunk");
+}
@@ -36,6 +36,7 @@
 #include "autoptr.h"
 #include <map>
 #include <string>
+#include <vector>
 
 using namespace std;
 
@@ -45,6 +46,42 @@ class BrassDatabase;
 namespace Brass {
     class PostlistChunkReader;
     class PostlistChunkWriter;
+
+    /// Flags stored at the start of the header of each postlist chunk.
+    enum {
+	/// This is the last chunk in the posting list.
+	CHUNK_LAST = 1,
+	/// The entries in the chunk are bit-packed (see pack_chunk()).
+	CHUNK_PACKED = 2
+    };
+
+    /** Convert a postlist chunk to the bit-packed encoding.
+     *
+     *  @param tag	The chunk, which must be in the form used for chunks
+     *			other than the first (i.e. starting with the chunk
+     *			flags).  It's modified in place.
+     *  @param first_did	The first document id in the chunk.
+     *
+     *  @return true if the chunk was converted, false if it was left alone
+     *	    because it is already bit-packed or has values which don't
+     *	    fit in 32 bits.
+     */
+    bool pack_chunk(std::string & tag, Xapian::docid first_did);
+
+    /** Decode the entries of a bit-packed postlist chunk.
+     *
+     *  @param pos	The start of the entries (after the chunk header).
+     *  @param end	The end of the chunk.
+     *  @param first_did	The first document id in the chunk.
+     *  @param dids	Set to the document ids in the chunk.
+     *  @param wdfs	Set to the corresponding wdfs.
+     *
+     *  Throws Xapian::DatabaseCorruptError if the data is malformed.
+     */
+    void unpack_chunk(const char * pos, const char * end,
+		      Xapian::docid first_did,
+		      std::vector<Xapian::docid> & dids,
+		      std::vector<Xapian::termcount> & wdfs);
 }
 
 class BrassPostList;
@@ -152,6 +189,32 @@ class BrassPostList : public LeafPostList {
 	/// The last document id in this chunk.
 	Xapian::docid last_did_in_chunk;
 
+	/// The highest wdf in this chunk.
+	Xapian::termcount max_wdf_in_chunk;
+
+	/** Upper bound on the weight of any document in this chunk.
+	 *
+	 *  This is calculated from max_wdf_in_chunk when it's first needed
+	 *  (it is negative until then).
+	 */
+	double max_weight_in_chunk;
+
+	/// True if the entries in the current chunk are bit-packed.
+	bool chunk_is_packed;
+
+	/** The document ids in the current chunk, if it's bit-packed.
+	 *
+	 *  Bit-packed chunks are decoded in one go, but not until we need an
+	 *  entry other than the first docid.  This is empty until then.
+	 */
+	vector<Xapian::docid> chunk_dids;
+
+	/// The wdfs in the current chunk, if it's bit-packed.
+	vector<Xapian::termcount> chunk_wdfs;
+
+	/// Index of the current entry in chunk_dids and chunk_wdfs.
+	size_t chunk_index;
+
 	/// Position of iteration through current chunk.
 	const char * pos;
 
@@ -173,6 +236,16 @@ class BrassPostList : public LeafPostList {
 	/// Assignment is not allowed.
 	void operator=(const BrassPostList &);
 
+	/** Read the first entry of the chunk we've just read the header of.
+	 *
+	 *  If the chunk is bit-packed, this leaves decoding it to
+	 *  unpack_chunk().
+	 */
+	void read_first_entry();
+
+	/// Decode all the entries of the current bit-packed chunk.
+	void unpack_chunk();
+
 	/** Move to the next item in the chunk, if possible.
 	 *  If already at the end of the chunk, returns false.
 	 */
@@ -218,6 +291,23 @@ class BrassPostList : public LeafPostList {
 	 */
 	bool move_forward_in_chunk_to_at_least(Xapian::docid desired_did);
 
+	/** Get an upper bound on the weight of any document in this chunk.
+	 *
+	 *  Must only be called if a weighting scheme has been set.
+	 */
+	double get_chunk_maxweight() {
+	    if (max_weight_in_chunk < 0)
+		max_weight_in_chunk = weight->get_maxpart_for_wdf(max_wdf_in_chunk);
+	    return max_weight_in_chunk;
+	}
+
+	/** Skip over chunks which can't contain a document with weight w_min.
+	 *
+	 *  If the current chunk could contain such a document, this does
+	 *  nothing.
+	 */
+	void skip_chunks_below(double w_min);
+
 	BrassPostList(Xapian::Internal::intrusive_ptr<const BrassDatabase> this_db_,
 		      const string & term,
 		      BrassCursor * cursor_);
@@ -0,0 +1,197 @@
+/** @file brass_prepareddoc.cc
+ * @brief Encode documents for adding to a brass database.
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include "brass_prepareddoc.h"
+
+#include "xapian/positioniterator.h"
+#include "xapian/termiterator.h"
+
+#include "api/termlist.h"
+#include "backends/document.h"
+#include "brass_positionlist.h"
+#include "brass_termlisttable.h"
+#include "omassert.h"
+#include "thread.h"
+
+using namespace std;
+
+void
+BrassPreparedDocument::prepare(const Xapian::Document & doc,
+			       const BrassPositionListTable & position_table,
+			       bool want_termlist)
+{
+    terms.clear();
+    terms.reserve(doc.termlist_count());
+    doclen = 0;
+    Xapian::TermIterator term = doc.termlist_begin();
+    for ( ; term != doc.termlist_end(); ++term) {
+	terms.push_back(Term());
+	Term & t = terms.back();
+	t.name = *term;
+	t.wdf = term.get_wdf();
+	doclen += t.wdf;
+
+	const vector<Xapian::termpos> * ptr;
+	ptr = term.internal->get_vector_termpos();
+	if (ptr) {
+	    if (!ptr->empty())
+		position_table.pack(t.positions, *ptr);
+	} else {
+	    Xapian::PositionIterator pos = term.positionlist_begin();
+	    if (pos != term.positionlist_end()) {
+		vector<Xapian::termpos> posvec(pos, Xapian::PositionIterator());
+		position_table.pack(t.positions, posvec);
+	    }
+	}
+    }
+
+    if (want_termlist) {
+	BrassTermListTable::encode_termlist(termlist_tag, doc, doclen);
+    } else {
+	termlist_tag.resize(0);
+    }
+    prepared = true;
+}
+
+size_t
+BrassPreparedDocument::get_memory_used() const
+{
+    size_t bytes = termlist_tag.size() + terms.size() * sizeof(Term);
+    vector<Term>::const_iterator t;
+    for (t = terms.begin(); t != terms.end(); ++t) {
+	bytes += t->name.size() + t->positions.size();
+    }
+    return bytes;
+}
+
+/// Prepare every n-th document of a batch.
+class PrepareThread : public Thread {
+    const BrassPositionListTable & position_table;
+
+    bool want_termlist;
+
+    const vector<Xapian::Document> * docs;
+
+    vector<BrassPreparedDocument> * out;
+
+    /// Index in docs of the first document of the batch.
+    size_t begin;
+
+    /// Index in docs after the last document of the batch.
+    size_t end;
+
+    /// Offset from begin of the first document for this thread to prepare.
+    size_t offset;
+
+    /// The distance between the documents for this thread to prepare.
+    size_t step;
+
+  public:
+    PrepareThread(const BrassPositionListTable & position_table_,
+		  bool want_termlist_)
+	: position_table(position_table_), want_termlist(want_termlist_),
+	  docs(NULL), out(NULL), begin(0), end(0), offset(0), step(1) { }
+
+    void set_batch(const vector<Xapian::Document> & docs_,
+		   size_t begin_, size_t end_,
+		   size_t offset_, size_t step_,
+		   vector<BrassPreparedDocument> & out_) {
+	docs = &docs_;
+	begin = begin_;
+	end = end_;
+	offset = offset_;
+	step = step_;
+	out = &out_;
+    }
+
+    void run();
+};
+
+void
+PrepareThread::run()
+{
+    for (size_t i = begin + offset; i < end; i += step) {
+	BrassPreparedDocument & prepared = (*out)[i - begin];
+	try {
+	    prepared.prepare((*docs)[i], position_table, want_termlist);
+	} catch (...) {
+	    // We can't propagate the exception from this thread, so just
+	    // note that it happened.  The caller will then prepare this
+	    // document itself, which will report the error in the usual way.
+	    prepared.prepared = false;
+	}
+    }
+}
+
+BrassDocumentPreparer::BrassDocumentPreparer(
+	const BrassPositionListTable & position_table,
+	bool want_termlist,
+	unsigned threads)
+{
+    Assert(threads > 0);
+    workers.reserve(threads);
+    try {
+	for (unsigned i = 0; i != threads; ++i) {
+	    workers.push_back(new PrepareThread(position_table,
+						want_termlist));
+	}
+    } catch (...) {
+	for (size_t i = 0; i != workers.size(); ++i) delete workers[i];
+	throw;
+    }
+}
+
+BrassDocumentPreparer::~BrassDocumentPreparer()
+{
+    // Deleting each thread joins it.
+    for (size_t i = 0; i != workers.size(); ++i) delete workers[i];
+}
+
+void
+BrassDocumentPreparer::start(const vector<Xapian::Document> & docs,
+			     size_t begin, size_t end,
+			     vector<BrassPreparedDocument> & out)
+{
+    Assert(begin <= end);
+    Assert(end <= docs.size());
+    // Read in any terms which aren't already in memory now, as that may
+    // need to access the database the document came from.
+    for (size_t i = begin; i != end; ++i) {
+	docs[i].internal->need_terms();
+    }
+
+    out.resize(end - begin);
+    for (size_t i = 0; i != out.size(); ++i) {
+	out[i].prepared = false;
+    }
+
+    size_t n = workers.size();
+    for (size_t k = 0; k != n; ++k) {
+	workers[k]->set_batch(docs, begin, end, k, n, out);
+	workers[k]->start();
+    }
+}
+
+void
+BrassDocumentPreparer::wait()
+{
+    for (size_t i = 0; i != workers.size(); ++i) workers[i]->join();
+}
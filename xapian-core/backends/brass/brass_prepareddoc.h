@@ -0,0 +1,140 @@
+/** @file brass_prepareddoc.h
+ * @brief Encode documents for adding to a brass database.
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#ifndef XAPIAN_INCLUDED_BRASS_PREPAREDDOC_H
+#define XAPIAN_INCLUDED_BRASS_PREPAREDDOC_H
+
+#include <string>
+#include <vector>
+
+#include "xapian/document.h"
+#include "xapian/types.h"
+
+#include "brass_types.h"
+
+class BrassPositionListTable;
+class PrepareThread;
+
+/** A document encoded ready to be added to a brass database.
+ *
+ *  Encoding the termlist and position lists of a document doesn't need
+ *  access to the database's tables, so it can be done in parallel for a
+ *  batch of documents, leaving only the updates to the tables to be
+ *  performed serially.
+ */
+class BrassPreparedDocument {
+  public:
+    /// A term in the document.
+    struct Term {
+	std::string name;
+
+	Xapian::termcount wdf;
+
+	/// The packed position list, or empty if there are no positions.
+	std::string positions;
+
+	Term() : wdf(0) { }
+    };
+
+    /// The terms, in ascending order.
+    std::vector<Term> terms;
+
+    /// The document length (the sum of the wdfs).
+    brass_doclen_t doclen;
+
+    /// The encoded termlist (empty if no termlist is wanted).
+    std::string termlist_tag;
+
+    /** Has the document been prepared successfully?
+     *
+     *  This is false if preparing the document in a worker thread failed,
+     *  in which case it should be prepared again in the calling thread so
+     *  that any exception is reported.
+     */
+    bool prepared;
+
+    BrassPreparedDocument() : doclen(0), prepared(false) { }
+
+    /** Encode @a doc.
+     *
+     *  This is safe to call for different documents in parallel provided
+     *  each document's terms have already been loaded (see
+     *  BrassDocumentPreparer::start()).
+     *
+     *  @param doc		The document to encode.
+     *  @param position_table	Used to pack the position lists.
+     *  @param want_termlist	Should the termlist be encoded?
+     */
+    void prepare(const Xapian::Document & doc,
+		 const BrassPositionListTable & position_table,
+		 bool want_termlist);
+
+    /// Approximately how much memory the encoded document uses, in bytes.
+    size_t get_memory_used() const;
+};
+
+/** Prepare batches of documents using worker threads.
+ *
+ *  The documents in a batch are shared between the threads, and the caller
+ *  is free to add the previous batch to the database while they work.
+ */
+class BrassDocumentPreparer {
+    /// Don't allow copying.
+    BrassDocumentPreparer(const BrassDocumentPreparer &);
+
+    /// Don't allow assignment.
+    void operator=(const BrassDocumentPreparer &);
+
+    std::vector<PrepareThread *> workers;
+
+  public:
+    /** Construct a preparer.
+     *
+     *  @param position_table	Used to pack the position lists.
+     *  @param want_termlist	Should termlists be encoded?
+     *  @param threads		The number of worker threads to use.
+     */
+    BrassDocumentPreparer(const BrassPositionListTable & position_table,
+			  bool want_termlist,
+			  unsigned threads);
+
+    /// Destructor, which waits for any batch in progress.
+    ~BrassDocumentPreparer();
+
+    /** Start preparing a batch of documents.
+     *
+     *  Any data which each document needs from a database is read before
+     *  this method returns, and the documents mustn't be modified until
+     *  wait() has been called.
+     *
+     *  @param docs	The documents to prepare.
+     *  @param begin	Index of the first document in @a docs to prepare.
+     *  @param end	Index after the last document in @a docs to prepare.
+     *  @param out	Resized to end - begin and filled in with the
+     *			prepared documents.
+     */
+    void start(const std::vector<Xapian::Document> & docs,
+	       size_t begin, size_t end,
+	       std::vector<BrassPreparedDocument> & out);
+
+    /// Wait for the batch being prepared to be ready.
+    void wait();
+};
+
+#endif // XAPIAN_INCLUDED_BRASS_PREPAREDDOC_H
@@ -35,6 +35,10 @@
 #include "stringutils.h" // For STRINGIZE().
 
 #include <sys/types.h>
+#include "safesysstat.h"
+#ifdef HAVE_MMAP
+# include <sys/mman.h>
+#endif
 
 #include <cstdio>    /* for rename */
 #include <cstring>   /* for memmove */
@@ -44,7 +48,9 @@
 #include "brass_changes.h"
 #include "brass_cursor.h"
 
+#include "backends/blockcache.h"
 #include "debuglog.h"
+#include "fd.h"
 #include "filetests.h"
 #include "io_utils.h"
 #include "omassert.h"
@@ -169,6 +175,12 @@ BrassTable::read_block(uint4 n, byte * p) const
 
     io_read_block(handle, reinterpret_cast<char *>(p), block_size, n);
 
+    check_block(n, p);
+}
+
+void
+BrassTable::check_block(uint4 n, const byte * p) const
+{
     if (GET_LEVEL(p) != LEVEL_FREELIST) {
 	int dir_end = DIR_END(p);
 	if (rare(dir_end < DIR_START || unsigned(dir_end) > block_size)) {
@@ -179,6 +191,166 @@ BrassTable::read_block(uint4 n, byte * p) const
     }
 }
 
+/** read_block_cached(n, p) reads block n to address p, consulting the shared
+ *  block cache first if this table is read-only and using it.
+ */
+void
+BrassTable::read_block_cached(uint4 n, byte * p) const
+{
+    LOGCALL_VOID(DB, "BrassTable::read_block_cached", n | (void*)p);
+    if (writable || block_cache_id.empty()) {
+	read_block(n, p);
+	return;
+    }
+
+    SharedBlockCache & cache = SharedBlockCache::instance();
+    if (!cache.enabled()) {
+	read_block(n, p);
+	return;
+    }
+
+    if (rare(handle == -2))
+	BrassTable::throw_database_closed();
+    if (cache.get(block_cache_id, revision_number, n, p, block_size))
+	return;
+
+    read_block(n, p);
+    // Don't share a block which has been overwritten since the revision we
+    // have open - the caller will spot this and throw
+    // DatabaseModifiedError, but another reader which opened the same
+    // revision might yet be able to proceed if it reads the block later.
+    if (REVISION(p) <= revision_number)
+	cache.add(block_cache_id, revision_number, n, p, block_size);
+}
+
+void
+BrassTable::set_block_cache_id(const string & db_id)
+{
+    LOGCALL_VOID(DB, "BrassTable::set_block_cache_id", db_id);
+    block_cache_id = db_id;
+    block_cache_id += tablename;
+    if (handle < 0) return;
+    struct stat statbuf;
+    if (fstat(handle, &statbuf) < 0) {
+	// Without the inode we can't tell a copy from the original.
+	block_cache_id.resize(0);
+	return;
+    }
+    block_cache_id += ' ';
+    block_cache_id += str((unsigned long long)statbuf.st_dev);
+    block_cache_id += ':';
+    block_cache_id += str((unsigned long long)statbuf.st_ino);
+#ifdef __WIN32__
+    // st_ino is always 0 on Windows, so use the path instead.
+    block_cache_id += ' ';
+    block_cache_id += name;
+#endif
+}
+
+/** Check the revision of block @a p in the mapping matches its copy @a q.
+ *
+ *  We read the mapping through a volatile pointer so the compiler can't just
+ *  reuse the bytes it read while making the copy.
+ */
+static inline bool
+same_revision(const byte * p, const byte * q)
+{
+    const volatile byte * v = p;
+    return v[0] == q[0] && v[1] == q[1] && v[2] == q[2] && v[3] == q[3];
+}
+
+const byte *
+BrassTable::load_block(Brass::Cursor & cur, uint4 n) const
+{
+    byte * q = cur.init(block_size);
+    if (n < mapping_blocks) {
+	if (rare(handle == -2))
+	    BrassTable::throw_database_closed();
+	// The block is copied just as read_block() would, so the mapping only
+	// saves the pread() call.  A writer may reuse the block and overwrite
+	// it while we copy it, just as it might during a pread(), so we can
+	// get a torn copy.  Any change is made by a later revision than ours,
+	// so if the revision in the mapping or the copy is newer, or the copy
+	// doesn't make sense and the mapping has changed under us, the
+	// revision we're reading has been discarded.
+	const byte * p = mapping + size_t(n) * block_size;
+	memcpy(q, p, block_size);
+	if (rare(!same_revision(p, q) || REVISION(q) > revision_number))
+	    set_overwritten();
+	try {
+	    check_block(n, q);
+	} catch (const Xapian::DatabaseCorruptError &) {
+	    if (!same_revision(p, q)) set_overwritten();
+	    throw;
+	}
+    } else {
+	read_block_cached(n, q);
+    }
+    cur.set_n(n);
+    return q;
+}
+
+void
+BrassTable::update_mapping()
+{
+    LOGCALL_VOID(DB, "BrassTable::update_mapping", NO_ARGS);
+    mapping_blocks = 0;
+#ifdef HAVE_MMAP
+    if (!(flags & Xapian::DB_MMAP) || writable || handle < 0) return;
+
+    struct stat statbuf;
+    if (fstat(handle, &statbuf) < 0) return;
+
+    uint4 blocks = base.get_first_unused_block();
+    // Check the file is big enough - it always should be, but we'd get
+    // SIGBUS if we tried to access a block beyond the end of it.
+    if (blocks > statbuf.st_size / block_size) return;
+    // Don't try to map tables which are too large for the address space.
+    if (blocks > (size_t(-1) / 2) / block_size) return;
+    size_t needed = size_t(blocks) * block_size;
+
+    if (mapping) {
+	if (statbuf.st_dev == mapping_dev && statbuf.st_ino == mapping_ino &&
+	    needed <= mapping_size) {
+	    mapping_blocks = blocks;
+	    return;
+	}
+	// The table has grown beyond the mapping, or the file has been
+	// replaced (e.g. by replication).
+	unmap();
+    }
+
+    if (needed == 0) return;
+
+    // Leave room for the table to grow so we don't have to remap on every
+    // reopen().  Pages past the end of the file are never touched.
+    size_t len = needed + needed / 2;
+    if (len < needed) len = needed;
+    void * p = mmap(NULL, len, PROT_READ, MAP_SHARED, handle, 0);
+    if (p == MAP_FAILED) {
+	LOGLINE(DB, "mmap() failed: " << strerror(errno));
+	return;
+    }
+    mapping = static_cast<const byte *>(p);
+    mapping_size = len;
+    mapping_dev = statbuf.st_dev;
+    mapping_ino = statbuf.st_ino;
+    mapping_blocks = blocks;
+#endif
+}
+
+void
+BrassTable::unmap()
+{
+#ifdef HAVE_MMAP
+    if (mapping) {
+	munmap(const_cast<byte *>(mapping), mapping_size);
+	mapping = NULL;
+    }
+#endif
+    mapping_blocks = 0;
+}
+
 /** write_block(n, p, appending) writes block n in the DB file from address p.
  *
  *  If appending is false (the default if not specified), then we check to see
@@ -339,10 +511,7 @@ BrassTable::block_to_cursor(Brass::Cursor * C_, int j, uint4 n) const
     if (n == C[j].get_n()) {
 	p = C_[j].clone(C[j]);
     } else {
-	byte * q = C_[j].init(block_size);
-	read_block(n, q);
-	p = q;
-	C_[j].set_n(n);
+	p = load_block(C_[j], n);
     }
 
     if (j < level) {
@@ -1148,6 +1317,7 @@ BrassTable::get_exact_entry(const string &key, string & tag) const
 {
     LOGCALL(DB, bool, "BrassTable::get_exact_entry", key | tag);
     Assert(!key.empty());
+    wait_for_writer();
 
     if (handle < 0) {
 	if (handle == -2) {
@@ -1171,6 +1341,7 @@ BrassTable::key_exists(const string &key) const
 {
     LOGCALL(DB, bool, "BrassTable::key_exists", key);
     Assert(!key.empty());
+    wait_for_writer();
 
     // An oversized key can't exist, so attempting to search for it should fail.
     if (key.size() > BRASS_BTREE_MAX_KEY_LEN) RETURN(false);
@@ -1538,7 +1709,13 @@ BrassTable::BrassTable(const char * tablename_, const string & path_,
 	  writable(!readonly_),
 	  cursor_created_since_last_modification(false),
 	  cursor_version(0),
+	  writer(NULL),
 	  changes_obj(NULL),
+	  mapping(NULL),
+	  mapping_size(0),
+	  mapping_blocks(0),
+	  mapping_dev(0),
+	  mapping_ino(0),
 	  split_p(0),
 	  compress_strategy(compress_strategy_),
 	  comp_stream(compress_strategy_),
@@ -1617,6 +1794,7 @@ BrassTable::create_and_open(int flags_, unsigned int block_size_)
 BrassTable::~BrassTable() {
     LOGCALL_DTOR(DB, "BrassTable");
     BrassTable::close();
+    unmap();
 }
 
 void BrassTable::close(bool permanent) {
@@ -1629,7 +1807,12 @@ void BrassTable::close(bool permanent) {
 	handle = -1;
     }
 
+    // Any mapping is left in place so reopen() can reuse it, but it's no
+    // longer valid for the revision we'll open next.
+    mapping_blocks = 0;
+
     if (permanent) {
+	unmap();
 	handle = -2;
 	// Don't delete the resources in the table, since they may
 	// still be used to look up cached content.
@@ -1674,6 +1857,16 @@ void
 BrassTable::commit(brass_revision_number_t revision)
 {
     LOGCALL_VOID(DB, "BrassTable::commit", revision);
+    bool sync_db = !(flags & Xapian::DB_NO_SYNC);
+    write_commit(revision, true);
+    if (sync_db) sync_commit();
+    finish_commit();
+}
+
+void
+BrassTable::write_commit(brass_revision_number_t revision, bool sync_base)
+{
+    LOGCALL_VOID(DB, "BrassTable::write_commit", revision | sync_base);
     Assert(writable);
 
     if (revision <= revision_number) {
@@ -1714,25 +1907,54 @@ BrassTable::commit(brass_revision_number_t revision)
 
 	// Save to "<table>.tmp" and then rename to "<table>.base<letter>" so
 	// that a reader can't try to read a partially written base file.
+	string tmp = name;
+	tmp += "tmp";
+	base.write_to_file(tmp, base_letter, tablename, changes_obj,
+			   sync_base);
+    } catch (...) {
+	BrassTable::close();
+	throw;
+    }
+}
+
+void
+BrassTable::start_sync()
+{
+    if (handle >= 0) io_start_sync(handle);
+}
+
+void
+BrassTable::sync_commit()
+{
+    LOGCALL_VOID(DB, "BrassTable::sync_commit", NO_ARGS);
+    if (handle < 0) return;
+
+    // Do this as late as possible to allow maximum time for writes to
+    // happen, and so the calls to io_sync() are adjacent which may be
+    // more efficient, at least with some Linux kernel versions.
+    if (!io_sync(handle)) {
+	(void)::close(handle);
+	handle = -1;
+	string tmp = name;
+	tmp += "tmp";
+	(void)unlink(tmp.c_str());
+	BrassTable::close();
+	throw Xapian::DatabaseError("Can't commit new revision - failed to flush DB to disk");
+    }
+}
+
+void
+BrassTable::finish_commit()
+{
+    LOGCALL_VOID(DB, "BrassTable::finish_commit", NO_ARGS);
+    if (handle < 0) return;
+
+    try {
 	string tmp = name;
 	tmp += "tmp";
 	string basefile = name;
 	basefile += "base";
 	basefile += char(base_letter);
-	base.write_to_file(tmp, base_letter, tablename, changes_obj);
-
-	// Do this as late as possible to allow maximum time for writes to
-	// happen, and so the calls to io_sync() are adjacent which may be
-	// more efficient, at least with some Linux kernel versions.
-	if ((flags & Xapian::DB_NO_SYNC) == 0) {
-	    if (!io_sync(handle)) {
-		(void)::close(handle);
-		handle = -1;
-		(void)unlink(tmp.c_str());
-		throw Xapian::DatabaseError("Can't commit new revision - failed to flush DB to disk");
-	    }
-	}
-
 	if (posixy_rename(tmp.c_str(), basefile.c_str()) < 0) {
 	    // With NFS, rename() failing may just mean that the server crashed
 	    // after successfully renaming, but before reporting this, and then
@@ -1847,6 +2069,8 @@ BrassTable::do_open_to_read(bool revision_supplied, brass_revision_number_t revi
 	C[j].init(block_size);
     }
 
+    update_mapping();
+
     read_root();
     RETURN(true);
 }
@@ -1931,10 +2155,7 @@ BrassTable::prev_for_sequential(Brass::Cursor * C_, int /*dummy*/) const
 		// Block isn't in the built-in cursor, so the form on disk
 		// is valid, so read it to check if it's the next level 0
 		// block.
-		byte * q = C_[0].init(block_size);
-		read_block(n, q);
-		p = q;
-		C_[0].set_n(n);
+		p = load_block(C_[0], n);
 	    }
 	    if (writable) AssertEq(revision_number, latest_revision_number);
 	    if (REVISION(p) > revision_number + writable) {
@@ -1985,13 +2206,11 @@ BrassTable::next_for_sequential(Brass::Cursor * C_, int /*dummy*/) const
 		    // is valid, so read it to check if it's the next level 0
 		    // block.
 		    byte * q = C_[0].init(block_size);
-		    read_block(n, q);
+		    read_block_cached(n, q);
 		    p = q;
 		}
 	    } else {
-		byte * q = C_[0].init(block_size);
-		read_block(n, q);
-		p = q;
+		p = load_block(C_[0], n);
 	    }
 	    if (writable) AssertEq(revision_number, latest_revision_number);
 	    if (REVISION(p) > revision_number + writable) {
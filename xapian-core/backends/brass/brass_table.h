@@ -41,6 +41,8 @@
 #include <algorithm>
 #include <string>
 
+#include <sys/types.h>
+
 #define DONT_COMPRESS -1
 
 /** Even for items of at maximum size, it must be possible to get this number of
@@ -275,6 +277,21 @@ public:
 
 class BrassChanges;
 
+/** Something which may write to a table from another thread.
+ *
+ *  While it does, other threads must wait before reading the table.
+ */
+class BrassTableWriter {
+  public:
+    virtual ~BrassTableWriter() { }
+
+    /** Wait for any write from another thread to finish.
+     *
+     *  This does nothing if called from the thread doing the writing.
+     */
+    virtual void wait_for_writer() const = 0;
+};
+
 /** Class managing a Btree table in a Brass database.
  *
  *  A table is a store holding a set of key/tag pairs.
@@ -404,6 +421,32 @@ class BrassTable {
 	 */
 	void commit(brass_revision_number_t revision);
 
+	/** Write a new revision of the table, but don't make it live yet.
+	 *
+	 *  This is the first step of commit(), which is split up so that
+	 *  several tables can be committed together with their syncs
+	 *  batched: call write_commit() for each table, then start_sync()
+	 *  and sync_commit() for each table (or sync the filesystem), then
+	 *  finish_commit() for each table.
+	 *
+	 *  @param revision	The new revision number, as for commit().
+	 *  @param sync_base	Sync the new base file to disk?
+	 */
+	void write_commit(brass_revision_number_t revision, bool sync_base);
+
+	/** Start writing the revision from write_commit() to disk.
+	 *
+	 *  This doesn't wait for the writes to finish, which allows several
+	 *  tables' writes to proceed together.
+	 */
+	void start_sync();
+
+	/// Wait until the revision from write_commit() is on disk.
+	void sync_commit();
+
+	/// Make the revision from write_commit() the live revision.
+	void finish_commit();
+
 	/** Cancel any outstanding changes.
 	 *
 	 *  This will discard any modifications which haven't been committed
@@ -440,6 +483,18 @@ class BrassTable {
 	 */
 	bool key_exists(const std::string &key) const;
 
+	/** Set what to wait for before reading this table.
+	 *
+	 *  @param writer_	Something writing to the table from another
+	 *			thread, or NULL if nothing is.
+	 */
+	void set_writer(const BrassTableWriter * writer_) { writer = writer_; }
+
+	/// Wait for any write to this table from another thread to finish.
+	void wait_for_writer() const {
+	    if (writer) writer->wait_for_writer();
+	}
+
 	/** Read the tag value for the key pointed to by cursor C_.
 	 *
 	 *  @param keep_compressed  Don't uncompress the tag - e.g. useful
@@ -605,6 +660,22 @@ class BrassTable {
 	    changes_obj = changes;
 	}
 
+	/** Set the identifier used for this table's blocks in the shared
+	 *  block cache.
+	 *
+	 *  Blocks are only shared for read-only tables which have had this
+	 *  set, since the cache has to be able to tell apart the blocks of
+	 *  different databases with the same table name.  The device and
+	 *  inode of the table's file are added to @a db_id, as a copy of a
+	 *  database has the same UUID but can be updated independently.
+	 *
+	 *  This needs to be called each time the table is opened.
+	 *
+	 *  @param db_id	A string which uniquely identifies the database
+	 *			(e.g. its UUID).
+	 */
+	void set_block_cache_id(const std::string & db_id);
+
 	/// Throw an exception indicating that the database is closed.
 	XAPIAN_NORETURN(static void throw_database_closed());
 
@@ -628,6 +699,7 @@ class BrassTable {
 	bool find(Brass::Cursor *) const;
 	int delete_kt();
 	void read_block(uint4 n, byte *p) const;
+	void read_block_cached(uint4 n, byte *p) const;
 	void write_block(uint4 n, const byte *p, bool appending = false) const;
 	XAPIAN_NORETURN(void set_overwritten() const);
 	void block_to_cursor(Brass::Cursor *C_, int j, uint4 n) const;
@@ -745,12 +817,69 @@ class BrassTable {
 	/// Version count for tracking when cursors need to rebuild.
 	unsigned long cursor_version;
 
+	/** What is writing to the table from another thread.
+	 *
+	 *  NULL unless a commit is running in the background.
+	 */
+	const BrassTableWriter * writer;
+
 	/** The BrassChanges object to write block changes to.
 	 *
 	 *  If NULL, no changes will be written.
 	 */
 	BrassChanges * changes_obj;
 
+	/** Identifies this table in the shared block cache.
+	 *
+	 *  If empty, the shared block cache isn't used.
+	 */
+	std::string block_cache_id;
+
+	/** Read-only memory mapping of the DB file (if DB_MMAP was specified).
+	 *
+	 *  NULL if the table isn't memory-mapped.
+	 */
+	const byte * mapping;
+
+	/// The length of mapping in bytes.
+	size_t mapping_size;
+
+	/** The number of blocks which may be accessed through mapping.
+	 *
+	 *  This is the number of blocks in use in the revision which is open,
+	 *  so always lies within the file (the mapping itself may extend past
+	 *  the end of the file to leave room for the file to grow).
+	 */
+	uint4 mapping_blocks;
+
+	/// The device and inode of the file which is mapped.
+	dev_t mapping_dev;
+	ino_t mapping_ino;
+
+	/** Set up mapping for the table which has just been opened to read.
+	 *
+	 *  If the file can't be mapped, we silently fall back to reading
+	 *  blocks.
+	 */
+	void update_mapping();
+
+	/// Unmap mapping if there is one.
+	void unmap();
+
+	/** Load block n into cursor level @a cur, and return a pointer to it.
+	 *
+	 *  The block is copied from the memory mapping if there is one which
+	 *  covers it, or otherwise read with read_block_cached().  Either way
+	 *  we parse a private copy, so the mapping just saves a system call.
+	 *
+	 *  If the block is seen to have been overwritten since the revision
+	 *  we're reading, DatabaseModifiedError is thrown.
+	 */
+	const byte * load_block(Brass::Cursor & cur, uint4 n) const;
+
+	/// Check that the directory end of block @a n at @a p is sane.
+	void check_block(uint4 n, const byte * p) const;
+
 	/* B-tree navigation functions */
 	bool prev(Brass::Cursor *C_, int j) const {
 	    if (sequential) return prev_for_sequential(C_, j);
@@ -43,6 +43,18 @@ BrassTermListTable::set_termlist(Xapian::docid did,
     LOGCALL_VOID(DB, "BrassTermListTable::set_termlist", did | doc | doclen);
 
     string tag;
+    encode_termlist(tag, doc, doclen);
+    add(make_key(did), tag);
+}
+
+void
+BrassTermListTable::encode_termlist(string & tag,
+				    const Xapian::Document & doc,
+				    brass_doclen_t doclen)
+{
+    LOGCALL_STATIC_VOID(DB, "BrassTermListTable::encode_termlist", tag | doc | doclen);
+
+    tag.resize(0);
     pack_uint(tag, doclen);
 
     Xapian::doccount termlist_size = doc.termlist_count();
@@ -50,7 +62,8 @@ BrassTermListTable::set_termlist(Xapian::docid did,
 	// doclen is sum(wdf) so should be zero if there are no terms.
 	Assert(doclen == 0);
 	Assert(doc.termlist_begin() == doc.termlist_end());
-	add(make_key(did), string());
+	// An empty termlist is stored as an empty tag.
+	tag.resize(0);
 	return;
     }
 
@@ -105,5 +118,4 @@ BrassTermListTable::set_termlist(Xapian::docid did,
 	}
     }
     Assert(termlist_size == 0);
-    add(make_key(did), tag);
 }
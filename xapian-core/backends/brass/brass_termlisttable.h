@@ -63,6 +63,28 @@ class BrassTermListTable : public BrassLazyTable {
     void set_termlist(Xapian::docid did, const Xapian::Document & doc,
 		      brass_doclen_t doclen);
 
+    /** Set the termlist data for document @a did from an encoded tag.
+     *
+     *  @param did	The docid to set the termlist data for.
+     *  @param tag	The termlist data, as built by encode_termlist().
+     */
+    void set_encoded_termlist(Xapian::docid did, const std::string & tag) {
+	add(make_key(did), tag);
+    }
+
+    /** Encode the termlist data for a document.
+     *
+     *  This doesn't access the table, so can be called from any thread
+     *  (provided @a doc has its terms loaded and isn't being modified).
+     *
+     *  @param tag	Set to the encoded termlist data.
+     *  @param doc	The Xapian::Document object to read term data from.
+     *  @param doclen	The document length.
+     */
+    static void encode_termlist(std::string & tag,
+				const Xapian::Document & doc,
+				brass_doclen_t doclen);
+
     /** Delete the termlist data for document @a did.
      *
      *  @param did  The docid to delete the termlist data for.
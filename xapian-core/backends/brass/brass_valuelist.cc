@@ -162,6 +162,31 @@ BrassValueList::check(Xapian::docid did)
     return true;
 }
 
+void
+BrassValueList::next_in_range(const string & begin, const string * end)
+{
+    if (!cursor || reader.at_end()) {
+	// Either we haven't started yet or check() failed to find a docid, so
+	// let next() sort out where we are.
+	next();
+	if (!cursor || value_in_range(reader.get_value(), begin, end)) return;
+    }
+
+    while (true) {
+	// Scan the rest of the current chunk without copying each value.
+	reader.next_in_range(begin, end);
+	if (!reader.at_end()) return;
+
+	cursor->next();
+	if (cursor->after_end() || !update_reader()) break;
+	if (value_in_range(reader.get_value(), begin, end)) return;
+    }
+
+    // We've reached the end.
+    delete cursor;
+    cursor = NULL;
+}
+
 string
 BrassValueList::get_description() const
 {
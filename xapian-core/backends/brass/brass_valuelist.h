@@ -67,6 +67,8 @@ class BrassValueList : public Xapian::ValueIterator::Internal {
 
     bool check(Xapian::docid did);
 
+    void next_in_range(const std::string & begin, const std::string * end);
+
     std::string get_description() const;
 };
 
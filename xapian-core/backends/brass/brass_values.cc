@@ -28,6 +28,7 @@
 #include "brass_termlist.h"
 #include "debuglog.h"
 #include "backends/document.h"
+#include "internaltypes.h"
 #include "pack.h"
 
 #include "xapian/error.h"
@@ -129,6 +130,88 @@ ValueChunkReader::skip_to(Xapian::docid target)
     p = NULL;
 }
 
+/** Return the first 8 bytes of a value as a big-endian integer.
+ *
+ *  Shorter values are padded with zero bytes.  If key(a) < key(b) then
+ *  a < b as strings, so most comparisons of values can be made using these
+ *  keys, and we only need to compare the values themselves when the keys
+ *  are equal.  The output of sortable_serialise() is at most 9 bytes, and
+ *  for such values the keys order in the same way as the numbers encoded.
+ */
+static inline uint8
+value_key(const char * p, size_t len)
+{
+    uint8 key = 0;
+    for (size_t i = 0; i != 8; ++i) {
+	key <<= 8;
+	if (i < len) key |= static_cast<unsigned char>(p[i]);
+    }
+    return key;
+}
+
+/// The largest number of entries next_in_range() decodes at once.
+const size_t VALUE_BLOCK_SIZE = 64;
+
+void
+ValueChunkReader::next_in_range(const string & lo, const string * hi)
+{
+    if (p == NULL) return;
+
+    const uint8 lo_key = value_key(lo.data(), lo.size());
+    const uint8 hi_key = hi ? value_key(hi->data(), hi->size()) : ~uint8(0);
+
+    // Decode a block of entries into arrays, then test the keys of the whole
+    // block in a tight loop, and only copy the value of the entry we stop
+    // at.  The block size starts small and doubles each time, so that when
+    // many values are in the range we don't decode entries which we then
+    // throw away.
+    Xapian::docid dids[VALUE_BLOCK_SIZE];
+    uint8 keys[VALUE_BLOCK_SIZE];
+    const char * values[VALUE_BLOCK_SIZE];
+    size_t lens[VALUE_BLOCK_SIZE];
+    size_t block_size = 1;
+    while (p != end) {
+	size_t n = 0;
+	do {
+	    Xapian::docid delta;
+	    if (rare(!unpack_uint(&p, end, &delta)))
+		throw Xapian::DatabaseCorruptError("Failed to unpack streamed value docid");
+	    did += delta + 1;
+	    size_t value_len;
+	    if (rare(!unpack_uint(&p, end, &value_len))) {
+		throw Xapian::DatabaseCorruptError("Failed to unpack streamed value length");
+	    }
+	    if (rare(value_len > size_t(end - p))) {
+		throw Xapian::DatabaseCorruptError("Failed to unpack streamed value");
+	    }
+	    dids[n] = did;
+	    keys[n] = value_key(p, value_len);
+	    values[n] = p;
+	    lens[n] = value_len;
+	    p += value_len;
+	} while (++n != block_size && p != end);
+
+	for (size_t i = 0; i != n; ++i) {
+	    const uint8 key = keys[i];
+	    if (key < lo_key || key > hi_key) continue;
+	    if (key == lo_key &&
+		lo.compare(0, string::npos, values[i], lens[i]) > 0)
+		continue;
+	    if (hi && key == hi_key &&
+		hi->compare(0, string::npos, values[i], lens[i]) < 0)
+		continue;
+	    // Position ourselves on this entry.
+	    did = dids[i];
+	    value.assign(values[i], lens[i]);
+	    p = values[i] + lens[i];
+	    return;
+	}
+
+	if (block_size < VALUE_BLOCK_SIZE) block_size *= 2;
+    }
+    p = NULL;
+}
+
 void
 BrassValueManager::add_value(Xapian::docid did, Xapian::valueno slot,
 			     const string & val)
@@ -172,6 +172,12 @@ class BrassValueManager {
 	slots.clear();
 	changes.clear();
     }
+
+    /// Swap the batched-up changes with those in @a o.
+    void swap_changes(BrassValueManager & o) {
+	slots.swap(o.slots);
+	changes.swap(o.changes);
+    }
 };
 
 namespace Brass {
@@ -203,6 +209,13 @@ class ValueChunkReader {
     void next();
 
     void skip_to(Xapian::docid target);
+
+    /** Advance to the next entry in this chunk with a value in a range.
+     *
+     *  See ValueList::next_in_range() for the meaning of the parameters.
+     *  If there's no such entry in this chunk, we end up at_end().
+     */
+    void next_in_range(const std::string & lo, const std::string * hi);
 };
 
 }
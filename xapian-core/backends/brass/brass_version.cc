@@ -42,7 +42,8 @@
 using namespace std;
 
 // YYYYMMDDX where X allows multiple format revisions in a day
-#define BRASS_VERSION 201311060
+#define BRASS_VERSION 202610180
+// 202610180 1.3.2 Postlist chunk flags and max wdf, optional bit-packing
 // 201311060 1.3.2 Order position table by term first
 // 201103110 1.2.5 Bump for new max changesets dbstats
 // 200912150 1.1.4 Brass debuts.
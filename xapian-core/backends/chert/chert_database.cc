@@ -997,6 +997,18 @@ ChertDatabase::get_uuid() const
     RETURN(version_file.get_uuid_string());
 }
 
+string
+ChertDatabase::get_revision_key() const
+{
+    LOGCALL(DB, string, "ChertDatabase::get_revision_key", NO_ARGS);
+    // A writable database may have uncommitted changes which aren't
+    // reflected in the revision number.
+    if (!readonly) RETURN(string());
+    string key(version_file.get_uuid(), 16);
+    pack_uint(key, get_revision_number());
+    RETURN(key);
+}
+
 void
 ChertDatabase::throw_termlist_table_close_exception() const
 {
@@ -294,6 +294,7 @@ class ChertDatabase : public Xapian::Database::Internal {
 				    Xapian::ReplicationInfo * info);
 	string get_revision_info() const;
 	string get_uuid() const;
+	string get_revision_key() const;
 	//@}
 
 	XAPIAN_NORETURN(void throw_termlist_table_close_exception() const);
@@ -132,6 +132,9 @@ class ChertPositionList : public PositionList {
 
     /// True if we're off the end of the list
     bool at_end() const;
+
+    /// Decode all the positions in one go.
+    void append_positions(std::vector<Xapian::termpos> & positions);
 };
 
 #endif /* XAPIAN_HGUARD_CHERT_POSITIONLIST_H */
@@ -116,6 +116,22 @@ Database::Internal::commit()
     Assert(false);
 }
 
+void
+Database::Internal::commit_async()
+{
+    commit();
+}
+
+void
+Database::Internal::wait_for_commit()
+{
+}
+
+void
+Database::Internal::set_sync_window(double)
+{
+}
+
 void
 Database::Internal::cancel()
 {
@@ -176,6 +192,19 @@ Database::Internal::add_document(const Xapian::Document &)
     return 0;
 }
 
+Xapian::docid
+Database::Internal::add_documents(const vector<Xapian::Document> & documents,
+				  unsigned)
+{
+    Xapian::docid first_did = 0;
+    vector<Xapian::Document>::const_iterator i;
+    for (i = documents.begin(); i != documents.end(); ++i) {
+	Xapian::docid did = add_document(*i);
+	if (first_did == 0) first_did = did;
+    }
+    return first_did;
+}
+
 void
 Database::Internal::delete_document(Xapian::docid)
 {
@@ -360,12 +389,24 @@ Database::Internal::get_uuid() const
     return string();
 }
 
+string
+Database::Internal::get_revision_key() const
+{
+    return string();
+}
+
 void
 Database::Internal::invalidate_doc_object(Xapian::Document::Internal *) const
 {
     // Do nothing, by default.
 }
 
+Database::Internal *
+Database::Internal::open_snapshot(size_t) const
+{
+    return NULL;
+}
+
 RemoteDatabase *
 Database::Internal::as_remotedatabase()
 {
@@ -407,6 +407,30 @@ class Database::Internal : public Xapian::Internal::intrusive_base {
 	 */
 	virtual void commit();
 
+	/** Start committing pending modifications in the background.
+	 *
+	 *  See WritableDatabase::commit_async() for more information.
+	 *
+	 *  The default implementation calls commit().
+	 */
+	virtual void commit_async();
+
+	/** Wait for a commit started by commit_async() to finish.
+	 *
+	 *  See WritableDatabase::wait_for_commit() for more information.
+	 *
+	 *  The default implementation does nothing.
+	 */
+	virtual void wait_for_commit();
+
+	/** Set a window within which commits are deferred.
+	 *
+	 *  See WritableDatabase::set_sync_window() for more information.
+	 *
+	 *  The default implementation does nothing.
+	 */
+	virtual void set_sync_window(double seconds);
+
 	/** Cancel pending modifications to the database. */
 	virtual void cancel();
 
@@ -414,7 +438,7 @@ class Database::Internal : public Xapian::Internal::intrusive_base {
 	 *
 	 *  See WritableDatabase::begin_transaction() for more information.
 	 */
-	void begin_transaction(bool flushed);
+	virtual void begin_transaction(bool flushed);
 
 	/** Commit a transaction.
 	 *
@@ -434,6 +458,15 @@ class Database::Internal : public Xapian::Internal::intrusive_base {
 	 */
 	virtual Xapian::docid add_document(const Xapian::Document & document);
 
+	/** Add several new documents to the database.
+	 *
+	 *  See WritableDatabase::add_documents() for more information.  The
+	 *  default implementation calls add_document() for each document.
+	 */
+	virtual Xapian::docid add_documents(
+		const std::vector<Xapian::Document> & documents,
+		unsigned threads);
+
 	/** Delete a document in the database.
 	 *
 	 *  See WritableDatabase::delete_document() for more information.
@@ -500,6 +533,17 @@ class Database::Internal : public Xapian::Internal::intrusive_base {
 	 */
 	virtual string get_uuid() const;
 
+	/** Get a key identifying the contents of the database for caching.
+	 *
+	 *  The key must change whenever the documents visible to this object
+	 *  might change, so it's typically made from the UUID and the revision.
+	 *
+	 *  The default implementation returns the empty string, which means
+	 *  results from this database can't be cached (for example, because it
+	 *  is writable and so may have uncommitted changes).
+	 */
+	virtual string get_revision_key() const;
+
 	/** Notify the database that document is no longer valid.
 	 *
 	 *  This is used to invalidate references to a document kept by a
@@ -509,6 +553,23 @@ class Database::Internal : public Xapian::Internal::intrusive_base {
 	 */
 	virtual void invalidate_doc_object(Xapian::Document::Internal * obj) const;
 
+	/** Open another object reading the same revision of the database.
+	 *
+	 *  Database objects aren't safe to read from several threads at
+	 *  once, but each thread can read from its own snapshot.
+	 *
+	 *  @param n	Which snapshot to return.  Backends may keep snapshots
+	 *		and return the same one for the same @a n until the
+	 *		database moves to another revision, so a caller must
+	 *		use different values of @a n for snapshots it uses
+	 *		at the same time.
+	 *
+	 *  @return	The new object, or NULL if the backend doesn't support
+	 *		this (the default) or the revision can't be opened
+	 *		(e.g. because it has since been overwritten).
+	 */
+	virtual Internal * open_snapshot(size_t n) const;
+
 	//////////////////////////////////////////////////////////////////
 	// Introspection methods:
 	// ======================
@@ -66,7 +66,7 @@ InMemory::open() {
 #endif
 
 static void
-open_stub(Database &db, const string &file)
+open_stub(Database &db, const string &file, int flags)
 {
     // A stub database is a text file with one or more lines of this format:
     // <dbtype> <serialised db object>
@@ -95,7 +95,7 @@ open_stub(Database &db, const string &file)
 
 	if (type == "auto") {
 	    resolve_relative_path(line, file);
-	    db.add_database(Database(line));
+	    db.add_database(Database(line, flags));
 	    continue;
 	}
 
@@ -110,7 +110,8 @@ open_stub(Database &db, const string &file)
 #ifdef XAPIAN_HAS_BRASS_BACKEND
 	if (type == "brass") {
 	    resolve_relative_path(line, file);
-	    db.add_database(Database(new BrassDatabase(line)));
+	    db.add_database(Database(new BrassDatabase(line, DB_READONLY_, 0u,
+							 flags)));
 	    continue;
 	}
 #endif
@@ -279,6 +280,8 @@ Database::Database(const string &path, int flags)
     LOGCALL_CTOR(API, "Database", path|flags);
 
     int type = flags & DB_BACKEND_MASK_;
+    // Clear the backend bits, so we just pass on other flags to open_stub, etc.
+    flags &= ~DB_BACKEND_MASK_;
     switch (type) {
 	case DB_BACKEND_CHERT:
 #ifdef XAPIAN_HAS_CHERT_BACKEND
@@ -289,13 +292,13 @@ Database::Database(const string &path, int flags)
 #endif
 	case DB_BACKEND_BRASS:
 #ifdef XAPIAN_HAS_BRASS_BACKEND
-	    internal.push_back(new BrassDatabase(path));
+	    internal.push_back(new BrassDatabase(path, DB_READONLY_, 0u, flags));
 	    return;
 #else
 	    throw FeatureUnavailableError("Brass backend disabled");
 #endif
 	case DB_BACKEND_STUB:
-	    open_stub(*this, path);
+	    open_stub(*this, path, flags);
 	    return;
     }
 
@@ -306,7 +309,7 @@ Database::Database(const string &path, int flags)
 
     if (S_ISREG(statbuf.st_mode)) {
 	// The path is a file, so assume it is a stub database file.
-	open_stub(*this, path);
+	open_stub(*this, path, flags);
 	return;
     }
 
@@ -323,7 +326,7 @@ Database::Database(const string &path, int flags)
 
 #ifdef XAPIAN_HAS_BRASS_BACKEND
     if (file_exists(path + "/iambrass")) {
-	internal.push_back(new BrassDatabase(path));
+	internal.push_back(new BrassDatabase(path, DB_READONLY_, 0u, flags));
 	return;
     }
 #endif
@@ -332,7 +335,7 @@ Database::Database(const string &path, int flags)
     string stub_file = path;
     stub_file += "/XAPIANDB";
     if (usual(file_exists(stub_file))) {
-	open_stub(*this, stub_file);
+	open_stub(*this, stub_file, flags);
 	return;
     }
 
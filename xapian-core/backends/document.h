@@ -197,6 +197,11 @@ class Xapian::Document::Internal : public Xapian::Internal::intrusive_base {
 	 */
 	Xapian::docid get_docid() const { return did; }
 
+	/// Is this document from database @a db?
+	bool is_from(const Xapian::Database::Internal * db) const {
+	    return database.get() == db;
+	}
+
 	/// Return a string describing this object.
 	string get_description() const;
 
@@ -77,3 +77,12 @@ InMemoryPositionList::at_end() const
 {
     return(mypos == positions.end());
 }
+
+void
+InMemoryPositionList::append_positions(vector<Xapian::termpos> & positions_)
+{
+    Assert(!iterating_in_progress);
+    iterating_in_progress = true;
+    positions_.insert(positions_.end(), positions.begin(), positions.end());
+    mypos = positions.end();
+}
@@ -85,6 +85,9 @@ class InMemoryPositionList : public PositionList
 
 	/// True if we're off the end of the list
 	bool at_end() const;
+
+	/// Append all the positions to a vector.
+	void append_positions(vector<Xapian::termpos> & positions_);
 };
 
 #endif /* OM_HGUARD_INMEMORY_POSITIONLIST_H */
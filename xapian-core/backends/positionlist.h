@@ -28,6 +28,8 @@
 #include <xapian/error.h>
 #include <xapian/positioniterator.h>
 
+#include <vector>
+
 using namespace std;
 
 /** Abstract base class for position lists. */
@@ -73,6 +75,20 @@ class Xapian::PositionIterator::Internal : public Xapian::Internal::intrusive_ba
 	 */
 	virtual bool at_end() const = 0;
 
+	/** Append all the positions in the list to a vector.
+	 *
+	 *  This can be called instead of iterating with next() and
+	 *  skip_to(), but only before either has been called.  Afterwards,
+	 *  the list is at_end().  Subclasses should override this if they
+	 *  can do better than calling next() for each position.
+	 *
+	 *  @param positions	The vector to append the positions to.
+	 */
+	virtual void append_positions(std::vector<Xapian::termpos> & positions) {
+	    for (next(); !at_end(); next())
+		positions.push_back(get_position());
+	}
+
 	/** For use by PhrasePostList - ignored by PostingList itself.
 	 *  This isn't the most elegant place to put this, but it greatly
 	 *  eases the implementation of PhrasePostList which can't subclass
@@ -0,0 +1,307 @@
+/** @file postlistcache.cc
+ * @brief Cache of decoded posting lists for frequently used terms.
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include "postlistcache.h"
+
+#include "xapian/cache.h"
+
+#include "debuglog.h"
+#include "mutex.h"
+#include "str.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+using namespace std;
+
+/// How many times a term must be opened before its posting list is cached.
+static const unsigned MIN_USES = 3;
+
+/** The maximum number of uncached terms to count the uses of.
+ *
+ *  If this is reached, the counts are discarded and we start again, which
+ *  stops a stream of different terms using an unbounded amount of memory.
+ */
+static const size_t MAX_TRACKED_TERMS = 10000;
+
+/// Process-wide settings and statistics for DecodedPostListCache.
+class PostListCacheSettings {
+    /// Don't allow copying.
+    PostListCacheSettings(const PostListCacheSettings &);
+
+    /// Don't allow assignment.
+    void operator=(const PostListCacheSettings &);
+
+  public:
+    /// Maximum number of bytes to hold per database (0 means disabled).
+    size_t max_size;
+
+    /// Maximum termfreq of a posting list to cache (0 means no limit).
+    Xapian::doccount max_termfreq;
+
+    unsigned long hits;
+
+    unsigned long misses;
+
+    Mutex mutex;
+
+    /** Construct the settings.
+     *
+     *  The initial maximum size is taken from XAPIAN_POSTLIST_CACHE_SIZE in
+     *  the environment, if set.
+     */
+    PostListCacheSettings()
+	: max_size(0), max_termfreq(0), hits(0), misses(0)
+    {
+	const char *p = getenv("XAPIAN_POSTLIST_CACHE_SIZE");
+	if (p) {
+	    long v = atol(p);
+	    if (v > 0) max_size = size_t(v);
+	}
+    }
+};
+
+static PostListCacheSettings settings;
+
+Xapian::termcount
+CachedPostList::get_doclength() const
+{
+    return db->get_doclength(get_docid());
+}
+
+PositionList *
+CachedPostList::read_position_list()
+{
+    positions.reset(db->open_position_list(get_docid(), term));
+    return positions.get();
+}
+
+PositionList *
+CachedPostList::open_position_list() const
+{
+    return db->open_position_list(get_docid(), term);
+}
+
+PostList *
+CachedPostList::next(double)
+{
+    Assert(!at_end());
+    if (!started) {
+	started = true;
+    } else {
+	++i;
+    }
+    return NULL;
+}
+
+PostList *
+CachedPostList::skip_to(Xapian::docid did, double)
+{
+    started = true;
+    const vector<Xapian::docid> & dids = data->dids;
+    if (at_end() || did <= dids[i]) return NULL;
+    i = lower_bound(dids.begin() + i + 1, dids.end(), did) - dids.begin();
+    return NULL;
+}
+
+string
+CachedPostList::get_description() const
+{
+    string desc("CachedPostList(");
+    desc += term;
+    desc += ", termfreq=";
+    desc += str(get_termfreq());
+    desc += ')';
+    return desc;
+}
+
+bool
+DecodedPostListCache::enabled()
+{
+    MutexLock lock(settings.mutex);
+    return settings.max_size != 0;
+}
+
+void
+DecodedPostListCache::evict(size_t limit)
+{
+    while (size > limit) {
+	Assert(!lru.empty());
+	Entry & e = lru.back();
+	size -= e.data->get_size() + e.term.size();
+	index.erase(e.term);
+	lru.pop_back();
+    }
+}
+
+LeafPostList *
+DecodedPostListCache::open_post_list(const Xapian::Database::Internal * db,
+				     const string & term,
+				     uint4 revision_)
+{
+    LOGCALL(DB, LeafPostList *, "DecodedPostListCache::open_post_list", db | term | revision_);
+    if (revision_ != revision) {
+	clear();
+	revision = revision_;
+    }
+
+    size_t max_size;
+    {
+	MutexLock lock(settings.mutex);
+	max_size = settings.max_size;
+	// The limit may have been reduced since we last looked.
+	evict(max_size);
+	index_type::iterator i = index.find(term);
+	if (i != index.end()) {
+	    ++settings.hits;
+	    // Move to the front of the LRU list.
+	    lru.splice(lru.begin(), lru, i->second);
+	    RETURN(new CachedPostList(db, term, i->second->data.get()));
+	}
+	++settings.misses;
+    }
+
+    if (max_size) {
+	if (uses.size() >= MAX_TRACKED_TERMS && uses.find(term) == uses.end())
+	    uses.clear();
+	++uses[term];
+    }
+    RETURN(NULL);
+}
+
+LeafPostList *
+DecodedPostListCache::add(const Xapian::Database::Internal * db,
+			  const string & term,
+			  LeafPostList * pl)
+{
+    LOGCALL(DB, LeafPostList *, "DecodedPostListCache::add", db | term | pl);
+    map<string, unsigned>::iterator u = uses.find(term);
+    if (u == uses.end() || u->second < MIN_USES) RETURN(pl);
+
+    size_t max_size;
+    Xapian::doccount max_termfreq;
+    {
+	MutexLock lock(settings.mutex);
+	max_size = settings.max_size;
+	max_termfreq = settings.max_termfreq;
+    }
+
+    Xapian::doccount termfreq = pl->get_termfreq();
+    // Don't cache a term which doesn't exist - there's nothing to save, and
+    // a CachedPostList must have at least one entry.
+    if (termfreq == 0) RETURN(pl);
+    if (max_termfreq && termfreq > max_termfreq) RETURN(pl);
+    size_t entry_size = sizeof(DecodedPostList) + term.size() +
+	termfreq * (sizeof(Xapian::docid) + sizeof(Xapian::termcount));
+    if (entry_size > max_size) RETURN(pl);
+
+    uses.erase(u);
+
+    AutoPtr<LeafPostList> old_pl(pl);
+    Xapian::Internal::intrusive_ptr<DecodedPostList> data(new DecodedPostList);
+    data->dids.reserve(termfreq);
+    data->wdfs.reserve(termfreq);
+    while (true) {
+	(void)pl->next(0.0);
+	if (pl->at_end()) break;
+	data->dids.push_back(pl->get_docid());
+	data->wdfs.push_back(pl->get_wdf());
+    }
+    LOGLINE(DB, "Caching posting list for " << term << " with " <<
+		data->dids.size() << " entries");
+
+    evict(max_size - entry_size);
+    lru.push_front(Entry(term, data.get()));
+    index.insert(make_pair(term, lru.begin()));
+    size += data->get_size() + term.size();
+    RETURN(new CachedPostList(db, term, data.get()));
+}
+
+void
+DecodedPostListCache::clear()
+{
+    evict(0);
+    uses.clear();
+}
+
+namespace Xapian {
+
+namespace PostListCache {
+
+void
+set_max_size(size_t max_size)
+{
+    LOGCALL_STATIC_VOID(API, "Xapian::PostListCache::set_max_size", max_size);
+    MutexLock lock(settings.mutex);
+    settings.max_size = max_size;
+}
+
+size_t
+get_max_size()
+{
+    LOGCALL_STATIC(API, size_t, "Xapian::PostListCache::get_max_size", NO_ARGS);
+    MutexLock lock(settings.mutex);
+    RETURN(settings.max_size);
+}
+
+void
+set_max_termfreq(Xapian::doccount max_termfreq)
+{
+    LOGCALL_STATIC_VOID(API, "Xapian::PostListCache::set_max_termfreq", max_termfreq);
+    MutexLock lock(settings.mutex);
+    settings.max_termfreq = max_termfreq;
+}
+
+Xapian::doccount
+get_max_termfreq()
+{
+    LOGCALL_STATIC(API, Xapian::doccount, "Xapian::PostListCache::get_max_termfreq", NO_ARGS);
+    MutexLock lock(settings.mutex);
+    RETURN(settings.max_termfreq);
+}
+
+unsigned long
+get_hits()
+{
+    LOGCALL_STATIC(API, unsigned long, "Xapian::PostListCache::get_hits", NO_ARGS);
+    MutexLock lock(settings.mutex);
+    RETURN(settings.hits);
+}
+
+unsigned long
+get_misses()
+{
+    LOGCALL_STATIC(API, unsigned long, "Xapian::PostListCache::get_misses", NO_ARGS);
+    MutexLock lock(settings.mutex);
+    RETURN(settings.misses);
+}
+
+void
+reset_stats()
+{
+    LOGCALL_STATIC_VOID(API, "Xapian::PostListCache::reset_stats", NO_ARGS);
+    MutexLock lock(settings.mutex);
+    settings.hits = settings.misses = 0;
+}
+
+}
+
+}
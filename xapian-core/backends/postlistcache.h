@@ -0,0 +1,202 @@
+/** @file postlistcache.h
+ * @brief Cache of decoded posting lists for frequently used terms.
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#ifndef XAPIAN_INCLUDED_POSTLISTCACHE_H
+#define XAPIAN_INCLUDED_POSTLISTCACHE_H
+
+#include <cstddef>
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "api/leafpostlist.h"
+#include "autoptr.h"
+#include "database.h"
+#include "internaltypes.h"
+#include "omassert.h"
+
+/// The decoded entries of a posting list.
+class DecodedPostList : public Xapian::Internal::intrusive_base {
+    /// Don't allow assignment.
+    void operator=(const DecodedPostList &);
+
+    /// Don't allow copying.
+    DecodedPostList(const DecodedPostList &);
+
+  public:
+    DecodedPostList() { }
+
+    std::vector<Xapian::docid> dids;
+
+    std::vector<Xapian::termcount> wdfs;
+
+    /// Return the approximate number of bytes used.
+    size_t get_size() const {
+	return sizeof(*this) +
+	       dids.size() * (sizeof(Xapian::docid) + sizeof(Xapian::termcount));
+    }
+};
+
+/// A PostList iterating over a DecodedPostList.
+class CachedPostList : public LeafPostList {
+    /// Don't allow assignment.
+    void operator=(const CachedPostList &);
+
+    /// Don't allow copying.
+    CachedPostList(const CachedPostList &);
+
+    /// The database, for document lengths and positions.
+    Xapian::Internal::intrusive_ptr<const Xapian::Database::Internal> db;
+
+    /// The entries, shared with the cache (and other postlists).
+    Xapian::Internal::intrusive_ptr<const DecodedPostList> data;
+
+    /// Index of the current entry in data (or data->dids.size() at the end).
+    size_t i;
+
+    /// Whether we've started reading the list yet.
+    bool started;
+
+    /// The position list returned by read_position_list().
+    AutoPtr<PositionList> positions;
+
+  public:
+    CachedPostList(Xapian::Internal::intrusive_ptr<const Xapian::Database::Internal> db_,
+		   const std::string & term_,
+		   const DecodedPostList * data_)
+	: LeafPostList(term_), db(db_), data(data_), i(0), started(false) { }
+
+    Xapian::doccount get_termfreq() const { return data->dids.size(); }
+
+    Xapian::docid get_docid() const {
+	Assert(started);
+	return data->dids[i];
+    }
+
+    Xapian::termcount get_doclength() const;
+
+    Xapian::termcount get_wdf() const {
+	Assert(started);
+	return data->wdfs[i];
+    }
+
+    PositionList * read_position_list();
+
+    PositionList * open_position_list() const;
+
+    PostList * next(double w_min);
+
+    PostList * skip_to(Xapian::docid did, double w_min);
+
+    bool at_end() const { return i == data->dids.size(); }
+
+    std::string get_description() const;
+};
+
+/** A size-bounded LRU cache of decoded posting lists for one database.
+ *
+ *  Terms are only cached once they've been opened a few times, so that
+ *  terms used in a single query don't push out the frequently used ones.
+ *  The whole cache is discarded when the database's revision changes.
+ *
+ *  The size limits are process-wide, and set via Xapian::PostListCache.
+ *  Like the database object which owns it, a DecodedPostListCache isn't
+ *  safe to use from more than one thread at once.
+ */
+class DecodedPostListCache {
+    /// Don't allow copying.
+    DecodedPostListCache(const DecodedPostListCache &);
+
+    /// Don't allow assignment.
+    void operator=(const DecodedPostListCache &);
+
+    struct Entry {
+	std::string term;
+
+	Xapian::Internal::intrusive_ptr<const DecodedPostList> data;
+
+	Entry(const std::string & term_, const DecodedPostList * data_)
+	    : term(term_), data(data_) { }
+    };
+
+    /// Cached posting lists, most recently used first.
+    std::list<Entry> lru;
+
+    typedef std::map<std::string, std::list<Entry>::iterator> index_type;
+
+    /// Map from term to position in @a lru.
+    index_type index;
+
+    /// How many times terms which aren't cached have been opened.
+    std::map<std::string, unsigned> uses;
+
+    /// Approximate number of bytes currently held.
+    size_t size;
+
+    /// The revision the cached posting lists are from.
+    uint4 revision;
+
+    /// Discard least recently used posting lists until size <= @a limit.
+    void evict(size_t limit);
+
+  public:
+    DecodedPostListCache() : size(0), revision(0) { }
+
+    /** Is caching of posting lists enabled?
+     *
+     *  Caching may be disabled by another thread before open_post_list()
+     *  or add() is called, but they handle that.
+     */
+    static bool enabled();
+
+    /** Open a cached posting list.
+     *
+     *  @param db		The database which owns this cache.
+     *  @param term		The term to open the posting list of.
+     *  @param revision_	The revision @a db is open at.
+     *
+     *  @return	A CachedPostList, or NULL if @a term isn't cached.
+     */
+    LeafPostList * open_post_list(const Xapian::Database::Internal * db,
+				  const std::string & term,
+				  uint4 revision_);
+
+    /** Consider adding a posting list to the cache.
+     *
+     *  Should be called after open_post_list() returns NULL.  If @a term
+     *  has been used often enough and its posting list is small enough, it
+     *  is decoded from @a pl into the cache.
+     *
+     *  @param db	The database which owns this cache.
+     *  @param term	The term @a pl is the posting list of.
+     *  @param pl	A newly opened posting list for @a term.
+     *
+     *  @return	@a pl, or a CachedPostList which replaces it (in which case
+     *		@a pl has been deleted).
+     */
+    LeafPostList * add(const Xapian::Database::Internal * db,
+		       const std::string & term,
+		       LeafPostList * pl);
+
+    /// Discard all cached posting lists.
+    void clear();
+};
+
+#endif // XAPIAN_INCLUDED_POSTLISTCACHE_H
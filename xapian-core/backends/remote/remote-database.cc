@@ -42,6 +42,8 @@
 #include "stringutils.h" // For STRINGIZE().
 #include "weight/weightinternal.h"
 
+#include <algorithm>
+#include <map>
 #include <string>
 #include <vector>
 
@@ -273,6 +275,7 @@ bool
 RemoteDatabase::reopen()
 {
     mru_slot = Xapian::BAD_VALUENO;
+    fetched_docs.clear();
     return update_stats(MSG_REOPEN);
 }
 
@@ -313,6 +316,75 @@ RemoteDatabase::open_document(Xapian::docid did, bool /*lazy*/) const
     return new RemoteDocument(this, did, doc_data, values);
 }
 
+void
+RemoteDatabase::request_document(Xapian::docid did) const
+{
+    Assert(did);
+    // Drop any copy from an earlier batch so we don't return stale data.
+    fetched_docs.erase(did);
+    pending_docs.push_back(did);
+}
+
+void
+RemoteDatabase::fetch_pending_docs(Xapian::docid did) const
+{
+    vector<Xapian::docid> docs;
+    swap(docs, pending_docs);
+
+    string message;
+    vector<Xapian::docid>::const_iterator i;
+    for (i = docs.begin(); i != docs.end(); ++i) {
+	message += encode_length(*i);
+    }
+    send_message(MSG_DOCUMENTS, message);
+
+    try {
+	for (i = docs.begin(); i != docs.end(); ++i) {
+	    get_message(message, REPLY_DOCUMENT);
+	    swap(fetched_docs[*i], message);
+	}
+    } catch (const Xapian::NetworkError &) {
+	throw;
+    } catch (const Xapian::Error &) {
+	// The server stops at the first document it fails to read and sends
+	// the exception in its place, so the connection is still in step.
+	// Documents after that one get fetched individually when collected,
+	// which will report any error for them then.
+	if (*i == did) throw;
+	return;
+    }
+    get_message(message, REPLY_DONE);
+}
+
+Xapian::Document::Internal *
+RemoteDatabase::collect_document(Xapian::docid did) const
+{
+    map<Xapian::docid, string>::iterator i = fetched_docs.find(did);
+    if (i == fetched_docs.end()) {
+	if (!pending_docs.empty()) {
+	    fetch_pending_docs(did);
+	    i = fetched_docs.find(did);
+	}
+	if (i == fetched_docs.end()) return open_document(did, true);
+    }
+
+    const char * p = i->second.data();
+    const char * p_end = p + i->second.size();
+    size_t len = decode_length(&p, p_end, true);
+    string doc_data(p, len);
+    p += len;
+    map<Xapian::valueno, string> values;
+    while (p != p_end) {
+	Xapian::valueno slot = decode_length(&p, p_end, false);
+	len = decode_length(&p, p_end, true);
+	values.insert(make_pair(slot, string(p, len)));
+	p += len;
+    }
+    fetched_docs.erase(i);
+
+    return new RemoteDocument(this, did, doc_data, values);
+}
+
 bool
 RemoteDatabase::update_stats(message_type msg_code) const
 {
@@ -357,6 +429,13 @@ RemoteDatabase::update_stats(message_type msg_code) const
     }
     has_positional_info = (*p++ == '1');
     total_length = decode_length(&p, p_end, false);
+    size_t compress_min = decode_length(&p, p_end, false);
+    if (msg_code == MSG_MAX && compress_min) {
+	// The server offers to compress large messages, so accept and do the
+	// same for messages we send.
+	send_message(MSG_COMPRESS, encode_length(compress_min));
+	link.set_compress_min(compress_min);
+    }
     uuid.assign(p, p_end);
     cached_stats_valid = true;
     return true;
@@ -558,6 +637,8 @@ RemoteDatabase::set_query(const Xapian::Query& query,
 			 Xapian::termcount qlen,
 			 Xapian::doccount collapse_max,
 			 Xapian::valueno collapse_key,
+			 Xapian::doccount collapse_limit,
+			 bool collapse_approximate,
 			 Xapian::Enquire::docid_order order,
 			 Xapian::valueno sort_key,
 			 Xapian::Enquire::Internal::sort_setting sort_by,
@@ -575,7 +656,11 @@ RemoteDatabase::set_query(const Xapian::Query& query,
     // Serialise assorted Enquire settings.
     message += encode_length(qlen);
     message += encode_length(collapse_max);
-    if (collapse_max) message += encode_length(collapse_key);
+    if (collapse_max) {
+	message += encode_length(collapse_key);
+	message += encode_length(collapse_limit);
+	message += char('0' + collapse_approximate);
+    }
     message += char('0' + order);
     message += encode_length(sort_key);
     message += char('0' + sort_by);
@@ -662,6 +747,8 @@ RemoteDatabase::get_mset(Xapian::MSet &mset,
 void
 RemoteDatabase::commit()
 {
+    fetched_docs.clear();
+
     send_message(MSG_COMMIT, string());
 
     // We need to wait for a response to ensure documents have been committed.
@@ -674,6 +761,7 @@ RemoteDatabase::cancel()
 {
     cached_stats_valid = false;
     mru_slot = Xapian::BAD_VALUENO;
+    fetched_docs.clear();
 
     send_message(MSG_CANCEL, string());
 }
@@ -699,6 +787,7 @@ RemoteDatabase::delete_document(Xapian::docid did)
 {
     cached_stats_valid = false;
     mru_slot = Xapian::BAD_VALUENO;
+    fetched_docs.clear();
 
     send_message(MSG_DELETEDOCUMENT, encode_length(did));
     string dummy;
@@ -710,6 +799,7 @@ RemoteDatabase::delete_document(const std::string & unique_term)
 {
     cached_stats_valid = false;
     mru_slot = Xapian::BAD_VALUENO;
+    fetched_docs.clear();
 
     send_message(MSG_DELETEDOCUMENTTERM, unique_term);
 }
@@ -720,6 +810,7 @@ RemoteDatabase::replace_document(Xapian::docid did,
 {
     cached_stats_valid = false;
     mru_slot = Xapian::BAD_VALUENO;
+    fetched_docs.clear();
 
     string message = encode_length(did);
     message += serialise_document(doc);
@@ -733,6 +824,7 @@ RemoteDatabase::replace_document(const std::string & unique_term,
 {
     cached_stats_valid = false;
     mru_slot = Xapian::BAD_VALUENO;
+    fetched_docs.clear();
 
     string message = encode_length(unique_term.size());
     message += unique_term;
@@ -29,6 +29,10 @@
 #include "backends/valuestats.h"
 #include "xapian/weight.h"
 
+#include <map>
+#include <string>
+#include <vector>
+
 namespace Xapian {
     class RSet;
 }
@@ -86,6 +90,24 @@ class RemoteDatabase : public Xapian::Database::Internal {
      */
     mutable Xapian::valueno mru_slot;
 
+    /** Documents passed to request_document() which we haven't fetched yet.
+     *
+     *  These are all fetched with a single MSG_DOCUMENTS message when the
+     *  first of them is collected.
+     */
+    mutable std::vector<Xapian::docid> pending_docs;
+
+    /** Documents fetched by MSG_DOCUMENTS but not yet collected.
+     *
+     *  Maps each docid to the contents of its REPLY_DOCUMENT message.  This
+     *  is cleared by reopen() and by any modification, so a document can't
+     *  be returned as it was before a change made through this object.
+     */
+    mutable std::map<Xapian::docid, std::string> fetched_docs;
+
+    /// Fetch all the documents in pending_docs into fetched_docs.
+    void fetch_pending_docs(Xapian::docid did) const;
+
     bool update_stats(message_type msg_code = MSG_UPDATE) const;
 
   protected:
@@ -134,6 +156,10 @@ class RemoteDatabase : public Xapian::Database::Internal {
      *					to leave after collapsing (0 for don't
      *					collapse).
      * @param collapse_key		The value number to collapse matches on.
+     * @param collapse_limit		Number of collapse key values to track
+     *					(0 for no limit).
+     * @param collapse_approximate	Only track the hash of each collapse
+     *					key value?
      * @param order			Sort order for docids.
      * @param sort_key			The value number to sort on.
      * @param sort_by			Which order to apply sorts in.
@@ -150,6 +176,8 @@ class RemoteDatabase : public Xapian::Database::Internal {
 		   Xapian::termcount qlen,
 		   Xapian::doccount collapse_max,
 		   Xapian::valueno collapse_key,
+		   Xapian::doccount collapse_limit,
+		   bool collapse_approximate,
 		   Xapian::Enquire::docid_order order,
 		   Xapian::valueno sort_key,
 		   Xapian::Enquire::Internal::sort_setting sort_by,
@@ -201,6 +229,12 @@ class RemoteDatabase : public Xapian::Database::Internal {
     /// Get a remote document.
     Xapian::Document::Internal * open_document(Xapian::docid did, bool lazy) const;
 
+    /// Queue a document to be fetched by the next collect_document() call.
+    void request_document(Xapian::docid did) const;
+
+    /// Get a document, fetching any requested ones in the same round trip.
+    Xapian::Document::Internal * collect_document(Xapian::docid did) const;
+
     /// Get the document count.
     Xapian::doccount get_doccount() const;
 
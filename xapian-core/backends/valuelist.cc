@@ -33,4 +33,13 @@ ValueIterator::Internal::check(Xapian::docid did)
     return true;
 }
 
+void
+ValueIterator::Internal::next_in_range(const std::string & begin,
+				       const std::string * end)
+{
+    do {
+	next();
+    } while (!at_end() && !value_in_range(get_value(), begin, end));
+}
+
 }
@@ -92,10 +92,30 @@ class Xapian::ValueIterator::Internal : public Xapian::Internal::intrusive_base
      */
     virtual bool check(Xapian::docid did);
 
+    /** Advance to the next entry with a value in a range.
+     *
+     *  This acts like calling next() until at_end() or the value at the
+     *  current position is >= @a begin and (if @a end is non-NULL)
+     *  <= *@a end, but backends can override it to test values more
+     *  efficiently (e.g. without copying each one).
+     *
+     *  The default implementation simply calls next() and get_value().
+     */
+    virtual void next_in_range(const std::string & begin,
+			       const std::string * end);
+
     /// Return a string description of this object.
     virtual std::string get_description() const = 0;
 };
 
+/// Test if a value lies in a range, as passed to next_in_range().
+inline bool
+value_in_range(const std::string & v,
+	       const std::string & begin, const std::string * end)
+{
+    return v >= begin && (!end || v <= *end);
+}
+
 // In the external API headers, this class is Xapian::ValueIterator::Internal,
 // but in the library code it's known as "ValueList" in most places.
 typedef Xapian::ValueIterator::Internal ValueList;
@@ -25,6 +25,7 @@
 #include <xapian.h>
 
 #include <cstdlib>
+#include "safeerrno.h"
 #include <iostream>
 
 #include "gnu_getopt.h"
@@ -37,6 +38,11 @@ using namespace std;
 #define OPT_HELP 1
 #define OPT_VERSION 2
 #define OPT_NO_RENUMBER 3
+#define OPT_PACK_POSTLISTS 4
+#define OPT_THREADS 5
+
+/// Upper limit on the value accepted for --threads.
+#define MAX_THREADS 1024
 
 static void show_usage() {
     cout << "Usage: "PROG_NAME" [OPTIONS] SOURCE_DATABASE... DESTINATION_DATABASE\n\n"
@@ -54,6 +60,10 @@ static void show_usage() {
 "                    unique ids from an external source).  Currently this\n"
 "                    option is only supported when merging databases if they\n"
 "                    have disjoint ranges of used document ids\n"
+"      --pack-postlists  Write posting lists in a bit-packed encoding which\n"
+"                    is faster to decode (currently only for brass)\n"
+"      --threads=N   Use up to N threads, building the tables of the output\n"
+"                    at the same time (currently only for brass)\n"
 "  --help            display this help and exit\n"
 "  --version         output version information and exit" << endl;
 }
@@ -61,11 +71,15 @@ static void show_usage() {
 class MyCompactor : public Xapian::Compactor {
     bool quiet;
 
+    bool concurrent;
+
   public:
-    MyCompactor() : quiet(false) { }
+    MyCompactor() : quiet(false), concurrent(false) { }
 
     void set_quiet(bool quiet_) { quiet = quiet_; }
 
+    void set_concurrent(bool concurrent_) { concurrent = concurrent_; }
+
     void set_status(const string & table, const string & status);
 
     string
@@ -81,7 +95,7 @@ MyCompactor::set_status(const string & table, const string & status)
 	return;
     if (!status.empty())
 	cout << '\r' << table << ": " << status << endl;
-    else
+    else if (!concurrent)
 	cout << table << " ..." << flush;
 }
 
@@ -110,6 +124,8 @@ main(int argc, char **argv)
 	{"multipass",	no_argument, 0, 'm'},
 	{"blocksize",	required_argument, 0, 'b'},
 	{"no-renumber", no_argument, 0, OPT_NO_RENUMBER},
+	{"pack-postlists", no_argument, 0, OPT_PACK_POSTLISTS},
+	{"threads",	required_argument, 0, OPT_THREADS},
 	{"quiet",	no_argument, 0, 'q'},
 	{"help",	no_argument, 0, OPT_HELP},
 	{"version",	no_argument, 0, OPT_VERSION},
@@ -150,6 +166,26 @@ main(int argc, char **argv)
 	    case OPT_NO_RENUMBER:
 		compactor.set_renumber(false);
 		break;
+	    case OPT_PACK_POSTLISTS:
+		compactor.set_pack_postlists(true);
+		break;
+	    case OPT_THREADS: {
+		char *p;
+		errno = 0;
+		unsigned long threads = strtoul(optarg, &p, 10);
+		if (p == optarg || *p || *optarg == '-' || errno == ERANGE ||
+		    threads == 0 || threads > MAX_THREADS) {
+		    cerr << PROG_NAME": Bad value '" << optarg
+			 << "' passed for threads, must be between 1 and "
+			 << MAX_THREADS << endl;
+		    exit(1);
+		}
+		compactor.set_threads(threads);
+		// Several tables may be in progress at once, so the
+		// "table ..." lines would be jumbled up.
+		compactor.set_concurrent(threads > 1);
+		break;
+	    }
 	    case 'q':
 		compactor.set_quiet(true);
 		break;
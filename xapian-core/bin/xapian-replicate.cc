@@ -45,6 +45,27 @@ using namespace std;
 // Number of seconds before we assume that a reader will be closed.
 #define READER_CLOSE_TIME 30
 
+static enum { NORMAL, VERBOSE, QUIET } verbosity = NORMAL;
+
+static void report_update(const Xapian::ReplicationInfo & info) {
+    if (verbosity == VERBOSE) {
+	cout << "Update complete: "
+	     << info.fullcopy_count << " copies, "
+	     << info.changeset_count << " changesets, "
+	     << (info.changed ? "new live database"
+			      : "no changes to live database")
+	     <<	endl;
+    }
+    if (verbosity != QUIET) {
+	if (info.fullcopy_count > 0 && !info.changed) {
+	    cout <<
+"Replication using a full copy failed.  This usually means that the master\n"
+"database is changing too frequently.  Ensure that sufficient changesets are\n"
+"present by setting XAPIAN_MAX_CHANGESETS on the master." << endl;
+	}
+    }
+}
+
 static void show_usage() {
     cout << "Usage: "PROG_NAME" [OPTIONS] DATABASE\n\n"
 "Options:\n"
@@ -58,6 +79,10 @@ static void show_usage() {
 "  -f, --force-copy    force a full copy of the database to be sent (and then\n"
 "                      replicate as normal)\n"
 "  -o, --one-shot      replicate only once and then exit\n"
+"  -s, --stream        keep the connection to the master open, and apply\n"
+"                      changes as soon as they are committed (if the\n"
+"                      connection is lost, reconnect after the interval; if\n"
+"                      the master is too old to support this, poll instead)\n"
 "  -q, --quiet         only report errors\n"
 "  -v, --verbose       be more verbose\n"
 "  --help              display this help and exit\n"
@@ -67,7 +92,7 @@ static void show_usage() {
 int
 main(int argc, char **argv)
 {
-    const char * opts = "h:p:m:i:r:ofqv";
+    const char * opts = "h:p:m:i:r:osfqv";
     const struct option long_opts[] = {
 	{"host",	required_argument,	0, 'h'},
 	{"port",	required_argument,	0, 'p'},
@@ -75,6 +100,7 @@ main(int argc, char **argv)
 	{"interval",	required_argument,	0, 'i'},
 	{"reader-time",	required_argument,	0, 'r'},
 	{"one-shot",	no_argument,		0, 'o'},
+	{"stream",	no_argument,		0, 's'},
 	{"force-copy",	no_argument,		0, 'f'},
 	{"quiet",	no_argument,		0, 'q'},
 	{"verbose",	no_argument,		0, 'v'},
@@ -88,7 +114,7 @@ main(int argc, char **argv)
     string masterdb;
     int interval = DEFAULT_INTERVAL;
     bool one_shot = false;
-    enum { NORMAL, VERBOSE, QUIET } verbosity = NORMAL;
+    bool stream = false;
     bool force_copy = false;
     int reader_close_time = READER_CLOSE_TIME;
 
@@ -116,6 +142,9 @@ main(int argc, char **argv)
 	    case 'o':
 		one_shot = true;
 		break;
+	    case 's':
+		stream = true;
+		break;
 	    case 'q':
 		verbosity = QUIET;
 		break;
@@ -169,25 +198,35 @@ main(int argc, char **argv)
 		     << masterdb << endl;
 	    }
 	    Xapian::ReplicationInfo info;
-	    client.update_from_master(dbpath, masterdb, info,
-				      reader_close_time, force_copy);
-	    if (verbosity == VERBOSE) {
-		cout << "Update complete: "
-		     << info.fullcopy_count << " copies, "
-		     << info.changeset_count << " changesets, "
-		     << (info.changed ? "new live database"
-				      : "no changes to live database")
-		     <<	endl;
-	    }
-	    if (verbosity != QUIET) {
-		if (info.fullcopy_count > 0 && !info.changed) {
-		    cout <<
-"Replication using a full copy failed.  This usually means that the master\n"
-"database is changing too frequently.  Ensure that sufficient changesets are\n"
-"present by setting XAPIAN_MAX_CHANGESETS on the master." << endl;
+	    if (stream && !one_shot) {
+		// Resume from the replica's current revision, and apply
+		// changes as the master pushes them until the connection is
+		// lost.
+		client.start_streaming(dbpath, masterdb, force_copy);
+		try {
+		    client.wait_for_update(dbpath, info, reader_close_time);
+		} catch (const Xapian::FeatureUnavailableError &) {
+		    // The master predates streaming, so poll it instead
+		    // (starting straight away).
+		    if (verbosity != QUIET) {
+			cout << "Master doesn't support streaming, so polling "
+				"every " << interval << " seconds instead" << endl;
+		    }
+		    stream = false;
+		    continue;
+		}
+		force_copy = false;
+		report_update(info);
+		while (true) {
+		    client.wait_for_update(dbpath, info, reader_close_time);
+		    report_update(info);
 		}
+	    } else {
+		client.update_from_master(dbpath, masterdb, info,
+					  reader_close_time, force_copy);
+		report_update(info);
+		force_copy = false;
 	    }
-	    force_copy = false;
 	} catch (const Xapian::NetworkError &error) {
 	    // Don't stop running if there's a network error - just log to
 	    // stderr and retry at next timeout.  This should make the client
@@ -54,6 +54,10 @@ const int MSECS_ACTIVE_TIMEOUT_DEFAULT = 15000;
 
 #define OPT_HELP 1
 #define OPT_VERSION 2
+#define OPT_THREADS 3
+
+/// Upper limit on the value accepted for --threads.
+#define MAX_THREADS 1024
 
 static const char * opts = "I:p:a:i:t:oqw";
 static const struct option long_opts[] = {
@@ -65,6 +69,7 @@ static const struct option long_opts[] = {
     {"one-shot",	no_argument,		0, 'o'},
     {"quiet",		no_argument,		0, 'q'},
     {"writable",	no_argument,		0, 'w'},
+    {"threads",		required_argument,	0, OPT_THREADS},
     {"help",		no_argument,		0, OPT_HELP},
     {"version",		no_argument,		0, OPT_VERSION},
     {NULL, 0, 0, 0}
@@ -82,6 +87,9 @@ static void show_usage() {
 "  --one-shot              serve a single connection and exit\n"
 "  --quiet                 disable information messages to stdout\n"
 "  --writable              allow updates (only one database directory allowed)\n"
+"  --threads N             handle up to N connections at once with a pool of\n"
+"                          threads which reuse open databases, rather than\n"
+"                          forking a process for each connection\n"
 "  --help                  display this help and exit\n"
 "  --version               output version information and exit" << endl;
 }
@@ -95,6 +103,7 @@ int main(int argc, char **argv) {
     bool one_shot = false;
     bool verbose = true;
     bool writable = false;
+    unsigned threads = 0;
     bool syntax_error = false;
 
     int c;
@@ -131,6 +140,20 @@ int main(int argc, char **argv) {
 	    case 'w':
 		writable = true;
 		break;
+	    case OPT_THREADS: {
+		char * end;
+		errno = 0;
+		unsigned long n = strtoul(optarg, &end, 10);
+		if (optarg == end || *end || *optarg == '-' ||
+		    errno == ERANGE || n == 0 || n > MAX_THREADS) {
+		    cerr << PROG_NAME": --threads must be an integer between 1 "
+			    "and " << MAX_THREADS << ", got '" << optarg << "'"
+			 << endl;
+		    exit(1);
+		}
+		threads = unsigned(n);
+		break;
+	    }
 	    default:
 		syntax_error = true;
 	}
@@ -186,6 +209,8 @@ int main(int argc, char **argv) {
 
 	if (one_shot) {
 	    server.run_once();
+	} else if (threads) {
+	    server.run_threads(threads);
 	} else {
 	    server.run();
 	}
@@ -1,6 +1,7 @@
 noinst_HEADERS +=\
 	common/append_filename_arg.h\
 	common/autoptr.h\
+	common/bitpack.h\
 	common/bitstream.h\
 	common/closefrom.h\
 	common/compression_stream.h\
@@ -14,6 +15,7 @@ noinst_HEADERS +=\
 	common/keyword.h\
 	common/log2.h\
 	common/msvc_dirent.h\
+	common/mutex.h\
 	common/noreturn.h\
 	common/omassert.h\
 	common/output.h\
@@ -42,6 +44,7 @@ noinst_HEADERS +=\
 	common/str.h\
 	common/stringutils.h\
 	common/submatch.h\
+	common/thread.h\
 	common/unaligned.h
 
 EXTRA_DIST +=\
@@ -52,6 +55,7 @@ EXTRA_DIST +=\
 	common/Tokeniseise.pm
 
 lib_src +=\
+	common/bitpack.cc\
 	common/bitstream.cc\
 	common/closefrom.cc\
 	common/debuglog.cc\
@@ -66,7 +70,8 @@ lib_src +=\
 	common/serialise-double.cc\
 	common/socket_utils.cc\
 	common/str.cc\
-	common/stringutils.cc
+	common/stringutils.cc\
+	common/thread.cc
 
 if BUILD_BACKEND_BRASS_OR_CHERT
 lib_src +=\
@@ -0,0 +1,106 @@
+/** @file bitpack.cc
+ * @brief Pack blocks of integers into a fixed number of bits each.
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include "bitpack.h"
+
+#include "omassert.h"
+
+#include <cstring>
+
+using namespace std;
+
+unsigned
+bitpack_width(const unsigned * v, size_t n)
+{
+    unsigned all = 0;
+    for (size_t i = 0; i != n; ++i) all |= v[i];
+    unsigned width = 0;
+    while (all) {
+	++width;
+	all >>= 1;
+    }
+    return width;
+}
+
+void
+bitpack_encode(string & s, const unsigned * v, size_t n, unsigned width)
+{
+    AssertRel(width,<=,32);
+    if (width == 0) return;
+    // The bits of the partial byte not yet appended to s.
+    unsigned acc = 0;
+    unsigned acc_bits = 0;
+    for (size_t i = 0; i != n; ++i) {
+	AssertRel(width == 32 || v[i] >> width,==,0);
+	unsigned val = v[i];
+	unsigned bits = width;
+	while (acc_bits + bits >= 8) {
+	    unsigned take = 8 - acc_bits;
+	    acc |= (val & ((1u << take) - 1)) << acc_bits;
+	    s += char(acc);
+	    val >>= take;
+	    bits -= take;
+	    acc = 0;
+	    acc_bits = 0;
+	}
+	acc |= val << acc_bits;
+	acc_bits += bits;
+    }
+    if (acc_bits) s += char(acc);
+}
+
+bool
+bitpack_decode(const char ** p, const char * end, unsigned * v, size_t n,
+	       unsigned width)
+{
+    if (n > BITPACK_BLOCK_SIZE || width > 32) return false;
+    size_t len = (n * width + 7) / 8;
+    if (size_t(end - *p) < len) return false;
+
+    // Copy into a buffer with enough zero padding that we can always load
+    // the 5 bytes starting at the byte containing the first bit of a value
+    // (a value is at most 32 bits, starting up to 7 bits into its first
+    // byte), which avoids any bounds checks in the loop below.
+    unsigned char buf[BITPACK_BLOCK_SIZE * 4 + 8];
+    memcpy(buf, *p, len);
+    memset(buf + len, 0, 8);
+    *p += len;
+
+    const unsigned mask = width == 32 ? 0xffffffffu : (1u << width) - 1;
+    size_t bit = 0;
+    for (size_t i = 0; i != n; ++i) {
+	const unsigned char * b = buf + (bit >> 3);
+	unsigned shift = bit & 7;
+	// Assemble the bytes explicitly so this works whatever the byte
+	// order - compilers turn it into a single load on little-endian
+	// platforms.
+	unsigned w = unsigned(b[0]) |
+		     unsigned(b[1]) << 8 |
+		     unsigned(b[2]) << 16 |
+		     unsigned(b[3]) << 24;
+	// The top bits of the value may be in the fifth byte.  We shift that
+	// in two steps, as shifting by 32 when shift is 0 is undefined.
+	w = (w >> shift) | ((unsigned(b[4]) << 1) << (31 - shift));
+	v[i] = w & mask;
+	bit += width;
+    }
+    return true;
+}
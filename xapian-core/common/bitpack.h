@@ -0,0 +1,75 @@
+/** @file bitpack.h
+ * @brief Pack blocks of integers into a fixed number of bits each.
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#ifndef XAPIAN_INCLUDED_BITPACK_H
+#define XAPIAN_INCLUDED_BITPACK_H
+
+#include <cstddef>
+#include <string>
+
+/** The largest number of values bitpack_decode() will decode in one call.
+ *
+ *  Encoders should split their data into blocks of this many values (the
+ *  last block may be shorter) so that the width of each block adapts to
+ *  the values in it.
+ */
+const size_t BITPACK_BLOCK_SIZE = 128;
+
+/** The number of bits needed to represent the largest of some values.
+ *
+ *  @param v	The values.
+ *  @param n	The number of values.
+ *
+ *  @return	The width, between 0 (if all the values are 0) and 32.
+ */
+unsigned bitpack_width(const unsigned * v, size_t n);
+
+/** Append values to a string, each using @a width bits.
+ *
+ *  The values are packed least significant bit first, and the output is
+ *  padded with zero bits to a whole number of bytes, which will be
+ *  (n * width + 7) / 8.
+ *
+ *  @param s	The string to append to.
+ *  @param v	The values, each of which must fit in @a width bits.
+ *  @param n	The number of values.
+ *  @param width	The number of bits to use for each value (0 to 32).
+ */
+void bitpack_encode(std::string & s, const unsigned * v, size_t n,
+		    unsigned width);
+
+/** Decode values written by bitpack_encode().
+ *
+ *  The loop is free of data-dependent branches, so decoding a block costs
+ *  the same whatever the values are, unlike variable length integers.
+ *
+ *  @param p	Pointer to the start of the encoded data, which is updated
+ *		to point after it.
+ *  @param end	Pointer to the end of the available data.
+ *  @param v	Where to store the decoded values.
+ *  @param n	The number of values (at most BITPACK_BLOCK_SIZE).
+ *  @param width	The number of bits used for each value (0 to 32).
+ *
+ *  @return	false if there isn't enough data (or @a n or @a width are
+ *		out of range), true otherwise.
+ */
+bool bitpack_decode(const char ** p, const char * end, unsigned * v, size_t n,
+		    unsigned width);
+
+#endif // XAPIAN_INCLUDED_BITPACK_H
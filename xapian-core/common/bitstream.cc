@@ -228,4 +228,32 @@ BitReader::decode_interpolative_next()
     return di_current.pos_k;
 }
 
+void
+BitReader::decode_interpolative_all(vector<Xapian::termpos> & pos)
+{
+    Assert(di_current.is_initialized());
+    Assert(di_stack.empty());
+    int n = di_current.k - di_current.j + 1;
+    size_t start = pos.size();
+    pos.resize(start + n);
+    Xapian::termpos * p = &pos[start];
+    p[0] = di_current.pos_j;
+    p[n - 1] = di_current.pos_k;
+    di_current.uninit();
+    decode_interpolative_range(p, 0, n - 1);
+}
+
+void
+BitReader::decode_interpolative_range(Xapian::termpos * pos, int j, int k)
+{
+    // This mirrors BitWriter::encode_interpolative().
+    while (j + 1 < k) {
+	const int mid = (j + k) / 2;
+	const Xapian::termpos outof = pos[k] - pos[j] + j - k + 1;
+	pos[mid] = decode(outof) + (pos[j] + mid - j);
+	decode_interpolative_range(pos, j, mid);
+	j = mid;
+    }
+}
+
 }
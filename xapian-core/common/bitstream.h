@@ -69,6 +69,9 @@ class BitReader {
 
     unsigned int read_bits(int count);
 
+    /// Decode pos elements between j and k, given pos[j] and pos[k].
+    void decode_interpolative_range(Xapian::termpos * pos, int j, int k);
+
     struct DIStack {
 	int j, k;
 	Xapian::termpos pos_k;
@@ -152,6 +155,14 @@ class BitReader {
 
     /// Perform on-demand interpolative decoding.
     Xapian::termpos decode_interpolative_next();
+
+    /** Decode all the elements set up by decode_interpolative() at once.
+     *
+     *  The elements (including the two at either end) are appended to
+     *  @a pos.  This must be called instead of decode_interpolative_next(),
+     *  and is faster when all the elements are going to be needed.
+     */
+    void decode_interpolative_all(std::vector<Xapian::termpos> & pos);
 };
 
 }
@@ -76,8 +76,8 @@ CompressionStream::compress(string & buf) {
 
 
 void
-CompressionStream::compress(const byte * buf, int size) {
-    if (!out || out_len < unsigned(size - 1)) {
+CompressionStream::compress(const byte * buf, size_t size) {
+    if (!out || out_len < size - 1) {
 	delete [] out;
 	out = NULL;
 	out_len = size - 1;
@@ -55,7 +55,7 @@ class CompressionStream {
     void lazy_alloc_inflate_zstream() const;
 
     void compress(std::string &);
-    void compress(const byte *, int);
+    void compress(const byte *, size_t);
 };
 
 #endif // XAPIAN_INCLUDED_COMPRESSION_STREAM_H
@@ -62,6 +62,34 @@ inline bool io_sync(int fd)
 #endif
 }
 
+/** Start writing data previously written to file descriptor fd to disk.
+ *
+ *  This doesn't wait for the writes to finish, so starting the writes for
+ *  several files before calling io_sync() on each allows the writes to
+ *  proceed together.  Where this isn't supported, it does nothing.
+ */
+inline void io_start_sync(int fd)
+{
+#ifdef HAVE_SYNC_FILE_RANGE
+    // Any error will be reported by the subsequent io_sync().
+    (void)sync_file_range(fd, 0, 0, SYNC_FILE_RANGE_WRITE);
+#else
+    (void)fd;
+#endif
+}
+
+#ifdef HAVE_SYNCFS
+/** Ensure all data previously written to the filesystem containing file
+ *  descriptor fd has been written to disk.
+ *
+ *  Returns false if this could not be done.
+ */
+inline bool io_sync_filesystem(int fd)
+{
+    return syncfs(fd) == 0;
+}
+#endif
+
 /** Read n bytes (or until EOF) into block pointed to by p from file descriptor
  *  fd.
  *
@@ -0,0 +1,99 @@
+/** @file mutex.h
+ *  @brief Simple wrapper around the platform's mutual exclusion primitive.
+ */
+/* This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef XAPIAN_INCLUDED_MUTEX_H
+#define XAPIAN_INCLUDED_MUTEX_H
+
+#ifdef __WIN32__
+# include "safewindows.h"
+#elif defined HAVE_PTHREAD_H
+# include <pthread.h>
+#endif
+
+/** A non-recursive mutex.
+ *
+ *  Xapian objects aren't thread-safe, but a few pieces of state are shared
+ *  between objects which may be used in different threads (for example, the
+ *  process-wide block cache), and those need to be protected by one of these.
+ *
+ *  If the platform has no thread support, locking is a no-op.
+ */
+class Mutex {
+    /// Don't allow copying.
+    Mutex(const Mutex &);
+
+    /// Don't allow assignment.
+    void operator=(const Mutex &);
+
+#ifdef __WIN32__
+    CRITICAL_SECTION cs;
+#elif defined HAVE_PTHREAD_H
+    pthread_mutex_t m;
+#endif
+
+  public:
+    Mutex() {
+#ifdef __WIN32__
+	InitializeCriticalSection(&cs);
+#elif defined HAVE_PTHREAD_H
+	pthread_mutex_init(&m, NULL);
+#endif
+    }
+
+    ~Mutex() {
+#ifdef __WIN32__
+	DeleteCriticalSection(&cs);
+#elif defined HAVE_PTHREAD_H
+	pthread_mutex_destroy(&m);
+#endif
+    }
+
+    void lock() {
+#ifdef __WIN32__
+	EnterCriticalSection(&cs);
+#elif defined HAVE_PTHREAD_H
+	pthread_mutex_lock(&m);
+#endif
+    }
+
+    void unlock() {
+#ifdef __WIN32__
+	LeaveCriticalSection(&cs);
+#elif defined HAVE_PTHREAD_H
+	pthread_mutex_unlock(&m);
+#endif
+    }
+};
+
+/// Lock a Mutex for the lifetime of this object.
+class MutexLock {
+    /// Don't allow copying.
+    MutexLock(const MutexLock &);
+
+    /// Don't allow assignment.
+    void operator=(const MutexLock &);
+
+    Mutex & mutex;
+
+  public:
+    explicit MutexLock(Mutex & mutex_) : mutex(mutex_) { mutex.lock(); }
+
+    ~MutexLock() { mutex.unlock(); }
+};
+
+#endif // XAPIAN_INCLUDED_MUTEX_H
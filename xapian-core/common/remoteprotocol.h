@@ -48,9 +48,23 @@
 // 36: 1.3.0 REPLY_UPDATE and REPLY_GREETING merged, and more...
 // 37: 1.3.1 Prefix-compress termlists.
 // 38: 1.3.2 Stats serialisation now includes collection freq, and more...
-#define XAPIAN_REMOTE_PROTOCOL_MAJOR_VERSION 38
+// 39: 1.3.2 New MSG_DOCUMENTS, compression of large messages negotiated by
+//     REPLY_UPDATE and MSG_COMPRESS, and MSG_QUERY passes the collapse table
+//     limit and approximate flag.
+#define XAPIAN_REMOTE_PROTOCOL_MAJOR_VERSION 39
 #define XAPIAN_REMOTE_PROTOCOL_MINOR_VERSION 0
 
+/** Messages with at least this many bytes of data are sent compressed.
+ *
+ *  The server offers this value in REPLY_UPDATE.  The client accepts it by
+ *  sending MSG_COMPRESS, after which both ends compress messages which are
+ *  at least this size.
+ */
+#define XAPIAN_REMOTE_COMPRESS_MIN 4096
+
+/// Flag set in the type code of a message whose data is compressed.
+#define MESSAGE_COMPRESSED 0x80
+
 /** Message types (client -> server).
  *
  *  When modifying this list, you probably need to update the array of function
@@ -86,6 +100,8 @@ enum message_type {
     MSG_GETMSET,		// Get MSet
     MSG_SHUTDOWN,		// Shutdown
     MSG_METADATAKEYLIST,	// Iterator for metadata keys
+    MSG_DOCUMENTS,		// Get several Documents
+    MSG_COMPRESS,		// Compress large messages
     MSG_MAX
 };
 
@@ -112,6 +128,7 @@ enum reply_type {
     REPLY_RESULTS,		// Results (MSet)
     REPLY_METADATA,		// Metadata
     REPLY_METADATAKEYLIST,	// Iterator for metadata keys
+    REPLY_DOCUMENT,		// Document data and values
     REPLY_MAX
 };
 
@@ -23,8 +23,12 @@
 
 // Versions:
 // 1: Initial support
+// 1.1: Streaming replication (the database name is sent with type 'S', and
+//      the master sends REPL_REPLY_KEEPALIVE while it waits for changes).
+//      A 1.0 master closes the connection without replying to 'S', which
+//      tells the client to fall back to polling.
 #define XAPIAN_REPLICATION_PROTOCOL_MAJOR_VERSION 1
-#define XAPIAN_REPLICATION_PROTOCOL_MINOR_VERSION 0
+#define XAPIAN_REPLICATION_PROTOCOL_MINOR_VERSION 1
 
 // Reply types (master -> slave)
 enum replicate_reply_type {
@@ -34,9 +38,18 @@ enum replicate_reply_type {
     REPL_REPLY_DB_FILENAME,	// The name of a file in a DB copy.
     REPL_REPLY_DB_FILEDATA,	// Contents of a file in a DB copy.
     REPL_REPLY_DB_FOOTER,	// End of a whole DB copy.
-    REPL_REPLY_CHANGESET	// A changeset file is being sent.
+    REPL_REPLY_CHANGESET,	// A changeset file is being sent.
+    REPL_REPLY_KEEPALIVE	// No changes yet, but the master is still there.
 };
 
+// How often (in seconds) a streaming master sends REPL_REPLY_KEEPALIVE while
+// it waits for changes.
+#define REPL_STREAM_KEEPALIVE_INTERVAL 10.0
+
+// How long (in seconds) a streaming client waits to hear from the master
+// before deciding the connection is dead.
+#define REPL_STREAM_READ_TIMEOUT (3 * REPL_STREAM_KEEPALIVE_INTERVAL)
+
 // The maximum number of copies of a database to send in a single conversation.
 // If more copies than this are required, a REPL_REPLY_FAIL message will be
 // sent.
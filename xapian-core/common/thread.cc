@@ -0,0 +1,118 @@
+/** @file thread.cc
+ * @brief Run a piece of work in a separate thread.
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include "thread.h"
+
+#ifdef __WIN32__
+# include <process.h>
+#endif
+
+#ifdef __WIN32__
+static unsigned __stdcall
+run_thread(void * p)
+{
+    Thread::run_in_thread(static_cast<Thread*>(p));
+    return 0;
+}
+#elif defined HAVE_PTHREAD_H
+extern "C" {
+
+static void *
+run_thread(void * p)
+{
+    Thread::run_in_thread(static_cast<Thread*>(p));
+    return NULL;
+}
+
+}
+#endif
+
+void
+Thread::run_in_thread(Thread * t)
+{
+    // Wait for start() to record which thread we are.
+    t->start_mutex.lock();
+    t->start_mutex.unlock();
+    t->run();
+}
+
+Thread::~Thread()
+{
+    join();
+}
+
+void
+Thread::start()
+{
+    MutexLock lock(start_mutex);
+#ifdef __WIN32__
+    handle = (HANDLE)_beginthreadex(NULL, 0, run_thread, this, 0,
+				    &thread_id);
+    if (handle != 0) {
+	running = true;
+	return;
+    }
+#elif defined HAVE_PTHREAD_H
+    if (pthread_create(&thread, NULL, run_thread, this) == 0) {
+	running = true;
+	return;
+    }
+#endif
+    // No thread support, or we failed to create a thread (probably because
+    // of resource limits), so just do the work now.
+    running_inline = true;
+    try {
+	run();
+    } catch (...) {
+	running_inline = false;
+	throw;
+    }
+    running_inline = false;
+}
+
+void
+Thread::join()
+{
+    if (!running) return;
+#ifdef __WIN32__
+    WaitForSingleObject(handle, INFINITE);
+    CloseHandle(handle);
+#elif defined HAVE_PTHREAD_H
+    pthread_join(thread, NULL);
+#endif
+    // Only clear this once the thread has finished, as is_current() reads it
+    // from the thread.
+    running = false;
+}
+
+bool
+Thread::is_current() const
+{
+    if (running_inline) return true;
+    if (!running) return false;
+#ifdef __WIN32__
+    return GetCurrentThreadId() == thread_id;
+#elif defined HAVE_PTHREAD_H
+    return pthread_equal(pthread_self(), thread);
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,91 @@
+/** @file thread.h
+ * @brief Run a piece of work in a separate thread.
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#ifndef XAPIAN_INCLUDED_THREAD_H
+#define XAPIAN_INCLUDED_THREAD_H
+
+#include "mutex.h"
+
+#ifdef __WIN32__
+# include "safewindows.h"
+#elif defined HAVE_PTHREAD_H
+# include <pthread.h>
+#endif
+
+/** A piece of work to run in its own thread.
+ *
+ *  Subclass this and implement run(), then call start() and later join().
+ *  The subclass must catch any exceptions thrown by the work itself, since
+ *  they can't be propagated out of the thread.
+ *
+ *  If the platform has no thread support, or a thread can't be created,
+ *  start() simply calls run() in the calling thread, so callers don't need
+ *  to handle that case specially.
+ */
+class Thread {
+    /// Don't allow copying.
+    Thread(const Thread &);
+
+    /// Don't allow assignment.
+    void operator=(const Thread &);
+
+    /// Has a thread been started which hasn't been joined yet?
+    bool running;
+
+    /// Is run() being called by start() because no thread could be made?
+    bool running_inline;
+
+    /** Held by start() until the new thread's details are stored.
+     *
+     *  The new thread locks this before calling run(), so is_current()
+     *  can safely be called from run().
+     */
+    Mutex start_mutex;
+
+#ifdef __WIN32__
+    HANDLE handle;
+
+    unsigned thread_id;
+#elif defined HAVE_PTHREAD_H
+    pthread_t thread;
+#endif
+
+  public:
+    Thread() : running(false), running_inline(false) { }
+
+    /// Destructor, which joins the thread if it's still running.
+    virtual ~Thread();
+
+    /// The work to perform.
+    virtual void run() = 0;
+
+    /// Start running run() in a new thread.
+    void start();
+
+    /// Wait for run() to finish.
+    void join();
+
+    /// Is the calling thread the one running run()?
+    bool is_current() const;
+
+    /// Entry point for the new thread, which calls run() (internal use).
+    static void run_in_thread(Thread * t);
+};
+
+#endif // XAPIAN_INCLUDED_THREAD_H
@@ -11,6 +11,7 @@ inc_HEADERS =\
 
 xapianinclude_HEADERS =\
 	include/xapian/attributes.h\
+	include/xapian/cache.h\
 	include/xapian/compactor.h\
 	include/xapian/constants.h\
 	include/xapian/database.h\
@@ -23,6 +24,7 @@ xapianinclude_HEADERS =\
 	include/xapian/expanddecider.h\
 	include/xapian/intrusive_ptr.h\
 	include/xapian/keymaker.h\
+	include/xapian/matchprofile.h\
 	include/xapian/matchspy.h\
 	include/xapian/positioniterator.h\
 	include/xapian/postingiterator.h\
@@ -57,6 +57,7 @@
 #include <xapian/errorhandler.h>
 
 // Access to databases, documents, etc.
+#include <xapian/cache.h>
 #include <xapian/database.h>
 #include <xapian/dbfactory.h>
 #include <xapian/document.h>
@@ -72,6 +73,7 @@
 #include <xapian/enquire.h>
 #include <xapian/expanddecider.h>
 #include <xapian/keymaker.h>
+#include <xapian/matchprofile.h>
 #include <xapian/matchspy.h>
 #include <xapian/postingsource.h>
 #include <xapian/query.h>
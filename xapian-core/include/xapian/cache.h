@@ -0,0 +1,212 @@
+/** @file cache.h
+ * @brief Control process-wide caches
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#ifndef XAPIAN_INCLUDED_CACHE_H
+#define XAPIAN_INCLUDED_CACHE_H
+
+#if !defined XAPIAN_INCLUDED_XAPIAN_H && !defined XAPIAN_LIB_BUILD
+# error "Never use <xapian/cache.h> directly; include <xapian.h> instead."
+#endif
+
+#include <xapian/types.h>
+#include <xapian/visibility.h>
+
+#include <cstddef>
+
+namespace Xapian {
+
+/** Control the process-wide cache of database blocks.
+ *
+ *  Disk-based backends which support it (currently brass) can share the
+ *  B-tree blocks read by read-only databases between all the Database
+ *  objects in the process, including those in use in different threads.
+ *  This means that many readers of the same database don't each need to
+ *  read hot blocks (such as those near the root of each B-tree) from disk.
+ *
+ *  Blocks are identified by the database they come from, the revision
+ *  of the database, and the block number, so a cached block will never be
+ *  returned to a reader which has opened a different revision.  When the
+ *  cache is full, the least recently used blocks are discarded.
+ *
+ *  The cache is disabled by default.  It can be enabled by calling
+ *  set_max_size(), or by setting the environment variable
+ *  XAPIAN_BLOCK_CACHE_SIZE to the required size in bytes.
+ */
+namespace BlockCache {
+
+/** Set the maximum size of the block cache.
+ *
+ *  If the cache currently holds more than this, the least recently used
+ *  blocks are discarded.
+ *
+ *  @param max_size	The maximum number of bytes of block data to cache.
+ *			0 disables the cache.
+ */
+XAPIAN_VISIBILITY_DEFAULT
+void set_max_size(size_t max_size);
+
+/// Get the maximum size of the block cache (0 if it is disabled).
+XAPIAN_VISIBILITY_DEFAULT
+size_t get_max_size();
+
+/// Get the number of bytes of block data currently in the cache.
+XAPIAN_VISIBILITY_DEFAULT
+size_t get_size();
+
+/// Get the number of block reads which were satisfied by the cache.
+XAPIAN_VISIBILITY_DEFAULT
+unsigned long get_hits();
+
+/// Get the number of block reads which had to go to disk.
+XAPIAN_VISIBILITY_DEFAULT
+unsigned long get_misses();
+
+/** Discard all cached blocks and reset the hit and miss counts.
+ *
+ *  The maximum size is left unchanged.
+ */
+XAPIAN_VISIBILITY_DEFAULT
+void clear();
+
+}
+
+/** Control the process-wide cache of match results.
+ *
+ *  When enabled, Enquire::get_mset() stores the MSets it computes in a cache
+ *  shared by all the Enquire objects in the process (including those in use
+ *  in different threads), and returns a copy of a cached MSet instead of
+ *  running the match again when the same results are asked for.
+ *
+ *  MSets are keyed by the query, the weighting scheme and its parameters,
+ *  the sort, collapse and cutoff settings, the relevance set, the first,
+ *  maxitems and checkatleast parameters, and the UUID and revision of each
+ *  database searched.  So reopening a database to a new revision means
+ *  results cached for the old revision won't be returned (they are discarded
+ *  once they become the least recently used).
+ *
+ *  Results are only cached for databases which support it (currently brass
+ *  and chert databases opened read-only), and not when a MatchDecider,
+ *  KeyMaker, MatchSpy, ErrorHandler or time limit is in use, or when the
+ *  query or weighting scheme can't be serialised.
+ *
+ *  The cache is disabled by default.  It can be enabled by calling
+ *  set_max_size(), or by setting the environment variable
+ *  XAPIAN_MSET_CACHE_SIZE to the required size in bytes.
+ */
+namespace MSetCache {
+
+/** Set the maximum size of the MSet cache.
+ *
+ *  If the cache currently holds more than this, the least recently used
+ *  MSets are discarded.
+ *
+ *  @param max_size	The (approximate) maximum number of bytes to use.
+ *			0 disables the cache.
+ */
+XAPIAN_VISIBILITY_DEFAULT
+void set_max_size(size_t max_size);
+
+/// Get the maximum size of the MSet cache (0 if it is disabled).
+XAPIAN_VISIBILITY_DEFAULT
+size_t get_max_size();
+
+/// Get the approximate number of bytes currently used by the MSet cache.
+XAPIAN_VISIBILITY_DEFAULT
+size_t get_size();
+
+/// Get the number of get_mset() calls which were satisfied by the cache.
+XAPIAN_VISIBILITY_DEFAULT
+unsigned long get_hits();
+
+/// Get the number of cacheable get_mset() calls which ran the match.
+XAPIAN_VISIBILITY_DEFAULT
+unsigned long get_misses();
+
+/** Discard all cached MSets and reset the hit and miss counts.
+ *
+ *  The maximum size is left unchanged.
+ */
+XAPIAN_VISIBILITY_DEFAULT
+void clear();
+
+}
+
+/** Control the caching of decoded posting lists for frequently used terms.
+ *
+ *  When enabled, each read-only database opened with a backend which
+ *  supports it (currently brass) keeps the decoded docids and wdfs of the
+ *  posting lists of terms which are opened repeatedly (such as boolean
+ *  filter terms used in most queries) in memory, and iterates over those
+ *  instead of reading and decoding the posting list from the B-tree again.
+ *  The cache is discarded when the database moves to a new revision (e.g.
+ *  by reopen()).
+ *
+ *  Unlike the other caches, each Database object has its own posting list
+ *  cache, but the limits set here apply to all of them.  When a
+ *  database's cache is full, the least recently used posting lists are
+ *  discarded.
+ *
+ *  The cache is disabled by default.  It can be enabled by calling
+ *  set_max_size(), or by setting the environment variable
+ *  XAPIAN_POSTLIST_CACHE_SIZE to the required size in bytes.
+ */
+namespace PostListCache {
+
+/** Set the maximum size of each database's posting list cache.
+ *
+ *  @param max_size	The (approximate) maximum number of bytes to use
+ *			per database.  0 disables the cache.
+ */
+XAPIAN_VISIBILITY_DEFAULT
+void set_max_size(size_t max_size);
+
+/// Get the maximum size of each database's posting list cache.
+XAPIAN_VISIBILITY_DEFAULT
+size_t get_max_size();
+
+/** Set the maximum length of posting list to cache.
+ *
+ *  @param max_termfreq	Posting lists with more entries than this aren't
+ *			cached.  0 (the default) means any posting list
+ *			which fits in the cache can be cached.
+ */
+XAPIAN_VISIBILITY_DEFAULT
+void set_max_termfreq(Xapian::doccount max_termfreq);
+
+/// Get the maximum length of posting list to cache (0 for no limit).
+XAPIAN_VISIBILITY_DEFAULT
+Xapian::doccount get_max_termfreq();
+
+/// Get the number of posting lists which were opened from the cache.
+XAPIAN_VISIBILITY_DEFAULT
+unsigned long get_hits();
+
+/// Get the number of posting lists which weren't in the cache.
+XAPIAN_VISIBILITY_DEFAULT
+unsigned long get_misses();
+
+/// Reset the hit and miss counts.
+XAPIAN_VISIBILITY_DEFAULT
+void reset_stats();
+
+}
+
+}
+
+#endif // XAPIAN_INCLUDED_CACHE_H
@@ -83,6 +83,29 @@ class XAPIAN_VISIBILITY_DEFAULT Compactor {
      */
     void set_multipass(bool multipass);
 
+    /** Set whether to bit-pack the posting lists in the output.
+     *
+     *  @param pack_postlists	If true, write posting list chunks using a
+     *  bit-packed encoding which is faster to decode than the standard one.
+     *  Chunks which are later updated are written back in the standard
+     *  encoding.  This is currently only supported by the brass backend,
+     *  and is ignored for other backends.  By default we don't do this.
+     */
+    void set_pack_postlists(bool pack_postlists);
+
+    /** Set the maximum number of threads to use.
+     *
+     *  @param threads	If greater than 1, build the tables of the output
+     *  concurrently, and perform the merges in each pass of a multipass
+     *  postlist merge concurrently.  No more than @a threads threads are
+     *  used in total, including the calling thread.  set_status() and
+     *  resolve_duplicate_metadata() are never called concurrently, but may
+     *  be called from threads other than the one which called compact().
+     *  This is currently only supported by the brass backend, and is
+     *  ignored for other backends.  By default only one thread is used.
+     */
+    void set_threads(unsigned threads);
+
     /** Set the compaction level.
      *
      *  @param compaction Available values are: - Xapian::Compactor::STANDARD -
@@ -116,6 +116,54 @@ const int DB_DANGEROUS		 = 0x08;
  */
 const int DB_NO_TERMLIST	 = 0x10;
 
+/** When opening a Database, memory-map the database files.
+ *
+ *  For backends which support it (currently brass), blocks are then copied
+ *  straight out of the OS page cache rather than being read with a system
+ *  call, which can significantly reduce the CPU cost of searching databases
+ *  which fit in memory.  Each block is still copied before it is used, so
+ *  this only saves the system call - a block which a writer overwrites is
+ *  detected, and DatabaseModifiedError thrown, just as without this flag.
+ *  Blocks added to the database after the mapping was made are read in the
+ *  usual way until the mapping is extended by Database::reopen().
+ *
+ *  This flag is ignored by WritableDatabase, and on platforms without mmap().
+ */
+const int DB_MMAP		 = 0x20;
+
+/** Build a new database in bulk.
+ *
+ *  For backends which support it (currently brass), when a WritableDatabase
+ *  with no documents is opened with this flag, postings and positional data
+ *  are written to sorted temporary files each time changes are flushed, and
+ *  these are merged at the end to write the posting list and position tables
+ *  in order with full blocks, much as Xapian::Compactor would.  This makes
+ *  building a large database much faster and the result smaller.
+ *
+ *  Nothing is committed until bulk loading ends, which happens at the first
+ *  call to WritableDatabase::commit() (or when the database is closed), or
+ *  as soon as anything needs the postings (such as searching the database,
+ *  or deleting or replacing an existing document).  After that, changes are
+ *  made in the usual way.
+ *
+ *  This flag is ignored if the database already contains documents.
+ */
+const int DB_BULK_LOAD		 = 0x40;
+
+/** Sync changes to disk by syncing the whole filesystem.
+ *
+ *  For backends which support it (currently brass), on platforms with
+ *  syncfs() (currently Linux), committing writes all the database's files
+ *  and then makes them durable with a single call to syncfs(), rather than
+ *  syncing each file separately.  On storage where each sync is expensive,
+ *  this can make commits much faster, but any other changes pending for the
+ *  same filesystem are also written out, so this is best used when the
+ *  database has a filesystem to itself.
+ *
+ *  This flag has no effect if Xapian::DB_NO_SYNC is also specified.
+ */
+const int DB_SYNC_FILESYSTEM	 = 0x80;
+
 /** Use the brass backend.
  *
  *  When opening a WritableDatabase, this means create a brass database if a
@@ -617,6 +617,21 @@ class XAPIAN_VISIBILITY_DEFAULT WritableDatabase : public Database {
 	 *  conservative, and if you have a machine with plenty of memory,
 	 *  you can improve indexing throughput dramatically by setting
 	 *  XAPIAN_FLUSH_THRESHOLD in the environment to a larger value.
+	 *  With the brass backend, you can instead give a memory size with
+	 *  a K, M or G suffix (e.g. XAPIAN_FLUSH_THRESHOLD=512M), and
+	 *  changes will be committed when they are using roughly that much
+	 *  memory, however many documents they are for.
+	 *
+	 *  With the brass backend, you can also trade some durability for a
+	 *  higher rate of commits with set_sync_window(), or by setting
+	 *  XAPIAN_SYNC_WINDOW in the environment to a number of seconds (e.g.
+	 *  XAPIAN_SYNC_WINDOW=0.1).  A commit made within that time of the
+	 *  last commit which was written to disk is deferred - its changes
+	 *  are written (and synced) together with those of the next commit
+	 *  after the window has passed, or when the database is closed.  Until
+	 *  then, other readers don't see the deferred changes, and they are
+	 *  lost if the process or system crashes, but the database on disk is
+	 *  always left intact.
 	 *
 	 *  This method was new in Xapian 1.1.0 - in earlier versions it was
 	 *  called flush().
@@ -629,6 +644,69 @@ class XAPIAN_VISIBILITY_DEFAULT WritableDatabase : public Database {
 	 */
 	void commit();
 
+	/** Start committing pending modifications in the background.
+	 *
+	 *  This is like commit(), except that for backends which support it
+	 *  (currently brass), the modifications are written to disk by a
+	 *  background thread, and this method returns without waiting for
+	 *  that to finish.  Other backends simply call commit().
+	 *
+	 *  While the commit runs, documents can still be added with
+	 *  add_document() - they're held in memory and will be part of the
+	 *  next commit.  Any other use of the database first waits for the
+	 *  commit to finish.  This includes using iterators (such as a
+	 *  PostingIterator or TermIterator) which were opened on this object
+	 *  before commit_async() was called, which wait for the commit to
+	 *  finish rather than reading the database while it is being written.
+	 *
+	 *  If the commit fails, the exception is thrown by wait_for_commit()
+	 *  or by whichever later call to a method of this object waits for
+	 *  it, and all modifications since the last successful commit
+	 *  (including documents added while the commit was running) are
+	 *  discarded.
+	 *
+	 *  It's not valid to call commit_async() within a transaction.
+	 *
+	 *  @exception Xapian::DatabaseError will be thrown if a problem occurs
+	 *             while modifying the database.
+	 */
+	void commit_async();
+
+	/** Wait for a commit started by commit_async() to finish.
+	 *
+	 *  Once this returns, the changes committed are durable (as far as
+	 *  commit() ensures that).  If no commit is running, this returns
+	 *  immediately.
+	 *
+	 *  @exception Xapian::DatabaseError will be thrown if the commit
+	 *             failed.
+	 */
+	void wait_for_commit();
+
+	/** Set a window within which commits are deferred.
+	 *
+	 *  A commit made less than @a seconds after the last commit which was
+	 *  written to disk is deferred, which allows many more commits per
+	 *  second.  At most 100 commits in a row are deferred, however long
+	 *  the window is.  The next commit which isn't deferred, closing the
+	 *  database, or beginning a transaction writes the changes from all
+	 *  the commits which were, as a single new revision.
+	 *
+	 *  This overrides XAPIAN_SYNC_WINDOW.  See commit() for what this
+	 *  means - deferred commits aren't visible to other readers until
+	 *  they are written, and are lost if there's a crash before then, but
+	 *  the database isn't put at risk.
+	 *
+	 *  Currently only the brass backend supports this, and not for a
+	 *  database opened with Xapian::DB_NO_SYNC.  Other backends ignore it
+	 *  and write every commit.
+	 *
+	 *  @param seconds	The length of the window (0 to write every
+	 *			commit, which is the default).  Setting this to
+	 *			0 writes any commits which were deferred.
+	 */
+	void set_sync_window(double seconds);
+
 	/** Pre-1.1.0 name for commit().
 	 *
 	 *  Use commit() instead in new code.  This alias may be deprecated in
@@ -761,6 +839,39 @@ class XAPIAN_VISIBILITY_DEFAULT WritableDatabase : public Database {
 	 */
 	Xapian::docid add_document(const Xapian::Document & document);
 
+	/** Add several new documents to the database.
+	 *
+	 *  This is equivalent to calling add_document() for each document in
+	 *  turn, except that for a brass database the work of encoding each
+	 *  document's termlist and position lists is shared between @a threads
+	 *  worker threads, and overlaps with this thread updating the tables.
+	 *  This can speed up indexing considerably when it's limited by CPU
+	 *  rather than by I/O.
+	 *
+	 *  The documents are added in order and get consecutive document IDs
+	 *  (except when the database has several sub-databases).  The
+	 *  documents mustn't be modified by another thread during this call.
+	 *
+	 *  If adding a document fails, an exception is thrown and, just as for
+	 *  add_document(), uncommitted changes may be lost.
+	 *
+	 *  @param documents	The new documents to be added.
+	 *  @param threads	The number of threads to prepare documents with
+	 *			(default: 0, which means add the documents
+	 *			serially).
+	 *
+	 *  @return	The document ID of the first document added (or 0 if
+	 *		@a documents is empty).
+	 *
+	 *  @exception Xapian::DatabaseError will be thrown if a problem occurs
+	 *             while writing to the database.
+	 *
+	 *  @exception Xapian::DatabaseCorruptError will be thrown if the
+	 *             database is in a corrupt state.
+	 */
+	Xapian::docid add_documents(const std::vector<Xapian::Document> & documents,
+				    unsigned threads = 0);
+
 	/** Delete a document from the database.
 	 *
 	 *  This method removes the document with the specified document ID
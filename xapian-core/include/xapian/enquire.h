@@ -35,6 +35,7 @@
 
 #include <xapian/attributes.h>
 #include <xapian/intrusive_ptr.h>
+#include <xapian/matchprofile.h>
 #include <xapian/types.h>
 #include <xapian/termiterator.h>
 #include <xapian/visibility.h>
@@ -213,6 +214,13 @@ class XAPIAN_VISIBILITY_DEFAULT MSet {
 	 */
 	double get_max_attained() const;
 
+	/** Return where the match which produced this MSet spent its time.
+	 *
+	 *  The profile is empty unless Enquire::set_profiling() was called
+	 *  before the match was run.
+	 */
+	Xapian::MatchProfile get_profile() const;
+
 	/** The number of items in this MSet */
 	Xapian::doccount size() const;
 
@@ -810,6 +818,33 @@ class XAPIAN_VISIBILITY_DEFAULT Enquire {
 	void set_collapse_key(Xapian::valueno collapse_key,
 			      Xapian::doccount collapse_max = 1);
 
+	/** Limit the memory used to track collapse key values.
+	 *
+	 *  By default, the matcher remembers every distinct collapse key value
+	 *  it sees, which can use a lot of memory when collapsing on a value
+	 *  with many distinct values (such as the site a page came from) for a
+	 *  query which matches many documents.
+	 *
+	 *  @param max_keys  The number of collapse key values to track
+	 *	before forgetting those which can't affect the result (default
+	 *	is 0, which means no limit).  A value is forgotten when all the
+	 *	documents kept for it rank below every document in the current
+	 *	candidate MSet.  This never changes which documents are returned,
+	 *	but get_collapse_count() and the MSet's match bounds and
+	 *	estimates may be lower than they would otherwise be.  The limit
+	 *	is raised if needed to be at least twice the number of values
+	 *	with documents in the candidate MSet.
+	 *
+	 *  @param approximate  If true, identify collapse key values by a
+	 *	64-bit hash of the value rather than storing the value itself
+	 *	(default false).  This uses less memory, but two different
+	 *	values with the same hash will be collapsed together.  The
+	 *	chance of this is tiny unless there are billions of distinct
+	 *	values.
+	 */
+	void set_collapse_limit(Xapian::doccount max_keys,
+				bool approximate = false);
+
 	typedef enum {
 	    ASCENDING = 1,
 	    DESCENDING = 0,
@@ -990,6 +1025,54 @@ class XAPIAN_VISIBILITY_DEFAULT Enquire {
 	 */
 	void set_time_limit(double time_limit);
 
+	/** Set the number of threads to use to match sub-databases.
+	 *
+	 *  When the Database being searched is made up of several local
+	 *  sub-databases, each can be matched in a separate thread, and the
+	 *  results merged at the end.  The threads share the minimum weight
+	 *  needed to make the MSet, so a sub-database can skip documents
+	 *  which can't rank highly enough because of the documents found in
+	 *  the others.
+	 *
+	 *  If there are fewer sub-databases than threads, each sub-database
+	 *  is also split into ranges of docids which are matched in separate
+	 *  threads.  Currently this is only supported for brass databases
+	 *  opened read-only - each extra range reads from its own snapshot
+	 *  of the database, which is opened with the same flags and kept
+	 *  for later matches until the database moves to a new revision.
+	 *
+	 *  Matching is always performed serially if there's only one
+	 *  sub-database which can't be split, if any sub-database is remote,
+	 *  if the same sub-database was added more than once, if the query
+	 *  uses a PostingSource which can't be cloned, or if a MatchSpy,
+	 *  MatchDecider or KeyMaker is in use (since these might not be safe
+	 *  to use from several threads at once).  As with
+	 *  remote databases, collapse counts and match estimates may differ a
+	 *  little from those of a serial match.
+	 *
+	 *  @param threads  The maximum number of threads to use (default: 1,
+	 *		    which means match serially).  The calling thread
+	 *		    does some of the work, so at most threads - 1
+	 *		    additional threads are created.
+	 */
+	void set_match_threads(unsigned threads);
+
+	/** Record where the match spends its time.
+	 *
+	 *  If enabled, each MSet returned by get_mset() has a profile of the
+	 *  match, giving the number of calls to each node of the tree of
+	 *  postlists built for the query and the time spent in it.  See
+	 *  Xapian::MSet::get_profile().
+	 *
+	 *  Profiling adds overhead, particularly from reading the clock, so
+	 *  the times are mostly useful for comparing the nodes of a query.
+	 *  A profiled match is always performed serially, and its MSet is
+	 *  never taken from or added to the MSet cache.
+	 *
+	 *  @param profiling  Whether to profile matches (default: false).
+	 */
+	void set_profiling(bool profiling);
+
 	/** Get (a portion of) the match set for the current query.
 	 *
 	 *  @param first     the first item in the result set to return.
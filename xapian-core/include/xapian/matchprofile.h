@@ -0,0 +1,172 @@
+/** @file matchprofile.h
+ * @brief Information about where a match spent its time
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#ifndef XAPIAN_INCLUDED_MATCHPROFILE_H
+#define XAPIAN_INCLUDED_MATCHPROFILE_H
+
+#if !defined XAPIAN_INCLUDED_XAPIAN_H && !defined XAPIAN_LIB_BUILD
+# error "Never use <xapian/matchprofile.h> directly; include <xapian.h> instead."
+#endif
+
+#include <string>
+
+#include <xapian/intrusive_ptr.h>
+#include <xapian/types.h>
+#include <xapian/visibility.h>
+
+namespace Xapian {
+
+/** Information about where a match spent its time.
+ *
+ *  This is only filled in if Enquire::set_profiling() has been called, and
+ *  is returned by MSet::get_profile().
+ *
+ *  There's a node for each node of the tree of postlists which was built for
+ *  each (local) sub-database to run the query.  Nested subqueries which are
+ *  combined into their parent (such as an OP_OR subquery of an OP_OR query)
+ *  don't get their own node.  Remote sub-databases aren't profiled.
+ */
+class XAPIAN_VISIBILITY_DEFAULT MatchProfile {
+  public:
+    class Internal;
+    /// @private @internal Reference counted internals.
+    Xapian::Internal::intrusive_ptr<Internal> internal;
+
+    class Node;
+
+    /// @private @internal Constructor for internal use.
+    explicit MatchProfile(Internal * internal_);
+
+    /// Create an empty MatchProfile.
+    MatchProfile();
+
+    /// Destroy a MatchProfile.
+    ~MatchProfile();
+
+    /// Copying is allowed (and is cheap).
+    MatchProfile(const MatchProfile & other);
+
+    /// Assignment is allowed (and is cheap).
+    void operator=(const MatchProfile & other);
+
+    /** Return the number of nodes.
+     *
+     *  This is zero if the match wasn't profiled.
+     */
+    size_t get_node_count() const;
+
+    /** Return a node of the postlist trees.
+     *
+     *  Each node is followed by the nodes below it, so the children of a
+     *  node are the following nodes with depth one greater, up to the next
+     *  node with the same or lesser depth.  If there are several
+     *  sub-databases, there's a tree for each, in order.
+     *
+     *  @param i	The index of the node, which must be less than
+     *			get_node_count().
+     */
+    Node get_node(size_t i) const;
+
+    /// Return the time taken by the whole match, in seconds.
+    double get_total_time() const;
+
+    /** Return the number of collapse key values tracked at the end of the
+     *  match.
+     *
+     *  This and the other collapse counts are zero unless
+     *  Enquire::set_collapse_key() has been called.
+     */
+    Xapian::doccount get_collapse_keys() const;
+
+    /// Return the number of buckets in the collapse key table.
+    Xapian::doccount get_collapse_buckets() const;
+
+    /// Return the most collapse key values tracked at once during the match.
+    Xapian::doccount get_collapse_peak_keys() const;
+
+    /** Return the number of collapse key values forgotten.
+     *
+     *  Values are only forgotten if Enquire::set_collapse_limit() has been
+     *  called with a non-zero @a max_keys.
+     */
+    Xapian::doccount get_collapse_keys_forgotten() const;
+
+    /** Return the profile formatted as a tree, one node per line.
+     *
+     *  Each line gives the description of a node, indented by its depth,
+     *  followed by its time in microseconds and the counts which are
+     *  non-zero.  The first line gives the total time for the match, and
+     *  the collapse key table counts if collapsing.
+     */
+    std::string get_description() const;
+};
+
+/// The counts for one node of the postlist tree.
+class XAPIAN_VISIBILITY_DEFAULT MatchProfile::Node {
+    friend class MatchProfile;
+
+    MatchProfile profile;
+
+    size_t index;
+
+    Node(const MatchProfile & profile_, size_t index_)
+	: profile(profile_), index(index_) { }
+
+  public:
+    /// Return the query operator, or a description of a leaf subquery.
+    std::string get_description() const;
+
+    /// Return the depth of this node in the tree (0 for the root).
+    unsigned get_depth() const;
+
+    /// Return the estimated number of documents this node matches.
+    Xapian::doccount get_termfreq_est() const;
+
+    /// Return the number of calls to next().
+    unsigned long get_next_calls() const;
+
+    /// Return the number of calls to skip_to().
+    unsigned long get_skip_to_calls() const;
+
+    /// Return the number of calls to check().
+    unsigned long get_check_calls() const;
+
+    /// Return the number of documents this node stopped at.
+    unsigned long get_docs() const;
+
+    /** Return the number of position lists opened.
+     *
+     *  This counts the position lists of documents, not the positions
+     *  decoded from them.
+     */
+    unsigned long get_position_lists_opened() const;
+
+    /// Return the number of calls to recalc_maxweight().
+    unsigned long get_recalc_maxweight_calls() const;
+
+    /** Return the time spent in this node, in seconds.
+     *
+     *  This includes the time spent in the nodes below it.
+     */
+    double get_time() const;
+};
+
+}
+
+#endif // XAPIAN_INCLUDED_MATCHPROFILE_H
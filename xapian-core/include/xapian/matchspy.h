@@ -195,8 +195,14 @@ class XAPIAN_VISIBILITY_DEFAULT ValueCountMatchSpy : public MatchSpy {
 	/// The values seen so far, together with their frequency.
 	std::map<std::string, Xapian::doccount> values;
 
-	Internal() : slot(Xapian::BAD_VALUENO), total(0) {}
-	Internal(Xapian::valueno slot_) : slot(slot_), total(0) {}
+	/// Pending counts and sampling state (NULL if there are none).
+	class Counts;
+	Counts * counts;
+
+	Internal() : slot(Xapian::BAD_VALUENO), total(0), counts(NULL) {}
+	Internal(Xapian::valueno slot_) : slot(slot_), total(0), counts(NULL) {}
+
+	~Internal();
     };
 #endif
 
@@ -208,8 +214,22 @@ class XAPIAN_VISIBILITY_DEFAULT ValueCountMatchSpy : public MatchSpy {
     ValueCountMatchSpy() : internal() {}
 
     /// Construct a MatchSpy which counts the values in a particular slot.
-    ValueCountMatchSpy(Xapian::valueno slot_)
-	    : internal(new Internal(slot_)) {}
+    ValueCountMatchSpy(Xapian::valueno slot_);
+
+    /** Construct a MatchSpy which counts the values in a sample of documents.
+     *
+     *  Only around one in @a sample_period of the documents the spy sees
+     *  have their values counted.  The documents are chosen by a hash of
+     *  the docid, so the same documents are counted each time the query is
+     *  run.  The frequencies returned are then scaled up to estimate the
+     *  frequencies over all the documents seen, and get_total() still
+     *  returns the number of documents seen.
+     *
+     *  @param slot_		The value slot to count.
+     *  @param sample_period	Count around one in this many documents
+     *				(1 means count them all).
+     */
+    ValueCountMatchSpy(Xapian::valueno slot_, Xapian::doccount sample_period);
 
     /** Return the total number of documents tallied. */
     size_t XAPIAN_NOTHROW(get_total() const) {
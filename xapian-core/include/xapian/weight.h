@@ -197,6 +197,22 @@ class XAPIAN_VISIBILITY_DEFAULT Weight {
      */
     virtual double get_maxpart() const = 0;
 
+    /** Return an upper bound on get_sumpart() for documents with a given
+     *  maximum wdf.
+     *
+     *  Backends which store the highest wdf in each block of a posting list
+     *  (currently brass) use this to skip whole blocks which can't contain
+     *  a document the matcher wants.
+     *
+     *  The default implementation returns get_maxpart(), which is always a
+     *  valid bound, but means no blocks can be skipped.  BM25Weight and
+     *  TradWeight override it, so if you subclass one of those and override
+     *  get_sumpart(), you need to override this method too.
+     *
+     *  @param wdf_max	An upper bound on the wdf of the documents.
+     */
+    virtual double get_maxpart_for_wdf(Xapian::termcount wdf_max) const;
+
     /** Calculate the term-independent weight component for a document.
      *
      *  The parameter gives information about the document which may be used
@@ -546,6 +562,7 @@ class XAPIAN_VISIBILITY_DEFAULT BM25Weight : public Weight {
     double get_sumpart(Xapian::termcount wdf,
 		       Xapian::termcount doclen) const;
     double get_maxpart() const;
+    double get_maxpart_for_wdf(Xapian::termcount wdf_max) const;
 
     double get_sumextra(Xapian::termcount doclen) const;
     double get_maxextra() const;
@@ -605,6 +622,7 @@ class XAPIAN_VISIBILITY_DEFAULT TradWeight : public Weight {
     double get_sumpart(Xapian::termcount wdf,
 		       Xapian::termcount doclen) const;
     double get_maxpart() const;
+    double get_maxpart_for_wdf(Xapian::termcount wdf_max) const;
 
     double get_sumextra(Xapian::termcount doclen) const;
     double get_maxextra() const;
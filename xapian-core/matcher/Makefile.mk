@@ -4,6 +4,7 @@ noinst_HEADERS +=\
 	matcher/branchpostlist.h\
 	matcher/collapser.h\
 	matcher/const_database_wrapper.h\
+	matcher/docidrangepostlist.h\
 	matcher/exactphrasepostlist.h\
 	matcher/externalpostlist.h\
 	matcher/extraweightpostlist.h\
@@ -17,9 +18,12 @@ noinst_HEADERS +=\
 	matcher/multixorpostlist.h\
 	matcher/orpostlist.h\
 	matcher/phrasepostlist.h\
+	matcher/positionbuffer.h\
+	matcher/profilepostlist.h\
 	matcher/queryoptimiser.h\
 	matcher/remotesubmatch.h\
 	matcher/selectpostlist.h\
+	matcher/sortkeyheap.h\
 	matcher/synonympostlist.h\
 	matcher/valuegepostlist.h\
 	matcher/valuerangepostlist.h\
@@ -55,7 +59,10 @@ lib_src +=\
 	matcher/multixorpostlist.cc\
 	matcher/orpostlist.cc\
 	matcher/phrasepostlist.cc\
+	matcher/profilepostlist.cc\
+	matcher/queryoptimiser.cc\
 	matcher/selectpostlist.cc\
+	matcher/sortkeyheap.cc\
 	matcher/synonympostlist.cc\
 	matcher/valuegepostlist.cc\
 	matcher/valuerangepostlist.cc\
@@ -22,12 +22,26 @@
 
 #include "collapser.h"
 
+#include "debuglog.h"
 #include "omassert.h"
 
 #include <algorithm>
 
 using namespace std;
 
+/// Hash a collapse key value (using 64-bit FNV-1a).
+static inline uint8
+hash_key(const string & key)
+{
+    uint8 h = (uint8(0xcbf29ce4) << 32) | 0x84222325;
+    const uint8 prime = (uint8(1) << 40) | 0x1b3;
+    for (string::const_iterator i = key.begin(); i != key.end(); ++i) {
+	h ^= static_cast<unsigned char>(*i);
+	h *= prime;
+    }
+    return h;
+}
+
 collapse_result
 CollapseData::add_item(const Xapian::Internal::MSetItem & item,
 		       Xapian::doccount collapse_max, const MSetCmp & mcmp,
@@ -66,11 +80,71 @@ CollapseData::add_item(const Xapian::Internal::MSetItem & item,
     return REPLACED;
 }
 
+bool
+CollapseData::all_below(const Xapian::Internal::MSetItem & min_item,
+			const MSetCmp & mcmp) const
+{
+    vector<Xapian::Internal::MSetItem>::const_iterator i;
+    for (i = items.begin(); i != items.end(); ++i) {
+	if (!mcmp(min_item, *i)) return false;
+    }
+    return true;
+}
+
+const unsigned Collapser::NO_ENTRY;
+
+size_t
+Collapser::find_bucket(uint8 hash, const string & key) const
+{
+    size_t mask = buckets.size() - 1;
+    // Fold in the top bits, since the low bits of FNV-1a mix less well.
+    size_t b = size_t(hash ^ (hash >> 32)) & mask;
+    while (buckets[b] != NO_ENTRY) {
+	const Entry & e = values[buckets[b]];
+	if (e.hash == hash && (approximate || e.key == key)) break;
+	b = (b + 1) & mask;
+    }
+    return b;
+}
+
+void
+Collapser::rehash(size_t n_buckets)
+{
+    buckets.assign(n_buckets, NO_ENTRY);
+    for (unsigned i = 0; i != values.size(); ++i) {
+	const Entry & e = values[i];
+	if (e.data.empty()) continue;
+	buckets[find_bucket(e.hash, e.key)] = i;
+    }
+}
+
+void
+Collapser::forget_unneeded(const Xapian::Internal::MSetItem & min_item,
+			   const MSetCmp & mcmp)
+{
+    if (entry_count > peak_entry_count) peak_entry_count = entry_count;
+    for (unsigned i = 0; i != values.size(); ++i) {
+	Entry & e = values[i];
+	if (e.data.empty() || !e.data.all_below(min_item, mcmp)) continue;
+	entry_count -= e.data.size();
+	e.data.clear();
+	free_values.push_back(i);
+	--keys;
+	++keys_forgotten;
+    }
+    LOGLINE(MATCH, "Collapser: forgot values, " << keys << " left");
+    // All the values we kept have an item in the proto-MSet, so if we can't
+    // free half the table, the limit is too small for this MSet size.
+    if (keys > max_keys / 2) max_keys = keys * 2;
+    rehash(buckets.size());
+}
+
 collapse_result
 Collapser::process(Xapian::Internal::MSetItem & item,
 		   PostList * postlist,
 		   Xapian::Document::Internal & vsdoc,
-		   const MSetCmp & mcmp)
+		   const MSetCmp & mcmp,
+		   const Xapian::Internal::MSetItem * min_item)
 {
     ++docs_considered;
     // The postlist will supply the collapse key for a remote match.
@@ -88,17 +162,38 @@ Collapser::process(Xapian::Internal::MSetItem & item,
 	return EMPTY;
     }
 
-    map<string, CollapseData>::iterator oldkey;
-    oldkey = table.find(item.collapse_key);
-    if (oldkey == table.end()) {
+    uint8 hash = hash_key(item.collapse_key);
+    size_t b = 0;
+    if (!buckets.empty()) b = find_bucket(hash, item.collapse_key);
+    if (buckets.empty() || buckets[b] == NO_ENTRY) {
 	// We've not seen this collapse key before.
-	table.insert(make_pair(item.collapse_key, CollapseData(item)));
+	if (max_keys && keys >= max_keys && min_item) {
+	    forget_unneeded(*min_item, mcmp);
+	    b = find_bucket(hash, item.collapse_key);
+	}
+	if ((keys + 1) * 2 > buckets.size()) {
+	    rehash(buckets.empty() ? 16 : buckets.size() * 2);
+	    b = find_bucket(hash, item.collapse_key);
+	}
+	unsigned i;
+	if (free_values.empty()) {
+	    i = values.size();
+	    values.push_back(Entry(item, hash));
+	} else {
+	    i = free_values.back();
+	    free_values.pop_back();
+	    values[i].data.reset(item);
+	    values[i].hash = hash;
+	}
+	if (!approximate) values[i].key = item.collapse_key;
+	buckets[b] = i;
+	if (++keys > peak_keys) peak_keys = keys;
 	++entry_count;
 	return ADDED;
     }
 
     collapse_result res;
-    CollapseData & collapse_data = oldkey->second;
+    CollapseData & collapse_data = values[buckets[b]].data;
     res = collapse_data.add_item(item, collapse_max, mcmp, old_item);
     if (res == ADDED) {
 	++entry_count;
@@ -112,16 +207,17 @@ Xapian::doccount
 Collapser::get_collapse_count(const string & collapse_key, int percent_cutoff,
 			      double min_weight) const
 {
-    map<string, CollapseData>::const_iterator key = table.find(collapse_key);
+    size_t b = find_bucket(hash_key(collapse_key), collapse_key);
     // If a collapse key is present in the MSet, it must be in our table.
-    Assert(key != table.end());
+    Assert(buckets[b] != NO_ENTRY);
+    const CollapseData & collapse_data = values[buckets[b]].data;
 
     if (!percent_cutoff) {
 	// The recorded collapse_count is correct.
-	return key->second.get_collapse_count();
+	return collapse_data.get_collapse_count();
     }
 
-    if (key->second.get_next_best_weight() < min_weight) {
+    if (collapse_data.get_next_best_weight() < min_weight) {
 	// We know for certain that all collapsed items would have failed the
 	// percentage cutoff, so collapse_count should be 0.
 	return 0;
@@ -139,7 +235,10 @@ Collapser::get_matches_lower_bound() const
 {
     // We've seen this many matches, but all other documents matching the query
     // could be collapsed onto values already seen.
-    Xapian::doccount matches_lower_bound = no_collapse_key + entry_count;
+    // If we've forgotten values, we did have peak_entry_count distinct items
+    // at one point, and each of those will still be represented.
+    Xapian::doccount matches_lower_bound =
+	no_collapse_key + max(entry_count, peak_entry_count);
     return matches_lower_bound;
     // FIXME: *Unless* we haven't achieved collapse_max occurrences of *any*
     // collapse key value, so we can increase matches_lower_bound like the
@@ -147,10 +246,10 @@ Collapser::get_matches_lower_bound() const
     // many documents.
 #if 0
     Xapian::doccount max_kept = 0;
-    map<string, CollapseData>::const_iterator i;
-    for (i = table.begin(); i != table.end(); ++i) {
-	if (i->second.get_collapse_count() > max_kept) {
-	    max_kept = i->second.get_collapse_count();
+    vector<Entry>::const_iterator i;
+    for (i = values.begin(); i != values.end(); ++i) {
+	if (i->data.get_collapse_count() > max_kept) {
+	    max_kept = i->data.get_collapse_count();
 	    if (max_kept == collapse_max) {
 		return matches_lower_bound;
 	    }
@@ -25,8 +25,10 @@
 #include "msetcmp.h"
 #include "api/omenquireinternal.h"
 #include "api/postlist.h"
+#include "internaltypes.h"
 
-#include <map>
+#include <string>
+#include <vector>
 
 /// Enumeration reporting how a document was handled by the Collapser.
 typedef enum {
@@ -62,6 +64,31 @@ class CollapseData {
 	items[0].collapse_key = string();
     }
 
+    /// Reuse this object for a new collapse key value, starting with @a item.
+    void reset(const Xapian::Internal::MSetItem & item) {
+	items.assign(1, item);
+	items[0].collapse_key = string();
+	next_best_weight = 0;
+	collapse_count = 0;
+    }
+
+    /// Forget the items (keeping the space allocated for reuse).
+    void clear() { items.clear(); }
+
+    /// Return true if this object is unused.
+    bool empty() const { return items.empty(); }
+
+    /// Return the number of items currently kept.
+    Xapian::doccount size() const { return items.size(); }
+
+    /** Return true if all the kept items rank below @a min_item.
+     *
+     *  Such items can't be in the proto-MSet, so forgetting this collapse
+     *  key value doesn't change which documents the match returns.
+     */
+    bool all_below(const Xapian::Internal::MSetItem & min_item,
+		   const MSetCmp & mcmp) const;
+
     /** Handle a new MSetItem with this collapse key value.
      *
      *  @param item		The new item.
@@ -83,14 +110,77 @@ class CollapseData {
     Xapian::doccount get_collapse_count() const { return collapse_count; }
 };
 
-/// The Collapser class tracks collapse keys and the documents they match.
+/** The Collapser class tracks collapse keys and the documents they match.
+ *
+ *  The collapse key values are kept in an open-addressing hash table,
+ *  indexed by a 64-bit hash of the value.  By default the value itself is
+ *  stored too, to resolve hash collisions, but in approximate mode only the
+ *  hash is stored, so values which happen to have the same hash will be
+ *  collapsed together.
+ *
+ *  If a limit on the number of values tracked is set and reached, values
+ *  whose kept documents all rank below the lowest document in the
+ *  proto-MSet are forgotten.  This doesn't change which documents are
+ *  returned, but collapse counts and the match bounds may be lower than
+ *  they would otherwise be.
+ */
 class Collapser {
-    /// Map from collapse key values to the items we're keeping for them.
-    std::map<std::string, CollapseData> table;
+    /// Information about a collapse key value we're tracking.
+    struct Entry {
+	/// The items we're keeping for this value.
+	CollapseData data;
+
+	/// The hash of the collapse key value.
+	uint8 hash;
+
+	/// The collapse key value (empty in approximate mode).
+	std::string key;
+
+	Entry(const Xapian::Internal::MSetItem & item, uint8 hash_)
+	    : data(item), hash(hash_) { }
+    };
+
+    /// Value in @a buckets for an unused bucket.
+    static const unsigned NO_ENTRY = unsigned(-1);
+
+    /** The hash table, holding indices into @a values.
+     *
+     *  The size is always a power of 2, and we keep it at least twice the
+     *  number of values so that probe sequences stay short.
+     */
+    std::vector<unsigned> buckets;
+
+    /// The collapse key values we're tracking.
+    std::vector<Entry> values;
 
-    /// How many items we're currently keeping in @a table.
+    /// Indices of unused elements of @a values.
+    std::vector<unsigned> free_values;
+
+    /// The number of collapse key values in the table.
+    Xapian::doccount keys;
+
+    /** The number of values to track before forgetting any (0 for no limit).
+     *
+     *  This is raised if forgetting values doesn't free at least half the
+     *  table, to avoid scanning the table too often.
+     */
+    Xapian::doccount max_keys;
+
+    /// If true, only store the hash of each collapse key value.
+    bool approximate;
+
+    /// The most values we've had in the table at once.
+    Xapian::doccount peak_keys;
+
+    /// The number of values we've forgotten to stay within max_keys.
+    Xapian::doccount keys_forgotten;
+
+    /// How many items we're currently keeping in @a values.
     Xapian::doccount entry_count;
 
+    /// The most items we've had in the table at once.
+    Xapian::doccount peak_entry_count;
+
     /** How many documents have we seen without a collapse key?
      *
      *  We use this statistic to improve matches_lower_bound.
@@ -117,14 +207,40 @@ class Collapser {
     /** The maximum number of items to keep for each collapse key value. */
     Xapian::doccount collapse_max;
 
+    /** Find the bucket for collapse key value @a key with hash @a hash.
+     *
+     *  @return The index of the bucket holding the value, or of the unused
+     *		bucket where it should be added if it isn't in the table.
+     */
+    size_t find_bucket(uint8 hash, const std::string & key) const;
+
+    /// Rebuild @a buckets with @a n_buckets buckets.
+    void rehash(size_t n_buckets);
+
+    /// Forget values whose items all rank below @a min_item.
+    void forget_unneeded(const Xapian::Internal::MSetItem & min_item,
+			 const MSetCmp & mcmp);
+
   public:
     /// Replaced item when REPLACED is returned by @a collapse().
     Xapian::Internal::MSetItem old_item;
 
-    Collapser(Xapian::valueno slot_, Xapian::doccount collapse_max_)
-	: entry_count(0), no_collapse_key(0), dups_ignored(0),
-	  docs_considered(0), slot(slot_), collapse_max(collapse_max_),
-	  old_item(0, 0) { }
+    /** Construct a Collapser.
+     *
+     *  @param slot_		The value slot to collapse on.
+     *  @param collapse_max_	Max no. of items for each collapse key value.
+     *  @param max_keys_	The number of values to track before forgetting
+     *				those which can't affect the result (0 for no
+     *				limit).
+     *  @param approximate_	If true, only store the hash of each value.
+     */
+    Collapser(Xapian::valueno slot_, Xapian::doccount collapse_max_,
+	      Xapian::doccount max_keys_ = 0, bool approximate_ = false)
+	: keys(0), max_keys(max_keys_), approximate(approximate_),
+	  peak_keys(0), keys_forgotten(0),
+	  entry_count(0), peak_entry_count(0), no_collapse_key(0),
+	  dups_ignored(0), docs_considered(0), slot(slot_),
+	  collapse_max(collapse_max_), old_item(0, 0) { }
 
     /// Return true if collapsing is active for this match.
     operator bool() const { return collapse_max != 0; }
@@ -136,13 +252,16 @@ class Collapser {
      *				(this happens for a remote match).
      *  @param doc		Document for getting values.
      *  @param mcmp		MSetItem comparison functor.
+     *  @param min_item	The lowest ranked item in the proto-MSet, or
+     *				NULL if the proto-MSet isn't full yet.
      *
      *  @return How @a item was handled: EMPTY, ADDED, REJECTED or REPLACED.
      */
     collapse_result process(Xapian::Internal::MSetItem & item,
 			    PostList * postlist,
 			    Xapian::Document::Internal & vsdoc,
-			    const MSetCmp & mcmp);
+			    const MSetCmp & mcmp,
+			    const Xapian::Internal::MSetItem * min_item);
 
     Xapian::doccount get_collapse_count(const std::string & collapse_key,
 					int percent_cutoff,
@@ -156,7 +275,19 @@ class Collapser {
 
     Xapian::doccount get_matches_lower_bound() const;
 
-    bool empty() const { return table.empty(); }
+    bool empty() const { return keys == 0; }
+
+    /// The number of collapse key values currently in the table.
+    Xapian::doccount get_table_keys() const { return keys; }
+
+    /// The number of buckets in the hash table.
+    size_t get_table_buckets() const { return buckets.size(); }
+
+    /// The most collapse key values we've had in the table at once.
+    Xapian::doccount get_peak_keys() const { return peak_keys; }
+
+    /// The number of values we've forgotten to stay within the limit.
+    Xapian::doccount get_keys_forgotten() const { return keys_forgotten; }
 };
 
 #endif // XAPIAN_INCLUDED_COLLAPSER_H
@@ -0,0 +1,135 @@
+/** @file docidrangepostlist.h
+ * @brief Restrict a postlist to a range of docids.
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#ifndef XAPIAN_INCLUDED_DOCIDRANGEPOSTLIST_H
+#define XAPIAN_INCLUDED_DOCIDRANGEPOSTLIST_H
+
+#include "multimatch.h"
+#include "str.h"
+
+#include <algorithm>
+
+/** A postlist which only returns the docids from @a begin to @a end.
+ *
+ *  This is used to split the matching of a single database between several
+ *  threads, each handling a different range of docids.
+ */
+class DocidRangePostList : public PostList {
+    /// Don't allow assignment.
+    void operator=(const DocidRangePostList &);
+
+    /// Don't allow copying.
+    DocidRangePostList(const DocidRangePostList &);
+
+    PostList * pl;
+
+    /// The first docid in the range.
+    Xapian::docid begin;
+
+    /// The last docid in the range.
+    Xapian::docid end;
+
+    MultiMatch * matcher;
+
+    /// Has next() or skip_to() been called yet?
+    bool started;
+
+    /// Have we moved past @a end?
+    bool done;
+
+    /// The proportion of the database's docids which are in the range.
+    double fraction;
+
+    void handle_prune(PostList * p) {
+	if (p) {
+	    delete pl;
+	    pl = p;
+	    if (matcher) matcher->recalc_maxweight();
+	}
+	started = true;
+	done = pl->at_end() || pl->get_docid() > end;
+    }
+
+  public:
+    DocidRangePostList(PostList * pl_,
+		       Xapian::docid begin_, Xapian::docid end_,
+		       Xapian::docid last_docid,
+		       MultiMatch * matcher_)
+	: pl(pl_), begin(begin_), end(end_), matcher(matcher_),
+	  started(false), done(false),
+	  fraction(double(end_ - begin_ + 1) / last_docid) { }
+
+    ~DocidRangePostList() { delete pl; }
+
+    Xapian::doccount get_termfreq_min() const { return 0; }
+
+    Xapian::doccount get_termfreq_max() const {
+	return std::min(pl->get_termfreq_max(),
+			Xapian::doccount(end - begin + 1));
+    }
+
+    Xapian::doccount get_termfreq_est() const {
+	Xapian::doccount est(pl->get_termfreq_est() * fraction + 0.5);
+	return std::min(est, get_termfreq_max());
+    }
+
+    double get_maxweight() const { return pl->get_maxweight(); }
+
+    Xapian::docid get_docid() const { return pl->get_docid(); }
+
+    Xapian::termcount get_doclength() const { return pl->get_doclength(); }
+
+    Xapian::termcount get_wdf() const { return pl->get_wdf(); }
+
+    double get_weight() const { return pl->get_weight(); }
+
+    bool at_end() const { return done; }
+
+    double recalc_maxweight() {
+	return done ? 0 : pl->recalc_maxweight();
+    }
+
+    PositionList * read_position_list() { return pl->read_position_list(); }
+
+    PostList * next(double w_min) {
+	if (!started) {
+	    // Jump straight to the start of the range.
+	    handle_prune(pl->skip_to(begin, w_min));
+	} else {
+	    handle_prune(pl->next(w_min));
+	}
+	return NULL;
+    }
+
+    PostList * skip_to(Xapian::docid did, double w_min) {
+	if (!done) handle_prune(pl->skip_to(std::max(did, begin), w_min));
+	return NULL;
+    }
+
+    Xapian::termcount count_matching_subqs() const {
+	return pl->count_matching_subqs();
+    }
+
+    std::string get_description() const {
+	return "(DocidRange " + str(begin) + ".." + str(end) + " " +
+	       pl->get_description() + ")";
+    }
+};
+
+#endif // XAPIAN_INCLUDED_DOCIDRANGEPOSTLIST_H
@@ -24,6 +24,7 @@
 
 #include "debuglog.h"
 #include "backends/positionlist.h"
+#include "positionbuffer.h"
 
 #include <algorithm>
 #include <vector>
@@ -36,11 +37,17 @@ ExactPhrasePostList::ExactPhrasePostList(PostList *source_,
     : SelectPostList(source_), terms(terms_begin, terms_end)
 {
     size_t n = terms.size();
-    poslists = new PositionList*[n];
+    buffers = new PositionBuffer[n];
     try {
-	order = new unsigned[n];
+	poslists = new PositionBuffer*[n];
+	try {
+	    order = new unsigned[n];
+	} catch (...) {
+	    delete [] poslists;
+	    throw;
+	}
     } catch (...) {
-	delete [] poslists;
+	delete [] buffers;
 	throw;
     }
     for (size_t i = 0; i < n; ++i) order[i] = unsigned(i);
@@ -48,6 +55,7 @@ ExactPhrasePostList::ExactPhrasePostList(PostList *source_,
 
 ExactPhrasePostList::~ExactPhrasePostList()
 {
+    delete [] buffers;
     delete [] poslists;
     delete [] order;
 }
@@ -56,7 +64,8 @@ void
 ExactPhrasePostList::start_position_list(unsigned i)
 {
     unsigned index = order[i];
-    poslists[i] = terms[index]->read_position_list();
+    poslists[i] = &buffers[index];
+    poslists[i]->read(terms[index]->read_position_list());
     poslists[i]->index = index;
 }
 
@@ -25,7 +25,7 @@
 #include "selectpostlist.h"
 #include <vector>
 
-typedef Xapian::PositionIterator::Internal PositionList;
+class PositionBuffer;
 
 /** Postlist which matches an exact phrase using positional information.
  *
@@ -40,7 +40,10 @@ typedef Xapian::PositionIterator::Internal PositionList;
 class ExactPhrasePostList : public SelectPostList {
     std::vector<PostList*> terms;
 
-    PositionList ** poslists;
+    /// The decoded positions for each term, reused for each document.
+    PositionBuffer * buffers;
+
+    PositionBuffer ** poslists;
 
     unsigned * order;
 
@@ -84,6 +84,8 @@ class ExternalPostList : public PostList {
 
     PostList * check(Xapian::docid did, double w_min, bool &valid);
 
+    bool is_expensive() const { return true; }
+
     bool at_end() const;
 
     Xapian::termcount count_matching_subqs() const;
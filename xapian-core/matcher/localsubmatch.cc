@@ -28,6 +28,7 @@
 #include "api/emptypostlist.h"
 #include "extraweightpostlist.h"
 #include "api/leafpostlist.h"
+#include "multimatch.h"
 #include "omassert.h"
 #include "queryoptimiser.h"
 #include "synonympostlist.h"
@@ -71,7 +72,6 @@ LocalSubMatch::get_postlist_and_term_info(MultiMatch * matcher,
 	Xapian::termcount * total_subqs_ptr)
 {
     LOGCALL(MATCH, PostList *, "LocalSubMatch::get_postlist_and_term_info", matcher | termfreqandwts | total_subqs_ptr);
-    (void)matcher;
     term_info = termfreqandwts;
 
     // Build the postlist tree for the query.  This calls
@@ -82,8 +82,8 @@ LocalSubMatch::get_postlist_and_term_info(MultiMatch * matcher,
 
     PostList * pl;
     {
-	QueryOptimiser opt(*db, *this, matcher);
-	pl = query.internal->postlist(&opt, 1.0);
+	QueryOptimiser opt(*db, *this, matcher, matcher->get_profile());
+	pl = opt.make_postlist(query.internal.get(), 1.0);
 	*total_subqs_ptr = opt.get_total_subqs();
     }
 
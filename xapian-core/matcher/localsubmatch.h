@@ -76,6 +76,15 @@ class LocalSubMatch : public SubMatch {
 	LOGCALL_CTOR(MATCH, "LocalSubMatch", db_ | query_ | qlen_ | rset_ | wt_factory_);
     }
 
+    /** Create a LocalSubMatch running the same query on another database.
+     *
+     *  The statistics aren't collated again, so @a db_ should be the same
+     *  revision of the same database (e.g. from open_snapshot()).
+     */
+    LocalSubMatch * clone_for(const Xapian::Database::Internal *db_) const {
+	return new LocalSubMatch(db_, query, qlen, rset, wt_factory);
+    }
+
     /// Fetch and collate statistics.
     bool prepare_match(bool nowait, Xapian::Weight::Internal & total_stats);
 
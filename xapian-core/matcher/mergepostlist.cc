@@ -57,7 +57,9 @@ MergePostList::next(double w_min)
 	    if (!plists[current]->at_end()) break;
 	    ++current;
 	    if (unsigned(current) >= plists.size()) break;
-	    vsdoc.new_subdb(current);
+	    // Consecutive postlists may come from the same sub-database.
+	    if (subdbs[current] != subdbs[current - 1])
+		vsdoc.new_subdb(subdbs[current]);
 	} catch (Xapian::Error & e) {
 	    if (errorhandler) {
 		LOGLINE(EXCEPTION, "Calling error handler in MergePostList::next().");
@@ -139,7 +141,7 @@ MergePostList::get_docid() const
     Assert(current != -1);
     // FIXME: this needs fixing so we can prune plists - see MultiPostlist
     // for code which does this...
-    RETURN((plists[current]->get_docid() - 1) * plists.size() + current + 1);
+    RETURN((plists[current]->get_docid() - 1) * n_subdbs + subdbs[current] + 1);
 }
 
 double
@@ -158,6 +160,14 @@ MergePostList::get_collapse_key() const
     return plists[current]->get_collapse_key();
 }
 
+const string *
+MergePostList::get_sort_key() const
+{
+    LOGCALL(MATCH, const string *, "MergePostList::get_sort_key", NO_ARGS);
+    Assert(current != -1);
+    return plists[current]->get_sort_key();
+}
+
 double
 MergePostList::get_maxweight() const
 {
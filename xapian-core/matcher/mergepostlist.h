@@ -44,6 +44,12 @@ class MergePostList : public PostList {
 
 	int current;
 
+	/// The index of the sub-database each postlist in plists is from.
+	vector<unsigned> subdbs;
+
+	/// The number of sub-databases.
+	Xapian::doccount n_subdbs;
+
 	/** The object which is using this postlist to perform
 	 *  a match.  This object needs to be notified when the
 	 *  tree changes such that the maximum weights need to be
@@ -69,6 +75,7 @@ class MergePostList : public PostList {
 	Xapian::docid  get_docid() const;
 	double get_weight() const;
 	const string * get_collapse_key() const;
+	const string * get_sort_key() const;
 
 	double get_maxweight() const;
 
@@ -87,11 +94,23 @@ class MergePostList : public PostList {
 
 	Xapian::termcount count_matching_subqs() const;
 
+	/** Construct a MergePostList.
+	 *
+	 *  @param plists_	The postlists to merge.
+	 *  @param subdbs_	The index of the sub-database each of @a plists_
+	 *			is from (several consecutive postlists can be
+	 *			from the same sub-database if each covers a
+	 *			different range of docids).
+	 *  @param n_subdbs_	The number of sub-databases.
+	 */
 	MergePostList(const std::vector<PostList *> & plists_,
+		      const std::vector<unsigned> & subdbs_,
+		      Xapian::doccount n_subdbs_,
 		      MultiMatch *matcher_,
 		      ValueStreamDocument & vsdoc_,
 		      Xapian::ErrorHandler * errorhandler_)
-	    : plists(plists_), current(-1), matcher(matcher_), vsdoc(vsdoc_),
+	    : plists(plists_), current(-1), subdbs(subdbs_),
+	      n_subdbs(n_subdbs_), matcher(matcher_), vsdoc(vsdoc_),
 	      errorhandler(errorhandler_) { }
 
 	~MergePostList();
@@ -31,6 +31,9 @@
  *  This class is used with the remote backend.  We perform a match on the
  *  remote server, then serialise the resulting MSet and pass it back to the
  *  client where we include it in the match by wrapping it in an MSetPostList.
+ *
+ *  It's also used to merge the MSets for each sub-database when they're
+ *  matched in parallel.
  */
 class MSetPostList : public PostList {
     /// Don't allow assignment.
@@ -51,10 +54,18 @@ class MSetPostList : public PostList {
      */
     bool decreasing_relevance;
 
+    /** Do the MSet items have their sort keys set?
+     *
+     *  The remote protocol doesn't currently pass sort keys back.
+     */
+    bool have_sort_keys;
+
   public:
-    MSetPostList(const Xapian::MSet mset, bool decreasing_relevance_)
+    MSetPostList(const Xapian::MSet mset, bool decreasing_relevance_,
+		 bool have_sort_keys_ = false)
 	: cursor(-1), mset_internal(mset.internal),
-	  decreasing_relevance(decreasing_relevance_) { }
+	  decreasing_relevance(decreasing_relevance_),
+	  have_sort_keys(have_sort_keys_) { }
 
     Xapian::doccount get_termfreq_min() const;
 
@@ -70,6 +81,9 @@ class MSetPostList : public PostList {
 
     const string * get_collapse_key() const;
 
+    /// Return the sort key, if the MSet has sort keys.
+    const string * get_sort_key() const;
+
     /// Not implemented for MSetPostList.
     Xapian::termcount get_doclength() const;
 
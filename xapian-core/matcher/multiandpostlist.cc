@@ -25,17 +25,23 @@
 #include "omassert.h"
 #include "debuglog.h"
 
+#include <algorithm>
+
 void
-MultiAndPostList::allocate_plist_and_max_wt()
+MultiAndPostList::allocate_arrays()
 {
     plist = new PostList * [n_kids];
     try {
 	max_wt = new double [n_kids];
+	rejects = new unsigned [n_kids];
     } catch (...) {
 	delete [] plist;
 	plist = NULL;
+	delete [] max_wt;
+	max_wt = NULL;
 	throw;
     }
+    std::fill_n(rejects, n_kids, 0u);
 }
 
 MultiAndPostList::~MultiAndPostList()
@@ -47,6 +53,7 @@ MultiAndPostList::~MultiAndPostList()
 	delete [] plist;
     }
     delete [] max_wt;
+    delete [] rejects;
 }
 
 Xapian::doccount
@@ -190,6 +197,34 @@ MultiAndPostList::recalc_maxweight()
     return max_total;
 }
 
+void
+MultiAndPostList::reorder_checks()
+{
+    LOGCALL_VOID(MATCH, "MultiAndPostList::reorder_checks", NO_ARGS);
+    candidates = 0;
+    // There are usually only a few sub-postlists, so an insertion sort is
+    // fine.  It's stable, so ties keep their current order.
+    for (size_t i = 2; i < n_kids; ++i) {
+	bool expensive = plist[i]->is_expensive();
+	size_t j = i;
+	while (j > 1) {
+	    bool prev_expensive = plist[j - 1]->is_expensive();
+	    if (prev_expensive != expensive) {
+		if (!prev_expensive) break;
+	    } else if (rejects[j - 1] >= rejects[j]) {
+		break;
+	    }
+	    std::swap(plist[j - 1], plist[j]);
+	    std::swap(max_wt[j - 1], max_wt[j]);
+	    std::swap(rejects[j - 1], rejects[j]);
+	    --j;
+	}
+    }
+    for (size_t i = 1; i < n_kids; ++i) {
+	rejects[i] /= 2;
+    }
+}
+
 PostList *
 MultiAndPostList::find_next_match(double w_min)
 {
@@ -199,10 +234,12 @@ advanced_plist0:
 	return NULL;
     }
     did = plist[0]->get_docid();
+    if (n_kids > 2 && ++candidates == REORDER_INTERVAL) reorder_checks();
     for (size_t i = 1; i < n_kids; ++i) {
 	bool valid;
 	check_helper(i, did, w_min, valid);
 	if (!valid) {
+	    ++rejects[i];
 	    next_helper(0, w_min);
 	    goto advanced_plist0;
 	}
@@ -212,6 +249,7 @@ advanced_plist0:
 	}
 	Xapian::docid new_did = plist[i]->get_docid();
 	if (new_did != did) {
+	    ++rejects[i];
 	    skip_to_helper(0, new_did, w_min);
 	    goto advanced_plist0;
 	}
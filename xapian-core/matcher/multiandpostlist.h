@@ -29,14 +29,21 @@
 /// N-way AND postlist.
 class MultiAndPostList : public PostList {
     /** Comparison functor which orders PostList* by ascending
-     *  get_termfreq_est(). */
+     *  get_termfreq_est(), but with any expensive postlists last. */
     struct ComparePostListTermFreqAscending {
-	/// Order by ascending get_termfreq_est().
+	/// Order by is_expensive(), then ascending get_termfreq_est().
         bool operator()(const PostList *a, const PostList *b) {
+	    bool a_expensive = a->is_expensive();
+	    if (a_expensive != b->is_expensive()) return !a_expensive;
             return a->get_termfreq_est() < b->get_termfreq_est();
         }
     };
 
+    /** How many candidates to consider between reordering the
+     *  sub-postlists we check them against.
+     */
+    static const unsigned REORDER_INTERVAL = 64;
+
     /// Don't allow assignment.
     void operator=(const MultiAndPostList &);
 
@@ -58,6 +65,16 @@ class MultiAndPostList : public PostList {
     /// Total maximum weight (== sum of max_wt values).
     double max_total;
 
+    /** Array of how often each sub-postlist has rejected a candidate.
+     *
+     *  These are halved each time we reorder, so they reflect recent
+     *  behaviour more than old.
+     */
+    unsigned * rejects;
+
+    /// Candidates considered since we last reordered.
+    unsigned candidates;
+
     /// The number of documents in the database.
     Xapian::doccount db_size;
 
@@ -100,11 +117,19 @@ class MultiAndPostList : public PostList {
 	}
     }
 
-    /** Allocate plist and max_wt arrays of @a n_kids each.
+    /** Allocate plist, max_wt and rejects arrays of @a n_kids each.
      *
      *  @exception  std::bad_alloc.
      */
-    void allocate_plist_and_max_wt();
+    void allocate_arrays();
+
+    /** Reorder the sub-postlists after the first by how often they reject
+     *  candidates, so those most likely to reject are checked first.
+     *
+     *  The first sub-postlist generates the candidates, so stays put, and
+     *  expensive sub-postlists stay after the others.
+     */
+    void reorder_checks();
 
     /// Advance the sublists to the next match.
     PostList * find_next_match(double w_min);
@@ -117,13 +142,16 @@ class MultiAndPostList : public PostList {
     MultiAndPostList(RandomItor pl_begin, RandomItor pl_end,
 		     MultiMatch * matcher_, Xapian::doccount db_size_)
 	: did(0), n_kids(pl_end - pl_begin), plist(NULL), max_wt(NULL),
-	  max_total(0), db_size(db_size_), matcher(matcher_)
+	  max_total(0), rejects(NULL), candidates(0), db_size(db_size_),
+	  matcher(matcher_)
     {
-	allocate_plist_and_max_wt();
+	allocate_arrays();
 
 	// Copy the postlists in ascending termfreq order, since it will
 	// be more efficient to look at the shorter lists first, and skip
-	// the longer lists based on those.
+	// the longer lists based on those.  Expensive postlists go last
+	// whatever their termfreq, as we only want to check candidates
+	// against them.
 	std::partial_sort_copy(pl_begin, pl_end, plist, plist + n_kids,
 			       ComparePostListTermFreqAscending());
     }
@@ -133,16 +161,17 @@ class MultiAndPostList : public PostList {
 		     double lmax, double rmax,
 		     MultiMatch * matcher_, Xapian::doccount db_size_)
 	: did(0), n_kids(2), plist(NULL), max_wt(NULL),
-	  max_total(lmax + rmax), db_size(db_size_), matcher(matcher_)
+	  max_total(lmax + rmax), rejects(NULL), candidates(0),
+	  db_size(db_size_), matcher(matcher_)
     {
 	// Even if we're the decay product of an OrPostList, we may want to
 	// swap here, as the subqueries may also have decayed and so their
 	// estimated termfreqs may have changed.
-	if (l->get_termfreq_est() < r->get_termfreq_est()) {
+	if (ComparePostListTermFreqAscending()(l, r)) {
 	    std::swap(l, r);
 	    std::swap(lmax, rmax);
 	}
-	allocate_plist_and_max_wt();
+	allocate_arrays();
 	// Put the least frequent postlist first.
 	plist[0] = r;
 	plist[1] = l;
@@ -34,21 +34,28 @@
 #include "localsubmatch.h"
 #include "omassert.h"
 #include "api/omenquireinternal.h"
+#include "api/queryinternal.h"
 #include "realtime.h"
 
 #include "api/emptypostlist.h"
 #include "branchpostlist.h"
+#include "docidrangepostlist.h"
 #include "mergepostlist.h"
 
 #include "backends/document.h"
 
 #include "msetcmp.h"
 
+#include "msetpostlist.h"
+#include "mutex.h"
+#include "sortkeyheap.h"
+#include "thread.h"
 #include "valuestreamdocument.h"
 #include "weight/weightinternal.h"
 
 #include <xapian/errorhandler.h>
 #include <xapian/matchspy.h>
+#include <xapian/postingsource.h>
 #include <xapian/version.h> // For XAPIAN_HAS_REMOTE_BACKEND
 
 #ifdef XAPIAN_HAS_REMOTE_BACKEND
@@ -265,6 +272,148 @@ MultipleMatchSpy::operator()(const Xapian::Document &doc, double wt) {
     }
 }
 
+/** Check each PostingSource in @a query can be cloned.
+ *
+ *  A PostingSource which can't be cloned is shared by all the postlist trees
+ *  built for the query, so it mustn't be used from several threads.
+ */
+static bool
+posting_sources_can_be_cloned(const Xapian::Query & query)
+{
+    if (!query.internal.get()) return true;
+    if (query.get_type() == Xapian::Query::LEAF_POSTING_SOURCE) {
+	const Xapian::Internal::QueryPostingSource * q;
+	q = static_cast<const Xapian::Internal::QueryPostingSource *>(
+		query.internal.get());
+	AutoPtr<Xapian::PostingSource> clone(q->get_source()->clone());
+	return clone.get() != NULL;
+    }
+    for (size_t i = 0; i != query.get_num_subqueries(); ++i) {
+	if (!posting_sources_can_be_cloned(query.get_subquery(i)))
+	    return false;
+    }
+    return true;
+}
+
+/// The minimum weight shared between sub-matches running in parallel.
+class SharedMinWeight {
+    /// Don't allow copying.
+    SharedMinWeight(const SharedMinWeight &);
+
+    /// Don't allow assignment.
+    void operator=(const SharedMinWeight &);
+
+    Mutex mutex;
+
+    double min_weight;
+
+  public:
+    SharedMinWeight() : min_weight(0.0) { }
+
+    double get() {
+	MutexLock lock(mutex);
+	return min_weight;
+    }
+
+    void raise(double w) {
+	MutexLock lock(mutex);
+	if (w > min_weight) min_weight = w;
+    }
+};
+
+/// A sub-database (or range of its docids) being matched in parallel.
+struct ShardMatch {
+    /// The index of the sub-database.
+    size_t subdb;
+
+    /// The first docid to match (or 0 to match the whole sub-database).
+    Xapian::docid range_begin;
+
+    /// The last docid to match (if range_begin isn't 0).
+    Xapian::docid range_end;
+
+    /** A snapshot of the sub-database for this range to read from.
+     *
+     *  NULL if we're reading the sub-database itself.
+     */
+    intrusive_ptr<Xapian::Database::Internal> snapshot;
+
+    /// The SubMatch for this sub-database (or snapshot).
+    intrusive_ptr<SubMatch> leaf;
+
+    /// The MultiMatch for just this sub-database.
+    MultiMatch * matcher;
+
+    vector<PostList *> postlists;
+
+    map<string, Xapian::MSet::Internal::TermFreqAndWeight> termfreqandwts;
+
+    Xapian::termcount total_subqs;
+
+    Xapian::doccount definite_matches_not_seen;
+
+    /// The result of matching this sub-database.
+    Xapian::MSet mset;
+
+    /// Did matching this sub-database throw an exception?
+    bool failed;
+
+    ShardMatch()
+	: subdb(0), range_begin(0), range_end(0),
+	  matcher(NULL), total_subqs(0), definite_matches_not_seen(0),
+	  failed(false) { }
+};
+
+/// Thread which matches sub-databases until there are none left.
+class ShardMatchThread : public Thread {
+    vector<ShardMatch> & shards;
+
+    /// Index of the next sub-database which needs matching.
+    size_t & next_shard;
+
+    /// Mutex protecting next_shard.
+    Mutex & mutex;
+
+    Xapian::doccount maxitems;
+
+    Xapian::doccount check_at_least;
+
+  public:
+    ShardMatchThread(vector<ShardMatch> & shards_, size_t & next_shard_,
+		     Mutex & mutex_, Xapian::doccount maxitems_,
+		     Xapian::doccount check_at_least_)
+	: shards(shards_), next_shard(next_shard_), mutex(mutex_),
+	  maxitems(maxitems_), check_at_least(check_at_least_) { }
+
+    void run();
+};
+
+void
+ShardMatchThread::run()
+{
+    while (true) {
+	size_t i;
+	{
+	    MutexLock lock(mutex);
+	    if (next_shard == shards.size()) return;
+	    i = next_shard++;
+	}
+	ShardMatch & shard = shards[i];
+	try {
+	    shard.matcher->run_match(shard.postlists, shard.termfreqandwts,
+				     shard.total_subqs,
+				     shard.definite_matches_not_seen,
+				     0, maxitems, check_at_least, shard.mset,
+				     NULL, NULL);
+	} catch (...) {
+	    // We can't propagate the exception from this thread, so just
+	    // note that it happened.  The caller will then repeat the match
+	    // serially, which will report the error in the usual way.
+	    shard.failed = true;
+	}
+    }
+}
+
 ////////////////////////////////////
 // Initialisation and cleaning up //
 ////////////////////////////////////
@@ -274,12 +423,15 @@ MultiMatch::MultiMatch(const Xapian::Database &db_,
 		       const Xapian::RSet * omrset,
 		       Xapian::doccount collapse_max_,
 		       Xapian::valueno collapse_key_,
+		       Xapian::doccount collapse_limit_,
+		       bool collapse_approximate_,
 		       int percent_cutoff_, double weight_cutoff_,
 		       Xapian::Enquire::docid_order order_,
 		       Xapian::valueno sort_key_,
 		       Xapian::Enquire::Internal::sort_setting sort_by_,
 		       bool sort_value_forward_,
 		       double time_limit_,
+		       unsigned match_threads_,
 		       Xapian::ErrorHandler * errorhandler_,
 		       Xapian::Weight::Internal & stats,
 		       const Xapian::Weight * weight_,
@@ -287,16 +439,19 @@ MultiMatch::MultiMatch(const Xapian::Database &db_,
 		       bool have_sorter, bool have_mdecider)
 	: db(db_), query(query_),
 	  collapse_max(collapse_max_), collapse_key(collapse_key_),
+	  collapse_limit(collapse_limit_),
+	  collapse_approximate(collapse_approximate_),
 	  percent_cutoff(percent_cutoff_), weight_cutoff(weight_cutoff_),
 	  order(order_),
 	  sort_key(sort_key_), sort_by(sort_by_),
 	  sort_value_forward(sort_value_forward_),
-	  time_limit(time_limit_),
+	  time_limit(time_limit_), match_threads(match_threads_),
 	  errorhandler(errorhandler_), weight(weight_),
 	  is_remote(db.internal.size()),
-	  matchspies(matchspies_)
+	  matchspies(matchspies_),
+	  shared_min_weight(NULL), profile(NULL)
 {
-    LOGCALL_CTOR(MATCH, "MultiMatch", db_ | query_ | qlen | omrset | collapse_max_ | collapse_key_ | percent_cutoff_ | weight_cutoff_ | int(order_) | sort_key_ | int(sort_by_) | sort_value_forward_ | time_limit_| errorhandler_ | stats | weight_ | matchspies_ | have_sorter | have_mdecider);
+    LOGCALL_CTOR(MATCH, "MultiMatch", db_ | query_ | qlen | omrset | collapse_max_ | collapse_key_ | collapse_limit_ | collapse_approximate_ | percent_cutoff_ | weight_cutoff_ | int(order_) | sort_key_ | int(sort_by_) | sort_value_forward_ | time_limit_ | match_threads_ | errorhandler_ | stats | weight_ | matchspies_ | have_sorter | have_mdecider);
 
     if (query.empty()) return;
 
@@ -322,6 +477,7 @@ MultiMatch::MultiMatch(const Xapian::Database &db_,
 		// FIXME: Remote handling for time_limit with multiple
 		// databases may need some work.
 		rem_db->set_query(query, qlen, collapse_max, collapse_key,
+				  collapse_limit, collapse_approximate,
 				  order, sort_key, sort_by, sort_value_forward,
 				  time_limit,
 				  percent_cutoff, weight_cutoff, weight,
@@ -354,6 +510,28 @@ MultiMatch::MultiMatch(const Xapian::Database &db_,
     stats.set_bounds_from_db(db);
 }
 
+MultiMatch::MultiMatch(const MultiMatch & parent, SubMatch * leaf,
+		       Xapian::Database::Internal * subdb,
+		       SharedMinWeight * shared_min_weight_)
+	: leaves(1, intrusive_ptr<SubMatch>(leaf)),
+	  db(subdb), query(parent.query),
+	  collapse_max(parent.collapse_max), collapse_key(parent.collapse_key),
+	  collapse_limit(parent.collapse_limit),
+	  collapse_approximate(parent.collapse_approximate),
+	  percent_cutoff(parent.percent_cutoff),
+	  weight_cutoff(parent.weight_cutoff),
+	  order(parent.order),
+	  sort_key(parent.sort_key), sort_by(parent.sort_by),
+	  sort_value_forward(parent.sort_value_forward),
+	  time_limit(parent.time_limit), match_threads(1),
+	  errorhandler(parent.errorhandler), weight(parent.weight),
+	  is_remote(1, false),
+	  matchspies(parent.matchspies),
+	  shared_min_weight(shared_min_weight_), profile(NULL)
+{
+    LOGCALL_CTOR(MATCH, "MultiMatch", Literal("[parent]") | leaf | subdb | shared_min_weight_);
+}
+
 double
 MultiMatch::getorrecalc_maxweight(PostList *pl)
 {
@@ -391,8 +569,6 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 
     Assert(!leaves.empty());
 
-    TimeOut timeout(time_limit);
-
 #ifdef XAPIAN_HAS_REMOTE_BACKEND
     // If there's only one database and it's remote, we can just unserialise
     // its MSet and return that.
@@ -405,6 +581,46 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
     }
 #endif
 
+    vector<PostList *> postlists;
+    map<string, Xapian::MSet::Internal::TermFreqAndWeight> termfreqandwts;
+    Xapian::termcount total_subqs = 0;
+    // Keep a count of matches which we know exist, but we won't see.  This
+    // occurs when a submatch is remote or was matched in parallel, and
+    // returns a lower bound on the number of matching documents which is
+    // higher than the number of documents it returns (because it wasn't
+    // asked for more documents).
+    Xapian::doccount definite_matches_not_seen = 0;
+
+    // The MatchSpy, MatchDecider and KeyMaker objects are user code which
+    // may not be safe to call from several threads at once, so we only
+    // match in parallel if none are in use.  We also match serially if
+    // profiling, as the profile isn't safe to update from several threads.
+    if (match_threads <= 1 || !matchspies.empty() || mdecider || sorter ||
+	profile ||
+	!open_postlists_in_parallel(first, maxitems, check_at_least, stats,
+				    postlists, termfreqandwts,
+				    definite_matches_not_seen)) {
+	open_postlists(first, maxitems, check_at_least, stats,
+		       postlists, termfreqandwts,
+		       total_subqs, definite_matches_not_seen);
+    }
+    Assert(!postlists.empty());
+
+    run_match(postlists, termfreqandwts, total_subqs,
+	      definite_matches_not_seen, first, maxitems, check_at_least,
+	      mset, mdecider, sorter);
+}
+
+void
+MultiMatch::open_postlists(Xapian::doccount first, Xapian::doccount maxitems,
+			   Xapian::doccount check_at_least,
+			   const Xapian::Weight::Internal & stats,
+			   vector<PostList *> & postlists,
+			   map<string, Xapian::MSet::Internal::TermFreqAndWeight> & termfreqandwts,
+			   Xapian::termcount & total_subqs,
+			   Xapian::doccount & definite_matches_not_seen)
+{
+    LOGCALL_VOID(MATCH, "MultiMatch::open_postlists", first | maxitems | check_at_least | stats | postlists | Literal("termfreqandwts") | total_subqs | definite_matches_not_seen);
     // Start matchers.
     {
 	vector<intrusive_ptr<SubMatch> >::iterator leaf;
@@ -425,17 +641,8 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
     }
 
     // Get postlists and term info
-    vector<PostList *> postlists;
-    map<string, Xapian::MSet::Internal::TermFreqAndWeight> termfreqandwts;
     map<string, Xapian::MSet::Internal::TermFreqAndWeight> * termfreqandwts_ptr;
     termfreqandwts_ptr = &termfreqandwts;
-
-    Xapian::termcount total_subqs = 0;
-    // Keep a count of matches which we know exist, but we won't see.  This
-    // occurs when a submatch is remote, and returns a lower bound on the
-    // number of matching documents which is higher than the number of
-    // documents it returns (because it wasn't asked for more documents).
-    Xapian::doccount definite_matches_not_seen = 0;
     for (size_t i = 0; i != leaves.size(); ++i) {
 	PostList *pl;
 	try {
@@ -466,7 +673,201 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 	}
 	postlists.push_back(pl);
     }
-    Assert(!postlists.empty());
+
+}
+
+bool
+MultiMatch::open_postlists_in_parallel(Xapian::doccount first,
+				       Xapian::doccount maxitems,
+				       Xapian::doccount check_at_least,
+				       const Xapian::Weight::Internal & stats,
+				       vector<PostList *> & postlists,
+				       map<string, Xapian::MSet::Internal::TermFreqAndWeight> & termfreqandwts,
+				       Xapian::doccount & definite_matches_not_seen)
+{
+    LOGCALL(MATCH, bool, "MultiMatch::open_postlists_in_parallel", first | maxitems | check_at_least | stats | postlists | Literal("termfreqandwts") | definite_matches_not_seen);
+    for (size_t i = 0; i != leaves.size(); ++i) {
+	if (!leaves[i].get() || is_remote[i]) RETURN(false);
+	// If the same database was added more than once, threads would share
+	// it, but Database objects aren't safe to use from several threads.
+	for (size_t j = 0; j != i; ++j) {
+	    if (db.internal[j].get() == db.internal[i].get()) RETURN(false);
+	}
+    }
+    if (!posting_sources_can_be_cloned(query)) RETURN(false);
+
+    // Sharing the minimum weight lets each sub-database skip documents which
+    // can't make the MSet because of documents already found in the others.
+    // That's not valid if we're collapsing (since the documents found in the
+    // others might be collapsed away) or if we're primarily sorting by value.
+    SharedMinWeight shared;
+    SharedMinWeight * shared_ptr = NULL;
+    if (collapse_max == 0 && (sort_by == REL || sort_by == REL_VAL))
+	shared_ptr = &shared;
+
+    // If there are more threads than sub-databases, split each sub-database
+    // into ranges of docids so that all the threads have something to do.
+    size_t n_ranges = 1;
+    if (match_threads > leaves.size()) n_ranges = match_threads / leaves.size();
+
+    vector<ShardMatch> shards;
+    bool ok = true;
+    try {
+	shards.reserve(leaves.size() * n_ranges);
+	for (size_t i = 0; i != leaves.size(); ++i) {
+	    Xapian::Database::Internal * subdb = db.internal[i].get();
+	    Xapian::docid last = 0;
+	    size_t n = 1;
+	    if (n_ranges > 1) {
+		last = subdb->get_lastdocid();
+		if (last >= n_ranges) n = n_ranges;
+	    }
+	    size_t first_shard = shards.size();
+	    for (size_t r = 0; r != n; ++r) {
+		shards.push_back(ShardMatch());
+		ShardMatch & shard = shards.back();
+		shard.subdb = i;
+		if (n == 1) {
+		    shard.leaf = leaves[i];
+		    break;
+		}
+		// Calculate the range bounds using double to avoid overflow.
+		shard.range_begin = Xapian::docid(double(last) * r / n) + 1;
+		shard.range_end = Xapian::docid(double(last) * (r + 1) / n);
+		if (r == 0) {
+		    shard.leaf = leaves[i];
+		    continue;
+		}
+		// Database objects aren't safe to use from several threads at
+		// once, so the other ranges each read from a snapshot.
+		Xapian::Database::Internal * snapshot;
+		snapshot = subdb->open_snapshot(r - 1);
+		if (!snapshot) {
+		    // Just match this sub-database as a whole.
+		    shards.resize(first_shard + 1);
+		    shards.back().range_begin = shards.back().range_end = 0;
+		    break;
+		}
+		shard.snapshot = snapshot;
+		LocalSubMatch * local;
+		local = static_cast<LocalSubMatch*>(leaves[i].get());
+		shard.leaf = local->clone_for(snapshot);
+	    }
+	}
+	// With a single sub-database which can't be split, there's nothing
+	// to gain from using another thread.
+	if (shards.size() <= 1) RETURN(false);
+
+	// Build the postlist trees in this thread, since doing so copies
+	// Query objects, and their reference counts aren't safe to update
+	// from several threads at once.
+	for (size_t i = 0; i != shards.size(); ++i) {
+	    ShardMatch & shard = shards[i];
+	    Xapian::Database::Internal * subdb = shard.snapshot.get();
+	    if (!subdb) subdb = db.internal[shard.subdb].get();
+	    shard.matcher = new MultiMatch(*this, shard.leaf.get(), subdb,
+					   shared_ptr);
+	    shard.matcher->open_postlists(0, first + maxitems,
+					  first + check_at_least, stats,
+					  shard.postlists,
+					  shard.termfreqandwts,
+					  shard.total_subqs,
+					  shard.definite_matches_not_seen);
+	    if (shard.range_begin) {
+		PostList *& pl = shard.postlists.front();
+		pl = new DocidRangePostList(pl,
+					    shard.range_begin, shard.range_end,
+					    subdb->get_lastdocid(),
+					    shard.matcher);
+	    }
+	}
+    } catch (...) {
+	ok = false;
+    }
+
+    if (ok) {
+	size_t n_threads = min(size_t(match_threads), shards.size());
+	size_t next_shard = 0;
+	Mutex mutex;
+	vector<ShardMatchThread *> threads;
+	threads.reserve(n_threads);
+	for (size_t t = 0; t != n_threads; ++t) {
+	    threads.push_back(new ShardMatchThread(shards, next_shard, mutex,
+						   first + maxitems,
+						   first + check_at_least));
+	}
+	// This thread does its share of the work rather than just waiting.
+	for (size_t t = 1; t != n_threads; ++t) {
+	    threads[t]->start();
+	}
+	threads[0]->run();
+	for (size_t t = 0; t != n_threads; ++t) {
+	    threads[t]->join();
+	    delete threads[t];
+	}
+    }
+
+    for (size_t i = 0; i != shards.size(); ++i) {
+	ShardMatch & shard = shards[i];
+	if (shard.failed) ok = false;
+	// Any postlists still here weren't handed over to run_match().
+	for (size_t j = 0; j != shard.postlists.size(); ++j) {
+	    delete shard.postlists[j];
+	}
+	delete shard.matcher;
+    }
+    if (!ok) {
+	LOGLINE(MATCH, "Parallel match failed, falling back to serial match");
+	RETURN(false);
+    }
+
+    bool decreasing_relevance = (sort_by == REL || sort_by == REL_VAL);
+    // If a sub-database was split into ranges, use the percentage factor
+    // from the range which found the highest weight, as that's where the
+    // highest weighted document from the sub-database will come from.
+    shard_percent_factors.assign(leaves.size(), 0.0);
+    vector<double> max_attained(leaves.size(), -1.0);
+    shard_subdbs.clear();
+    shard_subdbs.reserve(shards.size());
+    for (size_t i = 0; i != shards.size(); ++i) {
+	const Xapian::MSet & shard_mset = shards[i].mset;
+	size_t subdb = shards[i].subdb;
+	if (shard_mset.get_max_attained() > max_attained[subdb]) {
+	    max_attained[subdb] = shard_mset.get_max_attained();
+	    shard_percent_factors[subdb] = shard_mset.internal->percent_factor;
+	}
+	shard_subdbs.push_back(subdb);
+	if (termfreqandwts.empty())
+	    termfreqandwts = shard_mset.internal->termfreqandwts;
+	PostList * pl = new MSetPostList(shard_mset, decreasing_relevance,
+					 true);
+	if (pl->get_termfreq_min() > first + maxitems) {
+	    LOGLINE(MATCH, "Found " <<
+			   pl->get_termfreq_min() - (first + maxitems)
+			   << " definite matches in parallel submatch "
+			   "which aren't passed to the merge");
+	    definite_matches_not_seen += pl->get_termfreq_min();
+	    definite_matches_not_seen -= first + maxitems;
+	}
+	postlists.push_back(pl);
+    }
+    RETURN(true);
+}
+
+void
+MultiMatch::run_match(vector<PostList *> & postlists,
+		      const map<string, Xapian::MSet::Internal::TermFreqAndWeight> & termfreqandwts,
+		      Xapian::termcount total_subqs,
+		      Xapian::doccount definite_matches_not_seen,
+		      Xapian::doccount first, Xapian::doccount maxitems,
+		      Xapian::doccount check_at_least,
+		      Xapian::MSet & mset,
+		      const Xapian::MatchDecider *mdecider,
+		      const Xapian::KeyMaker *sorter)
+{
+    LOGCALL_VOID(MATCH, "MultiMatch::run_match", postlists | Literal("termfreqandwts") | total_subqs | definite_matches_not_seen | first | maxitems | check_at_least | Literal("mset") | Literal("mdecider") | Literal("sorter"));
+
+    TimeOut timeout(time_limit);
 
     ValueStreamDocument vsdoc(db);
     ++vsdoc._refs;
@@ -477,8 +878,15 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
     if (postlists.size() == 1) {
 	pl.reset(postlists.front());
     } else {
-	pl.reset(new MergePostList(postlists, this, vsdoc, errorhandler));
+	vector<unsigned> subdbs(shard_subdbs);
+	if (subdbs.empty()) {
+	    // One postlist for each sub-database.
+	    for (size_t i = 0; i != postlists.size(); ++i) subdbs.push_back(i);
+	}
+	pl.reset(new MergePostList(postlists, subdbs, db.internal.size(),
+				   this, vsdoc, errorhandler));
     }
+    postlists.clear();
 
     LOGLINE(MATCH, "pl = (" << pl->get_description() << ")");
 
@@ -495,9 +903,7 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
     Xapian::doccount docs_matched = 0;
     double greatest_wt = 0;
     Xapian::termcount greatest_wt_subqs_matched = 0;
-#ifdef XAPIAN_HAS_REMOTE_BACKEND
     unsigned greatest_wt_subqs_db_num = UINT_MAX;
-#endif
     vector<Xapian::Internal::MSetItem> items;
 
     // maximum weight a document could possibly have
@@ -579,7 +985,8 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
     percent_cutoff_factor -= DBL_EPSILON;
 
     // Object to handle collapsing.
-    Collapser collapser(collapse_key, collapse_max);
+    Collapser collapser(collapse_key, collapse_max,
+			collapse_limit, collapse_approximate);
 
     /// Comparison functor for sorting MSet
     bool sort_forward = (order != Xapian::Enquire::DESCENDING);
@@ -600,6 +1007,39 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
     // Is the mset a valid heap?
     bool is_heap = false;
 
+    // Has min_weight been raised by a sub-match running in parallel?  If so,
+    // we won't see all the matches even if the proto-mset doesn't fill up.
+    bool min_weight_shared = false;
+    unsigned candidates = 0;
+
+    // When sorting by value alone with nothing which needs to see each item
+    // (a match decider, match spy, collapsing or cutoffs), we keep the
+    // proto-mset in a SortKeyHeap instead of items, which is much cheaper.
+    SortKeyHeap value_heap(max_msize, sort_value_forward, sort_forward);
+    bool use_value_heap = (sort_by == VAL && !mdecider && !matchspy &&
+			   !collapser && !percent_cutoff && min_weight == 0.0);
+    // If documents arrive in ascending docid order and lower docids win
+    // ties, then once the proto-mset is full of documents with the best
+    // possible key for the slot, no later document can displace any of them.
+    const string * best_key = NULL;
+    string best_possible_key;
+    if (use_value_heap && !sorter && sort_forward &&
+	leaves.size() == 1 && shard_subdbs.empty()) {
+	try {
+	    if (sort_value_forward) {
+		best_possible_key = db.get_value_upper_bound(sort_key);
+	    } else if (db.get_value_freq(sort_key) == db.get_doccount()) {
+		best_possible_key = db.get_value_lower_bound(sort_key);
+	    }
+	    // Otherwise some documents have no value in the slot, so the best
+	    // key for an ascending sort is the empty string.
+	    best_key = &best_possible_key;
+	} catch (const Xapian::UnimplementedError &) {
+	    // The backend doesn't track value bounds.
+	}
+    }
+    string key;
+
     while (true) {
 	bool pushback;
 
@@ -612,6 +1052,22 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 	    }
 	}
 
+	// Checking the shared minimum weight involves locking a mutex, so we
+	// only check it periodically.
+	if (shared_min_weight && rare((++candidates & 63) == 0)) {
+	    double w = shared_min_weight->get();
+	    if (w > min_weight) {
+		LOGLINE(MATCH, "Setting min_weight to " << w << " from " <<
+			min_weight << " found by another sub-match");
+		min_weight = w;
+		min_weight_shared = true;
+		if (rare(getorrecalc_maxweight(pl.get()) < min_weight)) {
+		    LOGLINE(MATCH, "*** TERMINATING EARLY (4)");
+		    break;
+		}
+	    }
+	}
+
 	PostList * pl_copy = pl.get();
 	if (rare(next_handling_prune(pl_copy, min_weight, this))) {
 	    (void)pl.release();
@@ -656,8 +1112,40 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 	    check_at_least = maxitems;
 	}
 
+	if (use_value_heap) {
+	    const string * key_ptr = pl->get_sort_key();
+	    if (!key_ptr) {
+		if (sorter) {
+		    key = (*sorter)(doc);
+		} else {
+		    key = vsdoc.get_value(sort_key);
+		}
+		key_ptr = &key;
+	    }
+	    ++docs_matched;
+	    if (!calculated_weight) wt = pl->get_weight();
+	    value_heap.add(*key_ptr, did, wt);
+	    if (wt > greatest_wt) goto new_greatest_weight;
+	    // We also need to have seen the greatest weight, since it's used
+	    // to calculate percentages (this is always true for a boolean
+	    // query).
+	    if (best_key && greatest_wt >= max_possible &&
+		docs_matched >= check_at_least &&
+		value_heap.full_with_worst_key(*best_key)) {
+		LOGLINE(MATCH, "*** TERMINATING EARLY (5)");
+		break;
+	    }
+	    continue;
+	}
+
 	if (sort_by != REL) {
-	    if (sorter) {
+	    // If the entry comes from an MSet, it already has its sort key,
+	    // and we may not be able to read values in the order the MSet
+	    // returns documents.
+	    const string * key_ptr = pl->get_sort_key();
+	    if (key_ptr) {
+		new_item.sort_key = *key_ptr;
+	    } else if (sorter) {
 		new_item.sort_key = (*sorter)(doc);
 	    } else {
 		new_item.sort_key = vsdoc.get_value(sort_key);
@@ -730,7 +1218,10 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 	// Perform collapsing on key if requested.
 	if (collapser) {
 	    collapse_result res;
-	    res = collapser.process(new_item, pl.get(), vsdoc, mcmp);
+	    // min_item is only meaningful once the proto-mset has filled up
+	    // (items never have docid 0).
+	    res = collapser.process(new_item, pl.get(), vsdoc, mcmp,
+				    min_item.did ? &min_item : NULL);
 	    if (res == REJECTED) {
 		// If we're sorting by relevance primarily, then we throw away
 		// the lower weighted document anyway.
@@ -814,6 +1305,8 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 			    LOGLINE(MATCH, "Setting min_weight to " <<
 				    min_item.wt << " from " << min_weight);
 			    min_weight = min_item.wt;
+			    if (shared_min_weight)
+				shared_min_weight->raise(min_weight);
 			}
 		    }
 		}
@@ -846,20 +1339,15 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 	if (wt > greatest_wt) {
 new_greatest_weight:
 	    greatest_wt = wt;
-#ifdef XAPIAN_HAS_REMOTE_BACKEND
 	    const unsigned int multiplier = db.internal.size();
 	    unsigned int db_num = (did - 1) % multiplier;
-	    if (is_remote[db_num]) {
-		// Note that the greatest weighted document came from a remote
-		// database, and which one.
+	    if (is_remote[db_num] || !shard_percent_factors.empty()) {
+		// Note that the greatest weighted document came from an MSet
+		// for a remote database or a parallel match, and which one.
 		greatest_wt_subqs_db_num = db_num;
-	    } else
-#endif
-	    {
+	    } else {
 		greatest_wt_subqs_matched = pl->count_matching_subqs();
-#ifdef XAPIAN_HAS_REMOTE_BACKEND
 		greatest_wt_subqs_db_num = UINT_MAX;
-#endif
 	    }
 	    if (percent_cutoff) {
 		double w = wt * percent_cutoff_factor;
@@ -890,17 +1378,22 @@ new_greatest_weight:
     // done with posting list tree
     pl.reset(NULL);
 
+    if (use_value_heap) value_heap.get_items(items);
+
     double percent_scale = 0;
     if (!items.empty() && greatest_wt > 0) {
-#ifdef XAPIAN_HAS_REMOTE_BACKEND
 	if (greatest_wt_subqs_db_num != UINT_MAX) {
 	    const unsigned int n = greatest_wt_subqs_db_num;
-	    RemoteSubMatch * rem_match;
-	    rem_match = static_cast<RemoteSubMatch*>(leaves[n].get());
-	    percent_scale = rem_match->get_percent_factor() / 100.0;
-	} else
+	    if (!shard_percent_factors.empty()) {
+		percent_scale = shard_percent_factors[n] / 100.0;
+	    } else {
+#ifdef XAPIAN_HAS_REMOTE_BACKEND
+		RemoteSubMatch * rem_match;
+		rem_match = static_cast<RemoteSubMatch*>(leaves[n].get());
+		percent_scale = rem_match->get_percent_factor() / 100.0;
 #endif
-	{
+	    }
+	} else {
 	    percent_scale = greatest_wt_subqs_matched / double(total_subqs);
 	    percent_scale /= greatest_wt;
 	}
@@ -945,7 +1438,7 @@ new_greatest_weight:
     Xapian::doccount uncollapsed_lower_bound = matches_lower_bound;
     Xapian::doccount uncollapsed_upper_bound = matches_upper_bound;
     Xapian::doccount uncollapsed_estimated = matches_estimated;
-    if (items.size() < max_msize) {
+    if (items.size() < max_msize && !min_weight_shared) {
 	// We have fewer items in the mset than we tried to get for it, so we
 	// must have all the matches in it.
 	LOGLINE(MATCH, "items.size() = " << items.size() <<
@@ -956,7 +1449,8 @@ new_greatest_weight:
 	    = items.size();
 	if (collapser && matches_lower_bound > uncollapsed_lower_bound)
 	    uncollapsed_lower_bound = matches_lower_bound;
-    } else if (!collapser && docs_matched < check_at_least) {
+    } else if (!collapser && docs_matched < check_at_least &&
+	       !min_weight_shared) {
 	// We have seen fewer matches than we checked for, so we must have seen
 	// all the matches.
 	LOGLINE(MATCH, "Setting bounds equal");
@@ -1088,6 +1582,16 @@ new_greatest_weight:
     }
 
     if (collapser) {
+	LOGLINE(MATCH, "Collapse table: " << collapser.get_table_keys() <<
+		" keys in " << collapser.get_table_buckets() <<
+		" buckets, peak " << collapser.get_peak_keys() <<
+		" keys, " << collapser.get_keys_forgotten() << " forgotten");
+	if (profile) {
+	    profile->collapse_keys = collapser.get_table_keys();
+	    profile->collapse_buckets = collapser.get_table_buckets();
+	    profile->collapse_peak_keys = collapser.get_peak_keys();
+	    profile->collapse_keys_forgotten = collapser.get_keys_forgotten();
+	}
 	AssertRel(uncollapsed_lower_bound,<=,uncollapsed_upper_bound);
 	if (uncollapsed_estimated < uncollapsed_lower_bound) {
 	    uncollapsed_estimated = uncollapsed_lower_bound;
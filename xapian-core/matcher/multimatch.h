@@ -26,11 +26,16 @@
 
 #include "submatch.h"
 
+#include <map>
+#include <string>
 #include <vector>
 
+#include "api/matchprofileinternal.h"
 #include "xapian/query.h"
 #include "xapian/weight.h"
 
+class SharedMinWeight;
+
 class MultiMatch
 {
     private:
@@ -45,6 +50,12 @@ class MultiMatch
 
 	Xapian::valueno collapse_key;
 
+	/// Number of collapse key values to track (0 for no limit).
+	Xapian::doccount collapse_limit;
+
+	/// Only track the hash of each collapse key value?
+	bool collapse_approximate;
+
 	int percent_cutoff;
 
 	double weight_cutoff;
@@ -59,6 +70,9 @@ class MultiMatch
 
 	double time_limit;
 
+	/// The number of threads to use to match sub-databases in parallel.
+	unsigned match_threads;
+
 	/// ErrorHandler
 	Xapian::ErrorHandler * errorhandler;
 
@@ -76,6 +90,29 @@ class MultiMatch
 	/// The matchspies to use.
 	const vector<Xapian::MatchSpy *> & matchspies;
 
+	/** Minimum weight shared with sub-matches running in parallel.
+	 *
+	 *  This is NULL unless this object is matching a single sub-database
+	 *  in a worker thread on behalf of a parallel match.
+	 */
+	SharedMinWeight * shared_min_weight;
+
+	/** The percentage factors of the MSets from a parallel match.
+	 *
+	 *  This is empty unless we matched the sub-databases in parallel.
+	 */
+	vector<double> shard_percent_factors;
+
+	/** The sub-database each postlist from a parallel match came from.
+	 *
+	 *  This is empty unless we matched in parallel.  A sub-database which
+	 *  was split into ranges of docids has a postlist for each range.
+	 */
+	vector<unsigned> shard_subdbs;
+
+	/// The profile to record in, or NULL if we aren't profiling.
+	Xapian::MatchProfile::Internal * profile;
+
 	/** get the maxweight that the postlist pl may return, calling
 	 *  recalc_maxweight if recalculate_w_max is set, and unsetting it.
 	 *  Must only be called on the top of the postlist tree.
@@ -88,6 +125,77 @@ class MultiMatch
 	/// Assignment is not permitted.
 	void operator=(const MultiMatch &);
 
+	/** Construct a MultiMatch to match one sub-database of another.
+	 *
+	 *  @param parent	The MultiMatch for all the sub-databases.
+	 *  @param leaf	The (local) SubMatch to run.
+	 *  @param subdb	The sub-database @a leaf searches.
+	 *  @param shared_min_weight_	Minimum weight shared with the other
+	 *				sub-databases (or NULL not to share).
+	 */
+	MultiMatch(const MultiMatch & parent, SubMatch * leaf,
+		   Xapian::Database::Internal * subdb,
+		   SharedMinWeight * shared_min_weight_);
+
+	/** Start the SubMatch objects and build their postlists.
+	 *
+	 *  @param postlists	Vector to append a postlist for each leaf to.
+	 *  @param termfreqandwts	Set to the term frequency and weight
+	 *				information.
+	 *  @param total_subqs	Set to the number of subqueries.
+	 *  @param definite_matches_not_seen	Set to the number of matches
+	 *					which remote sub-matches found
+	 *					but didn't return.
+	 */
+	void open_postlists(Xapian::doccount first,
+			   Xapian::doccount maxitems,
+			   Xapian::doccount check_at_least,
+			   const Xapian::Weight::Internal & stats,
+			   std::vector<PostList *> & postlists,
+			   std::map<std::string,
+				    Xapian::MSet::Internal::TermFreqAndWeight> & termfreqandwts,
+			   Xapian::termcount & total_subqs,
+			   Xapian::doccount & definite_matches_not_seen);
+
+	/** Match each sub-database in a worker thread.
+	 *
+	 *  If there are more threads than sub-databases, sub-databases are
+	 *  also split into ranges of docids which are matched separately.
+	 *
+	 *  On success, @a postlists has an MSetPostList appended for each
+	 *  sub-database (or range), returning the entries from its MSet.
+	 *
+	 *  @return	true if the parallel match succeeded; false if it failed,
+	 *		in which case the caller should perform the match serially
+	 *		(which will handle any errors in the usual way).
+	 */
+	bool open_postlists_in_parallel(Xapian::doccount first,
+			   Xapian::doccount maxitems,
+			   Xapian::doccount check_at_least,
+			   const Xapian::Weight::Internal & stats,
+			   std::vector<PostList *> & postlists,
+			   std::map<std::string,
+				    Xapian::MSet::Internal::TermFreqAndWeight> & termfreqandwts,
+			   Xapian::doccount & definite_matches_not_seen);
+
+	/** Run the match over the postlists from open_postlists().
+	 *
+	 *  This takes ownership of the postlists in @a postlists.
+	 */
+	void run_match(std::vector<PostList *> & postlists,
+		       const std::map<std::string,
+				      Xapian::MSet::Internal::TermFreqAndWeight> & termfreqandwts,
+		       Xapian::termcount total_subqs,
+		       Xapian::doccount definite_matches_not_seen,
+		       Xapian::doccount first,
+		       Xapian::doccount maxitems,
+		       Xapian::doccount check_at_least,
+		       Xapian::MSet & mset,
+		       const Xapian::MatchDecider * mdecider,
+		       const Xapian::KeyMaker * sorter);
+
+	friend class ShardMatchThread;
+
     public:
 	/** MultiMatch constructor.
 	 *
@@ -95,8 +203,14 @@ class MultiMatch
 	 *  @param query     The query
 	 *  @param qlen      The query length
 	 *  @param omrset    The relevance set (or NULL for no RSet)
+	 *  @param collapse_limit_ Number of collapse key values to track
+	 *			   (0 for no limit)
+	 *  @param collapse_approximate_ Only track the hash of each collapse
+	 *				 key value?
 	 *  @param time_limit_ Seconds to reduce check_at_least after (or <= 0
 	 *                     for no limit)
+	 *  @param match_threads_ Number of threads to match sub-databases in
+	 *			  parallel with (or <= 1 to match serially)
 	 *  @param errorhandler Errorhandler object
 	 *  @param stats     The stats object to add our stats to.
 	 *  @param wtscheme  Weighting scheme
@@ -110,6 +224,8 @@ class MultiMatch
 		   const Xapian::RSet * omrset,
 		   Xapian::doccount collapse_max_,
 		   Xapian::valueno collapse_key_,
+		   Xapian::doccount collapse_limit_,
+		   bool collapse_approximate_,
 		   int percent_cutoff_,
 		   double weight_cutoff_,
 		   Xapian::Enquire::docid_order order_,
@@ -117,6 +233,7 @@ class MultiMatch
 		   Xapian::Enquire::Internal::sort_setting sort_by_,
 		   bool sort_value_forward_,
 		   double time_limit_,
+		   unsigned match_threads_,
 		   Xapian::ErrorHandler * errorhandler,
 		   Xapian::Weight::Internal & stats,
 		   const Xapian::Weight *wtscheme,
@@ -135,6 +252,18 @@ class MultiMatch
 		      const Xapian::MatchDecider * mdecider,
 		      const Xapian::KeyMaker * sorter);
 
+	/** Record where the match spends its time in @a profile_.
+	 *
+	 *  Must be called before get_mset().  Setting a profile stops the
+	 *  sub-databases being matched in parallel.
+	 */
+	void set_profile(Xapian::MatchProfile::Internal * profile_) {
+	    profile = profile_;
+	}
+
+	/// Return the profile to record in, or NULL if we aren't profiling.
+	Xapian::MatchProfile::Internal * get_profile() const { return profile; }
+
 	/** Called by postlists to indicate that they've rearranged themselves
 	 *  and the maxweight now possible is smaller.
 	 */
@@ -38,7 +38,7 @@ class PositionListCmpLt {
     public:
 	/** Return true if and only if a is strictly shorter than b.
 	 */
-        bool operator()(const PositionList *a, const PositionList *b) {
+        bool operator()(const PositionBuffer *a, const PositionBuffer *b) {
             return a->get_size() < b->get_size();
         }
 };
@@ -50,30 +50,30 @@ bool
 NearPostList::test_doc()
 {
     LOGCALL(MATCH, bool, "NearPostList::test_doc", NO_ARGS);
-    std::vector<PositionList *> plists;
+    std::vector<PositionBuffer *> plists;
 
     std::vector<PostList *>::const_iterator i;
     for (i = terms.begin(); i != terms.end(); ++i) {
 	PositionList * p = (*i)->read_position_list();
 	// If p is NULL, the backend doesn't support positionlists
 	if (!p) return false;
-	plists.push_back(p);
+	PositionBuffer * buf = &buffers[i - terms.begin()];
+	buf->read(p);
+	plists.push_back(buf);
     }
 
     std::sort(plists.begin(), plists.end(), PositionListCmpLt());
 
-    Xapian::termpos pos;
-    do {
-	plists[0]->next();
-	if (plists[0]->at_end()) RETURN(false);
-	pos = plists[0]->get_position();
-    } while (!do_test(plists, 1, pos, pos));
+    for ( ; !plists[0]->at_end(); plists[0]->next()) {
+	Xapian::termpos pos = plists[0]->get_position();
+	if (do_test(plists, 1, pos, pos)) RETURN(true);
+    }
 
-    RETURN(true);
+    RETURN(false);
 }
 
 bool
-NearPostList::do_test(std::vector<PositionList *> &plists, Xapian::termcount i,
+NearPostList::do_test(std::vector<PositionBuffer *> &plists, Xapian::termcount i,
 		      Xapian::termcount min, Xapian::termcount max)
 {
     LOGCALL(MATCH, bool, "NearPostList::do_test", plists | i | min | max);
@@ -176,38 +176,37 @@ bool
 PhrasePostList::test_doc()
 {
     LOGCALL(MATCH, bool, "PhrasePostList::test_doc", NO_ARGS);
-    std::vector<PositionList *> plists;
+    std::vector<PositionBuffer *> plists;
 
     std::vector<PostList *>::const_iterator i;
     for (i = terms.begin(); i != terms.end(); ++i) {
 	PositionList * p = (*i)->read_position_list();
 	// If p is NULL, the backend doesn't support positionlists
 	if (!p) return false;
-	p->index = i - terms.begin();
-	plists.push_back(p);
+	PositionBuffer * buf = &buffers[i - terms.begin()];
+	buf->read(p);
+	buf->index = i - terms.begin();
+	plists.push_back(buf);
     }
 
     std::sort(plists.begin(), plists.end(), PositionListCmpLt());
 
-    Xapian::termpos pos;
-    Xapian::termpos idx, min;
-    do {
-	plists[0]->next();
-	if (plists[0]->at_end()) {
-	    LOGLINE(MATCH, "--MISS--");
-	    RETURN(false);
-	}
-	pos = plists[0]->get_position();
-	idx = plists[0]->index;
-	min = pos + plists.size() - idx;
+    for ( ; !plists[0]->at_end(); plists[0]->next()) {
+	Xapian::termpos pos = plists[0]->get_position();
+	Xapian::termpos idx = plists[0]->index;
+	Xapian::termpos min = pos + plists.size() - idx;
 	if (min > window) min -= window; else min = 0;
-    } while (!do_test(plists, 1, min, pos + window - idx));
-    LOGLINE(MATCH, "**HIT**");
-    RETURN(true);
+	if (do_test(plists, 1, min, pos + window - idx)) {
+	    LOGLINE(MATCH, "**HIT**");
+	    RETURN(true);
+	}
+    }
+    LOGLINE(MATCH, "--MISS--");
+    RETURN(false);
 }
 
 bool
-PhrasePostList::do_test(std::vector<PositionList *> &plists, Xapian::termcount i,
+PhrasePostList::do_test(std::vector<PositionBuffer *> &plists, Xapian::termcount i,
 			Xapian::termcount min, Xapian::termcount max)
 {
     LOGCALL(MATCH, bool, "PhrasePostList::do_test", plists | i | min | max);
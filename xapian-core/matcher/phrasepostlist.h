@@ -25,10 +25,9 @@
 #define OM_HGUARD_PHRASEPOSTLIST_H
 
 #include "selectpostlist.h"
+#include "positionbuffer.h"
 #include <vector>
 
-typedef Xapian::PositionIterator::Internal PositionList;
-
 /** a postlist comprising several postlists NEARed together.
  *
  *  This postlist returns a posting if and only if it is in all of the
@@ -41,8 +40,11 @@ class NearPostList : public SelectPostList {
         Xapian::termpos window;
 	std::vector<PostList *> terms;
 
+	/// The decoded positions for each term, reused for each document.
+	std::vector<PositionBuffer> buffers;
+
     	bool test_doc();
-        bool do_test(std::vector<PositionList *> &plists, Xapian::termcount i,
+        bool do_test(std::vector<PositionBuffer *> &plists, Xapian::termcount i,
 		     Xapian::termcount min, Xapian::termcount max);
     public:
 	std::string get_description() const;
@@ -60,7 +62,8 @@ class NearPostList : public SelectPostList {
         NearPostList(PostList *source_, Xapian::termpos window_,
 		     std::vector<PostList *>::const_iterator &terms_begin_,
 		     std::vector<PostList *>::const_iterator &terms_end_)
-	    : SelectPostList(source_), terms(terms_begin_, terms_end_)
+	    : SelectPostList(source_), terms(terms_begin_, terms_end_),
+	      buffers(terms.size())
         {
 	    window = window_;
 	}
@@ -78,8 +81,11 @@ class PhrasePostList : public SelectPostList {
         Xapian::termpos window;
 	std::vector<PostList *> terms;
 
+	/// The decoded positions for each term, reused for each document.
+	std::vector<PositionBuffer> buffers;
+
     	bool test_doc();
-        bool do_test(std::vector<PositionList *> &plists, Xapian::termcount i,
+        bool do_test(std::vector<PositionBuffer *> &plists, Xapian::termcount i,
 		     Xapian::termcount min, Xapian::termcount max);
     public:
 	std::string get_description() const;
@@ -97,7 +103,8 @@ class PhrasePostList : public SelectPostList {
         PhrasePostList(PostList *source_, Xapian::termpos window_,
 		       std::vector<PostList *>::const_iterator &terms_begin_,
 		       std::vector<PostList *>::const_iterator &terms_end_)
-	    : SelectPostList(source_), terms(terms_begin_, terms_end_)
+	    : SelectPostList(source_), terms(terms_begin_, terms_end_),
+	      buffers(terms.size())
         {
 	    window = window_;
 	}
@@ -0,0 +1,93 @@
+/** @file positionbuffer.h
+ * @brief A decoded position list, for checking phrase and near conditions.
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#ifndef XAPIAN_INCLUDED_POSITIONBUFFER_H
+#define XAPIAN_INCLUDED_POSITIONBUFFER_H
+
+#include "backends/positionlist.h"
+#include "omassert.h"
+
+#include <algorithm>
+#include <vector>
+
+/** The positions of a term in the current document, decoded into a buffer.
+ *
+ *  The interface is like PositionList's, except that a PositionBuffer
+ *  starts at its first position, and its methods aren't virtual.
+ *  skip_to() gallops forwards, so skipping a long way costs O(log(distance))
+ *  rather than a step per position.
+ *
+ *  The buffer is reused for each document, which avoids allocating memory
+ *  once it has grown to the size of the longest list seen.
+ */
+class PositionBuffer {
+    /// The positions.
+    std::vector<Xapian::termpos> positions;
+
+    /// Offset of the current position.
+    size_t i;
+
+  public:
+    /// The term's offset in the phrase, for ExactPhrasePostList.
+    Xapian::termcount index;
+
+    PositionBuffer() : i(0), index(0) { }
+
+    /// Read the positions from @a poslist, which must not have been started.
+    void read(PositionList * poslist) {
+	positions.clear();
+	i = 0;
+	poslist->append_positions(positions);
+    }
+
+    /// Return the number of positions.
+    Xapian::termcount get_size() const { return positions.size(); }
+
+    /// Return the current position.
+    Xapian::termpos get_position() const {
+	Assert(!at_end());
+	return positions[i];
+    }
+
+    /// Advance to the next position.
+    void next() { ++i; }
+
+    /// Advance to the first position which is at least @a termpos.
+    void skip_to(Xapian::termpos termpos) {
+	size_t n = positions.size();
+	if (i == n || positions[i] >= termpos) return;
+	// Gallop forwards to find a range which contains the target, then
+	// binary chop within it.  Invariant: positions[lo] < termpos.
+	size_t lo = i;
+	size_t step = 1;
+	while (lo + step < n && positions[lo + step] < termpos) {
+	    lo += step;
+	    step <<= 1;
+	}
+	size_t hi = std::min(lo + step, n);
+	i = std::lower_bound(positions.begin() + lo + 1,
+			     positions.begin() + hi,
+			     termpos) - positions.begin();
+    }
+
+    /// True if we're off the end of the list.
+    bool at_end() const { return i == positions.size(); }
+};
+
+#endif // XAPIAN_INCLUDED_POSITIONBUFFER_H
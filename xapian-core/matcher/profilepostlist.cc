@@ -0,0 +1,112 @@
+/** @file profilepostlist.cc
+ * @brief Count the calls to a postlist and the time spent in it.
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include "profilepostlist.h"
+
+#include "debuglog.h"
+#include "multimatch.h"
+#include "realtime.h"
+
+void
+ProfilePostList::handle_prune(PostList * p)
+{
+    if (p) {
+	delete pl;
+	pl = p;
+	if (matcher) matcher->recalc_maxweight();
+    }
+}
+
+double
+ProfilePostList::get_weight() const
+{
+    double start = RealTime::now();
+    double w = pl->get_weight();
+    node().time += RealTime::now() - start;
+    return w;
+}
+
+double
+ProfilePostList::recalc_maxweight()
+{
+    LOGCALL(MATCH, double, "ProfilePostList::recalc_maxweight", NO_ARGS);
+    ++node().recalc_maxweight_calls;
+    double start = RealTime::now();
+    double w = pl->recalc_maxweight();
+    node().time += RealTime::now() - start;
+    RETURN(w);
+}
+
+PositionList *
+ProfilePostList::read_position_list()
+{
+    ++node().position_lists_opened;
+    double start = RealTime::now();
+    PositionList * poslist = pl->read_position_list();
+    node().time += RealTime::now() - start;
+    return poslist;
+}
+
+PositionList *
+ProfilePostList::open_position_list() const
+{
+    ++node().position_lists_opened;
+    double start = RealTime::now();
+    PositionList * poslist = pl->open_position_list();
+    node().time += RealTime::now() - start;
+    return poslist;
+}
+
+PostList *
+ProfilePostList::next(double w_min)
+{
+    LOGCALL(MATCH, PostList *, "ProfilePostList::next", w_min);
+    ++node().next_calls;
+    double start = RealTime::now();
+    handle_prune(pl->next(w_min));
+    node().time += RealTime::now() - start;
+    count_doc();
+    RETURN(NULL);
+}
+
+PostList *
+ProfilePostList::skip_to(Xapian::docid did, double w_min)
+{
+    LOGCALL(MATCH, PostList *, "ProfilePostList::skip_to", did | w_min);
+    ++node().skip_to_calls;
+    double start = RealTime::now();
+    handle_prune(pl->skip_to(did, w_min));
+    node().time += RealTime::now() - start;
+    count_doc();
+    RETURN(NULL);
+}
+
+PostList *
+ProfilePostList::check(Xapian::docid did, double w_min, bool & valid)
+{
+    LOGCALL(MATCH, PostList *, "ProfilePostList::check", did | w_min | valid);
+    ++node().check_calls;
+    double start = RealTime::now();
+    handle_prune(pl->check(did, w_min, valid));
+    node().time += RealTime::now() - start;
+    if (valid) count_doc();
+    RETURN(NULL);
+}
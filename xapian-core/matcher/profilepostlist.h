@@ -0,0 +1,139 @@
+/** @file profilepostlist.h
+ * @brief Count the calls to a postlist and the time spent in it.
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#ifndef XAPIAN_INCLUDED_PROFILEPOSTLIST_H
+#define XAPIAN_INCLUDED_PROFILEPOSTLIST_H
+
+#include "api/postlist.h"
+#include "api/matchprofileinternal.h"
+
+class MultiMatch;
+
+/** A postlist which records the use of the postlist it wraps.
+ *
+ *  The counts are kept in a node of a MatchProfile::Internal rather than in
+ *  this object so that they survive this object being pruned from the tree.
+ *  If the wrapped postlist is pruned, we take its replacement and tell the
+ *  matcher to recalculate the maximum weight, so this object stays in the
+ *  tree until the end of the match (unless its parent prunes it).
+ */
+class ProfilePostList : public PostList {
+    /// Don't allow assignment.
+    void operator=(const ProfilePostList &);
+
+    /// Don't allow copying.
+    ProfilePostList(const ProfilePostList &);
+
+    PostList * pl;
+
+    /// The profile to record in.
+    Xapian::MatchProfile::Internal * profile;
+
+    /// The index of the node for this postlist in profile->nodes.
+    size_t index;
+
+    MultiMatch * matcher;
+
+    /// The last document counted (0 if none yet).
+    Xapian::docid last_did;
+
+    Xapian::MatchProfile::Internal::Node & node() const {
+	return profile->nodes[index];
+    }
+
+    void handle_prune(PostList * p);
+
+    /** Count the document we're now on, if we've moved.
+     *
+     *  skip_to() and check() don't move if already at or past the target.
+     */
+    void count_doc() {
+	if (pl->at_end()) return;
+	Xapian::docid did = pl->get_docid();
+	if (did != last_did) {
+	    ++node().docs;
+	    last_did = did;
+	}
+    }
+
+  public:
+    ProfilePostList(PostList * pl_, Xapian::MatchProfile::Internal * profile_,
+		    size_t index_, MultiMatch * matcher_)
+	: pl(pl_), profile(profile_), index(index_), matcher(matcher_),
+	  last_did(0) { }
+
+    ~ProfilePostList() { delete pl; }
+
+    Xapian::doccount get_termfreq_min() const {
+	return pl->get_termfreq_min();
+    }
+
+    Xapian::doccount get_termfreq_max() const {
+	return pl->get_termfreq_max();
+    }
+
+    Xapian::doccount get_termfreq_est() const {
+	return pl->get_termfreq_est();
+    }
+
+    TermFreqs get_termfreq_est_using_stats(
+	    const Xapian::Weight::Internal & stats) const {
+	return pl->get_termfreq_est_using_stats(stats);
+    }
+
+    double get_maxweight() const { return pl->get_maxweight(); }
+
+    Xapian::docid get_docid() const { return pl->get_docid(); }
+
+    Xapian::termcount get_doclength() const { return pl->get_doclength(); }
+
+    Xapian::termcount get_wdf() const { return pl->get_wdf(); }
+
+    double get_weight() const;
+
+    const std::string * get_collapse_key() const {
+	return pl->get_collapse_key();
+    }
+
+    const std::string * get_sort_key() const { return pl->get_sort_key(); }
+
+    bool at_end() const { return pl->at_end(); }
+
+    double recalc_maxweight();
+
+    PositionList * read_position_list();
+
+    PositionList * open_position_list() const;
+
+    PostList * next(double w_min);
+
+    PostList * skip_to(Xapian::docid did, double w_min);
+
+    PostList * check(Xapian::docid did, double w_min, bool & valid);
+
+    bool is_expensive() const { return pl->is_expensive(); }
+
+    Xapian::termcount count_matching_subqs() const {
+	return pl->count_matching_subqs();
+    }
+
+    std::string get_description() const { return pl->get_description(); }
+};
+
+#endif // XAPIAN_INCLUDED_PROFILEPOSTLIST_H
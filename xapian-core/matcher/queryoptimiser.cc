@@ -0,0 +1,88 @@
+/** @file queryoptimiser.cc
+ * @brief Details passed around while building PostList tree from Query tree
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include "queryoptimiser.h"
+
+#include "xapian/query.h"
+
+#include "api/matchprofileinternal.h"
+#include "debuglog.h"
+#include "profilepostlist.h"
+
+using namespace std;
+
+/// Return the label to use for @a query in a MatchProfile.
+static string
+profile_label(const Xapian::Query::Internal * query)
+{
+    switch (query->get_type()) {
+	case Xapian::Query::OP_AND:
+	    return "AND";
+	case Xapian::Query::OP_OR:
+	    return "OR";
+	case Xapian::Query::OP_AND_NOT:
+	    return "AND_NOT";
+	case Xapian::Query::OP_XOR:
+	    return "XOR";
+	case Xapian::Query::OP_AND_MAYBE:
+	    return "AND_MAYBE";
+	case Xapian::Query::OP_FILTER:
+	    return "FILTER";
+	case Xapian::Query::OP_NEAR:
+	    return "NEAR";
+	case Xapian::Query::OP_PHRASE:
+	    return "PHRASE";
+	case Xapian::Query::OP_SCALE_WEIGHT:
+	    return "SCALE_WEIGHT";
+	case Xapian::Query::OP_ELITE_SET:
+	    return "ELITE_SET";
+	case Xapian::Query::OP_SYNONYM:
+	    return "SYNONYM";
+	case Xapian::Query::OP_MAX:
+	    return "MAX";
+	default:
+	    // A leaf, so the description is short enough to use.
+	    return query->get_description();
+    }
+}
+
+PostList *
+QueryOptimiser::make_postlist(const Xapian::Query::Internal * query,
+			      double factor)
+{
+    LOGCALL(MATCH, PostList *, "QueryOptimiser::make_postlist", query | factor);
+    if (!profile) RETURN(query->postlist(this, factor));
+
+    size_t index = profile->nodes.size();
+    typedef Xapian::MatchProfile::Internal::Node Node;
+    profile->nodes.push_back(Node(profile_label(query), profile_depth));
+    PostList * pl;
+    ++profile_depth;
+    try {
+	pl = query->postlist(this, factor);
+    } catch (...) {
+	--profile_depth;
+	throw;
+    }
+    --profile_depth;
+    profile->nodes[index].termfreq_est = pl->get_termfreq_est();
+    RETURN(new ProfilePostList(pl, profile, index, matcher));
+}
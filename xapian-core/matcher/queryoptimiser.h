@@ -22,6 +22,8 @@
 #ifndef XAPIAN_INCLUDED_QUERYOPTIMISER_H
 #define XAPIAN_INCLUDED_QUERYOPTIMISER_H
 
+#include "xapian/matchprofile.h"
+
 #include "backends/database.h"
 #include "localsubmatch.h"
 #include "api/postlist.h"
@@ -50,6 +52,12 @@ class QueryOptimiser {
 
     LeafPostList * hint;
 
+    /// The profile to record in, or NULL if we aren't profiling.
+    Xapian::MatchProfile::Internal * profile;
+
+    /// The depth in the postlist tree of the next node to be profiled.
+    unsigned profile_depth;
+
   public:
     const Xapian::Database::Internal & db;
 
@@ -59,8 +67,10 @@ class QueryOptimiser {
 
     QueryOptimiser(const Xapian::Database::Internal & db_,
 		   LocalSubMatch & localsubmatch_,
-		   MultiMatch * matcher_)
+		   MultiMatch * matcher_,
+		   Xapian::MatchProfile::Internal * profile_ = NULL)
 	: localsubmatch(localsubmatch_), total_subqs(0), hint(0),
+	  profile(profile_), profile_depth(0),
 	  db(db_), db_size(db.get_doccount()), matcher(matcher_) { }
 
     void inc_total_subqs() { ++total_subqs; }
@@ -79,6 +89,14 @@ class QueryOptimiser {
 	return localsubmatch.open_post_list(&hint, term, max_part);
     }
 
+    /** Build the postlist for a subquery.
+     *
+     *  If we're profiling, the postlist is wrapped so that its use is
+     *  recorded in a new node of the profile.
+     */
+    PostList * make_postlist(const Xapian::Query::Internal * query,
+			     double factor);
+
     PostList * make_synonym_postlist(PostList * pl, double factor) {
 	return localsubmatch.make_synonym_postlist(pl, matcher, factor);
     }
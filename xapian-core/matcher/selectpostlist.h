@@ -66,6 +66,7 @@ class SelectPostList : public PostList {
 	PositionList * read_position_list() { return source->read_position_list(); }
 	PositionList * open_position_list() const { return source->open_position_list(); }
 	bool at_end() const { return source->at_end(); }
+	bool is_expensive() const { return true; }
 
 	Xapian::termcount count_matching_subqs() const {
 	    return source->count_matching_subqs();
@@ -0,0 +1,144 @@
+/** @file sortkeyheap.cc
+ * @brief Compact heap of the best documents when sorting by value.
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include "sortkeyheap.h"
+
+#include "omassert.h"
+
+#include <algorithm>
+
+using namespace std;
+
+/// Return up to 8 bytes of @a p as a big-endian integer, padded with zeros.
+static inline uint8
+key_bytes(const char * p, size_t len)
+{
+    uint8 result = 0;
+    for (size_t i = 0; i != 8; ++i) {
+	result <<= 8;
+	if (i < len) result |= static_cast<unsigned char>(p[i]);
+    }
+    return result;
+}
+
+void
+SortKeyHeap::set_key(Entry & e, const string & key) const
+{
+    size_t len = key.size();
+    e.key_hi = key_bytes(key.data(), len);
+    e.key_lo = len > 8 ? key_bytes(key.data() + 8, len - 8) : 0;
+    e.key_len = len;
+    e.long_key = CANDIDATE;
+    if (len > 16) candidate_key = &key;
+}
+
+int
+SortKeyHeap::compare_keys(const Entry & a, const Entry & b) const
+{
+    if (a.key_hi != b.key_hi) return a.key_hi < b.key_hi ? -1 : 1;
+    if (a.key_lo != b.key_lo) return a.key_lo < b.key_lo ? -1 : 1;
+    // The first 16 bytes (padded with zeros) are the same.  If either key
+    // is no longer than that, it's a prefix of the other (up to trailing
+    // zero bytes), so the shorter key sorts first.
+    if (a.key_len <= 16 || b.key_len <= 16) {
+	if (a.key_len == b.key_len) return 0;
+	return a.key_len < b.key_len ? -1 : 1;
+    }
+    const string & a_key = (a.long_key == CANDIDATE ?
+			    *candidate_key : long_keys[a.long_key]);
+    const string & b_key = (b.long_key == CANDIDATE ?
+			    *candidate_key : long_keys[b.long_key]);
+    return a_key.compare(b_key);
+}
+
+void
+SortKeyHeap::store_long_key(Entry & e)
+{
+    if (e.key_len <= 16) return;
+    AssertEq(e.long_key, CANDIDATE);
+    if (free_long_keys.empty()) {
+	e.long_key = long_keys.size();
+	long_keys.push_back(*candidate_key);
+    } else {
+	e.long_key = free_long_keys.back();
+	free_long_keys.pop_back();
+	// Assigning reuses the string's existing buffer if it's big enough.
+	long_keys[e.long_key] = *candidate_key;
+    }
+}
+
+bool
+SortKeyHeap::add(const string & key, Xapian::docid did, double wt)
+{
+    if (max_size == 0) return false;
+
+    Entry e;
+    set_key(e, key);
+    e.did = did;
+    e.wt = wt;
+
+    if (entries.size() < max_size) {
+	store_long_key(e);
+	entries.push_back(e);
+	if (entries.size() == max_size)
+	    make_heap(entries.begin(), entries.end(), Cmp(this));
+	return true;
+    }
+
+    if (!ranks_above(e, entries.front())) return false;
+
+    // Replace the worst entry.
+    pop_heap(entries.begin(), entries.end(), Cmp(this));
+    Entry & worst = entries.back();
+    if (worst.key_len > 16) free_long_keys.push_back(worst.long_key);
+    store_long_key(e);
+    worst = e;
+    push_heap(entries.begin(), entries.end(), Cmp(this));
+    return true;
+}
+
+bool
+SortKeyHeap::full_with_worst_key(const string & key) const
+{
+    if (max_size == 0 || entries.size() < max_size) return false;
+    Entry e;
+    set_key(e, key);
+    return compare_keys(e, entries.front()) == 0;
+}
+
+void
+SortKeyHeap::get_items(vector<Xapian::Internal::MSetItem> & items) const
+{
+    items.reserve(items.size() + entries.size());
+    vector<Entry>::const_iterator i;
+    for (i = entries.begin(); i != entries.end(); ++i) {
+	items.push_back(Xapian::Internal::MSetItem(i->wt, i->did));
+	string & key = items.back().sort_key;
+	if (i->key_len > 16) {
+	    key = long_keys[i->long_key];
+	} else {
+	    for (size_t j = 0; j != i->key_len; ++j) {
+		uint8 word = (j < 8 ? i->key_hi : i->key_lo);
+		key += char((word >> (56 - 8 * (j % 8))) & 0xff);
+	    }
+	}
+    }
+}
@@ -0,0 +1,149 @@
+/** @file sortkeyheap.h
+ * @brief Compact heap of the best documents when sorting by value.
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#ifndef XAPIAN_INCLUDED_SORTKEYHEAP_H
+#define XAPIAN_INCLUDED_SORTKEYHEAP_H
+
+#include "api/omenquireinternal.h"
+#include "internaltypes.h"
+
+#include <string>
+#include <vector>
+
+/** Keep the best documents seen so far when sorting by value alone.
+ *
+ *  This does the job of the heap of MSetItem objects in MultiMatch, but
+ *  stores the first 16 bytes of each sort key inline as integers, which is
+ *  all of the key for the output of sortable_serialise() and for most
+ *  dates.  Longer keys are stored in a pool of strings which is reused as
+ *  entries are replaced, so adding a document doesn't allocate memory, and
+ *  moving entries around the heap doesn't copy any strings.
+ */
+class SortKeyHeap {
+    /// Don't allow assignment.
+    void operator=(const SortKeyHeap &);
+
+    /// Don't allow copying.
+    SortKeyHeap(const SortKeyHeap &);
+
+    struct Entry {
+	/// The first 8 bytes of the sort key, as a big-endian integer.
+	uint8 key_hi;
+
+	/// The next 8 bytes of the sort key, as a big-endian integer.
+	uint8 key_lo;
+
+	/// The length of the sort key.
+	size_t key_len;
+
+	/** The index of the whole sort key in long_keys.
+	 *
+	 *  Only used if key_len > 16.  CANDIDATE means the key is in
+	 *  *candidate_key instead.
+	 */
+	unsigned long_key;
+
+	Xapian::docid did;
+
+	double wt;
+    };
+
+    /// Comparison functor which puts the worst entry at the top of the heap.
+    struct Cmp {
+	const SortKeyHeap * heap;
+
+	Cmp(const SortKeyHeap * heap_) : heap(heap_) { }
+
+	bool operator()(const Entry & a, const Entry & b) const {
+	    return heap->ranks_above(a, b);
+	}
+    };
+
+    /// Value of Entry::long_key for an entry which isn't in the heap yet.
+    static const unsigned CANDIDATE = unsigned(-1);
+
+    /// The entries, which form a heap once there are max_size of them.
+    std::vector<Entry> entries;
+
+    /// Keys longer than 16 bytes.
+    std::vector<std::string> long_keys;
+
+    /// Indices of entries in long_keys which are free for reuse.
+    std::vector<unsigned> free_long_keys;
+
+    /// The key of the entry being considered (if it's longer than 16 bytes).
+    mutable const std::string * candidate_key;
+
+    /// The number of entries to keep.
+    Xapian::doccount max_size;
+
+    /// If true, higher sort keys rank higher; otherwise lower keys do.
+    bool forward_value;
+
+    /// If true, lower docids rank higher for equal keys; otherwise higher do.
+    bool forward_did;
+
+    /// Set the key of @a e to @a key (using *candidate_key if it's long).
+    void set_key(Entry & e, const std::string & key) const;
+
+    /// Compare the sort keys of two entries, returning <0, 0 or >0.
+    int compare_keys(const Entry & a, const Entry & b) const;
+
+    /// Return true if @a a should be ranked above @a b.
+    bool ranks_above(const Entry & a, const Entry & b) const {
+	int c = compare_keys(a, b);
+	if (c) return forward_value ? (c > 0) : (c < 0);
+	return forward_did ? (a.did < b.did) : (a.did > b.did);
+    }
+
+    /// Store the key of candidate entry @a e in long_keys if needed.
+    void store_long_key(Entry & e);
+
+  public:
+    /** Construct a SortKeyHeap.
+     *
+     *  @param max_size_	The number of documents to keep.
+     *  @param forward_value_	As for the sort_value_forward setting.
+     *  @param forward_did_	As for the sort_forward setting.
+     */
+    SortKeyHeap(Xapian::doccount max_size_,
+		bool forward_value_, bool forward_did_)
+	: candidate_key(NULL), max_size(max_size_),
+	  forward_value(forward_value_), forward_did(forward_did_) { }
+
+    /** Consider a document for the heap.
+     *
+     *  @return	true if the document was added (possibly replacing the
+     *		worst entry), or false if it doesn't rank highly enough.
+     */
+    bool add(const std::string & key, Xapian::docid did, double wt);
+
+    /** Return true if the heap is full and its worst entry has key @a key.
+     *
+     *  If @a key is the best possible key and documents are arriving in
+     *  ascending docid order with ties broken in favour of lower docids,
+     *  then no later document can be added.
+     */
+    bool full_with_worst_key(const std::string & key) const;
+
+    /// Append the entries (in no particular order) to @a items.
+    void get_items(std::vector<Xapian::Internal::MSetItem> & items) const;
+};
+
+#endif // XAPIAN_INCLUDED_SORTKEYHEAP_H
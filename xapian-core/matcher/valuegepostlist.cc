@@ -35,13 +35,8 @@ ValueGePostList::next(double)
 {
     Assert(db);
     if (!valuelist) valuelist = db->open_value_list(slot);
-    valuelist->next();
-    while (!valuelist->at_end()) {
-	const string & v = valuelist->get_value();
-	if (v >= begin) return NULL;
-	valuelist->next();
-    }
-    db = NULL;
+    valuelist->next_in_range(begin, NULL);
+    if (valuelist->at_end()) db = NULL;
     return NULL;
 }
 
@@ -51,10 +46,10 @@ ValueGePostList::skip_to(Xapian::docid did, double)
     Assert(db);
     if (!valuelist) valuelist = db->open_value_list(slot);
     valuelist->skip_to(did);
-    while (!valuelist->at_end()) {
-	const string & v = valuelist->get_value();
-	if (v >= begin) return NULL;
-	valuelist->next();
+    if (!valuelist->at_end()) {
+	if (value_in_range(valuelist->get_value(), begin, NULL)) return NULL;
+	valuelist->next_in_range(begin, NULL);
+	if (!valuelist->at_end()) return NULL;
     }
     db = NULL;
     return NULL;
@@ -124,15 +124,8 @@ ValueRangePostList::next(double)
 {
     Assert(db);
     if (!valuelist) valuelist = db->open_value_list(slot);
-    valuelist->next();
-    while (!valuelist->at_end()) {
-	const string & v = valuelist->get_value();
-	if (v >= begin && v <= end) {
-	    return NULL;
-	}
-	valuelist->next();
-    }
-    db = NULL;
+    valuelist->next_in_range(begin, &end);
+    if (valuelist->at_end()) db = NULL;
     return NULL;
 }
 
@@ -142,12 +135,10 @@ ValueRangePostList::skip_to(Xapian::docid did, double)
     Assert(db);
     if (!valuelist) valuelist = db->open_value_list(slot);
     valuelist->skip_to(did);
-    while (!valuelist->at_end()) {
-	const string & v = valuelist->get_value();
-	if (v >= begin && v <= end) {
-	    return NULL;
-	}
-	valuelist->next();
+    if (!valuelist->at_end()) {
+	if (value_in_range(valuelist->get_value(), begin, &end)) return NULL;
+	valuelist->next_in_range(begin, &end);
+	if (!valuelist->at_end()) return NULL;
     }
     db = NULL;
     return NULL;
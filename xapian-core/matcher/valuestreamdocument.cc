@@ -49,6 +49,7 @@ ValueStreamDocument::new_subdb(int n)
     current = unsigned(n);
     database = db.internal[n];
     clear_valuelists(valuelists);
+    last_valuelist = valuelists.end();
 }
 
 string
@@ -61,20 +62,22 @@ ValueStreamDocument::do_get_value(Xapian::valueno slot) const
     }
 #endif
 
-    pair<map<Xapian::valueno, ValueList *>::iterator, bool> ret;
-    ret = valuelists.insert(make_pair(slot, static_cast<ValueList*>(NULL)));
-    ValueList * vl;
-    if (ret.second) {
-	// Entry didn't already exist, so open a value list for slot.
-	vl = database->open_value_list(slot);
-	ret.first->second = vl;
-    } else {
-	vl = ret.first->second;
-	if (!vl) {
-	    AssertEqParanoid(string(), doc->get_value(slot));
-	    return string();
+    map<Xapian::valueno, ValueList *>::iterator i = last_valuelist;
+    if (i == valuelists.end() || i->first != slot) {
+	pair<map<Xapian::valueno, ValueList *>::iterator, bool> ret;
+	ret = valuelists.insert(make_pair(slot, static_cast<ValueList*>(NULL)));
+	i = ret.first;
+	last_valuelist = i;
+	if (ret.second) {
+	    // Entry didn't already exist, so open a value list for slot.
+	    i->second = database->open_value_list(slot);
 	}
     }
+    ValueList * vl = i->second;
+    if (!vl) {
+	AssertEqParanoid(string(), doc->get_value(slot));
+	return string();
+    }
 
     size_t multiplier = db.internal.size();
     Xapian::docid sub_did = (did - current - 2 + multiplier) / multiplier + 1;
@@ -82,7 +85,7 @@ ValueStreamDocument::do_get_value(Xapian::valueno slot) const
     if (vl->check(sub_did)) {
 	if (vl->at_end()) {
 	    delete vl;
-	    ret.first->second = NULL;
+	    i->second = NULL;
 	} else if (vl->get_docid() == sub_did) {
 	    Assert(vl);
 	    string v = vl->get_value();
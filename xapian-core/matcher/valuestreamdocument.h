@@ -37,6 +37,14 @@ class ValueStreamDocument : public Xapian::Document::Internal {
 
     mutable std::map<Xapian::valueno, ValueList *> valuelists;
 
+    /** The entry in valuelists which was used most recently.
+     *
+     *  The matcher usually wants the same slot for each document (e.g. when
+     *  sorting or collapsing), so remembering this saves a map lookup per
+     *  document.  Equal to valuelists.end() if not set.
+     */
+    mutable std::map<Xapian::valueno, ValueList *>::iterator last_valuelist;
+
     Xapian::Database db;
 
     size_t current;
@@ -45,7 +53,8 @@ class ValueStreamDocument : public Xapian::Document::Internal {
 
   public:
     ValueStreamDocument(const Xapian::Database & db_)
-       	: Internal(db_.internal[0], 0), db(db_), current(0), doc(NULL) { }
+       	: Internal(db_.internal[0], 0), last_valuelist(valuelists.end()),
+	  db(db_), current(0), doc(NULL) { }
 
     void new_subdb(int n);
 
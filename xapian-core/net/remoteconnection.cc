@@ -65,7 +65,7 @@ update_overlapped_offset(WSAOVERLAPPED & overlapped, DWORD n)
 
 RemoteConnection::RemoteConnection(int fdin_, int fdout_,
 				   const string & context_)
-    : fdin(fdin_), fdout(fdout_), context(context_)
+    : fdin(fdin_), fdout(fdout_), compress_min(0), context(context_)
 {
 #ifdef __WIN32__
     memset(&overlapped, 0, sizeof(overlapped));
@@ -211,9 +211,17 @@ RemoteConnection::send_message(char type, const string &message,
     if (fdout == -1)
 	throw_database_closed();
 
+    const string * data = &message;
+    string compressed;
     string header;
-    header += type;
-    header += encode_length(message.size());
+    if (compress_min && message.size() >= compress_min &&
+	compress(message, compressed)) {
+	data = &compressed;
+	header += char(type | MESSAGE_COMPRESSED);
+    } else {
+	header += type;
+    }
+    header += encode_length(data->size());
 
 #ifdef __WIN32__
     HANDLE hout = fd_to_handle(fdout);
@@ -246,8 +254,8 @@ RemoteConnection::send_message(char type, const string &message,
 	update_overlapped_offset(overlapped, n);
 
 	if (count == str->size()) {
-	    if (str == &message || message.empty()) return;
-	    str = &message;
+	    if (str == data || data->empty()) return;
+	    str = data;
 	    count = 0;
 	}
     }
@@ -270,8 +278,8 @@ RemoteConnection::send_message(char type, const string &message,
 	if (n >= 0) {
 	    count += n;
 	    if (count == str->size()) {
-		if (str == &message || message.empty()) return;
-		str = &message;
+		if (str == data || data->empty()) return;
+		str = data;
 		count = 0;
 	    }
 	    continue;
@@ -446,6 +454,58 @@ RemoteConnection::send_file(char type, int fd, double end_time)
 #endif
 }
 
+bool
+RemoteConnection::compress(const string & message, string & compressed)
+{
+    // zlib can't take more than a uInt's worth of input at once.
+    if (uInt(message.size()) != message.size()) return false;
+    comp_stream.lazy_alloc_deflate_zstream();
+    comp_stream.compress(reinterpret_cast<const byte *>(message.data()),
+			 message.size());
+    // If deflate succeeded, then the output was at least one byte smaller
+    // than the input.
+    if (comp_stream.zerr != Z_STREAM_END) return false;
+    compressed.assign(reinterpret_cast<const char *>(comp_stream.out),
+		      comp_stream.deflate_zstream->total_out);
+    return true;
+}
+
+void
+RemoteConnection::decompress(string & data)
+{
+    if (uInt(data.size()) != data.size())
+	throw Xapian::NetworkError("Compressed message too large", context);
+    comp_stream.lazy_alloc_inflate_zstream();
+    z_stream * zstream = comp_stream.inflate_zstream;
+    zstream->next_in = (Bytef*)const_cast<char *>(data.data());
+    zstream->avail_in = (uInt)data.size();
+
+    string result;
+    // May not be enough, but it's a reasonable guess.
+    result.reserve(data.size() * 2);
+
+    Bytef buf[8192];
+    int err = Z_OK;
+    while (err != Z_STREAM_END) {
+	zstream->next_out = buf;
+	zstream->avail_out = (uInt)sizeof(buf);
+	err = inflate(zstream, Z_SYNC_FLUSH);
+	if (err != Z_OK && err != Z_STREAM_END) {
+	    if (err == Z_MEM_ERROR) throw std::bad_alloc();
+	    string msg = "Failed to decompress message";
+	    if (zstream->msg) {
+		msg += " (";
+		msg += zstream->msg;
+		msg += ')';
+	    }
+	    throw Xapian::NetworkError(msg, context);
+	}
+	result.append(reinterpret_cast<const char *>(buf),
+		      zstream->next_out - buf);
+    }
+    swap(data, result);
+}
+
 char
 RemoteConnection::sniff_next_message_type(double end_time)
 {
@@ -467,32 +527,33 @@ RemoteConnection::get_message(string &result, double end_time)
 
     read_at_least(2, end_time);
     size_t len = static_cast<unsigned char>(buffer[1]);
-    read_at_least(len + 2, end_time);
-    if (len != 0xff) {
-	result.assign(buffer.data() + 2, len);
-	char type = buffer[0];
-	buffer.erase(0, len + 2);
-	RETURN(type);
+    size_t header_len = 2;
+    if (len == 0xff) {
+	read_at_least(len + 2, end_time);
+	len = 0;
+	string::const_iterator i = buffer.begin() + 2;
+	unsigned char ch;
+	int shift = 0;
+	do {
+	    if (i == buffer.end() || shift > 28) {
+		// Something is very wrong...
+		throw Xapian::NetworkError("Insane message length specified!");
+	    }
+	    ch = *i++;
+	    len |= size_t(ch & 0x7f) << shift;
+	    shift += 7;
+	} while ((ch & 0x80) == 0);
+	len += 255;
+	header_len = (i - buffer.begin());
     }
-    len = 0;
-    string::const_iterator i = buffer.begin() + 2;
-    unsigned char ch;
-    int shift = 0;
-    do {
-	if (i == buffer.end() || shift > 28) {
-	    // Something is very wrong...
-	    throw Xapian::NetworkError("Insane message length specified!");
-	}
-	ch = *i++;
-	len |= size_t(ch & 0x7f) << shift;
-	shift += 7;
-    } while ((ch & 0x80) == 0);
-    len += 255;
-    size_t header_len = (i - buffer.begin());
     read_at_least(header_len + len, end_time);
     result.assign(buffer.data() + header_len, len);
     char type = buffer[0];
     buffer.erase(0, header_len + len);
+    if (type & MESSAGE_COMPRESSED) {
+	decompress(result);
+	type &= ~MESSAGE_COMPRESSED;
+    }
     RETURN(type);
 }
 
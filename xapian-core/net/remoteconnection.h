@@ -23,6 +23,7 @@
 
 #include <string>
 
+#include "compression_stream.h"
 #include "remoteprotocol.h"
 #include "safeunistd.h"
 
@@ -119,6 +120,29 @@ class RemoteConnection {
     /// Remaining bytes of message data still to come over fdin for a chunked read.
     off_t chunked_data_left;
 
+    /** Send messages with at least this many bytes of data compressed.
+     *
+     *  0 means never compress.  Compressed messages have the top bit of
+     *  their type code set, so we can read them whatever this is set to.
+     */
+    size_t compress_min;
+
+    /// Zlib state for compressing and decompressing message data.
+    CompressionStream comp_stream;
+
+    /** Compress message data.
+     *
+     *  @param message		The data to compress.
+     *  @param[out] compressed	The compressed data.
+     *
+     *  @return			true if compressing made the data smaller (in
+     *				which case @a compressed is set), else false.
+     */
+    bool compress(const std::string & message, std::string & compressed);
+
+    /// Decompress message data which was sent compressed.
+    void decompress(std::string & data);
+
     /** Read until there are at least min_len bytes in buffer.
      *
      *  If for some reason this isn't possible, throws NetworkError.
@@ -162,6 +186,19 @@ class RemoteConnection {
     ~RemoteConnection();
 #endif
 
+    /** Set the size above which messages are sent compressed.
+     *
+     *  Compressed messages can only be read by a peer which supports them,
+     *  so this should only be set once both ends have agreed to use them.
+     *
+     *  @param compress_min_	Compress messages with at least this many
+     *				bytes of data (if that makes them smaller).
+     *				0 means never compress, which is the default.
+     */
+    void set_compress_min(size_t compress_min_) {
+	compress_min = compress_min_;
+    }
+
     /** See if there is data available to read.
      *
      *  @return		true if there is data waiting to be read.
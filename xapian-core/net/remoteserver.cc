@@ -59,7 +59,7 @@ struct ConnectionClosed { };
 RemoteServer::RemoteServer(const std::vector<std::string> &dbpaths,
 			   int fdin_, int fdout_,
 			   double active_timeout_, double idle_timeout_,
-			   bool writable_)
+			   bool writable_, Xapian::Database * shared_db)
     : RemoteConnection(fdin_, fdout_, std::string()),
       db(NULL), wdb(NULL), writable(writable_),
       active_timeout(active_timeout_), idle_timeout(idle_timeout_)
@@ -67,24 +67,39 @@ RemoteServer::RemoteServer(const std::vector<std::string> &dbpaths,
     // Catch errors opening the database and propagate them to the client.
     try {
 	Assert(!dbpaths.empty());
-	// We always open the database read-only to start with.  If we're
-	// writable, the client can ask to be upgraded to write access once
-	// connected if it wants it.
-	db = new Xapian::Database(dbpaths[0]);
+	Assert(!shared_db || !writable);
 	// Build a better description than Database::get_description() gives
 	// in the variable context.  FIXME: improve Database::get_description()
 	// and then just use that instead.
 	context = dbpaths[0];
 
-	if (!writable) {
+	if (shared_db && !shared_db->internal.empty()) {
+	    // Reuse the databases opened for an earlier connection, but make
+	    // sure we see any changes made since.
+	    shared_db->reopen();
+	    db = new Xapian::Database(*shared_db);
 	    vector<std::string>::const_iterator i(dbpaths.begin());
 	    for (++i; i != dbpaths.end(); ++i) {
-		db->add_database(Xapian::Database(*i));
 		context += ' ';
 		context += *i;
 	    }
 	} else {
-	    AssertEq(dbpaths.size(), 1); // Expecting exactly one database.
+	    // We always open the database read-only to start with.  If we're
+	    // writable, the client can ask to be upgraded to write access once
+	    // connected if it wants it.
+	    db = new Xapian::Database(dbpaths[0]);
+
+	    if (!writable) {
+		vector<std::string>::const_iterator i(dbpaths.begin());
+		for (++i; i != dbpaths.end(); ++i) {
+		    db->add_database(Xapian::Database(*i));
+		    context += ' ';
+		    context += *i;
+		}
+		if (shared_db) *shared_db = *db;
+	    } else {
+		AssertEq(dbpaths.size(), 1); // Expecting exactly one database.
+	    }
 	}
     } catch (const Xapian::Error &err) {
 	// Propagate the exception to the client.
@@ -100,7 +115,8 @@ RemoteServer::RemoteServer(const std::vector<std::string> &dbpaths,
 	throw Xapian::NetworkError("Couldn't set SIGPIPE to SIG_IGN", errno);
 #endif
 
-    // Send greeting message.
+    // Send greeting message.  This offers to compress large messages, but we
+    // don't until the client accepts with MSG_COMPRESS.
     msg_update(string());
 }
 
@@ -184,6 +200,8 @@ RemoteServer::run()
 		0, // MSG_GETMSET - used during a conversation.
 		0, // MSG_SHUTDOWN - handled by get_message().
 		&RemoteServer::msg_openmetadatakeylist,
+		&RemoteServer::msg_documents,
+		&RemoteServer::msg_compress,
 	    };
 
 	    string message;
@@ -363,6 +381,7 @@ RemoteServer::msg_update(const string &)
     totlen_t total_len = totlen_t(db->get_avlength() * db->get_doccount() + .5);
     message += encode_length(total_len);
     //message += encode_length(db->get_total_length());
+    message += encode_length(XAPIAN_REMOTE_COMPRESS_MIN);
     string uuid = db->get_uuid();
     message += uuid;
     send_message(REPLY_UPDATE, message);
@@ -402,7 +421,16 @@ RemoteServer::msg_query(const string &message_in)
     Xapian::valueno collapse_max = decode_length(&p, p_end, false);
 
     Xapian::valueno collapse_key = Xapian::BAD_VALUENO;
-    if (collapse_max) collapse_key = decode_length(&p, p_end, false);
+    Xapian::doccount collapse_limit = 0;
+    bool collapse_approximate = false;
+    if (collapse_max) {
+	collapse_key = decode_length(&p, p_end, false);
+	collapse_limit = decode_length(&p, p_end, false);
+	if (p == p_end || *p < '0' || *p > '1') {
+	    throw Xapian::NetworkError("bad message (collapse_approximate)");
+	}
+	collapse_approximate = (*p++ != '0');
+    }
 
     if (p_end - p < 4 || *p < '0' || *p > '2') {
 	throw Xapian::NetworkError("bad message (docid_order)");
@@ -477,9 +505,10 @@ RemoteServer::msg_query(const string &message_in)
 
     Xapian::Weight::Internal local_stats;
     MultiMatch match(*db, query, qlen, &rset, collapse_max, collapse_key,
+		     collapse_limit, collapse_approximate,
 		     percent_cutoff, weight_cutoff, order,
-		     sort_key, sort_by, sort_value_forward, time_limit, NULL,
-		     local_stats, wt.get(), matchspies.spies, false, false);
+		     sort_key, sort_by, sort_value_forward, time_limit, 1,
+		     NULL, local_stats, wt.get(), matchspies.spies, false, false);
 
     send_message(REPLY_STATS, serialise_stats(local_stats));
 
@@ -532,6 +561,40 @@ RemoteServer::msg_document(const string &message)
     send_message(REPLY_DONE, string());
 }
 
+void
+RemoteServer::msg_documents(const string &message)
+{
+    const char *p = message.data();
+    const char *p_end = p + message.size();
+    while (p != p_end) {
+	Xapian::docid did = decode_length(&p, p_end, false);
+
+	Xapian::Document doc = db->get_document(did);
+
+	string data = doc.get_data();
+	string item = encode_length(data.size());
+	item += data;
+	Xapian::ValueIterator i;
+	for (i = doc.values_begin(); i != doc.values_end(); ++i) {
+	    item += encode_length(i.get_valueno());
+	    item += encode_length((*i).size());
+	    item += *i;
+	}
+	send_message(REPLY_DOCUMENT, item);
+    }
+    send_message(REPLY_DONE, string());
+}
+
+void
+RemoteServer::msg_compress(const string &message)
+{
+    const char *p = message.data();
+    const char *p_end = p + message.size();
+    // The client can read compressed messages, and wants messages with at
+    // least this many bytes of data compressed (0 meaning none).
+    set_compress_min(decode_length(&p, p_end, false));
+}
+
 void
 RemoteServer::msg_keepalive(const string &)
 {
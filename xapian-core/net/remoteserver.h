@@ -89,6 +89,12 @@ class XAPIAN_VISIBILITY_DEFAULT RemoteServer : private RemoteConnection {
     // get document
     void msg_document(const std::string & message);
 
+    // get several documents
+    void msg_documents(const std::string & message);
+
+    // compress large messages
+    void msg_compress(const std::string & message);
+
     // term exists?
     void msg_termexists(const std::string & message);
 
@@ -176,12 +182,20 @@ class XAPIAN_VISIBILITY_DEFAULT RemoteServer : private RemoteConnection {
      *  @param idle_timeout_	Timeout while waiting for a new action from
      *			the client (specified in seconds).
      *  @param writable Should the database be opened for writing?
+     *  @param shared_db If non-NULL, a Database to share with later
+     *			connections (only supported if @a writable is false).
+     *			If it's already been opened, it's reopened and used
+     *			rather than opening @a dbpaths again; otherwise
+     *			@a dbpaths are opened and assigned to it.  The caller
+     *			must ensure it isn't used in any other thread while
+     *			this object exists.
      */
     RemoteServer(const std::vector<std::string> &dbpaths,
 		 int fdin, int fdout,
 		 double active_timeout_,
 		 double idle_timeout_,
-		 bool writable = false);
+		 bool writable = false,
+		 Xapian::Database * shared_db = NULL);
 
     /// Destructor.
     ~RemoteServer();
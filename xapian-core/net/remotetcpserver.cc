@@ -46,9 +46,19 @@ RemoteTcpServer::RemoteTcpServer(const vector<std::string> &dbpaths_,
 void
 RemoteTcpServer::handle_one_connection(int socket)
 {
+    Xapian::Database shared_db;
+    if (!writable) {
+	MutexLock lock(spare_dbs_mutex);
+	if (!spare_dbs.empty()) {
+	    shared_db = spare_dbs.back();
+	    spare_dbs.pop_back();
+	}
+    }
+
     try {
 	RemoteServer sserv(dbpaths, socket, socket,
-			   active_timeout, idle_timeout, writable);
+			   active_timeout, idle_timeout, writable,
+			   writable ? NULL : &shared_db);
 	sserv.run();
     } catch (const Xapian::NetworkTimeoutError &e) {
 	if (verbose)
@@ -58,4 +68,12 @@ RemoteTcpServer::handle_one_connection(int socket)
     } catch (...) {
 	// ignore other exceptions
     }
+
+    if (!shared_db.internal.empty()) {
+	// Database reference counts aren't thread-safe, so we must drop our
+	// reference while holding the lock.
+	MutexLock lock(spare_dbs_mutex);
+	spare_dbs.push_back(shared_db);
+	shared_db = Xapian::Database();
+    }
 }
@@ -23,6 +23,8 @@
 
 #include "tcpserver.h"
 
+#include "mutex.h"
+
 #include <xapian/database.h>
 #include <xapian/visibility.h>
 
@@ -55,6 +57,18 @@ class XAPIAN_VISIBILITY_DEFAULT RemoteTcpServer : public TcpServer {
     /** Timeout between operations (in seconds). */
     double idle_timeout;
 
+    /** Read-only databases opened for earlier connections.
+     *
+     *  These are reused by later connections to save opening the databases
+     *  again each time.  There's at most one for each connection which can
+     *  be handled at once, so when connections are handled by a pool of
+     *  threads, each thread effectively keeps its own.
+     */
+    std::vector<Xapian::Database> spare_dbs;
+
+    /// Mutex protecting spare_dbs.
+    Mutex spare_dbs_mutex;
+
     /** Accept a connection and return the filedescriptor for it. */
     int accept_connection();
 
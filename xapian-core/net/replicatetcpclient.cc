@@ -24,14 +24,29 @@
 
 #include "api/replication.h"
 
+#include <xapian/error.h>
+
+#include "realtime.h"
+#include "replicationprotocol.h"
+#include "safeerrno.h"
+#include "safesysselect.h"
 #include "tcpclient.h"
 
+// Not safesyssocket.h, whose socket() macro would clash with our member.
+#ifndef __WIN32__
+# include <sys/types.h>
+# include <sys/socket.h>
+#else
+# include "safewinsock2.h"
+#endif
+
 using namespace std;
 
 ReplicateTcpClient::ReplicateTcpClient(const string & hostname, int port,
 				       double timeout_connect)
     : socket(open_socket(hostname, port, timeout_connect)),
-      remconn(-1, socket)
+      remconn(-1, socket), read_timeout(REPL_STREAM_READ_TIMEOUT),
+      stream_confirmed(false)
 {
 }
 
@@ -54,6 +69,81 @@ ReplicateTcpClient::update_from_master(const std::string & path,
 			 force_copy ? string() : replica.get_revision_info(),
 			 0.0);
     remconn.send_message('D', masterdb, 0.0);
+    apply_changes(replica, info, reader_close_time);
+}
+
+void
+ReplicateTcpClient::start_streaming(const std::string & path,
+				    const std::string & masterdb,
+				    bool force_copy)
+{
+    Xapian::DatabaseReplica replica(path);
+    remconn.send_message('R',
+			 force_copy ? string() : replica.get_revision_info(),
+			 0.0);
+    remconn.send_message('S', masterdb, 0.0);
+    stream_confirmed = false;
+}
+
+bool
+ReplicateTcpClient::server_replied()
+{
+    fd_set fdset;
+    FD_ZERO(&fdset);
+    FD_SET(socket, &fdset);
+
+    int retval;
+    do {
+	// FIXME: Reduce the timeout if we retry on EINTR.
+	struct timeval tv;
+	RealTime::to_timeval(read_timeout, &tv);
+	retval = select(socket + 1, &fdset, 0, 0,
+			read_timeout > 0.0 ? &tv : NULL);
+    } while (retval < 0 && errno == EINTR);
+
+    if (retval < 0)
+	throw Xapian::NetworkError("select failed", socket_errno());
+    if (retval == 0)
+	throw Xapian::NetworkTimeoutError("Timeout expired waiting for replication server", ETIMEDOUT);
+
+    char ch;
+    int n;
+    do {
+	n = recv(socket, &ch, 1, MSG_PEEK);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0)
+	throw Xapian::NetworkError("recv failed", socket_errno());
+    return n > 0;
+}
+
+void
+ReplicateTcpClient::wait_for_update(const std::string & path,
+				    Xapian::ReplicationInfo & info,
+				    double reader_close_time)
+{
+    if (!stream_confirmed) {
+	// A server which predates streaming closes the connection without
+	// replying to 'S', whereas one which supports it always sends the
+	// changes needed to bring the replica up to date.
+	if (!server_replied()) {
+	    throw Xapian::FeatureUnavailableError("Replication server doesn't support streaming");
+	}
+	stream_confirmed = true;
+    }
+
+    Xapian::DatabaseReplica replica(path);
+    replica.set_read_timeout(read_timeout);
+    apply_changes(replica, info, reader_close_time);
+    // Tell the server which revision we've reached, so it can send the
+    // changes after it as soon as they're committed.
+    remconn.send_message('R', replica.get_revision_info(), 0.0);
+}
+
+void
+ReplicateTcpClient::apply_changes(Xapian::DatabaseReplica & replica,
+				  Xapian::ReplicationInfo & info,
+				  double reader_close_time)
+{
     replica.set_read_fd(socket);
     info.clear();
     bool more;
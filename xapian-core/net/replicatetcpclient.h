@@ -46,6 +46,12 @@ class XAPIAN_VISIBILITY_DEFAULT ReplicateTcpClient SOCKET_INITIALIZER_MIXIN {
     /// Write-only connection to the server.
     RemoteConnection remconn;
 
+    /// How long to wait to hear from a streaming server (in seconds).
+    double read_timeout;
+
+    /// Has the server replied since start_streaming() was called?
+    bool stream_confirmed;
+
     /** Attempt to open a TCP/IP socket connection to a replication server.
      *
      *  Connect to replication server running on port @a port of host @a hostname.
@@ -59,6 +65,20 @@ class XAPIAN_VISIBILITY_DEFAULT ReplicateTcpClient SOCKET_INITIALIZER_MIXIN {
     static int open_socket(const std::string & hostname, int port,
 			   double timeout_connect);
 
+    /** Wait for the server to reply to a request to stream changes.
+     *
+     *  Throws Xapian::NetworkTimeoutError if nothing arrives within the
+     *  read timeout.
+     *
+     *  @return false if the server closed the connection without replying.
+     */
+    bool server_replied();
+
+    /// Apply the changes the server sends until it reports there are no more.
+    void apply_changes(Xapian::DatabaseReplica & replica,
+		       Xapian::ReplicationInfo & info,
+		       double reader_close_time);
+
   public:
     /** Constructor.
      *
@@ -76,6 +96,44 @@ class XAPIAN_VISIBILITY_DEFAULT ReplicateTcpClient SOCKET_INITIALIZER_MIXIN {
 			    double reader_close_time,
 			    bool force_copy);
 
+    /** Ask the server to stream changes to the replica.
+     *
+     *  After calling this, call wait_for_update() repeatedly to apply the
+     *  changes, which the server sends as soon as they are committed to
+     *  the master.  The first call brings the replica up to date.
+     *
+     *  If the connection is lost, create a new client and call this again,
+     *  which resumes from the replica's current revision.
+     *
+     *  The server sends a keepalive while it waits for changes, so if
+     *  nothing at all arrives within the read timeout, wait_for_update()
+     *  throws Xapian::NetworkTimeoutError and the connection should be
+     *  treated as lost.
+     */
+    void start_streaming(const std::string & path,
+			 const std::string & remotedb,
+			 bool force_copy);
+
+    /** Wait for the server to send changes, and apply them to the replica.
+     *
+     *  Only valid after start_streaming() has been called.
+     *
+     *  If the server is too old to support streaming, the first call throws
+     *  Xapian::FeatureUnavailableError, and update_from_master() should be
+     *  used on a new connection instead.
+     */
+    void wait_for_update(const std::string & path,
+			 Xapian::ReplicationInfo & info,
+			 double reader_close_time);
+
+    /** Set how long to wait to hear from a streaming server.
+     *
+     *  The default is REPL_STREAM_READ_TIMEOUT.
+     *
+     *  @param timeout	The timeout in seconds, or 0.0 to wait indefinitely.
+     */
+    void set_read_timeout(double timeout) { read_timeout = timeout; }
+
     /** Destructor. */
     ~ReplicateTcpClient();
 };
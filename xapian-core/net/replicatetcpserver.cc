@@ -24,18 +24,50 @@
 
 #include <xapian/error.h>
 #include "api/replication.h"
+#include "realtime.h"
+#include "replicationprotocol.h"
 
 using namespace std;
 
 ReplicateTcpServer::ReplicateTcpServer(const string & host, int port,
 				       const string & path_)
-    : TcpServer(host, port, false, false), path(path_)
+    : TcpServer(host, port, false, false), path(path_),
+      keepalive_interval(REPL_STREAM_KEEPALIVE_INTERVAL),
+      read_timeout(REPL_STREAM_READ_TIMEOUT)
 {
 }
 
 ReplicateTcpServer::~ReplicateTcpServer() {
 }
 
+void
+ReplicateTcpServer::stream_changes(RemoteConnection & client, int socket,
+				   const Xapian::DatabaseMaster & master)
+{
+    while (true) {
+	// Each time the client has applied the changes we sent, it tells us
+	// the revision it has reached.  Don't wait forever, or a client which
+	// has gone away without closing the connection would tie up this
+	// process.
+	string revision;
+	double end_time = RealTime::end_time(read_timeout);
+	if (client.get_message(revision, end_time) != 'R') {
+	    throw Xapian::NetworkError("Bad replication client message (3)");
+	}
+
+	// Send the changes as soon as there's a new revision.  The client
+	// shouldn't send anything else until it has the changes, so if the
+	// connection becomes readable, it has been closed.  Until then, send
+	// a keepalive now and then so the client can tell we're still here.
+	while (!master.wait_for_changes(revision, keepalive_interval)) {
+	    if (client.ready_to_read()) return;
+	    RemoteConnection conn(-1, socket);
+	    conn.send_message(REPL_REPLY_KEEPALIVE, string(), 0.0);
+	}
+	master.write_changesets_to_fd(socket, revision, NULL);
+    }
+}
+
 void
 ReplicateTcpServer::handle_one_connection(int socket)
 {
@@ -47,9 +79,11 @@ ReplicateTcpServer::handle_one_connection(int socket)
 	    throw Xapian::NetworkError("Bad replication client message");
 	}
 
-	// Read dbname from the client.
+	// Read dbname from the client.  The message type is 'S' if the
+	// client wants changes streamed to it.
 	string dbname;
-	if (client.get_message(dbname, 0.0) != 'D') {
+	char type = client.get_message(dbname, 0.0);
+	if (type != 'D' && type != 'S') {
 	    throw Xapian::NetworkError("Bad replication client message (2)");
 	}
 	if (dbname.find("..") != string::npos) {
@@ -61,6 +95,7 @@ ReplicateTcpServer::handle_one_connection(int socket)
 	dbpath += dbname;
 	Xapian::DatabaseMaster master(dbpath);
 	master.write_changesets_to_fd(socket, start_revision, NULL);
+	if (type == 'S') stream_changes(client, socket, master);
     } catch (...) {
 	// Ignore exceptions.
     }
@@ -31,6 +31,19 @@ class XAPIAN_VISIBILITY_DEFAULT ReplicateTcpServer : public TcpServer {
     /// The path to pass to DatabaseMaster.
     std::string path;
 
+    /// How often to send a keepalive to a streaming client (in seconds).
+    double keepalive_interval;
+
+    /// How long to wait for a streaming client to reply (in seconds).
+    double read_timeout;
+
+    /** Send new changesets to a client as soon as they're committed.
+     *
+     *  Returns when the client closes the connection.
+     */
+    void stream_changes(RemoteConnection & client, int socket,
+			const Xapian::DatabaseMaster & master);
+
   public:
     /** Construct a ReplicateTcpServer and start listening for connections.
      *
@@ -45,6 +58,26 @@ class XAPIAN_VISIBILITY_DEFAULT ReplicateTcpServer : public TcpServer {
     /// Destructor.
     ~ReplicateTcpServer();
 
+    /** Set how often to send a keepalive to a streaming client.
+     *
+     *  The default is REPL_STREAM_KEEPALIVE_INTERVAL.
+     *
+     *  @param interval	The interval in seconds.
+     */
+    void set_keepalive_interval(double interval) {
+	keepalive_interval = interval;
+    }
+
+    /** Set how long to wait for a streaming client to report the revision
+     *  it has reached after being sent changes.
+     *
+     *  If it takes longer, the connection is closed.  The default is
+     *  REPL_STREAM_READ_TIMEOUT.
+     *
+     *  @param timeout	The timeout in seconds, or 0.0 to wait indefinitely.
+     */
+    void set_read_timeout(double timeout) { read_timeout = timeout; }
+
     /** Handle a single connection on an already connected socket.
      *
      *  This method may be called by multiple threads.
@@ -32,6 +32,7 @@
 
 #include "noreturn.h"
 #include "remoteconnection.h"
+#include "thread.h"
 
 #ifdef __WIN32__
 # include <process.h>    /* _beginthread, _endthread */
@@ -52,6 +53,7 @@
 #include <cstdio> // For sprintf() on __WIN32__ or cygwin.
 #include <cstdlib>
 #include <sys/types.h>
+#include <vector>
 
 using namespace std;
 
@@ -491,3 +493,57 @@ TcpServer::run_once()
 #else
 # error Neither HAVE_FORK nor __WIN32__ are defined.
 #endif
+
+/// Thread which services connections for a TcpServer.
+class ConnectionThread : public Thread {
+    TcpServer & server;
+
+  public:
+    ConnectionThread(TcpServer & server_) : server(server_) { }
+
+    void run() { server.handle_connections(); }
+};
+
+void
+TcpServer::handle_connections()
+{
+    while (true) {
+	try {
+	    int connected_socket = accept_connection();
+	    if (connected_socket == -1)
+	       return; // Shutdown has happened
+
+	    handle_one_connection(connected_socket);
+	    CLOSESOCKET(connected_socket);
+
+	    if (verbose) cout << "Closing connection." << endl;
+	} catch (const Xapian::Error &e) {
+	    // FIXME: better error handling.
+	    cerr << "Caught " << e.get_description() << endl;
+	} catch (...) {
+	    // FIXME: better error handling.
+	    cerr << "Caught exception." << endl;
+	}
+    }
+}
+
+void
+TcpServer::run_threads(unsigned threads)
+{
+    if (threads == 0) threads = 1;
+
+    vector<ConnectionThread *> workers;
+    workers.reserve(threads);
+    for (unsigned i = 0; i != threads; ++i) {
+	workers.push_back(new ConnectionThread(*this));
+    }
+    // This thread services connections too, rather than just waiting.
+    for (unsigned i = 1; i != threads; ++i) {
+	workers[i]->start();
+    }
+    workers[0]->run();
+    for (unsigned i = 0; i != threads; ++i) {
+	workers[i]->join();
+	delete workers[i];
+    }
+}
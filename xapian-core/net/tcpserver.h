@@ -69,6 +69,14 @@ class XAPIAN_VISIBILITY_DEFAULT TcpServer SOCKET_INITIALIZER_MIXIN {
 #endif
 	    );
 
+    /** Accept connections and service them until shutdown.
+     *
+     *  This is run by each thread in run_threads().
+     */
+    void handle_connections();
+
+    friend class ConnectionThread;
+
   protected:
     /** Should we produce output when connections are made or lost? */
     bool verbose;
@@ -100,6 +108,21 @@ class XAPIAN_VISIBILITY_DEFAULT TcpServer SOCKET_INITIALIZER_MIXIN {
      */
     void run();
 
+    /** Accept connections and service them using a pool of threads.
+     *
+     *  Each thread accepts a connection, services requests on it, and then
+     *  waits for another, so at most @a threads connections are serviced at
+     *  once, and any others wait to be accepted.  This avoids the overhead
+     *  of a fork() for each connection, and lets handle_one_connection()
+     *  reuse resources between connections.
+     *
+     *  If the platform doesn't support threads, connections are serviced
+     *  one at a time.
+     *
+     *  @param threads	The number of threads to use.
+     */
+    void run_threads(unsigned threads);
+
     /** Accept a single connection, service requests on it, then stop.  */
     void run_once();
 
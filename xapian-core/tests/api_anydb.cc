@@ -2450,3 +2450,89 @@ DEFINE_TESTCASE(uuid1, backend && !multi) {
 
     return true;
 }
+
+// Feature test for Enquire::set_profiling() and MSet::get_profile().
+DEFINE_TESTCASE(matchprofile1, backend && !remote) {
+    Xapian::Database db = get_database("apitest_simpledata");
+    Xapian::Enquire enquire(db);
+    enquire.set_query(Xapian::Query(Xapian::Query::OP_OR,
+		Xapian::Query(Xapian::Query::OP_AND,
+			      Xapian::Query("this"),
+			      Xapian::Query("paragraph")),
+		Xapian::Query("simple")));
+
+    // By default, the match isn't profiled.
+    Xapian::MSet mset = enquire.get_mset(0, 10);
+    TEST_EQUAL(mset.get_profile().get_node_count(), 0);
+    TEST_EQUAL(mset.get_profile().get_total_time(), 0);
+
+    enquire.set_profiling(true);
+    Xapian::MSet mset2 = enquire.get_mset(0, 10);
+    TEST_EQUAL(mset, mset2);
+    Xapian::MatchProfile profile = mset2.get_profile();
+    tout << profile.get_description();
+    TEST_REL(profile.get_total_time(),>=,0);
+
+    // There's a tree of 5 nodes for each sub-database.
+    size_t n_nodes = profile.get_node_count();
+    TEST_EQUAL(n_nodes % 5, 0);
+    TEST(n_nodes != 0);
+    unsigned long root_docs = 0;
+    for (size_t i = 0; i < n_nodes; i += 5) {
+	Xapian::MatchProfile::Node root = profile.get_node(i);
+	TEST_EQUAL(root.get_description(), "OR");
+	TEST_EQUAL(root.get_depth(), 0);
+	TEST_EQUAL(profile.get_node(i + 1).get_description(), "AND");
+	TEST_EQUAL(profile.get_node(i + 1).get_depth(), 1);
+	TEST_EQUAL(profile.get_node(i + 2).get_description(), "this");
+	TEST_EQUAL(profile.get_node(i + 2).get_depth(), 2);
+	TEST_EQUAL(profile.get_node(i + 3).get_description(), "paragraph");
+	TEST_EQUAL(profile.get_node(i + 3).get_depth(), 2);
+	TEST_EQUAL(profile.get_node(i + 4).get_description(), "simple");
+	TEST_EQUAL(profile.get_node(i + 4).get_depth(), 1);
+	TEST_REL(root.get_next_calls(),>,0);
+	TEST_REL(profile.get_node(i + 2).get_termfreq_est(),>,0);
+	TEST_REL(root.get_time(),>=,profile.get_node(i + 1).get_time());
+	TEST_EQUAL(root.get_position_lists_opened(), 0);
+	root_docs += root.get_docs();
+    }
+    // Each document in the MSet must have been reached by a root.
+    TEST_REL(root_docs,>=,mset2.size());
+    TEST_EXCEPTION(Xapian::RangeError, profile.get_node(n_nodes));
+
+    string desc = profile.get_description();
+    TEST_STRINGS_EQUAL(desc.substr(0, 7), "total: ");
+    TEST(desc.find("\n  OR: ") != string::npos);
+    TEST(desc.find("\n      this: ") != string::npos);
+
+    // A profiled match isn't affected by or added to the MSet cache.
+    size_t old_max_size = Xapian::MSetCache::get_max_size();
+    Xapian::MSetCache::set_max_size(1024 * 1024);
+    Xapian::MSetCache::clear();
+    try {
+	Xapian::MSet mset3 = enquire.get_mset(0, 10);
+	TEST(mset3.get_profile().get_node_count() != 0);
+	TEST_EQUAL(Xapian::MSetCache::get_misses(), 0);
+    } catch (...) {
+	Xapian::MSetCache::set_max_size(old_max_size);
+	throw;
+    }
+    Xapian::MSetCache::set_max_size(old_max_size);
+
+    // A phrase opens the position lists of its subqueries for each candidate.
+    enquire.set_query(Xapian::Query(Xapian::Query::OP_PHRASE,
+				    Xapian::Query("this"),
+				    Xapian::Query("paragraph")));
+    profile = enquire.get_mset(0, 10).get_profile();
+    tout << profile.get_description();
+    unsigned long poslists = 0;
+    for (size_t i = 0; i != profile.get_node_count(); ++i) {
+	Xapian::MatchProfile::Node node = profile.get_node(i);
+	if (node.get_depth() == 1)
+	    poslists += node.get_position_lists_opened();
+    }
+    TEST_REL(poslists,>,0);
+    TEST(profile.get_description().find(" poslists=") != string::npos);
+
+    return true;
+}
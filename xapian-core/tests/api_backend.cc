@@ -28,7 +28,9 @@
 #include <xapian.h>
 
 #include "filetests.h"
+#include "remoteprotocol.h"
 #include "str.h"
+#include "stringutils.h"
 #include "testsuite.h"
 #include "testutils.h"
 #include "unixcmds.h"
@@ -39,6 +41,18 @@
 #include "safesysstat.h"
 #include "safeunistd.h"
 
+#include <fstream>
+
+#ifdef __linux__
+# include <dirent.h>
+#endif
+
+#ifdef HAVE_FORK
+# include "safesyssocket.h"
+# include <arpa/inet.h>
+# include <netinet/in.h>
+#endif
+
 using namespace std;
 
 /// Regression test - lockfile should honour umask, was only user-readable.
@@ -615,6 +629,308 @@ make_orcheck_db(Xapian::WritableDatabase &db, const string &)
     }
 }
 
+static void
+make_blockmax1_db(Xapian::WritableDatabase &db, const string &)
+{
+    // Enough documents for "common" to need several postlist chunks, with
+    // most chunks only having wdf 1 for it.
+    for (unsigned i = 1; i <= 4000; ++i) {
+	Xapian::Document doc;
+	Xapian::termcount wdf = (i >= 1500 && i < 1600) ? 20 : 1;
+	doc.add_term("common", wdf);
+	if (i % 3 == 0) doc.add_term("third");
+	if (i % 7 == 0) doc.add_term("seventh", i % 5 + 1);
+	db.add_document(doc);
+    }
+    // Reduce the wdf of one of the high wdf entries, which leaves the
+    // chunk's maximum wdf higher than any wdf in it.
+    Xapian::Document doc;
+    doc.add_term("common");
+    db.replace_document(1550, doc);
+}
+
+/// Check skipping postlist chunks by their maximum wdf finds the right docs.
+DEFINE_TESTCASE(blockmax1, generated) {
+    Xapian::Database db = get_database("blockmax1", make_blockmax1_db);
+    Xapian::Enquire enq(db);
+    vector<Xapian::Query> queries;
+    // For a single term, the matcher passes the minimum weight straight to
+    // the postlist, so the chunks after 1500..1599 get skipped.
+    queries.push_back(Xapian::Query("common"));
+    static const char * const terms[] = { "third", "seventh", NULL };
+    for (const char * const * t = terms; *t; ++t) {
+	queries.push_back(Xapian::Query(Xapian::Query::OP_OR,
+					Xapian::Query("common"),
+					Xapian::Query(*t)));
+	queries.push_back(Xapian::Query(Xapian::Query::OP_AND,
+					Xapian::Query("common"),
+					Xapian::Query(*t)));
+    }
+    for (size_t i = 0; i != queries.size(); ++i) {
+	tout << queries[i].get_description() << '\n';
+	enq.set_query(queries[i]);
+	// Checking every document stops the matcher passing a useful minimum
+	// weight to the postlists, so no chunks are skipped.
+	Xapian::MSet all = enq.get_mset(0, 10, db.get_doccount());
+	Xapian::MSet mset = enq.get_mset(0, 10);
+	TEST_EQUAL(mset.size(), 10);
+	TEST(mset_range_is_same(mset, 0, all, 0, 10));
+	TEST(mset_range_is_same_weights(mset, 0, all, 0, 10));
+    }
+    return true;
+}
+
+/// The number of calls to WdfWeight::get_maxpart_for_wdf().
+static unsigned long wdf_weight_maxpart_calls = 0;
+
+/// Weight a document by the wdf of each term.
+class WdfWeight : public Xapian::Weight {
+    double factor;
+
+  public:
+    WdfWeight() : factor(0) {
+	need_stat(WDF);
+	need_stat(WDF_MAX);
+    }
+
+    WdfWeight * clone() const { return new WdfWeight; }
+
+    void init(double factor_) { factor = factor_; }
+
+    double get_sumpart(Xapian::termcount wdf, Xapian::termcount) const {
+	return wdf * factor;
+    }
+
+    double get_maxpart() const { return get_wdf_upper_bound() * factor; }
+
+    double get_maxpart_for_wdf(Xapian::termcount wdf_max) const {
+	++wdf_weight_maxpart_calls;
+	return min(wdf_max, get_wdf_upper_bound()) * factor;
+    }
+
+    double get_sumextra(Xapian::termcount) const { return 0; }
+
+    double get_maxextra() const { return 0; }
+};
+
+/// Check a user weighting scheme's get_maxpart_for_wdf() is used.
+DEFINE_TESTCASE(blockmax2, brass) {
+    Xapian::Database db = get_database("blockmax1", make_blockmax1_db);
+    Xapian::Enquire enq(db);
+    enq.set_weighting_scheme(WdfWeight());
+    enq.set_query(Xapian::Query("common"));
+    Xapian::MSet all = enq.get_mset(0, 10, db.get_doccount());
+    wdf_weight_maxpart_calls = 0;
+    Xapian::MSet mset = enq.get_mset(0, 10);
+    TEST_REL(wdf_weight_maxpart_calls,>,0);
+    TEST_EQUAL(mset.size(), 10);
+    TEST(mset_range_is_same(mset, 0, all, 0, 10));
+    TEST(mset_range_is_same_weights(mset, 0, all, 0, 10));
+    return true;
+}
+
+static void
+make_matchthreads1_db(Xapian::WritableDatabase &db, const string & arg)
+{
+    // Offset the documents in each sub-database a little so the best matches
+    // are spread across them.
+    unsigned offset = atoi(arg.c_str());
+    for (unsigned i = 1; i <= 1000; ++i) {
+	unsigned n = i * 3 + offset;
+	Xapian::Document doc;
+	doc.add_term("all");
+	doc.add_term("len", n % 23 + 1);
+	if (n % 2 == 0) doc.add_term("two", n % 11 + 1);
+	if (n % 5 == 0) doc.add_term("five", n % 3 + 1);
+	doc.add_value(0, str(n % 17));
+	db.add_document(doc);
+    }
+}
+
+/// Check matching sub-databases in parallel gives the same MSet.
+DEFINE_TESTCASE(matchthreads1, generated) {
+    Xapian::Database db;
+    db.add_database(get_database("matchthreads1_0", make_matchthreads1_db, "0"));
+    db.add_database(get_database("matchthreads1_1", make_matchthreads1_db, "1"));
+    db.add_database(get_database("matchthreads1_2", make_matchthreads1_db, "2"));
+    Xapian::Enquire serial(db);
+    Xapian::Enquire parallel(db);
+    parallel.set_match_threads(3);
+
+    vector<Xapian::Query> queries;
+    queries.push_back(Xapian::Query("all"));
+    queries.push_back(Xapian::Query("two"));
+    queries.push_back(Xapian::Query(Xapian::Query::OP_OR,
+				    Xapian::Query("two"),
+				    Xapian::Query("five")));
+    queries.push_back(Xapian::Query(Xapian::Query::OP_AND,
+				    Xapian::Query("two"),
+				    Xapian::Query("five")));
+    for (size_t i = 0; i != queries.size(); ++i) {
+	serial.set_query(queries[i]);
+	parallel.set_query(queries[i]);
+	for (int sort = 0; sort != 3; ++sort) {
+	    tout << queries[i].get_description() << " sort " << sort << '\n';
+	    if (sort == 0) {
+		serial.set_sort_by_relevance();
+		parallel.set_sort_by_relevance();
+	    } else if (sort == 1) {
+		serial.set_sort_by_value_then_relevance(0, false);
+		parallel.set_sort_by_value_then_relevance(0, false);
+	    } else {
+		serial.set_sort_by_relevance_then_value(0, true);
+		parallel.set_sort_by_relevance_then_value(0, true);
+	    }
+	    Xapian::MSet s = serial.get_mset(15, 20);
+	    Xapian::MSet p = parallel.get_mset(15, 20);
+	    TEST_EQUAL(p.size(), s.size());
+	    TEST(mset_range_is_same(p, 0, s, 0, s.size()));
+	    if (sort == 0) {
+		TEST_EQUAL(p.begin().get_percent(), s.begin().get_percent());
+	    }
+	    TEST_REL(p.get_matches_lower_bound(),<=,p.get_matches_estimated());
+	    TEST_REL(p.get_matches_estimated(),<=,p.get_matches_upper_bound());
+
+	    // If we check every document, the counts should be exact.
+	    s = serial.get_mset(0, 10, db.get_doccount());
+	    p = parallel.get_mset(0, 10, db.get_doccount());
+	    TEST(mset_range_is_same(p, 0, s, 0, s.size()));
+	    TEST_EQUAL(p.get_matches_lower_bound(), s.get_matches_lower_bound());
+	    TEST_EQUAL(p.get_matches_estimated(), s.get_matches_estimated());
+	    TEST_EQUAL(p.get_matches_upper_bound(), s.get_matches_upper_bound());
+	}
+    }
+    return true;
+}
+
+/// Check splitting sub-databases into docid ranges gives the same MSet.
+DEFINE_TESTCASE(matchthreads2, generated) {
+    Xapian::Database db1 = get_database("matchthreads1_0", make_matchthreads1_db, "0");
+    Xapian::Database db2(db1);
+    db2.add_database(get_database("matchthreads1_1", make_matchthreads1_db, "1"));
+
+    vector<Xapian::Query> queries;
+    queries.push_back(Xapian::Query("all"));
+    queries.push_back(Xapian::Query(Xapian::Query::OP_OR,
+				    Xapian::Query("two"),
+				    Xapian::Query("five")));
+    queries.push_back(Xapian::Query(Xapian::Query::OP_AND,
+				    Xapian::Query("two"),
+				    Xapian::Query("five")));
+    // Split a single database into 4 ranges, and two databases into 2
+    // ranges each.
+    for (int n = 1; n <= 2; ++n) {
+	const Xapian::Database & db = (n == 1 ? db1 : db2);
+	Xapian::Enquire serial(db);
+	Xapian::Enquire parallel(db);
+	parallel.set_match_threads(n == 1 ? 4 : 5);
+	for (size_t i = 0; i != queries.size(); ++i) {
+	    tout << n << " databases: " << queries[i].get_description() << '\n';
+	    serial.set_query(queries[i]);
+	    parallel.set_query(queries[i]);
+	    Xapian::MSet s = serial.get_mset(5, 20);
+	    Xapian::MSet p = parallel.get_mset(5, 20);
+	    TEST_EQUAL(p.size(), s.size());
+	    TEST(mset_range_is_same(p, 0, s, 0, s.size()));
+	    TEST(mset_range_is_same_weights(p, 0, s, 0, s.size()));
+	    TEST_EQUAL(p.begin().get_percent(), s.begin().get_percent());
+	    TEST_REL(p.get_matches_lower_bound(),<=,p.get_matches_estimated());
+	    TEST_REL(p.get_matches_estimated(),<=,p.get_matches_upper_bound());
+
+	    // If we check every document, the counts should be exact.
+	    s = serial.get_mset(0, 10, db.get_doccount());
+	    p = parallel.get_mset(0, 10, db.get_doccount());
+	    TEST(mset_range_is_same(p, 0, s, 0, s.size()));
+	    TEST_EQUAL(p.get_matches_lower_bound(), s.get_matches_lower_bound());
+	    TEST_EQUAL(p.get_matches_estimated(), s.get_matches_estimated());
+	    TEST_EQUAL(p.get_matches_upper_bound(), s.get_matches_upper_bound());
+	}
+    }
+    return true;
+}
+
+/// PostingSource for odd docids, which doesn't support clone().
+class OddPostingSource : public Xapian::PostingSource {
+    Xapian::docid last_docid;
+
+    Xapian::docid did;
+
+  public:
+    /// The number of times init() has been called.
+    unsigned inits;
+
+    OddPostingSource() : last_docid(0), did(0), inits(0) { }
+
+    void init(const Xapian::Database & db) {
+	last_docid = db.get_lastdocid();
+	did = 0;
+	++inits;
+    }
+
+    Xapian::doccount get_termfreq_min() const { return 0; }
+
+    Xapian::doccount get_termfreq_est() const { return last_docid / 2; }
+
+    Xapian::doccount get_termfreq_max() const { return last_docid; }
+
+    void next(double) {
+	++did;
+	if (did % 2 == 0) ++did;
+    }
+
+    void skip_to(Xapian::docid to_did, double) {
+	if (to_did > did) did = to_did;
+	if (did % 2 == 0) ++did;
+    }
+
+    bool at_end() const { return did > last_docid; }
+
+    Xapian::docid get_docid() const { return did; }
+
+    string get_description() const { return "OddPostingSource"; }
+};
+
+/// Check the cases where we have to fall back to matching serially.
+DEFINE_TESTCASE(matchthreads3, generated) {
+    Xapian::Database db1 = get_database("matchthreads1_0", make_matchthreads1_db, "0");
+    // A PostingSource which can't be cloned would be shared by the threads
+    // matching each docid range.
+    OddPostingSource source;
+    Xapian::Query query(Xapian::Query::OP_FILTER,
+			Xapian::Query("len"), Xapian::Query(&source));
+    Xapian::Enquire serial(db1);
+    serial.set_query(query);
+    Xapian::MSet s = serial.get_mset(0, 20);
+    TEST_EQUAL(s.size(), 20);
+    for (Xapian::MSetIterator i = s.begin(); i != s.end(); ++i) {
+	TEST_EQUAL(*i % 2, 1);
+    }
+    Xapian::Enquire parallel(db1);
+    parallel.set_match_threads(4);
+    parallel.set_query(query);
+    source.inits = 0;
+    Xapian::MSet p = parallel.get_mset(0, 20);
+    // The source should only have been used for one postlist tree.
+    TEST_EQUAL(source.inits, 1);
+    TEST_EQUAL(p.size(), s.size());
+    TEST(mset_range_is_same(p, 0, s, 0, s.size()));
+    TEST_EQUAL(p.get_matches_estimated(), s.get_matches_estimated());
+
+    // The same database added twice would be shared by two threads.
+    Xapian::Database db2(db1);
+    db2.add_database(db1);
+    serial = Xapian::Enquire(db2);
+    serial.set_query(Xapian::Query("two"));
+    parallel = Xapian::Enquire(db2);
+    parallel.set_match_threads(2);
+    parallel.set_query(Xapian::Query("two"));
+    s = serial.get_mset(0, 20);
+    p = parallel.get_mset(0, 20);
+    TEST_EQUAL(p.size(), s.size());
+    TEST(mset_range_is_same(p, 0, s, 0, s.size()));
+    return true;
+}
+
 /** Regression test for bugs in the check() method of OrPostList. (ticket #485)
  *  Bugs introduced and fixed between 1.2.0 and 1.2.1 (never in a release).
  */
@@ -932,3 +1248,612 @@ DEFINE_TESTCASE(notermlist1, brass) {
     TEST_EXCEPTION(Xapian::FeatureUnavailableError, db.termlist_begin(1));
     return true;
 }
+
+/// Feature test for Xapian::BlockCache.
+DEFINE_TESTCASE(blockcache1, brass) {
+    size_t old_max_size = Xapian::BlockCache::get_max_size();
+    Xapian::BlockCache::set_max_size(1024 * 1024);
+    Xapian::BlockCache::clear();
+    try {
+	string path = get_database_path("apitest_simpledata");
+	Xapian::Query query(Xapian::Query::OP_OR,
+			    Xapian::Query("this"), Xapian::Query("word"));
+
+	Xapian::Database db1(path);
+	Xapian::Enquire enq1(db1);
+	enq1.set_query(query);
+	Xapian::MSet mset1 = enq1.get_mset(0, 10);
+	mset1.fetch();
+	TEST_REL(Xapian::BlockCache::get_misses(),>,0);
+	TEST_EQUAL(Xapian::BlockCache::get_hits(), 0);
+	TEST_REL(Xapian::BlockCache::get_size(),>,0);
+
+	// A second reader of the same revision should find the blocks it
+	// needs in the cache.
+	unsigned long misses = Xapian::BlockCache::get_misses();
+	Xapian::Database db2(path);
+	Xapian::Enquire enq2(db2);
+	enq2.set_query(query);
+	Xapian::MSet mset2 = enq2.get_mset(0, 10);
+	mset2.fetch();
+	TEST_REL(Xapian::BlockCache::get_hits(),>,0);
+	TEST_EQUAL(Xapian::BlockCache::get_misses(), misses);
+	TEST_EQUAL(mset1, mset2);
+	for (Xapian::MSetIterator i = mset2.begin(); i != mset2.end(); ++i) {
+	    TEST_EQUAL(i.get_document().get_data(),
+		       db1.get_document(*i).get_data());
+	}
+
+	// Shrinking the cache should discard blocks to fit.
+	Xapian::BlockCache::set_max_size(1);
+	TEST_EQUAL(Xapian::BlockCache::get_size(), 0);
+    } catch (...) {
+	Xapian::BlockCache::set_max_size(old_max_size);
+	throw;
+    }
+    Xapian::BlockCache::set_max_size(old_max_size);
+    return true;
+}
+
+/// Check copies of a database with the same UUID don't share cached blocks.
+DEFINE_TESTCASE(blockcache2, brass) {
+    size_t old_max_size = Xapian::BlockCache::get_max_size();
+    Xapian::BlockCache::set_max_size(1024 * 1024);
+    Xapian::BlockCache::clear();
+    try {
+	string path = get_named_writable_database_path("blockcache2");
+	string copy_path = path + "copy";
+	{
+	    Xapian::WritableDatabase db = get_named_writable_database("blockcache2");
+	    // Add enough documents that the record table has several leaf
+	    // blocks, as opening it reads the first.
+	    for (int i = 0; i != 1000; ++i) {
+		Xapian::Document doc;
+		doc.set_data("document " + str(i));
+		db.add_document(doc);
+	    }
+	    db.commit();
+	}
+	rm_rf(copy_path);
+	cp_R(path, copy_path);
+
+	// Update both to the same revision, with different data.
+	const char * paths[] = { path.c_str(), copy_path.c_str() };
+	const char * data[] = { "first", "second" };
+	for (int i = 0; i != 2; ++i) {
+	    Xapian::WritableDatabase db(paths[i], Xapian::DB_OPEN);
+	    Xapian::Document doc;
+	    doc.set_data(data[i]);
+	    db.replace_document(500, doc);
+	    db.commit();
+	}
+
+	Xapian::Database db1(path);
+	Xapian::Database db2(copy_path);
+	TEST_EQUAL(db1.get_uuid(), db2.get_uuid());
+	TEST_EQUAL(db1.get_document(500).get_data(), "first");
+	TEST_REL(Xapian::BlockCache::get_size(),>,0);
+	TEST_EQUAL(db2.get_document(500).get_data(), "second");
+    } catch (...) {
+	Xapian::BlockCache::set_max_size(old_max_size);
+	throw;
+    }
+    Xapian::BlockCache::set_max_size(old_max_size);
+    return true;
+}
+
+/// Feature test for Xapian::MSetCache.
+DEFINE_TESTCASE(msetcache1, brass) {
+    size_t old_max_size = Xapian::MSetCache::get_max_size();
+    Xapian::MSetCache::set_max_size(1024 * 1024);
+    Xapian::MSetCache::clear();
+    try {
+	Xapian::WritableDatabase wdb = get_writable_database("apitest_simpledata");
+	wdb.commit();
+	Xapian::Query query(Xapian::Query::OP_OR,
+			    Xapian::Query("this"), Xapian::Query("word"));
+
+	// Results from a writable database aren't cached, since it may have
+	// uncommitted changes.
+	Xapian::Enquire wenq(wdb);
+	wenq.set_query(query);
+	Xapian::MSet mset0 = wenq.get_mset(0, 10);
+	TEST_EQUAL(Xapian::MSetCache::get_misses(), 0);
+
+	Xapian::Database db1 = get_writable_database_as_database();
+	Xapian::Enquire enq1(db1);
+	enq1.set_query(query);
+	Xapian::MSet mset1 = enq1.get_mset(0, 10);
+	TEST_EQUAL(Xapian::MSetCache::get_misses(), 1);
+	TEST_EQUAL(Xapian::MSetCache::get_hits(), 0);
+	TEST_REL(Xapian::MSetCache::get_size(),>,0);
+	TEST_EQUAL(mset0, mset1);
+
+	// The same query from another Enquire object should be a hit, and the
+	// documents should be readable from the cached MSet.
+	Xapian::Database db2 = get_writable_database_as_database();
+	Xapian::Enquire enq2(db2);
+	enq2.set_query(query);
+	Xapian::MSet mset2 = enq2.get_mset(0, 10);
+	TEST_EQUAL(Xapian::MSetCache::get_hits(), 1);
+	TEST_EQUAL(mset1, mset2);
+	for (Xapian::MSetIterator i = mset2.begin(); i != mset2.end(); ++i) {
+	    TEST_EQUAL(i.get_document().get_data(),
+		       db1.get_document(*i).get_data());
+	    TEST_EQUAL(i.get_percent(), mset1[i.get_rank()].get_percent());
+	}
+	TEST_EQUAL(mset2.get_termfreq("word"), mset1.get_termfreq("word"));
+
+	// Different parameters or settings should miss.
+	(void)enq2.get_mset(1, 10);
+	TEST_EQUAL(Xapian::MSetCache::get_misses(), 2);
+	enq2.set_weighting_scheme(Xapian::BM25Weight(1, 0, 1, 0, 0.5));
+	(void)enq2.get_mset(0, 10);
+	TEST_EQUAL(Xapian::MSetCache::get_misses(), 3);
+	enq2.set_weighting_scheme(Xapian::BM25Weight());
+	enq2.set_sort_by_value(1, true);
+	(void)enq2.get_mset(0, 10);
+	TEST_EQUAL(Xapian::MSetCache::get_misses(), 4);
+	enq2.set_sort_by_relevance();
+	enq2.set_match_threads(2);
+	(void)enq2.get_mset(0, 10);
+	TEST_EQUAL(Xapian::MSetCache::get_misses(), 5);
+
+	// A match using a MatchSpy isn't cached.
+	Xapian::ValueCountMatchSpy spy(1);
+	enq1.add_matchspy(&spy);
+	(void)enq1.get_mset(0, 10);
+	TEST_REL(spy.get_total(),>,0);
+	TEST_EQUAL(Xapian::MSetCache::get_hits(), 1);
+	TEST_EQUAL(Xapian::MSetCache::get_misses(), 5);
+	enq1.clear_matchspies();
+
+	// After a commit and reopen(), the new revision should be searched.
+	Xapian::Document doc;
+	doc.add_term("word");
+	Xapian::docid did = wdb.add_document(doc);
+	wdb.commit();
+	db1.reopen();
+	Xapian::MSet mset3 = enq1.get_mset(0, 10);
+	TEST_EQUAL(Xapian::MSetCache::get_misses(), 6);
+	TEST_EQUAL(mset3.get_matches_estimated(),
+		   mset1.get_matches_estimated() + 1);
+	bool found = false;
+	for (Xapian::MSetIterator i = mset3.begin(); i != mset3.end(); ++i) {
+	    if (*i == did) found = true;
+	}
+	TEST(found);
+
+	// Shrinking the cache should discard MSets to fit.
+	Xapian::MSetCache::set_max_size(1);
+	TEST_EQUAL(Xapian::MSetCache::get_size(), 0);
+    } catch (...) {
+	Xapian::MSetCache::set_max_size(old_max_size);
+	throw;
+    }
+    Xapian::MSetCache::set_max_size(old_max_size);
+    return true;
+}
+
+static Xapian::termcount
+count_positions(const Xapian::PostingIterator & p)
+{
+    Xapian::termcount count = 0;
+    Xapian::PositionIterator i;
+    for (i = p.positionlist_begin(); i != p.positionlist_end(); ++i) {
+	++count;
+    }
+    return count;
+}
+
+/// Feature test for Xapian::PostListCache.
+DEFINE_TESTCASE(postlistcache1, brass) {
+    size_t old_max_size = Xapian::PostListCache::get_max_size();
+    Xapian::PostListCache::set_max_size(1024 * 1024);
+    Xapian::PostListCache::reset_stats();
+    try {
+	Xapian::WritableDatabase wdb = get_writable_database("apitest_simpledata");
+	wdb.commit();
+	Xapian::Database db = get_writable_database_as_database();
+
+	// Read the posting list with the cache disabled for comparison.
+	vector<Xapian::docid> dids;
+	vector<Xapian::termcount> wdfs, doclens, positions;
+	Xapian::PostListCache::set_max_size(0);
+	Xapian::PostingIterator p;
+	for (p = db.postlist_begin("this"); p != db.postlist_end("this"); ++p) {
+	    dids.push_back(*p);
+	    wdfs.push_back(p.get_wdf());
+	    doclens.push_back(p.get_doclength());
+	    positions.push_back(count_positions(p));
+	}
+	TEST_REL(dids.size(),>,2);
+	Xapian::PostListCache::set_max_size(1024 * 1024);
+
+	// The posting list should be cached once it's been opened a few times.
+	for (int n = 0; n < 5; ++n) {
+	    size_t i = 0;
+	    for (p = db.postlist_begin("this"); p != db.postlist_end("this"); ++p) {
+		TEST(i < dids.size());
+		TEST_EQUAL(*p, dids[i]);
+		TEST_EQUAL(p.get_wdf(), wdfs[i]);
+		TEST_EQUAL(p.get_doclength(), doclens[i]);
+		TEST_EQUAL(count_positions(p), positions[i]);
+		++i;
+	    }
+	    TEST_EQUAL(i, dids.size());
+	}
+	TEST_EQUAL(Xapian::PostListCache::get_hits(), 2);
+	TEST_EQUAL(Xapian::PostListCache::get_misses(), 3);
+
+	p = db.postlist_begin("this");
+	p.skip_to(dids[1]);
+	TEST_EQUAL(*p, dids[1]);
+	p.skip_to(dids.back() + 1);
+	TEST(p == db.postlist_end("this"));
+
+	// A posting list with more entries than max_termfreq isn't cached.
+	Xapian::PostListCache::set_max_termfreq(1);
+	for (int n = 0; n < 5; ++n) {
+	    p = db.postlist_begin("word");
+	    TEST_EQUAL(p.get_description().find("CachedPostList"), string::npos);
+	}
+	Xapian::PostListCache::set_max_termfreq(0);
+
+	// A term which doesn't exist isn't cached, however often it's opened.
+	unsigned long hits = Xapian::PostListCache::get_hits();
+	for (int n = 0; n < 5; ++n) {
+	    p = db.postlist_begin("nosuchterm");
+	    TEST(p == db.postlist_end("nosuchterm"));
+	}
+	TEST_EQUAL(Xapian::PostListCache::get_hits(), hits);
+
+	// After a commit and reopen(), the new revision should be read.
+	Xapian::Document doc;
+	doc.add_term("this");
+	Xapian::docid did = wdb.add_document(doc);
+	wdb.commit();
+	db.reopen();
+	Xapian::doccount count = 0;
+	for (int n = 0; n < 5; ++n) {
+	    count = 0;
+	    for (p = db.postlist_begin("this"); p != db.postlist_end("this"); ++p) {
+		++count;
+	    }
+	    TEST_EQUAL(count, dids.size() + 1);
+	    p = db.postlist_begin("this");
+	    p.skip_to(did);
+	    TEST_EQUAL(*p, did);
+	}
+    } catch (...) {
+	Xapian::PostListCache::set_max_size(old_max_size);
+	Xapian::PostListCache::set_max_termfreq(0);
+	throw;
+    }
+    Xapian::PostListCache::set_max_size(old_max_size);
+    return true;
+}
+
+/** Check if the table file @a file of database @a path is memory-mapped.
+ *
+ *  Returns false if we can't tell (i.e. there's no /proc/self/maps).
+ */
+static bool
+table_is_mapped(const string & path, const string & file)
+{
+    ifstream maps("/proc/self/maps");
+    string suffix = path.substr(path.find_last_of('/') + 1) + "/" + file;
+    string line;
+    while (getline(maps, line)) {
+	if (endswith(line, "/" + suffix)) return true;
+    }
+    return false;
+}
+
+/// Check that DB_MMAP gives the same results, including after reopen().
+DEFINE_TESTCASE(mmap1, brass) {
+    string path = get_database_path("apitest_simpledata");
+    Xapian::Query query(Xapian::Query::OP_OR,
+			Xapian::Query("this"), Xapian::Query("word"));
+
+    Xapian::Database db1(path);
+    Xapian::Enquire enq1(db1);
+    enq1.set_query(query);
+    Xapian::MSet mset1 = enq1.get_mset(0, 10);
+
+    Xapian::Database db2(path, Xapian::DB_MMAP);
+    Xapian::Enquire enq2(db2);
+    enq2.set_query(query);
+    Xapian::MSet mset2 = enq2.get_mset(0, 10);
+    TEST_EQUAL(mset1, mset2);
+    for (Xapian::MSetIterator i = mset2.begin(); i != mset2.end(); ++i) {
+	TEST_EQUAL(i.get_document().get_data(),
+		   db1.get_document(*i).get_data());
+    }
+    TEST_EQUAL(db1.get_doccount(), db2.get_doccount());
+    Xapian::TermIterator t1 = db1.allterms_begin();
+    Xapian::TermIterator t2 = db2.allterms_begin();
+    while (t1 != db1.allterms_end()) {
+	TEST(t2 != db2.allterms_end());
+	TEST_EQUAL(*t1, *t2);
+	TEST_EQUAL(t1.get_termfreq(), t2.get_termfreq());
+	++t1;
+	++t2;
+    }
+    TEST(t2 == db2.allterms_end());
+
+#if defined HAVE_MMAP && defined __linux__
+    // Check the tables really were mapped (and only by db2).
+    TEST(table_is_mapped(path, "postlist.DB"));
+    TEST(table_is_mapped(path, "record.DB"));
+    db2.close();
+    TEST(!table_is_mapped(path, "postlist.DB"));
+#endif
+
+    // Check that a reader picks up blocks added since it mapped the table.
+    Xapian::WritableDatabase wdb = get_named_writable_database("mmap1");
+    string wpath = get_named_writable_database_path("mmap1");
+    Xapian::Database rdb(wpath, Xapian::DB_MMAP);
+    TEST_EQUAL(rdb.get_doccount(), 0);
+    for (Xapian::doccount n = 0; n < 2000; ++n) {
+	Xapian::Document doc;
+	doc.add_term("foo");
+	doc.add_term("bar" + str(n));
+	doc.set_data(string(n % 200, 'x'));
+	wdb.add_document(doc);
+	if (n % 1000 == 999) {
+	    wdb.commit();
+	    TEST(rdb.reopen());
+	    TEST_EQUAL(rdb.get_doccount(), n + 1);
+	    TEST_EQUAL(rdb.get_termfreq("foo"), n + 1);
+	    TEST_EQUAL(rdb.get_termfreq("bar" + str(n)), 1);
+	    TEST_EQUAL(rdb.get_document(n + 1).get_data(),
+		       string(n % 200, 'x'));
+	}
+    }
+
+    // If the writer reuses the blocks of the revision being read, reading
+    // them through the mapping should report that the revision has gone.
+    for (int i = 0; i != 2; ++i) {
+	for (Xapian::docid did = 1; did <= 2000; ++did) {
+	    Xapian::Document doc;
+	    doc.set_data(string(did % 150, 'y'));
+	    wdb.replace_document(did, doc);
+	}
+	wdb.commit();
+    }
+    try {
+	for (Xapian::docid did = 2000; did >= 1; --did) {
+	    TEST_EQUAL(rdb.get_document(did).get_data(),
+		       string((did - 1) % 200, 'x'));
+	}
+	FAIL_TEST("Expected DatabaseModifiedError");
+    } catch (const Xapian::DatabaseModifiedError &) {
+    }
+
+    return true;
+}
+
+#ifdef __linux__
+/// Count the file descriptors this process has open.
+static size_t
+count_open_fds()
+{
+    DIR * dir = opendir("/proc/self/fd");
+    if (!dir) return 0;
+    size_t count = 0;
+    while (readdir(dir)) ++count;
+    closedir(dir);
+    return count;
+}
+
+/// Count how many times a table's file is currently mapped.
+static size_t
+table_mappings(const string & path, const string & file)
+{
+    ifstream maps("/proc/self/maps");
+    string suffix = path.substr(path.find_last_of('/') + 1) + "/" + file;
+    size_t count = 0;
+    string line;
+    while (getline(maps, line)) {
+	if (endswith(line, "/" + suffix)) ++count;
+    }
+    return count;
+}
+#endif
+
+/// Check snapshots used to split a database are reused and opened alike.
+DEFINE_TESTCASE(matchthreads4, brass) {
+    string path = get_database_path("matchthreads1_0", make_matchthreads1_db,
+				    "0");
+    for (int mmap = 0; mmap != 2; ++mmap) {
+	Xapian::Database db(path, mmap ? Xapian::DB_MMAP : 0);
+	Xapian::Enquire serial(db);
+	serial.set_query(Xapian::Query("len"));
+	Xapian::MSet s = serial.get_mset(0, 20);
+
+	Xapian::Enquire parallel(db);
+	parallel.set_query(Xapian::Query("len"));
+	parallel.set_match_threads(4);
+#ifdef __linux__
+	size_t fds = count_open_fds();
+#endif
+	Xapian::MSet p = parallel.get_mset(0, 20);
+	TEST(mset_range_is_same(p, 0, s, 0, s.size()));
+#ifdef __linux__
+	// The snapshots for the three extra ranges should stay open, and be
+	// used again for later matches.
+	size_t fds_kept = count_open_fds();
+	TEST_REL(fds_kept,>,fds);
+	for (int i = 0; i != 3; ++i) {
+	    p = parallel.get_mset(0, 20);
+	    TEST(mset_range_is_same(p, 0, s, 0, s.size()));
+	    TEST_EQUAL(count_open_fds(), fds_kept);
+	}
+# ifdef HAVE_MMAP
+	// With DB_MMAP, the snapshots should map the tables too.
+	if (mmap) TEST_EQUAL(table_mappings(path, "postlist.DB"), 4);
+# endif
+#endif
+    }
+
+    return true;
+}
+
+/// Test xapian-tcpsrv --threads serves concurrent clients and reuses databases.
+DEFINE_TESTCASE(tcpsrvthreads1, remote) {
+    SKIP_TEST_UNLESS_BACKEND("remotetcp");
+#ifndef HAVE_FORK
+    SKIP_TEST("Can't stop a threaded xapian-tcpsrv on this platform");
+#else
+    mkdir(".tcpsrv", 0755);
+    string path = ".tcpsrv/threads1";
+    Xapian::WritableDatabase wdb(path, Xapian::DB_CREATE_OR_OVERWRITE);
+    Xapian::Document doc;
+    doc.add_term("foo");
+    wdb.add_document(doc);
+    wdb.commit();
+
+    // Out of range thread counts should be rejected.
+    try {
+	(void)start_threaded_server(path, 0);
+	FAIL_TEST("xapian-tcpsrv accepted --threads 0");
+    } catch (const string &) {
+    }
+
+    int port = start_threaded_server(path, 2);
+
+    // Both connections must be served at once, otherwise the second would
+    // time out waiting for the server's greeting.
+    {
+	Xapian::Database db1 = Xapian::Remote::open("127.0.0.1", port);
+	Xapian::Database db2 = Xapian::Remote::open("127.0.0.1", port);
+	TEST_EQUAL(db1.get_doccount(), 1);
+	TEST_EQUAL(db2.get_doccount(), 1);
+	Xapian::Enquire enq1(db1);
+	enq1.set_query(Xapian::Query("foo"));
+	Xapian::Enquire enq2(db2);
+	enq2.set_query(Xapian::Query("foo"));
+	TEST_EQUAL(enq2.get_mset(0, 10).size(), 1);
+	TEST_EQUAL(enq1.get_mset(0, 10).size(), 1);
+    }
+
+    // Later connections reuse the databases opened above, and should still
+    // see changes committed since.
+    for (Xapian::doccount n = 2; n <= 5; ++n) {
+	wdb.add_document(doc);
+	wdb.commit();
+	Xapian::Database db = Xapian::Remote::open("127.0.0.1", port);
+	TEST_EQUAL(db.get_doccount(), n);
+	TEST_EQUAL(db.get_termfreq("foo"), n);
+    }
+
+    return true;
+#endif
+}
+
+#ifdef HAVE_FORK
+/// Read exactly @a n bytes from @a fd.
+static void
+read_raw(int fd, char * p, size_t n)
+{
+    while (n) {
+	ssize_t r = read(fd, p, n);
+	if (r <= 0) FAIL_TEST("Failed to read from xapian-tcpsrv");
+	p += r;
+	n -= r;
+    }
+}
+
+/// Read a remote protocol message, returning its type code unaltered.
+static unsigned char
+read_raw_message(int fd, string & data)
+{
+    char header[2];
+    read_raw(fd, header, 2);
+    size_t len = static_cast<unsigned char>(header[1]);
+    if (len == 0xff) {
+	len = 0;
+	int shift = 0;
+	char ch;
+	do {
+	    read_raw(fd, &ch, 1);
+	    len |= size_t(ch & 0x7f) << shift;
+	    shift += 7;
+	} while ((ch & 0x80) == 0);
+	len += 255;
+    }
+    data.resize(len);
+    if (len) read_raw(fd, &data[0], len);
+    return static_cast<unsigned char>(header[0]);
+}
+
+/// Send a remote protocol message with less than 255 bytes of data.
+static void
+send_raw_message(int fd, char type, const string & data)
+{
+    string message(1, type);
+    message += char(data.size());
+    message += data;
+    TEST_EQUAL(write(fd, message.data(), message.size()),
+	       ssize_t(message.size()));
+}
+#endif
+
+/// Check the remote server only compresses messages once the client accepts.
+DEFINE_TESTCASE(remotecompress1, remote) {
+    SKIP_TEST_UNLESS_BACKEND("remotetcp");
+#ifndef HAVE_FORK
+    SKIP_TEST("Can't stop a threaded xapian-tcpsrv on this platform");
+#else
+    mkdir(".tcpsrv", 0755);
+    string path = ".tcpsrv/compress1";
+    string text;
+    while (text.size() < 100000)
+	text += "the quick brown fox " + str(text.size());
+    {
+	Xapian::WritableDatabase wdb(path, Xapian::DB_CREATE_OR_OVERWRITE);
+	Xapian::Document doc;
+	doc.set_data(text);
+	wdb.add_document(doc);
+    }
+
+    int port = start_threaded_server(path, 1);
+    for (int accept = 0; accept <= 1; ++accept) {
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	TEST(fd >= 0);
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+	TEST_EQUAL(connect(fd, reinterpret_cast<sockaddr *>(&addr),
+			   sizeof(addr)), 0);
+
+	string data;
+	TEST_EQUAL(read_raw_message(fd, data), REPLY_UPDATE);
+	// Accept compression with a threshold of 100 bytes.
+	if (accept) send_raw_message(fd, MSG_COMPRESS, string(1, char(100)));
+	send_raw_message(fd, MSG_DOCUMENT, string(1, '\x01'));
+
+	unsigned char type = read_raw_message(fd, data);
+	if (accept) {
+	    TEST_EQUAL(type, REPLY_DOCDATA | MESSAGE_COMPRESSED);
+	    TEST_REL(data.size(),<,text.size() / 2);
+	} else {
+	    TEST_EQUAL(type, REPLY_DOCDATA);
+	    TEST(data == text);
+	}
+	TEST_EQUAL(read_raw_message(fd, data), REPLY_DONE);
+
+	send_raw_message(fd, MSG_SHUTDOWN, string());
+	close(fd);
+    }
+
+    // And check a real client gets the right data back.
+    Xapian::Database db = Xapian::Remote::open("127.0.0.1", port);
+    TEST(db.get_document(1).get_data() == text);
+
+    return true;
+#endif
+}
@@ -25,6 +25,7 @@
 #include <xapian.h>
 
 #include "apitest.h"
+#include "str.h"
 #include "testutils.h"
 
 using namespace std;
@@ -81,3 +82,89 @@ DEFINE_TESTCASE(collapsekey5,backend) {
 
     return true;
 }
+
+static void
+make_collapsekey6_db(Xapian::WritableDatabase &db, const string &)
+{
+    for (unsigned i = 1; i <= 2000; ++i) {
+	Xapian::Document doc;
+	// Vary the weights so that the order documents arrive in isn't the
+	// order they rank in.
+	doc.add_term("all", 1 + i % 5);
+	for (unsigned j = i % 7; j != 0; --j) doc.add_term("pad" + str(j));
+	if (i % 11 != 0) doc.add_value(0, str(i % 503));
+	doc.add_value(1, "a collapse key which is quite long " + str(i % 97));
+	db.add_document(doc);
+    }
+}
+
+/// Check limiting the collapse table doesn't change the documents returned.
+DEFINE_TESTCASE(collapsekey6,generated) {
+    Xapian::Database db = get_database("collapsekey6", make_collapsekey6_db);
+    Xapian::Enquire enquire(db);
+    enquire.set_query(Xapian::Query("all"));
+
+    const Xapian::doccount limits[] = { 1, 5, 40, 0 };
+    for (Xapian::valueno slot = 0; slot != 2; ++slot) {
+	for (Xapian::doccount cmax = 1; cmax != 3; ++cmax) {
+	    enquire.set_collapse_key(slot, cmax);
+	    enquire.set_collapse_limit(0);
+	    Xapian::doccount matches = enquire.get_mset(0, 2000).size();
+	    Xapian::MSet mset1 = enquire.get_mset(0, 10);
+	    Xapian::MSet mset2 = enquire.get_mset(7, 30);
+	    for (size_t l = 0; l != sizeof(limits) / sizeof(limits[0]); ++l) {
+		for (int approx = 0; approx != 2; ++approx) {
+		    tout << "slot " << slot << " cmax " << cmax << " limit "
+			 << limits[l] << " approximate " << approx << endl;
+		    enquire.set_collapse_limit(limits[l], approx);
+		    Xapian::MSet m1 = enquire.get_mset(0, 10);
+		    Xapian::MSet m2 = enquire.get_mset(7, 30);
+		    TEST(mset_range_is_same(m1, 0, mset1, 0, mset1.size()));
+		    TEST(mset_range_is_same(m2, 0, mset2, 0, mset2.size()));
+		    TEST_REL(m2.get_matches_lower_bound(),<=,matches);
+		    TEST_REL(m2.get_matches_upper_bound(),>=,matches);
+		    // Collapse counts are lower bounds, so may be reduced.
+		    Xapian::MSetIterator i, j;
+		    for (i = m2.begin(), j = mset2.begin(); i != m2.end();
+			 ++i, ++j) {
+			TEST_REL(i.get_collapse_count(),<=,j.get_collapse_count());
+		    }
+		}
+	    }
+	}
+    }
+
+    return true;
+}
+
+/// Check the collapse table counts are reported in the MatchProfile.
+DEFINE_TESTCASE(collapsekey7,generated && !remote) {
+    Xapian::Database db = get_database("collapsekey6", make_collapsekey6_db);
+    Xapian::Enquire enquire(db);
+    enquire.set_query(Xapian::Query("all"));
+    enquire.set_profiling(true);
+
+    // Without collapsing, the counts are zero.
+    Xapian::MatchProfile profile = enquire.get_mset(0, 10).get_profile();
+    TEST_EQUAL(profile.get_collapse_buckets(), 0);
+    TEST_EQUAL(profile.get_collapse_peak_keys(), 0);
+
+    // All 503 values of slot 0 are seen if every match is checked.
+    enquire.set_collapse_key(0);
+    profile = enquire.get_mset(0, 10, 2000).get_profile();
+    tout << profile.get_description();
+    TEST_EQUAL(profile.get_collapse_keys(), 503);
+    TEST_EQUAL(profile.get_collapse_peak_keys(), 503);
+    TEST_REL(profile.get_collapse_buckets(),>=,2 * 503);
+    TEST_EQUAL(profile.get_collapse_keys_forgotten(), 0);
+    TEST(profile.get_description().find(" collapse_keys=503") != string::npos);
+
+    enquire.set_collapse_limit(40);
+    profile = enquire.get_mset(0, 10, 2000).get_profile();
+    tout << profile.get_description();
+    TEST_REL(profile.get_collapse_peak_keys(),<,503);
+    TEST_REL(profile.get_collapse_keys_forgotten(),>,0);
+    TEST_REL(profile.get_collapse_keys(),<=,profile.get_collapse_peak_keys());
+
+    return true;
+}
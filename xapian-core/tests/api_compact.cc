@@ -34,10 +34,18 @@
 
 #include <cstdlib>
 #include <fstream>
+#include <map>
+#include <vector>
 
+#include "safeunistd.h"
 #include "str.h"
+#include "stringutils.h"
 #include "unixcmds.h"
 
+#ifdef HAVE_PTHREAD_H
+# include <pthread.h>
+#endif
+
 using namespace std;
 
 static void
@@ -297,6 +305,127 @@ DEFINE_TESTCASE(compactmultichunks1, generated) {
     return true;
 }
 
+static void
+make_packed_db(Xapian::WritableDatabase &db, const string &)
+{
+    for (Xapian::docid did = 1; did <= 5000; ++did) {
+	Xapian::Document doc;
+	doc.add_term("all", did % 13 + 1);
+	if (did % 3 == 0) doc.add_term("three");
+	// Large gaps and wdfs, to test wider bit widths.
+	if (did % 1000 == 7) doc.add_term("rare", did * 1000);
+	if (did == 4000) doc.add_term("one");
+	db.replace_document(did * 5, doc);
+    }
+    db.commit();
+}
+
+/// Check two databases have the same posting lists and document lengths.
+static void
+check_same_postlists(const Xapian::Database & a, const Xapian::Database & b)
+{
+    Xapian::TermIterator t = a.allterms_begin();
+    Xapian::TermIterator u = b.allterms_begin();
+    for ( ; t != a.allterms_end(); ++t, ++u) {
+	TEST(u != b.allterms_end());
+	TEST_EQUAL(*t, *u);
+	TEST_EQUAL(t.get_termfreq(), u.get_termfreq());
+	Xapian::PostingIterator p = a.postlist_begin(*t);
+	Xapian::PostingIterator q = b.postlist_begin(*t);
+	for ( ; p != a.postlist_end(*t); ++p, ++q) {
+	    TEST(q != b.postlist_end(*t));
+	    TEST_EQUAL(*p, *q);
+	    TEST_EQUAL(p.get_wdf(), q.get_wdf());
+	    TEST_EQUAL(p.get_doclength(), q.get_doclength());
+	}
+	TEST(q == b.postlist_end(*t));
+    }
+    TEST(u == b.allterms_end());
+}
+
+// Test compacting to bit-packed posting lists.
+DEFINE_TESTCASE(compactpack1, generated) {
+    string indbpath = get_database_path("compactpack1in", make_packed_db, "");
+    string outdbpath = get_named_writable_database_path("compactpack1out");
+    rm_rf(outdbpath);
+
+    Xapian::Compactor compact;
+    compact.set_renumber(false);
+    compact.set_destdir(outdbpath);
+    compact.add_source(indbpath);
+    compact.set_pack_postlists(true);
+    compact.compact();
+
+    Xapian::Database indb(indbpath);
+    {
+	Xapian::Database outdb(outdbpath);
+	check_same_postlists(indb, outdb);
+	dbcheck(outdb, 5000, 25000);
+	TEST_EQUAL(Xapian::Database::check(outdbpath), 0);
+
+	// Check skip_to() within and between chunks.
+	static const Xapian::docid targets[] = {
+	    1, 2, 5, 6, 14, 400, 401, 12345, 12346, 19999, 24996, 25000
+	};
+	const char * terms[] = { "all", "three", "rare", NULL };
+	for (const char ** term = terms; *term; ++term) {
+	    Xapian::PostingIterator p = outdb.postlist_begin(*term);
+	    Xapian::PostingIterator q = indb.postlist_begin(*term);
+	    for (size_t i = 0; i != sizeof(targets) / sizeof(targets[0]); ++i) {
+		p.skip_to(targets[i]);
+		q.skip_to(targets[i]);
+		if (q == indb.postlist_end(*term)) {
+		    TEST(p == outdb.postlist_end(*term));
+		    break;
+		}
+		TEST_EQUAL(*p, *q);
+		TEST_EQUAL(p.get_wdf(), q.get_wdf());
+	    }
+	}
+
+	// Check the matcher gets the same results, which means moving
+	// through bit-packed chunks with a minimum weight.
+	Xapian::Query query(Xapian::Query::OP_OR,
+			    Xapian::Query("all"), Xapian::Query("rare"));
+	Xapian::Enquire inenq(indb);
+	inenq.set_query(query);
+	Xapian::Enquire outenq(outdb);
+	outenq.set_query(query);
+	TEST_EQUAL(outenq.get_mset(0, 10), inenq.get_mset(0, 10));
+    }
+
+    // Check the bit-packed database can be updated, by comparing with the
+    // same updates to an unpacked copy.
+    string copypath = get_named_writable_database_path("compactpack1copy");
+    rm_rf(copypath);
+    compact.set_destdir(copypath);
+    compact.set_pack_postlists(false);
+    compact.compact();
+
+    Xapian::WritableDatabase copy(copypath, Xapian::DB_OPEN);
+    Xapian::WritableDatabase outdb(outdbpath, Xapian::DB_OPEN);
+    for (Xapian::docid did = 5; did <= 25000; did += 1005) {
+	Xapian::Document doc;
+	doc.add_term("all", 2);
+	doc.add_term("new");
+	copy.replace_document(did, doc);
+	outdb.replace_document(did, doc);
+    }
+    for (Xapian::docid did = 25; did <= 10000; did += 15) {
+	copy.delete_document(did);
+	outdb.delete_document(did);
+    }
+    copy.delete_document(20000);
+    outdb.delete_document(20000);
+    copy.commit();
+    outdb.commit();
+    check_same_postlists(copy, outdb);
+    dbcheck(outdb, outdb.get_doccount(), outdb.get_lastdocid());
+    TEST_EQUAL(Xapian::Database::check(outdbpath), 0);
+
+    return true;
+}
+
 // Test compacting from a stub database directory.
 DEFINE_TESTCASE(compactstub1, brass || chert) {
     const char * stubpath = ".stub/compactstub1";
@@ -584,3 +713,97 @@ DEFINE_TESTCASE(compactmultipass1, brass || chert) {
 
     return true;
 }
+
+/// Compactor which checks each table gets a final status exactly once.
+class StatusCountingCompactor : public Xapian::Compactor {
+  public:
+    map<string, int> done;
+
+    void set_status(const string & table, const string & status) {
+	if (!status.empty()) ++done[table];
+    }
+};
+
+#ifdef HAVE_PTHREAD_H
+/// Compactor which also notes which threads start building tables.
+class ThreadNotingCompactor : public StatusCountingCompactor {
+  public:
+    vector<pthread_t> threads;
+
+    void set_status(const string & table, const string & status) {
+	StatusCountingCompactor::set_status(table, status);
+	if (!status.empty()) return;
+	pthread_t self = pthread_self();
+	for (size_t i = 0; i != threads.size(); ++i) {
+	    if (pthread_equal(threads[i], self)) return;
+	}
+	threads.push_back(self);
+	// Stall the first thread, so another thread should take the next
+	// table meanwhile even if there's only one CPU.
+	if (threads.size() == 1) sleep(1);
+    }
+};
+#endif
+
+// Test compacting with several threads gives the same result as with one.
+DEFINE_TESTCASE(compactthreads1, brass || chert) {
+    static const char * const specs[] = {
+	"1-10", "3 5 7-20", "1-4 !2", "100-120", "6-9", "1-30 !15", "42"
+    };
+    const size_t n_specs = sizeof(specs) / sizeof(specs[0]);
+    vector<string> sources;
+    for (size_t i = 0; i != n_specs; ++i) {
+	sources.push_back(get_database_path("compactthreads1_" + str(i),
+					    make_sparse_db, specs[i]));
+    }
+
+    string serialdbpath = get_named_writable_database_path("compactthreads1");
+    string outdbpath = get_named_writable_database_path("compactthreads1out");
+    for (int multipass = 0; multipass != 2; ++multipass) {
+	rm_rf(serialdbpath);
+	rm_rf(outdbpath);
+
+	Xapian::Compactor serial;
+	serial.set_destdir(serialdbpath);
+	serial.set_multipass(multipass);
+	for (size_t i = 0; i != n_specs; ++i) serial.add_source(sources[i]);
+	serial.compact();
+
+#ifdef HAVE_PTHREAD_H
+	ThreadNotingCompactor compact;
+#else
+	StatusCountingCompactor compact;
+#endif
+	compact.set_destdir(outdbpath);
+	compact.set_multipass(multipass);
+	compact.set_threads(4);
+	for (size_t i = 0; i != n_specs; ++i) compact.add_source(sources[i]);
+	compact.compact();
+
+	map<string, int>::const_iterator t;
+	for (t = compact.done.begin(); t != compact.done.end(); ++t) {
+	    TEST_EQUAL(t->second, 1);
+	}
+	TEST_EQUAL(compact.done.size(), 6);
+#ifdef HAVE_PTHREAD_H
+	if (startswith(get_dbtype(), "brass")) {
+	    // Check the tables really were built by more than one thread, but
+	    // by no more than we asked for.
+	    TEST_REL(compact.threads.size(),>=,2);
+	    TEST_REL(compact.threads.size(),<=,4);
+	}
+#endif
+
+	Xapian::Database serialdb(serialdbpath);
+	Xapian::Database outdb(outdbpath);
+	dbcheck(outdb, serialdb.get_doccount(), serialdb.get_lastdocid());
+	check_same_postlists(serialdb, outdb);
+	Xapian::PostingIterator p = serialdb.postlist_begin(string());
+	for ( ; p != serialdb.postlist_end(string()); ++p) {
+	    TEST_EQUAL(outdb.get_document(*p).get_data(),
+		       serialdb.get_document(*p).get_data());
+	}
+    }
+
+    return true;
+}
@@ -28,6 +28,7 @@
 #include <xapian.h>
 
 #include "str.h"
+#include "stringutils.h"
 #include <cmath>
 #include <map>
 #include <vector>
@@ -327,3 +328,146 @@ DEFINE_TESTCASE(matchspy6, !backend)
 
     return true;
 }
+
+static void
+make_matchspy7_db(Xapian::WritableDatabase &db, const string &)
+{
+    for (unsigned i = 1; i <= 1000; ++i) {
+	Xapian::Document doc;
+	doc.add_term("all");
+	// Values of one and two bytes (including zero bytes), longer values,
+	// and no value for some documents.
+	switch (i % 4) {
+	    case 0:
+		doc.add_value(0, string(1, char(i % 7)));
+		break;
+	    case 1:
+		doc.add_value(0, Xapian::sortable_serialise(i % 11));
+		break;
+	    case 2:
+		doc.add_value(0, "value" + str(i % 13));
+		break;
+	}
+	db.add_document(doc);
+    }
+}
+
+/// Check ValueCountMatchSpy counts values of all lengths, and sampling.
+DEFINE_TESTCASE(matchspy7, generated)
+{
+    Xapian::Database db = get_database("matchspy7", make_matchspy7_db);
+
+    map<string, Xapian::doccount> tally;
+    for (Xapian::docid did = 1; did <= db.get_doccount(); ++did) {
+	string val = db.get_document(did).get_value(0);
+	if (!val.empty()) ++tally[val];
+    }
+
+    Xapian::Enquire enq(db);
+    enq.set_query(Xapian::Query("all"));
+    Xapian::ValueCountMatchSpy spy(0);
+    Xapian::ValueCountMatchSpy sample_spy(0, 4);
+    enq.add_matchspy(&spy);
+    enq.add_matchspy(&sample_spy);
+    enq.get_mset(0, 10, db.get_doccount());
+
+    TEST_EQUAL(spy.get_total(), db.get_doccount());
+    TEST_EQUAL(sample_spy.get_total(), db.get_doccount());
+
+    map<string, Xapian::doccount>::const_iterator t = tally.begin();
+    Xapian::TermIterator i;
+    for (i = spy.values_begin(); i != spy.values_end(); ++i) {
+	TEST(t != tally.end());
+	TEST_EQUAL(*i, t->first);
+	TEST_EQUAL(i.get_termfreq(), t->second);
+	++t;
+    }
+    TEST(t == tally.end());
+
+    // The sampled frequencies are estimates, but should be in the right
+    // ballpark, and the values seen should be a subset of the real ones.
+    Xapian::doccount est_total = 0;
+    for (i = sample_spy.values_begin(); i != sample_spy.values_end(); ++i) {
+	TEST(tally.find(*i) != tally.end());
+	est_total += i.get_termfreq();
+    }
+    TEST_REL(est_total,>,500);
+    TEST_REL(est_total,<,1000);
+
+    // The sample is chosen by docid, so running the query again should give
+    // exactly the same counts.
+    Xapian::ValueCountMatchSpy sample_spy2(0, 4);
+    Xapian::Enquire enq2(db);
+    enq2.set_query(Xapian::Query("all"));
+    enq2.add_matchspy(&sample_spy2);
+    enq2.get_mset(0, 10, db.get_doccount());
+    Xapian::TermIterator j = sample_spy2.top_values_begin(10);
+    for (i = sample_spy.top_values_begin(10);
+	 i != sample_spy.top_values_end(10); ++i, ++j) {
+	TEST(j != sample_spy2.top_values_end(10));
+	TEST_EQUAL(*i, *j);
+	TEST_EQUAL(i.get_termfreq(), j.get_termfreq());
+    }
+    TEST(j == sample_spy2.top_values_end(10));
+
+    return true;
+}
+
+static void
+make_matchspy8_db(Xapian::WritableDatabase &db, const string &)
+{
+    for (unsigned i = 1; i <= 1000; ++i) {
+	Xapian::Document doc;
+	doc.add_term("all");
+	// Enough distinct two byte values that they don't all get counted the
+	// same way, mixed with longer values.
+	if (i % 3) {
+	    unsigned v = i % 600;
+	    char buf[2] = { char(v >> 8), char(v & 0xff) };
+	    doc.add_value(0, string(buf, 2));
+	} else {
+	    doc.add_value(0, "value" + str(i % 13));
+	}
+	db.add_document(doc);
+    }
+}
+
+/// Check ValueCountMatchSpy counts many distinct two byte values correctly.
+DEFINE_TESTCASE(matchspy8, generated)
+{
+    Xapian::Database db = get_database("matchspy8", make_matchspy8_db);
+
+    map<string, Xapian::doccount> tally;
+    for (Xapian::docid did = 1; did <= db.get_doccount(); ++did) {
+	++tally[db.get_document(did).get_value(0)];
+    }
+
+    Xapian::Enquire enq(db);
+    enq.set_query(Xapian::Query("all"));
+    Xapian::ValueCountMatchSpy spy(0);
+    enq.add_matchspy(&spy);
+    enq.get_mset(0, 10, db.get_doccount());
+
+    map<string, Xapian::doccount>::const_iterator t = tally.begin();
+    Xapian::TermIterator i;
+    for (i = spy.values_begin(); i != spy.values_end(); ++i) {
+	TEST(t != tally.end());
+	TEST_EQUAL(*i, t->first);
+	TEST_EQUAL(i.get_termfreq(), t->second);
+	++t;
+    }
+    TEST(t == tally.end());
+
+    // The most frequent are the longer values, then the two byte values
+    // which occur twice, in ascending order.
+    i = spy.top_values_begin(20);
+    for (int n = 0; n != 13; ++n, ++i) {
+	TEST(i != spy.top_values_end(20));
+	TEST(startswith(*i, "value"));
+    }
+    TEST(i != spy.top_values_end(20));
+    TEST_EQUAL((*i).size(), 2);
+    TEST_EQUAL(i.get_termfreq(), 2);
+
+    return true;
+}
@@ -28,6 +28,7 @@
 #include <xapian.h>
 
 #include "apitest.h"
+#include "str.h"
 #include "testsuite.h"
 #include "testutils.h"
 
@@ -122,6 +123,66 @@ DEFINE_TESTCASE(valuerange5, generated) {
     return true;
 }
 
+static void
+make_valuerange7(Xapian::WritableDatabase &db, const string &)
+{
+    for (Xapian::docid did = 1; did <= 3000; ++did) {
+	Xapian::Document doc;
+	if (did % 11 == 0) {
+	    // Leave the slot unset.
+	} else if (did % 7 == 0) {
+	    // Values which share their first 8 bytes.
+	    doc.add_value(0, "longprefix" + str(did % 100));
+	} else {
+	    doc.add_value(0, Xapian::sortable_serialise(double(did % 301) - 150.5));
+	}
+	db.add_document(doc);
+    }
+}
+
+/// Check value ranges give the same results as comparing each value.
+DEFINE_TESTCASE(valuerange7, generated) {
+    Xapian::Database db = get_database("valuerange7", make_valuerange7);
+    const string ranges[][2] = {
+	{ Xapian::sortable_serialise(-10), Xapian::sortable_serialise(10) },
+	{ Xapian::sortable_serialise(-150.5), Xapian::sortable_serialise(-149) },
+	{ Xapian::sortable_serialise(149), "longprefix" },
+	{ "longprefix2", "longprefix5" },
+	{ "longprefix", "longprefix" },
+	{ "longprefix50", "longprefix50" },
+	{ string(), Xapian::sortable_serialise(-100) },
+	{ "longprefix9", string() }
+    };
+    Xapian::Enquire enq(db);
+    enq.set_docid_order(Xapian::Enquire::ASCENDING);
+    enq.set_weighting_scheme(Xapian::BoolWeight());
+    for (size_t r = 0; r != sizeof(ranges) / sizeof(ranges[0]); ++r) {
+	const string & begin = ranges[r][0];
+	const string & end = ranges[r][1];
+	Xapian::Query q;
+	if (begin.empty()) {
+	    q = Xapian::Query(Xapian::Query::OP_VALUE_LE, 0, end);
+	} else if (end.empty()) {
+	    q = Xapian::Query(Xapian::Query::OP_VALUE_GE, 0, begin);
+	} else {
+	    q = Xapian::Query(Xapian::Query::OP_VALUE_RANGE, 0, begin, end);
+	}
+	tout << q.get_description() << '\n';
+	enq.set_query(q);
+	Xapian::MSet mset = enq.get_mset(0, db.get_doccount());
+	Xapian::MSetIterator i = mset.begin();
+	for (Xapian::docid did = 1; did <= db.get_lastdocid(); ++did) {
+	    const string & v = db.get_document(did).get_value(0);
+	    if (v.empty() || v < begin || (!end.empty() && v > end)) continue;
+	    TEST(i != mset.end());
+	    TEST_EQUAL(*i, did);
+	    ++i;
+	}
+	TEST(i == mset.end());
+    }
+    return true;
+}
+
 // Feature test for Query::OP_VALUE_GE.
 DEFINE_TESTCASE(valuege1, backend) {
     Xapian::Database db(get_database("apitest_phrase"));
@@ -247,3 +308,44 @@ DEFINE_TESTCASE(valuerange4, backend) {
     Xapian::MSet mset = enq.get_mset(0, 20);
     return true;
 }
+
+// Test an AND including a value range, where which subquery rejects the
+// most candidates changes part way through, so the checks get reordered.
+DEFINE_TESTCASE(valuerange6, writable) {
+    Xapian::WritableDatabase db = get_writable_database();
+    const Xapian::docid N = 2000;
+    for (Xapian::docid did = 1; did <= N; ++did) {
+	Xapian::Document doc;
+	doc.add_term("all");
+	bool first_half = (did <= N / 2);
+	if (first_half || did % 5 == 0) doc.add_term("a");
+	if (!first_half || did % 5 == 0) doc.add_term("b");
+	if (did % 3 != 0) doc.add_term("c");
+	doc.add_value(1, str(10000 + did));
+	db.add_document(doc);
+    }
+    db.commit();
+
+    Xapian::Query terms[] = {
+	Xapian::Query("all"),
+	Xapian::Query("a"),
+	Xapian::Query("b"),
+	Xapian::Query("c"),
+	Xapian::Query(Xapian::Query::OP_VALUE_RANGE, 1, "10100", "11900")
+    };
+    Xapian::Enquire enq(db);
+    enq.set_query(Xapian::Query(Xapian::Query::OP_AND, terms, terms + 5));
+    enq.set_docid_order(Xapian::Enquire::ASCENDING);
+    enq.set_weighting_scheme(Xapian::BoolWeight());
+    Xapian::MSet mset = enq.get_mset(0, N);
+
+    Xapian::MSetIterator i = mset.begin();
+    for (Xapian::docid did = 100; did <= 1900; ++did) {
+	if (did % 5 != 0 || did % 3 == 0) continue;
+	TEST(i != mset.end());
+	TEST_EQUAL(*i, did);
+	++i;
+    }
+    TEST(i == mset.end());
+    return true;
+}
@@ -27,6 +27,7 @@
 #include <xapian.h>
 
 #include <string>
+#include <vector>
 #include "safeunistd.h"
 
 #include "testutils.h"
@@ -661,3 +662,128 @@ DEFINE_TESTCASE(matchtimelimit1, generated && !remote)
 
     return true;
 }
+
+/// PostingSource matching docids for which did % mod != 0 (or == 0).
+class CheckCountingPostingSource : public Xapian::PostingSource {
+    Xapian::docid mod;
+
+    bool multiples;
+
+    Xapian::doccount termfreq_est;
+
+    Xapian::docid last_docid;
+
+    Xapian::docid did;
+
+    bool matches(Xapian::docid d) const { return (d % mod == 0) == multiples; }
+
+  public:
+    /// The docids check() was called for.
+    vector<Xapian::docid> checked;
+
+    CheckCountingPostingSource(Xapian::docid mod_, bool multiples_,
+			       Xapian::doccount termfreq_est_)
+	: mod(mod_), multiples(multiples_), termfreq_est(termfreq_est_),
+	  last_docid(0), did(0) { }
+
+    void init(const Xapian::Database & db) {
+	last_docid = db.get_lastdocid();
+	did = 0;
+    }
+
+    Xapian::doccount get_termfreq_min() const { return 0; }
+
+    Xapian::doccount get_termfreq_est() const { return termfreq_est; }
+
+    Xapian::doccount get_termfreq_max() const { return last_docid; }
+
+    void next(double) {
+	do ++did; while (did <= last_docid && !matches(did));
+    }
+
+    void skip_to(Xapian::docid to_did, double) {
+	if (to_did <= did) return;
+	did = to_did - 1;
+	next(0);
+    }
+
+    bool check(Xapian::docid to_did, double) {
+	checked.push_back(to_did);
+	// If to_did doesn't match, next() moves on from it, as required.
+	did = to_did;
+	return matches(did);
+    }
+
+    bool at_end() const { return did > last_docid; }
+
+    Xapian::docid get_docid() const { return did; }
+
+    string get_description() const { return "CheckCountingPostingSource"; }
+};
+
+static void
+make_checkorder_db(Xapian::WritableDatabase & db, const string &)
+{
+    for (Xapian::docid did = 1; did <= 2000; ++did) {
+	Xapian::Document doc;
+	doc.add_term("all");
+	if (did % 3 != 0) doc.add_term("c");
+	db.add_document(doc);
+    }
+}
+
+/// Check that an AND only checks expensive subqueries on candidates the
+/// cheap ones matched, and checks first those which reject the most.
+DEFINE_TESTCASE(externalsource5, generated && !remote && !multi) {
+    Xapian::Database db = get_database("checkorder", make_checkorder_db);
+    // rare_reject rejects 1 in 7 documents, and has the lower termfreq
+    // estimate so is checked first to begin with.  often_reject rejects
+    // every odd docid, so should be checked first once the order adapts.
+    CheckCountingPostingSource rare_reject(7, false, 100);
+    CheckCountingPostingSource often_reject(2, true, 1000);
+    Xapian::Query terms[] = {
+	Xapian::Query(&often_reject),
+	Xapian::Query("all"),
+	Xapian::Query(&rare_reject),
+	Xapian::Query("c")
+    };
+    Xapian::Enquire enq(db);
+    enq.set_query(Xapian::Query(Xapian::Query::OP_AND, terms, terms + 4));
+    enq.set_docid_order(Xapian::Enquire::ASCENDING);
+    enq.set_weighting_scheme(Xapian::BoolWeight());
+    Xapian::MSet mset = enq.get_mset(0, 2000);
+
+    Xapian::MSetIterator m = mset.begin();
+    for (Xapian::docid did = 1; did <= 2000; ++did) {
+	if (did % 3 == 0 || did % 2 != 0 || did % 7 == 0) continue;
+	TEST(m != mset.end());
+	TEST_EQUAL(*m, did);
+	++m;
+    }
+    TEST(m == mset.end());
+
+    // The expensive subqueries are only checked on documents which the
+    // cheap ones matched.
+    vector<Xapian::docid>::const_iterator i;
+    for (i = often_reject.checked.begin(); i != often_reject.checked.end(); ++i)
+	TEST_NOT_EQUAL(*i % 3, 0);
+    size_t early_odd = 0, late_odd = 0;
+    for (i = rare_reject.checked.begin(); i != rare_reject.checked.end(); ++i) {
+	TEST_NOT_EQUAL(*i % 3, 0);
+	if (*i % 2 == 0) continue;
+	if (*i <= 90) {
+	    ++early_odd;
+	} else if (*i > 300) {
+	    ++late_odd;
+	}
+    }
+
+    // Until the order adapts, rare_reject checks every candidate, but
+    // afterwards only those often_reject accepted, so it's checked about
+    // half as often.
+    TEST_EQUAL(early_odd, 30);
+    TEST_EQUAL(late_odd, 0);
+    TEST_REL(rare_reject.checked.size(),<,often_reject.checked.size() * 2 / 3);
+
+    return true;
+}
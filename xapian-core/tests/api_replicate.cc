@@ -48,6 +48,13 @@
 
 #include <stdlib.h> // For setenv() or putenv()
 
+#if defined XAPIAN_HAS_REMOTE_BACKEND && defined HAVE_FORK
+# include "net/replicatetcpclient.h"
+# include "net/replicatetcpserver.h"
+# include <signal.h>
+# include <sys/wait.h>
+#endif
+
 using namespace std;
 
 static void rmtmpdir(const string & path) {
@@ -818,3 +825,230 @@ DEFINE_TESTCASE(replicate6, replicas) {
     rmtmpdir(tempdir);
     return true;
 }
+
+// Test DatabaseMaster::wait_for_changes(), used for streaming replication.
+DEFINE_TESTCASE(replicate7, replicas) {
+    UNSET_MAX_CHANGESETS_AFTERWARDS;
+    string tempdir = ".replicatmp";
+    mktmpdir(tempdir);
+    string masterpath = get_named_writable_database_path("master");
+
+    set_max_changesets(10);
+
+    Xapian::WritableDatabase orig(get_named_writable_database("master"));
+    Xapian::DatabaseMaster master(masterpath);
+    string replicapath = tempdir + "/replica";
+    Xapian::DatabaseReplica replica(replicapath);
+
+    Xapian::Document doc1;
+    doc1.set_data(string("doc1"));
+    doc1.add_posting("doc", 1);
+    doc1.add_posting("one", 1);
+    orig.add_document(doc1);
+    orig.commit();
+
+    // A replica with no database needs a copy.
+    TEST(master.wait_for_changes(string(), 0.0));
+    int count = replicate(master, replica, tempdir, 0, 1, true);
+    TEST_EQUAL(count, 1);
+
+    // The replica is up to date, so this should time out.
+    string revision = replica.get_revision_info();
+    TEST(!master.wait_for_changes(revision, 0.0));
+    TEST(!master.wait_for_changes(revision, 0.1));
+
+    orig.add_document(doc1);
+    orig.commit();
+    TEST(master.wait_for_changes(revision, 10.0));
+    count = replicate(master, replica, tempdir, 1, 0, true);
+    TEST_EQUAL(count, 2);
+    TEST(!master.wait_for_changes(replica.get_revision_info(), 0.0));
+
+    check_equal_dbs(masterpath, replicapath);
+
+    // Need to close the replica before we remove the temporary directory on
+    // Windows.
+    replica.close();
+    rmtmpdir(tempdir);
+    return true;
+}
+
+#if defined XAPIAN_HAS_REMOTE_BACKEND && defined HAVE_FORK
+/** Start a ReplicateTcpServer in a child process.
+ *
+ *  The child is the leader of a new process group, which also contains the
+ *  processes it forks to handle each connection.
+ *
+ *  @return the port the server is listening on.
+ */
+static int
+start_replicate_server(const string & path, double keepalive_interval,
+		       double read_timeout, pid_t & pid)
+{
+    // Start at 1239 and try higher ports until one isn't already in use.
+    for (int port = 1239; port < 65536; ++port) {
+	int fds[2];
+	if (pipe(fds) < 0) FAIL_TEST("pipe() failed");
+	pid = fork();
+	if (pid == 0) {
+	    close(fds[0]);
+	    setpgid(0, 0);
+	    try {
+		// Exits with status 69 if the port is already in use.
+		ReplicateTcpServer server("127.0.0.1", port, path);
+		server.set_keepalive_interval(keepalive_interval);
+		server.set_read_timeout(read_timeout);
+		// Tell the parent we're listening.
+		if (write(fds[1], "", 1) != 1) _exit(1);
+		server.run();
+	    } catch (...) {
+	    }
+	    _exit(1);
+	}
+	if (pid < 0) FAIL_TEST("fork() failed");
+	close(fds[1]);
+	char ch;
+	ssize_t n = read(fds[0], &ch, 1);
+	close(fds[0]);
+	if (n == 1) return port;
+	waitpid(pid, NULL, 0);
+    }
+    FAIL_TEST("Couldn't find a free port for ReplicateTcpServer");
+}
+#endif
+
+// Test streaming replication over TCP, as xapian-replicate --stream uses.
+DEFINE_TESTCASE(replicate8, replicas) {
+#if !defined XAPIAN_HAS_REMOTE_BACKEND || !defined HAVE_FORK
+    SKIP_TEST("Needs the remote backend and fork()");
+#else
+    UNSET_MAX_CHANGESETS_AFTERWARDS;
+    string tempdir = ".replicatmp";
+    mktmpdir(tempdir);
+    string masterpath = get_named_writable_database_path("master");
+    string::size_type slash = masterpath.rfind('/');
+    string masterdir(masterpath, 0, slash);
+    string masterdb(masterpath, slash + 1);
+
+    // Start the server before opening the master, so the child doesn't
+    // inherit its lock.
+    pid_t pid;
+    int port = start_replicate_server(masterdir, 0.1, 30.0, pid);
+
+    set_max_changesets(10);
+
+    Xapian::WritableDatabase orig(get_named_writable_database("master"));
+    string replicapath = tempdir + "/replica";
+
+    Xapian::Document doc1;
+    doc1.set_data(string("doc1"));
+    doc1.add_posting("doc", 1);
+    doc1.add_posting("one", 1);
+    orig.add_document(doc1);
+    orig.commit();
+
+    {
+	// The server rejects a bad database name by closing the connection
+	// without replying, as a server which predates streaming does for
+	// 'S', so the client should report that streaming isn't supported.
+	ReplicateTcpClient client("127.0.0.1", port, 10.0);
+	client.set_read_timeout(5.0);
+	client.start_streaming(replicapath, "../" + masterdb, false);
+	Xapian::ReplicationInfo info;
+	TEST_EXCEPTION(Xapian::FeatureUnavailableError,
+		       client.wait_for_update(replicapath, info, 0));
+    }
+
+    ReplicateTcpClient client("127.0.0.1", port, 10.0);
+    client.set_read_timeout(1.0);
+    client.start_streaming(replicapath, masterdb, false);
+
+    // The first update brings the replica up to date with a copy.
+    Xapian::ReplicationInfo info;
+    client.wait_for_update(replicapath, info, 0);
+    TEST_EQUAL(info.changeset_count, 0);
+    TEST_EQUAL(info.fullcopy_count, 1);
+    TEST(info.changed);
+    check_equal_dbs(masterpath, replicapath);
+
+    // Later updates are sent as changesets once they're committed.  Wait
+    // longer than the read timeout first so that keepalives are queued
+    // before each changeset.
+    for (int i = 0; i < 2; ++i) {
+	sleep(2);
+	orig.add_document(doc1);
+	orig.commit();
+	client.wait_for_update(replicapath, info, 0);
+	TEST_EQUAL(info.changeset_count, 1);
+	TEST_EQUAL(info.fullcopy_count, 0);
+	TEST(info.changed);
+	check_equal_dbs(masterpath, replicapath);
+    }
+
+    // If the server stops responding, the client should give up waiting
+    // once the read timeout expires, rather than hanging.
+    kill(-pid, SIGSTOP);
+    TEST_EXCEPTION(Xapian::NetworkTimeoutError,
+		   client.wait_for_update(replicapath, info, 0));
+    kill(-pid, SIGKILL);
+    waitpid(pid, NULL, 0);
+
+    rmtmpdir(tempdir);
+    return true;
+#endif
+}
+
+// Test a streaming server closes the connection if the client doesn't report
+// the revision it reached within the read timeout.
+DEFINE_TESTCASE(replicate9, replicas) {
+#if !defined XAPIAN_HAS_REMOTE_BACKEND || !defined HAVE_FORK
+    SKIP_TEST("Needs the remote backend and fork()");
+#else
+    string tempdir = ".replicatmp";
+    mktmpdir(tempdir);
+    string masterpath = get_named_writable_database_path("master");
+    string::size_type slash = masterpath.rfind('/');
+    string masterdir(masterpath, 0, slash);
+    string masterdb(masterpath, slash + 1);
+
+    pid_t pid;
+    int port = start_replicate_server(masterdir, 0.1, 0.5, pid);
+
+    Xapian::WritableDatabase orig(get_named_writable_database("master"));
+    Xapian::Document doc1;
+    doc1.set_data(string("doc1"));
+    doc1.add_posting("doc", 1);
+    orig.add_document(doc1);
+    orig.commit();
+
+    string replicapath = tempdir + "/replica";
+    ReplicateTcpClient client("127.0.0.1", port, 10.0);
+    client.set_read_timeout(2.0);
+    client.start_streaming(replicapath, masterdb, false);
+
+    // Don't apply the copy the server sends until after its read timeout
+    // has expired.  The copy is still buffered, but the server should then
+    // have closed the connection rather than waiting for us, so we shouldn't
+    // get the changes committed after it.  Ignore SIGPIPE so telling the
+    // server our revision gives an exception rather than killing us.
+    sleep(2);
+    orig.add_document(doc1);
+    orig.commit();
+    void (*old_handler)(int) = signal(SIGPIPE, SIG_IGN);
+    try {
+	Xapian::ReplicationInfo info;
+	client.wait_for_update(replicapath, info, 0);
+	client.wait_for_update(replicapath, info, 0);
+	signal(SIGPIPE, old_handler);
+	FAIL_TEST("Server didn't close the connection");
+    } catch (const Xapian::NetworkError &) {
+    }
+    signal(SIGPIPE, old_handler);
+
+    kill(-pid, SIGKILL);
+    waitpid(pid, NULL, 0);
+
+    rmtmpdir(tempdir);
+    return true;
+#endif
+}
@@ -25,6 +25,7 @@
 #include <xapian.h>
 
 #include "apitest.h"
+#include "str.h"
 #include "testutils.h"
 
 using namespace std;
@@ -242,3 +243,69 @@ DEFINE_TESTCASE(sortfunctorremote1,remote) {
     );
     return true;
 }
+
+static void
+make_sortvalue2_db(Xapian::WritableDatabase &db, const string &)
+{
+    for (unsigned i = 1; i <= 600; ++i) {
+	Xapian::Document doc;
+	doc.add_term("all");
+	if (i % 2) doc.add_term("odd");
+	// Short keys, and long keys which share their first 16 bytes.
+	if (i % 10 != 0) {
+	    string key = Xapian::sortable_serialise(i % 37);
+	    if (i % 3 == 0) key = "a long key with " + str(i % 13);
+	    doc.add_value(0, key);
+	}
+	// Dates, where a third of the documents have the latest date.
+	if (i % 3 == 0) {
+	    doc.add_value(1, "20121231");
+	} else {
+	    doc.add_value(1, "2012" + str(1000 + i % 500));
+	}
+	db.add_document(doc);
+    }
+}
+
+/// Check sorting by value alone gives the same order as by value then weight.
+DEFINE_TESTCASE(sortvalue2, generated) {
+    Xapian::Database db = get_database("sortvalue2", make_sortvalue2_db);
+    Xapian::Enquire enq_val(db);
+    Xapian::Enquire enq_valrel(db);
+    enq_val.set_weighting_scheme(Xapian::BoolWeight());
+    enq_valrel.set_weighting_scheme(Xapian::BoolWeight());
+    const char * terms[] = { "all", "odd" };
+    for (int t = 0; t != 2; ++t) {
+	enq_val.set_query(Xapian::Query(terms[t]));
+	enq_valrel.set_query(Xapian::Query(terms[t]));
+	for (int n = 0; n != 8; ++n) {
+	    Xapian::valueno slot = n & 1;
+	    bool ascending = (n & 2);
+	    Xapian::Enquire::docid_order order = (n & 4) ?
+		Xapian::Enquire::DESCENDING : Xapian::Enquire::ASCENDING;
+	    tout << terms[t] << " slot " << slot << " ascending " << ascending
+		 << " order " << order << '\n';
+	    enq_val.set_sort_by_value(slot, ascending);
+	    enq_val.set_docid_order(order);
+	    enq_valrel.set_sort_by_value_then_relevance(slot, ascending);
+	    enq_valrel.set_docid_order(order);
+	    Xapian::MSet mset1 = enq_val.get_mset(0, 10);
+	    Xapian::MSet mset2 = enq_valrel.get_mset(0, 10);
+	    TEST(mset_range_is_same(mset1, 0, mset2, 0, 10));
+	    TEST_REL(mset1.get_matches_lower_bound(),<=,
+		     mset1.get_matches_estimated());
+	    TEST_REL(mset1.get_matches_estimated(),<=,
+		     mset1.get_matches_upper_bound());
+	    mset1 = enq_val.get_mset(5, 300);
+	    mset2 = enq_valrel.get_mset(5, 300);
+	    TEST_EQUAL(mset1.size(), mset2.size());
+	    TEST(mset_range_is_same(mset1, 0, mset2, 0, mset2.size()));
+	    mset1 = enq_val.get_mset(0, 1000);
+	    mset2 = enq_valrel.get_mset(0, 1000);
+	    TEST_EQUAL(mset1.size(), mset2.size());
+	    TEST(mset_range_is_same(mset1, 0, mset2, 0, mset2.size()));
+	    TEST_EQUAL(mset1.get_matches_estimated(), mset1.size());
+	}
+    }
+    return true;
+}
@@ -38,6 +38,7 @@
 
 #include "apitest.h"
 
+#include "safesysstat.h"
 #include "safeunistd.h"
 #include <cmath>
 #include <cstdlib>
@@ -2014,3 +2015,713 @@ DEFINE_TESTCASE(modifyvalues1, writable) {
 
     return true;
 }
+
+/// Check fetching documents copes with one being deleted after the match.
+DEFINE_TESTCASE(fetchdocs2, writable && !inmemory) {
+    Xapian::WritableDatabase db = get_writable_database();
+    for (int i = 1; i <= 10; ++i) {
+	Xapian::Document doc;
+	doc.set_data("doc " + str(i));
+	doc.add_value(0, "val " + str(i));
+	doc.add_term("test");
+	db.add_document(doc);
+    }
+    db.commit();
+
+    Xapian::Enquire enquire(db);
+    enquire.set_query(Xapian::Query("test"));
+    enquire.set_docid_order(Xapian::Enquire::ASCENDING);
+    Xapian::MSet mset = enquire.get_mset(0, 10);
+    TEST_EQUAL(mset.size(), 10);
+
+    // fetch() only requests the documents - none are actually read until
+    // one is accessed, so the deletion should be seen.
+    mset.fetch(mset[4]);
+    db.delete_document(5);
+    TEST_EXCEPTION(Xapian::DocNotFoundError,
+		   mset[4].get_document().get_data());
+
+    mset = enquire.get_mset(0, 10);
+    TEST_EQUAL(mset.size(), 9);
+    mset.fetch();
+    Xapian::MSetIterator it;
+    for (it = mset.begin(); it != mset.end(); ++it) {
+	Xapian::docid did = *it;
+	Xapian::Document doc = it.get_document();
+	TEST_EQUAL(doc.get_data(), "doc " + str(did));
+	TEST_EQUAL(doc.get_value(0), "val " + str(did));
+    }
+
+    // Check we don't get a stale copy of a document from an earlier fetch.
+    Xapian::Document doc;
+    doc.set_data("changed");
+    doc.add_term("test");
+    db.replace_document(1, doc);
+    mset = enquire.get_mset(0, 10);
+    mset.fetch();
+    TEST_EQUAL(mset.begin().get_document().get_data(), "changed");
+    TEST_EQUAL(mset.begin().get_document().get_value(0), "");
+
+    // Documents requested for one MSet are read along with those requested
+    // for another, so check changes made in between are still seen.
+    Xapian::Enquire enquire2(db);
+    enquire2.set_query(Xapian::Query("test"));
+    enquire2.set_docid_order(Xapian::Enquire::DESCENDING);
+    mset = enquire.get_mset(0, 10);
+    Xapian::MSet mset2 = enquire2.get_mset(0, 3);
+    TEST_EQUAL(*mset2[2], 8);
+    mset.fetch(mset[1]);
+    mset2.fetch();
+    TEST_EQUAL(mset[1].get_document().get_data(), "doc 2");
+    doc.set_data("changed 8");
+    db.replace_document(8, doc);
+    TEST_EQUAL(mset2[2].get_document().get_data(), "changed 8");
+    TEST_EQUAL(mset2[1].get_document().get_data(), "doc 9");
+
+    mset = enquire.get_mset(0, 10);
+    mset2 = enquire2.get_mset(0, 3);
+    mset.fetch(mset[2]);
+    mset2.fetch();
+    TEST_EQUAL(mset[2].get_document().get_data(), "doc 3");
+    doc.set_data("changed 9");
+    db.replace_document(9, doc);
+    db.commit();
+    TEST_EQUAL(mset2[1].get_document().get_data(), "changed 9");
+
+    return true;
+}
+
+/// Check large document data and values survive, compressible or not.
+DEFINE_TESTCASE(bigdocdata1, writable) {
+    Xapian::WritableDatabase db = get_writable_database();
+
+    // Compressible data and value.
+    string text;
+    while (text.size() < 100000) text += "the quick brown fox " + str(text.size());
+    // Data which won't compress.
+    string noise;
+    srand(42);
+    while (noise.size() < 100000) noise += char(rand() >> 8);
+
+    Xapian::Document doc;
+    doc.set_data(text);
+    doc.add_value(0, noise);
+    doc.add_term("text");
+    db.add_document(doc);
+    doc.set_data(noise);
+    doc.add_value(0, text);
+    doc.add_term("noise");
+    db.add_document(doc);
+    db.commit();
+
+    Xapian::Enquire enquire(db);
+    enquire.set_query(Xapian::Query("text"));
+    enquire.set_docid_order(Xapian::Enquire::ASCENDING);
+    Xapian::MSet mset = enquire.get_mset(0, 10);
+    TEST_EQUAL(mset.size(), 2);
+    mset.fetch();
+    TEST(mset[0].get_document().get_data() == text);
+    TEST(mset[0].get_document().get_value(0) == noise);
+    TEST(mset[1].get_document().get_data() == noise);
+    TEST(mset[1].get_document().get_value(0) == text);
+
+    TEST(db.get_document(1).get_data() == text);
+    TEST(db.get_document(2).get_data() == noise);
+
+    return true;
+}
+
+/// Check changes buffered out of docid order are merged correctly.
+DEFINE_TESTCASE(outoforder1, writable) {
+    Xapian::WritableDatabase db = get_writable_database();
+
+    const Xapian::docid N = 300;
+    for (Xapian::docid did = 1; did <= N; ++did) {
+	Xapian::Document doc;
+	doc.add_posting("x", 1);
+	doc.add_term("all");
+	db.add_document(doc);
+    }
+    db.commit();
+
+    // Replace documents in descending order, some of them twice, and
+    // delete every seventh.
+    for (Xapian::docid did = N; did >= 1; --did) {
+	Xapian::Document doc;
+	doc.add_posting("x", did);
+	doc.add_posting("x", did + 1);
+	doc.add_term("all");
+	db.replace_document(did, doc);
+	if (did % 5 == 0) {
+	    doc.add_posting("x", did + 2);
+	    db.replace_document(did, doc);
+	}
+    }
+    for (Xapian::docid did = 7; did <= N; did += 7) {
+	db.delete_document(did);
+    }
+
+    for (int pass = 0; pass != 2; ++pass) {
+	Xapian::docid expect = 1;
+	Xapian::PostingIterator p;
+	for (p = db.postlist_begin("x"); p != db.postlist_end("x"); ++p) {
+	    if (expect % 7 == 0) ++expect;
+	    TEST_EQUAL(*p, expect);
+	    Xapian::termcount wdf = (expect % 5 == 0) ? 3 : 2;
+	    TEST_EQUAL(p.get_wdf(), wdf);
+	    TEST_EQUAL(db.get_doclength(expect), wdf + 1);
+	    Xapian::PositionIterator pos = db.positionlist_begin(expect, "x");
+	    TEST_EQUAL(*pos, expect);
+	    ++pos;
+	    TEST_EQUAL(*pos, expect + 1);
+	    ++expect;
+	}
+	TEST_EQUAL(expect, N + 1);
+	TEST_EQUAL(db.get_termfreq("x"), N - N / 7);
+	db.commit();
+    }
+
+    return true;
+}
+
+/// Add the documents for the adddocuments tests.
+static void
+make_adddocuments_docs(vector<Xapian::Document> & docs)
+{
+    for (unsigned i = 0; i != 1000; ++i) {
+	Xapian::Document doc;
+	doc.set_data("doc " + str(i));
+	// Leave some documents empty.
+	if (i % 100 != 7) {
+	    doc.add_term("common", 1 + i % 3);
+	    for (unsigned j = 0; j != i % 13; ++j) {
+		doc.add_posting("t" + str((i + j) % 37), j + 1);
+	    }
+	    doc.add_boolean_term("Q" + str(i));
+	}
+	if (i % 3) doc.add_value(i % 5, str(i));
+	docs.push_back(doc);
+    }
+}
+
+/// Check databases @a a and @a b have the same contents.
+static void
+check_same_contents(const Xapian::Database & a, const Xapian::Database & b)
+{
+    TEST_EQUAL(a.get_doccount(), b.get_doccount());
+    TEST_EQUAL(a.get_lastdocid(), b.get_lastdocid());
+    TEST_EQUAL(a.get_avlength(), b.get_avlength());
+    for (Xapian::docid did = 1; did <= a.get_lastdocid(); ++did) {
+	Xapian::Document doc_a = a.get_document(did);
+	Xapian::Document doc_b = b.get_document(did);
+	TEST_EQUAL(doc_a.get_data(), doc_b.get_data());
+	TEST_EQUAL(a.get_doclength(did), b.get_doclength(did));
+	Xapian::TermIterator t = doc_b.termlist_begin();
+	for (Xapian::TermIterator s = doc_a.termlist_begin();
+	     s != doc_a.termlist_end(); ++s) {
+	    TEST(t != doc_b.termlist_end());
+	    TEST_EQUAL(*s, *t);
+	    TEST_EQUAL(s.get_wdf(), t.get_wdf());
+	    Xapian::PositionIterator q = b.positionlist_begin(did, *t);
+	    Xapian::PositionIterator p;
+	    for (p = a.positionlist_begin(did, *s);
+		 p != a.positionlist_end(did, *s); ++p) {
+		TEST(q != b.positionlist_end(did, *t));
+		TEST_EQUAL(*p, *q);
+		++q;
+	    }
+	    TEST(q == b.positionlist_end(did, *t));
+	    ++t;
+	}
+	TEST(t == doc_b.termlist_end());
+	Xapian::ValueIterator v = doc_b.values_begin();
+	for (Xapian::ValueIterator u = doc_a.values_begin();
+	     u != doc_a.values_end(); ++u) {
+	    TEST(v != doc_b.values_end());
+	    TEST_EQUAL(u.get_valueno(), v.get_valueno());
+	    TEST_EQUAL(*u, *v);
+	    ++v;
+	}
+	TEST(v == doc_b.values_end());
+    }
+}
+
+/// Feature test for WritableDatabase::add_documents().
+DEFINE_TESTCASE(adddocuments1, writable) {
+    vector<Xapian::Document> docs;
+    make_adddocuments_docs(docs);
+
+    Xapian::WritableDatabase db1 =
+	get_named_writable_database("adddocuments1a", string());
+    for (size_t i = 0; i != docs.size(); ++i) {
+	db1.add_document(docs[i]);
+    }
+    db1.commit();
+
+    Xapian::WritableDatabase db2 =
+	get_named_writable_database("adddocuments1b", string());
+    TEST_EQUAL(db2.add_documents(vector<Xapian::Document>(), 4), 0);
+    TEST_EQUAL(db2.add_documents(docs, 4), 1);
+    db2.commit();
+    check_same_contents(db1, db2);
+
+    // Adding serially should give the same result too.
+    Xapian::WritableDatabase db3 =
+	get_named_writable_database("adddocuments1c", string());
+    TEST_EQUAL(db3.add_documents(docs), 1);
+    TEST_EQUAL(db3.add_documents(docs, 3), docs.size() + 1);
+    db3.commit();
+    TEST_EQUAL(db3.get_doccount(), 2 * docs.size());
+    TEST_EQUAL(db3.get_termfreq("Q0"), 2);
+
+    return true;
+}
+
+/// Test add_documents() with documents from a database, and with an error.
+DEFINE_TESTCASE(adddocuments2, brass) {
+    vector<Xapian::Document> docs;
+    make_adddocuments_docs(docs);
+    Xapian::WritableDatabase db1 =
+	get_named_writable_database("adddocuments2a", string());
+    (void)db1.add_documents(docs, 4);
+    db1.commit();
+
+    // Documents read from a database have their terms read in lazily, which
+    // add_documents() must do before handing them to other threads.
+    vector<Xapian::Document> db_docs;
+    for (Xapian::docid did = 1; did <= db1.get_lastdocid(); ++did) {
+	db_docs.push_back(db1.get_document(did));
+    }
+    Xapian::WritableDatabase db2 =
+	get_named_writable_database("adddocuments2b", string());
+    (void)db2.add_documents(db_docs, 4);
+    db2.commit();
+    check_same_contents(db1, db2);
+
+    // A document which can't be added should throw the usual exception, and
+    // leave the database as add_document() would.
+    Xapian::WritableDatabase db3 =
+	get_named_writable_database("adddocuments2c", string());
+    docs[500].add_term(string(300, 'x'));
+    TEST_EXCEPTION(Xapian::InvalidArgumentError,
+		   db3.add_documents(docs, 4));
+    db3.commit();
+    TEST_EQUAL(db3.get_doccount(), 0);
+
+    return true;
+}
+
+/** Set environment variable @a NAME to @a VALUE.
+ *
+ *  Both must be string literals, as putenv() keeps a pointer to the string
+ *  it is passed.
+ */
+#ifdef HAVE__PUTENV_S
+# define set_env_literal(NAME, VALUE) _putenv_s(NAME, VALUE)
+#elif defined HAVE_SETENV
+# define set_env_literal(NAME, VALUE) setenv(NAME, VALUE, 1)
+#else
+# define set_env_literal(NAME, VALUE) putenv(const_cast<char*>(NAME "=" VALUE))
+#endif
+
+#define set_flush_threshold(N) set_env_literal("XAPIAN_FLUSH_THRESHOLD", #N)
+
+/// Check databases @a a and @a b have the same postlists.
+static void
+check_same_postlists(const Xapian::Database & a, const Xapian::Database & b)
+{
+    Xapian::TermIterator t = b.allterms_begin();
+    for (Xapian::TermIterator s = a.allterms_begin(); s != a.allterms_end();
+	 ++s) {
+	TEST(t != b.allterms_end());
+	TEST_EQUAL(*s, *t);
+	TEST_EQUAL(s.get_termfreq(), t.get_termfreq());
+	TEST_EQUAL(a.get_collection_freq(*s), b.get_collection_freq(*t));
+	Xapian::PostingIterator q = b.postlist_begin(*t);
+	Xapian::PostingIterator p;
+	for (p = a.postlist_begin(*s); p != a.postlist_end(*s); ++p) {
+	    TEST(q != b.postlist_end(*t));
+	    TEST_EQUAL(*p, *q);
+	    TEST_EQUAL(p.get_wdf(), q.get_wdf());
+	    TEST_EQUAL(p.get_doclength(), q.get_doclength());
+	    ++q;
+	}
+	TEST(q == b.postlist_end(*t));
+	++t;
+    }
+    TEST(t == b.allterms_end());
+}
+
+/// Feature test for Xapian::DB_BULK_LOAD.
+DEFINE_TESTCASE(bulkload1, brass) {
+    vector<Xapian::Document> docs;
+    make_adddocuments_docs(docs);
+    Xapian::WritableDatabase db1 =
+	get_named_writable_database("bulkload1", string());
+    for (size_t i = 0; i != docs.size(); ++i) {
+	db1.add_document(docs[i]);
+    }
+    db1.commit();
+
+    string db_dir = "." + get_dbtype();
+    mkdir(db_dir.c_str(), 0755);
+    db_dir += "/db__bulkload1";
+    const int flags =
+	Xapian::DB_CREATE|Xapian::DB_BACKEND_BRASS|Xapian::DB_BULK_LOAD;
+
+    // Flush often enough that there are too many runs to merge in one go.
+    set_flush_threshold(20);
+    try {
+	rm_rf(db_dir);
+	{
+	    Xapian::WritableDatabase db2(db_dir, flags);
+	    db2.set_metadata("key", "value");
+	    for (size_t i = 0; i != docs.size(); ++i) {
+		db2.add_document(docs[i]);
+	    }
+	    // Nothing is committed until bulk loading ends.
+	    TEST(dir_exists(db_dir + "/bulk0"));
+	    Xapian::Database rdb(db_dir);
+	    TEST_EQUAL(rdb.get_doccount(), 0);
+	    db2.commit();
+	    TEST(!dir_exists(db_dir + "/bulk0"));
+	    TEST(rdb.reopen());
+	    check_same_contents(db1, rdb);
+	    check_same_postlists(db1, rdb);
+	    TEST_EQUAL(rdb.get_metadata("key"), "value");
+	    TEST_EQUAL(rdb.get_value_freq(1), db1.get_value_freq(1));
+
+	    // Changes are made in the usual way once bulk loading has ended.
+	    db2.delete_document(5);
+	    db2.add_document(docs[5]);
+	    db2.commit();
+	    db1.delete_document(5);
+	    db1.add_document(docs[5]);
+	    db1.commit();
+	    TEST(rdb.reopen());
+	    check_same_postlists(db1, rdb);
+	}
+
+	// Reading postings ends bulk loading too.
+	rm_rf(db_dir);
+	{
+	    Xapian::WritableDatabase db3(db_dir, flags);
+	    for (size_t i = 0; i != 500; ++i) {
+		db3.add_document(docs[i]);
+	    }
+	    TEST_EQUAL(db3.get_termfreq("common"), 495);
+	    TEST(!dir_exists(db_dir + "/bulk0"));
+	    for (size_t i = 500; i != docs.size(); ++i) {
+		db3.add_document(docs[i]);
+	    }
+	    db3.delete_document(5);
+	    db3.add_document(docs[5]);
+	    db3.commit();
+	    TEST_EQUAL(db3.get_doccount(), db1.get_doccount());
+	    TEST_EQUAL(db3.get_avlength(), db1.get_avlength());
+	    check_same_postlists(db1, db3);
+	}
+
+	// Cancelling discards the runs.
+	rm_rf(db_dir);
+	{
+	    Xapian::WritableDatabase db4(db_dir, flags);
+	    db4.begin_transaction(false);
+	    for (size_t i = 0; i != 100; ++i) {
+		db4.add_document(docs[i]);
+	    }
+	    TEST(dir_exists(db_dir + "/bulk0"));
+	    db4.cancel_transaction();
+	    TEST(!dir_exists(db_dir + "/bulk0"));
+	    TEST_EQUAL(db4.get_doccount(), 0);
+	    db4.add_document(docs[0]);
+	    db4.commit();
+	    TEST_EQUAL(db4.get_termfreq("common"), 1);
+	}
+
+	// Runs left behind by a bulk load which didn't finish are removed
+	// when the database is next opened for writing, even without
+	// DB_BULK_LOAD.
+	mkdir((db_dir + "/bulk0").c_str(), 0755);
+	touch(db_dir + "/bulk0/postlist.DB");
+	mkdir((db_dir + "/bulk12").c_str(), 0755);
+	mkdir((db_dir + "/bulkx").c_str(), 0755);
+	{
+	    Xapian::WritableDatabase db5(db_dir, Xapian::DB_OPEN);
+	    TEST(!dir_exists(db_dir + "/bulk0"));
+	    TEST(!dir_exists(db_dir + "/bulk12"));
+	    // Only directories named like runs are removed.
+	    TEST(dir_exists(db_dir + "/bulkx"));
+	    TEST_EQUAL(db5.get_doccount(), 1);
+	}
+    } catch (...) {
+	set_flush_threshold(0);
+	throw;
+    }
+    set_flush_threshold(0);
+
+    return true;
+}
+
+/// Feature test for WritableDatabase::commit_async().
+DEFINE_TESTCASE(commitasync1, writable) {
+    vector<Xapian::Document> docs;
+    make_adddocuments_docs(docs);
+    Xapian::WritableDatabase db1 =
+	get_named_writable_database("commitasync1a", string());
+    for (size_t i = 0; i != docs.size(); ++i) {
+	db1.add_document(docs[i]);
+    }
+    db1.commit();
+
+    Xapian::WritableDatabase db2 =
+	get_named_writable_database("commitasync1b", string());
+    // Nothing to commit.
+    db2.commit_async();
+    db2.wait_for_commit();
+    for (size_t i = 0; i != 500; ++i) {
+	db2.add_document(docs[i]);
+    }
+    db2.commit_async();
+    // Adding documents doesn't have to wait for the commit.
+    for (size_t i = 500; i != 700; ++i) {
+	TEST_EQUAL(db2.add_document(docs[i]), i + 1);
+    }
+    // Anything else does.
+    TEST_EQUAL(db2.get_doccount(), 700);
+    TEST_EQUAL(db2.get_termfreq("common"), 693);
+    db2.commit_async();
+    for (size_t i = 700; i != docs.size(); ++i) {
+	db2.add_document(docs[i]);
+    }
+    db2.commit_async();
+    db2.wait_for_commit();
+    // Calling wait_for_commit() again is harmless.
+    db2.wait_for_commit();
+    check_same_contents(db1, db2);
+
+    return true;
+}
+
+/// Check what's visible while a commit_async() runs.
+DEFINE_TESTCASE(commitasync2, brass) {
+    vector<Xapian::Document> docs;
+    make_adddocuments_docs(docs);
+    Xapian::WritableDatabase db = get_writable_database();
+    for (size_t i = 0; i != 500; ++i) {
+	db.add_document(docs[i]);
+    }
+    db.commit_async();
+    for (size_t i = 500; i != 600; ++i) {
+	db.add_document(docs[i]);
+    }
+    // A document from the database itself can't be queued.
+    db.add_document(db.get_document(1));
+    db.wait_for_commit();
+
+    // The documents added during the commit aren't committed.
+    Xapian::Database rdb = get_writable_database_as_database();
+    TEST_EQUAL(rdb.get_doccount(), 500);
+    TEST_EQUAL(db.get_doccount(), 601);
+    TEST_EQUAL(db.get_document(601).get_data(), docs[0].get_data());
+
+    db.commit_async();
+    db.wait_for_commit();
+    TEST(rdb.reopen());
+    TEST_EQUAL(rdb.get_doccount(), 601);
+    TEST_EQUAL(rdb.get_termfreq("common"), 595);
+    TEST_EQUAL(rdb.get_document(600).get_data(), docs[599].get_data());
+
+    // A document which can't be added throws without waiting for the commit,
+    // and gives back its docid.
+    db.commit_async();
+    Xapian::Document bad;
+    bad.add_term(string(300, 'x'));
+    TEST_EXCEPTION(Xapian::InvalidArgumentError, db.add_document(bad));
+    TEST_EQUAL(db.add_document(docs[0]), 602);
+    db.commit();
+    TEST(rdb.reopen());
+    TEST_EQUAL(rdb.get_doccount(), 602);
+
+    db.begin_transaction();
+    TEST_EXCEPTION(Xapian::InvalidOperationError, db.commit_async());
+    db.cancel_transaction();
+
+    return true;
+}
+
+/// Check iterators opened before commit_async() wait for the commit.
+DEFINE_TESTCASE(commitasync3, brass) {
+    vector<Xapian::Document> docs;
+    make_adddocuments_docs(docs);
+    Xapian::WritableDatabase db = get_writable_database();
+    for (size_t i = 0; i != docs.size(); ++i) {
+	db.add_document(docs[i]);
+    }
+    db.commit();
+
+    Xapian::TermIterator t = db.allterms_begin();
+    Xapian::PostingIterator p = db.postlist_begin("common");
+    // Give the background thread plenty to write.
+    for (int n = 0; n != 3; ++n) {
+	for (size_t i = 0; i != docs.size(); ++i) {
+	    db.add_document(docs[i]);
+	}
+    }
+    db.commit_async();
+
+    // Advancing the iterator reads the table, so it waits for the commit to
+    // finish, after which a new reader sees the commit.
+    TEST(t != db.allterms_end());
+    string prev = *t;
+    ++t;
+    Xapian::Database rdb = get_writable_database_as_database();
+    TEST_EQUAL(rdb.get_doccount(), 4000);
+    TEST_EQUAL(rdb.get_termfreq("common"), 3960);
+
+    // The iterators can still be used.
+    while (t != db.allterms_end()) {
+	TEST_REL(prev,<,*t);
+	prev = *t;
+	++t;
+    }
+    Xapian::docid did = 0;
+    Xapian::doccount count = 0;
+    while (p != db.postlist_end("common")) {
+	TEST_REL(did,<,*p);
+	did = *p;
+	++count;
+	++p;
+    }
+    TEST_REL(count,>=,990);
+
+    return true;
+}
+
+/// Check documents queued during a commit_async() are bounded by size.
+DEFINE_TESTCASE(commitasync4, brass) {
+    vector<Xapian::Document> docs;
+    make_adddocuments_docs(docs);
+    Xapian::WritableDatabase db1 =
+	get_named_writable_database("commitasync4a", string());
+    for (size_t i = 0; i != docs.size(); ++i) {
+	db1.add_document(docs[i]);
+    }
+    db1.commit();
+
+    // With a byte threshold, the queue is limited to 64K of documents rather
+    // than the default document count threshold.
+    set_flush_threshold(64K);
+    try {
+	Xapian::WritableDatabase db2 =
+	    get_named_writable_database("commitasync4b", string());
+	for (size_t i = 0; i != docs.size(); ++i) {
+	    if (i % 300 == 0) db2.commit_async();
+	    TEST_EQUAL(db2.add_document(docs[i]), i + 1);
+	}
+	db2.commit();
+	check_same_contents(db1, db2);
+    } catch (...) {
+	set_flush_threshold(0);
+	throw;
+    }
+    set_flush_threshold(0);
+
+    return true;
+}
+
+/// Check that commits within the sync window are deferred, not lost.
+DEFINE_TESTCASE(syncwindow1, brass) {
+    vector<Xapian::Document> docs;
+    make_adddocuments_docs(docs);
+
+    string db_dir = "." + get_dbtype();
+    mkdir(db_dir.c_str(), 0755);
+    db_dir += "/db__syncwindow1";
+    rm_rf(db_dir);
+
+    // Every commit after the first is within the window, so is deferred.
+    set_env_literal("XAPIAN_SYNC_WINDOW", "3600");
+    try {
+	Xapian::WritableDatabase db(db_dir,
+				    Xapian::DB_CREATE|Xapian::DB_BACKEND_BRASS|
+				    Xapian::DB_SYNC_FILESYSTEM);
+	Xapian::Database rdb(db_dir);
+	for (size_t i = 0; i != docs.size(); ++i) {
+	    db.add_document(docs[i]);
+	    if (i % 100 == 99) {
+		db.set_metadata("count", str(i + 1));
+		db.commit();
+		// The writer sees its own changes either way.
+		TEST_EQUAL(db.get_doccount(), i + 1);
+		TEST_EQUAL(db.get_metadata("count"), str(i + 1));
+		if (i == 99) {
+		    TEST(rdb.reopen());
+		} else {
+		    TEST(!rdb.reopen());
+		}
+		TEST_EQUAL(rdb.get_doccount(), 100);
+	    }
+	}
+	TEST_REL(docs.size(),>,200);
+
+	// Cancelling a transaction mustn't discard deferred commits.
+	db.begin_transaction();
+	db.add_document(docs[0]);
+	db.cancel_transaction();
+	TEST(rdb.reopen());
+	TEST_EQUAL(rdb.get_doccount(), docs.size());
+
+	db.add_document(docs[0]);
+	db.commit();
+	db.close();
+    } catch (...) {
+	set_env_literal("XAPIAN_SYNC_WINDOW", "0");
+	throw;
+    }
+    set_env_literal("XAPIAN_SYNC_WINDOW", "0");
+
+    // Closing the database wrote the deferred commit.
+    Xapian::WritableDatabase db(db_dir, Xapian::DB_OPEN);
+    TEST_EQUAL(db.get_doccount(), docs.size() + 1);
+    db.add_document(docs[0]);
+    db.commit();
+    Xapian::Database rdb(db_dir);
+    TEST_EQUAL(rdb.get_doccount(), docs.size() + 2);
+
+    return true;
+}
+
+/// Check set_sync_window(), and the limit on commits deferred in a row.
+DEFINE_TESTCASE(syncwindow2, brass) {
+    string db_dir = "." + get_dbtype();
+    mkdir(db_dir.c_str(), 0755);
+    db_dir += "/db__syncwindow2";
+    rm_rf(db_dir);
+
+    Xapian::WritableDatabase db(db_dir,
+				Xapian::DB_CREATE|Xapian::DB_BACKEND_BRASS);
+    db.set_sync_window(3600);
+    Xapian::Database rdb(db_dir);
+    for (int i = 1; i <= 150; ++i) {
+	Xapian::Document doc;
+	doc.add_term("t" + str(i));
+	db.add_document(doc);
+	db.commit();
+	(void)rdb.reopen();
+	// The first commit is written, then 100 are deferred, and the next
+	// is written because of the limit.
+	Xapian::doccount expected = (i <= 101 ? 1 : 102);
+	TEST_EQUAL(rdb.get_doccount(), expected);
+    }
+    // Turning the window off writes the commits deferred by it.
+    db.set_sync_window(0);
+    TEST(rdb.reopen());
+    TEST_EQUAL(rdb.get_doccount(), 150);
+    db.add_document(Xapian::Document());
+    db.commit();
+    TEST(rdb.reopen());
+    TEST_EQUAL(rdb.get_doccount(), 151);
+
+    return true;
+}
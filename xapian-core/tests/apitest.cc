@@ -120,6 +120,12 @@ get_writable_database_again()
     return backendmanager->get_writable_database_again();
 }
 
+int
+start_threaded_server(const string &dbpath, unsigned threads)
+{
+    return backendmanager->start_threaded_server(dbpath, threads);
+}
+
 void
 skip_test_unless_backend(const std::string & backend_prefix)
 {
@@ -336,6 +336,15 @@ BackendManager::get_writable_database_again()
     throw Xapian::InvalidOperationError(msg);
 }
 
+int
+BackendManager::start_threaded_server(const string &, unsigned)
+{
+    string msg = "Backend ";
+    msg += get_dbtype();
+    msg += " doesn't support start_threaded_server()";
+    throw Xapian::InvalidOperationError(msg);
+}
+
 void
 BackendManager::clean_up()
 {
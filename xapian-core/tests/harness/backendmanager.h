@@ -190,6 +190,14 @@ class BackendManager {
     /// Create a WritableDatabase object for the last opened WritableDatabase.
     virtual Xapian::WritableDatabase get_writable_database_again();
 
+    /** Start a xapian-tcpsrv which serves @a dbpath using a pool of threads.
+     *
+     *  Returns the port the server is listening on.  The server is stopped
+     *  by clean_up().
+     */
+    virtual int start_threaded_server(const std::string & dbpath,
+				      unsigned threads);
+
     /** Called after each test, to perform any necessary cleanup.
      *
      *  May be called more than once for a given test in some cases.
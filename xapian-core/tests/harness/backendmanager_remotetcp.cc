@@ -76,6 +76,9 @@ using namespace std;
 struct pid_fd {
     pid_t pid;
     int fd;
+    // True for a server which doesn't exit after one connection, so
+    // clean_up() needs to terminate it.
+    bool kill;
 };
 
 static pid_fd pid_to_fd[16];
@@ -93,6 +96,7 @@ on_SIGCHLD(int /*sig*/)
 		int fd = pid_to_fd[i].fd;
 		pid_to_fd[i].fd = 0;
 		pid_to_fd[i].pid = 0;
+		pid_to_fd[i].kill = false;
 		// NB close() *is* safe to use in a signal handler.
 		close(fd);
 		break;
@@ -104,7 +108,7 @@ on_SIGCHLD(int /*sig*/)
 }
 
 static int
-launch_xapian_tcpsrv(const string & args)
+launch_xapian_tcpsrv(const string & args, bool one_shot = true)
 {
     int port = DEFAULT_PORT;
 
@@ -112,10 +116,14 @@ launch_xapian_tcpsrv(const string & args)
     // if xapian-tcpsrv doesn't start listening successfully.
     signal(SIGCHLD, SIG_DFL);
 try_next_port:
-    string cmd = XAPIAN_TCPSRV" --one-shot --interface "LOCALHOST" --port " + str(port) + " " + args;
+    string cmd = XAPIAN_TCPSRV;
+    if (one_shot) cmd += " --one-shot";
+    cmd += " --interface "LOCALHOST" --port " + str(port) + " " + args;
 #ifdef HAVE_VALGRIND
     if (RUNNING_ON_VALGRIND) cmd = "./runsrv " + cmd;
 #endif
+    // Replace the shell so that clean_up() can signal the server directly.
+    if (!one_shot) cmd = "exec " + cmd;
     int fds[2];
     if (socketpair(AF_UNIX, SOCK_STREAM, PF_UNSPEC, fds) < 0) {
 	string msg("Couldn't create socketpair: ");
@@ -201,6 +209,7 @@ try_next_port:
 	if (pid_to_fd[i].pid == 0) {
 	    pid_to_fd[i].fd = tracked_fd;
 	    pid_to_fd[i].pid = child;
+	    pid_to_fd[i].kill = !one_shot;
 	    break;
 	}
     }
@@ -238,12 +247,14 @@ static void win32_throw_error_string(const char * str)
 // This implementation uses the WIN32 API to start xapian-tcpsrv as a child
 // process and read its output using a pipe.
 static int
-launch_xapian_tcpsrv(const string & args)
+launch_xapian_tcpsrv(const string & args, bool one_shot = true)
 {
     int port = DEFAULT_PORT;
 
 try_next_port:
-    string cmd = XAPIAN_TCPSRV" --one-shot --interface "LOCALHOST" --port " + str(port) + " " + args;
+    string cmd = XAPIAN_TCPSRV;
+    if (one_shot) cmd += " --one-shot";
+    cmd += " --interface "LOCALHOST" --port " + str(port) + " " + args;
 
     // Create a pipe so we can read stdout/stderr from the child process.
     HANDLE hRead, hWrite;
@@ -366,6 +377,19 @@ BackendManagerRemoteTcp::get_writable_database_again()
     return Xapian::Remote::open_writable(LOCALHOST, port);
 }
 
+int
+BackendManagerRemoteTcp::start_threaded_server(const string & dbpath,
+					       unsigned threads)
+{
+#ifdef HAVE_FORK
+    string args = "--threads " + str(threads) + " " + dbpath;
+    return launch_xapian_tcpsrv(args, false);
+#else
+    // We've no way to stop the server again after the test.
+    return BackendManager::start_threaded_server(dbpath, threads);
+#endif
+}
+
 void
 BackendManagerRemoteTcp::clean_up()
 {
@@ -374,6 +398,7 @@ BackendManagerRemoteTcp::clean_up()
     for (unsigned i = 0; i < sizeof(pid_to_fd) / sizeof(pid_fd); ++i) {
 	pid_t child = pid_to_fd[i].pid;
 	if (child) {
+	    if (pid_to_fd[i].kill) kill(child, SIGTERM);
 	    int status;
 	    while (waitpid(child, &status, 0) == -1 && errno == EINTR) { }
 	    // Other possible error from waitpid is ECHILD, which it seems can
@@ -383,6 +408,7 @@ BackendManagerRemoteTcp::clean_up()
 	    int fd = pid_to_fd[i].fd;
 	    pid_to_fd[i].fd = 0;
 	    pid_to_fd[i].pid = 0;
+	    pid_to_fd[i].kill = false;
 	    close(fd);
 	}
     }
@@ -64,6 +64,9 @@ class BackendManagerRemoteTcp : public BackendManagerRemote {
     /// Create a WritableDatabase object for the last opened WritableDatabase.
     Xapian::WritableDatabase get_writable_database_again();
 
+    /// Start a xapian-tcpsrv serving @a dbpath with a pool of @a threads.
+    int start_threaded_server(const std::string & dbpath, unsigned threads);
+
     /// Called after each test, to perform any necessary cleanup.
     void clean_up();
 };
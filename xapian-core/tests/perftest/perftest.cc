@@ -280,14 +280,15 @@ PerfTestLogger::indexing_begin(const string & dbname,
     }
     i = params.find("flush_threshold");
     if (i == params.end()) {
-	Xapian::doccount flush_threshold = 0;
+	// This may be a number of documents or a memory size (e.g. "512M").
+	string flush_threshold;
 	const char *p = getenv("XAPIAN_FLUSH_THRESHOLD");
-	if (p)
-	    flush_threshold = atoi(p);
-	if (flush_threshold == 0)
-	    flush_threshold = 10000;
+	if (p && atoi(p) != 0)
+	    flush_threshold = p;
+	else
+	    flush_threshold = "10000";
 	write("    <param name=\"flush_threshold\">" +
-	      escape_xml(str(flush_threshold)) + "</param>\n");
+	      escape_xml(flush_threshold) + "</param>\n");
     }
     write("   </params>\n");
     indexing_addcount = 0;
@@ -46,6 +46,8 @@ using namespace std;
     } while (0)
 
 // Code we're unit testing:
+#include "../common/bitpack.cc"
+#include "../common/bitstream.cc"
 #include "../common/fileutils.cc"
 #include "../common/serialise-double.cc"
 #include "../net/length.cc"
@@ -310,6 +312,78 @@ static bool test_log2()
     return true;
 }
 
+// Test bitpack_encode() and bitpack_decode() round trip for every width.
+static bool test_bitpack1()
+{
+    for (unsigned width = 0; width <= 32; ++width) {
+	unsigned in[BITPACK_BLOCK_SIZE];
+	unsigned max = width == 32 ? 0xffffffffu : (1u << width) - 1;
+	for (size_t i = 0; i != BITPACK_BLOCK_SIZE; ++i) {
+	    in[i] = (i % 3 == 0) ? max : unsigned(i * 2654435761u) & max;
+	}
+	TEST_EQUAL(bitpack_width(in, BITPACK_BLOCK_SIZE), width);
+	for (size_t n = 0; n <= BITPACK_BLOCK_SIZE; n += 37) {
+	    string s = "x";
+	    bitpack_encode(s, in, n, width);
+	    TEST_EQUAL(s.size(), 1 + (n * width + 7) / 8);
+	    s += "y";
+	    const char * p = s.data() + 1;
+	    const char * end = s.data() + s.size();
+	    unsigned out[BITPACK_BLOCK_SIZE];
+	    TEST(bitpack_decode(&p, end, out, n, width));
+	    TEST_EQUAL(*p, 'y');
+	    for (size_t i = 0; i != n; ++i) {
+		TEST_EQUAL(out[i], in[i]);
+	    }
+	    // Check truncated data is detected.
+	    if (n * width >= 8) {
+		p = s.data() + 1;
+		TEST(!bitpack_decode(&p, end - 2, out, n, width));
+	    }
+	}
+    }
+    return true;
+}
+
+// Test decode_interpolative_all() matches decode_interpolative_next().
+static bool test_bitstream1()
+{
+    vector<Xapian::termpos> in;
+    Xapian::termpos pos = 0;
+    for (unsigned i = 0; i != 300; ++i) {
+	pos += 1 + (i * 2654435761u) % (i % 7 == 0 ? 1000 : 5);
+	in.push_back(pos);
+	if (in.size() < 2) continue;
+
+	BitWriter wr;
+	wr.encode(in[0], in.back());
+	wr.encode(in.size() - 2, in.back() - in[0]);
+	wr.encode_interpolative(in, 0, in.size() - 1);
+	string s = wr.freeze();
+
+	BitReader rd(s);
+	Xapian::termpos first = rd.decode(in.back());
+	Xapian::termpos size = rd.decode(in.back() - first) + 2;
+	TEST_EQUAL(first, in[0]);
+	TEST_EQUAL(size, in.size());
+	rd.decode_interpolative(0, size - 1, first, in.back());
+	for (size_t j = 1; j != in.size(); ++j) {
+	    TEST_EQUAL(rd.decode_interpolative_next(), in[j]);
+	}
+
+	BitReader rd2(s);
+	first = rd2.decode(in.back());
+	size = rd2.decode(in.back() - first) + 2;
+	rd2.decode_interpolative(0, size - 1, first, in.back());
+	vector<Xapian::termpos> out(1, 42);
+	rd2.decode_interpolative_all(out);
+	TEST_EQUAL(out.size(), in.size() + 1);
+	TEST_EQUAL(out[0], 42);
+	TEST(equal(in.begin(), in.end(), out.begin() + 1));
+    }
+    return true;
+}
+
 static const test_desc tests[] = {
     TESTCASE(simple_exceptions_work1),
     TESTCASE(class_exceptions_work1),
@@ -320,6 +394,8 @@ static const test_desc tests[] = {
     TESTCASE(serialiselength2),
 #endif
     TESTCASE(log2),
+    TESTCASE(bitpack1),
+    TESTCASE(bitstream1),
     END_OF_TESTCASES
 };
 
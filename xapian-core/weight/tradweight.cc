@@ -149,9 +149,16 @@ TradWeight::get_sumpart(Xapian::termcount wdf, Xapian::termcount len) const
 
 double
 TradWeight::get_maxpart() const
+{
+    return TradWeight::get_maxpart_for_wdf(get_wdf_upper_bound());
+}
+
+double
+TradWeight::get_maxpart_for_wdf(Xapian::termcount wdf_max_) const
 {
     // FIXME: need to force non-zero wdf_max to stop percentages breaking...
-    double wdf_max(max(get_wdf_upper_bound(), Xapian::termcount(1)));
+    Xapian::termcount wdf_ub = min(wdf_max_, get_wdf_upper_bound());
+    double wdf_max(max(wdf_ub, Xapian::termcount(1)));
     Xapian::termcount doclen_lb = get_doclength_lower_bound();
     return termweight * (wdf_max / (doclen_lb * len_factor + wdf_max));
 }
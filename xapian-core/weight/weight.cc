@@ -115,6 +115,12 @@ Weight::init_(const Internal & stats, Xapian::termcount query_length,
 
 Weight::~Weight() { }
 
+double
+Weight::get_maxpart_for_wdf(Xapian::termcount) const
+{
+    return get_maxpart();
+}
+
 string
 Weight::name() const
 {